@@ -0,0 +1,75 @@
+#include "../include/shm_reader.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/// @brief Example consumer of the shared-memory live value table
+/// @details Prints the current value of the given items, or of every item when no path is given.
+/// Usage: shm_reader_example <segment> [<machine>/<group>/<item> ...]
+
+static void print_slot(const char* name, int length, const ShmTableSlot* value){
+
+    printf("%.*s status=0x%08" PRIx32 " ", length, name, value->status);
+
+    switch (value->type) {
+        case SHM_VALUE_BOOLEAN:
+            printf("%s", value->value.i ? "true" : "false");
+            break;
+        case SHM_VALUE_INT:
+        case SHM_VALUE_DATETIME:
+            printf("%" PRId64, value->value.i);
+            break;
+        case SHM_VALUE_UINT:
+            printf("%" PRIu64, value->value.u);
+            break;
+        case SHM_VALUE_DOUBLE:
+            printf("%g", value->value.d);
+            break;
+        case SHM_VALUE_STRING:
+            printf("\"%.*s\"", (int)value->length, value->text);
+            break;
+        default:
+            printf("(empty)");
+            break;
+    }
+
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+
+    ShmReader reader;
+    ShmTableSlot value;
+    size_t slot;
+    size_t length;
+    const char* name;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <segment> [<machine>/<group>/<item> ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!shm_reader_open(&reader, argv[1])) {
+        fprintf(stderr, "No value table in segment %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc == 2) {
+        for (size_t i = 0; i < shm_reader_count(&reader); i++) {
+            name = shm_reader_entry(&reader, i, &length, &slot);
+            if (shm_reader_read(&reader, slot, &value)) print_slot(name, (int)length, &value);
+        }
+    }
+
+    for (int i = 2; i < argc; i++) {
+        if (!shm_reader_find(&reader, argv[i], &slot)) {
+            fprintf(stderr, "Unknown item %s\n", argv[i]);
+            continue;
+        }
+        if (shm_reader_read(&reader, slot, &value)) print_slot(argv[i], -1, &value);
+    }
+
+    shm_reader_close(&reader);
+    return EXIT_SUCCESS;
+}
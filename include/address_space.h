@@ -0,0 +1,164 @@
+#ifndef ADDRESS_SPACE_H
+#define ADDRESS_SPACE_H
+
+#include "common.h"
+#include "machine_config.h"
+
+#include <open62541/server.h>
+#include <open62541/plugin/nodestore.h>
+
+/// @brief Header file for the numeric NodeId layout of the gateway namespaces
+/// @file address_space.h
+/// @details Every machine owns one namespace. Inside it, the machine object is `i=1`,
+/// the groups follow from `i=2` in configuration order and the items of all groups
+/// come right after the last group, again in configuration order.
+/// The "<machine>/<group>/<item>" paths of the nodes are indexed in a hash table built
+/// with the layout, so browse paths resolve without walking the references.
+
+typedef struct OnDemand OnDemand;
+
+/// @brief Numeric identifier of the machine object inside its namespace
+#define ADDRESS_SPACE_MACHINE_ID 1
+
+/// @brief Numeric identifier of the first group object inside a machine namespace
+#define ADDRESS_SPACE_FIRST_GROUP_ID 2
+
+/// @brief Maximum length of a path in the path index, longer paths are not indexed
+#define ADDRESS_SPACE_MAX_PATH 1024
+
+typedef enum {
+    ADDRESS_SPACE_NODE_MACHINE,
+    ADDRESS_SPACE_NODE_GROUP,
+    ADDRESS_SPACE_NODE_ITEM
+} AddressSpaceNodeKind;
+
+typedef struct {
+    MachineConfig* config;
+    UA_UInt16 namespace_index;
+    size_t first_item;
+    size_t item_count;
+    size_t first_group;        ///< Global index of the first group of the machine
+    size_t* group_first_item;
+} AddressSpaceMachine;
+
+typedef struct {
+    AddressSpaceNodeKind kind;
+    size_t machine;
+    size_t group;
+    size_t item;
+} AddressSpaceNode;
+
+typedef struct {
+    UA_UInt32 hash;            ///< FNV-1a hash of the path
+    UA_UInt32 node;            ///< (kind + 1) << 30 | global index of the node, 0 for an empty slot
+} AddressSpacePath;
+
+typedef struct {
+    ArrayMachineConfig* config;
+    size_t count;
+    AddressSpaceMachine* machines;
+    size_t item_count;
+    size_t group_count;
+    size_t namespace_count;
+    AddressSpaceMachine** by_namespace;
+    AddressSpacePath* paths;   ///< Open-addressing index of the machine, group and item paths
+    size_t path_capacity;      ///< Number of slots, a power of two
+    OnDemand* on_demand;       ///< Reads the ondemand items on the machines when clients read them, may be NULL
+} AddressSpace;
+
+/// @brief Initialize the layout of the gateway namespaces
+/// @param address_space Pointer to the AddressSpace structure to initialize
+/// @param config Machine configurations described by the layout
+/// @note The configurations must outlive the layout. Namespaces are only known after `address_space_register_namespaces`.
+void init_address_space(AddressSpace* address_space, ArrayMachineConfig* config);
+
+/// @brief Register one namespace per machine in the server
+/// @param address_space Pointer to the initialized AddressSpace
+/// @param server Pointer to the UA_Server instance
+/// @note Machines sharing a namespace URI with a previous machine are not reachable and a warning is logged.
+void address_space_register_namespaces(AddressSpace* address_space, UA_Server* server);
+
+/// @brief Resolve a NodeId to a machine, group or item of the layout
+/// @param address_space Pointer to the AddressSpace to search
+/// @param node_id The NodeId to resolve
+/// @param node Output receiving the resolved position
+/// @return true if the NodeId belongs to the gateway namespaces, false otherwise
+/// @note For items, `node->item` is the index of the item inside its machine.
+bool address_space_resolve(const AddressSpace* address_space, const UA_NodeId* node_id, AddressSpaceNode* node);
+
+/// @brief Build the NodeId of a machine, group or item of the layout
+/// @param address_space Pointer to the AddressSpace
+/// @param node The position to convert
+/// @return The numeric NodeId of the node (no memory is allocated)
+UA_NodeId address_space_node_id(const AddressSpace* address_space, const AddressSpaceNode* node);
+
+/// @brief Get the browse name of a machine, group or item
+/// @param address_space Pointer to the AddressSpace
+/// @param node Position of the node
+/// @return A browse name pointing into the machine configuration (no memory is allocated)
+UA_QualifiedName address_space_browse_name(const AddressSpace* address_space, const AddressSpaceNode* node);
+
+/// @brief Link the machine objects of the layout below the Objects folder
+/// @param server Pointer to the UA_Server instance
+/// @param address_space Layout with registered namespaces
+/// @return UA_STATUSCODE_GOOD on success
+/// @note Only the Objects folder is modified through the nodestore, the machine nodes are provided by the gateway nodestore.
+UA_StatusCode address_space_link_machines(UA_Server* server, const AddressSpace* address_space);
+
+/// @brief Add a reference to a node built by a gateway nodestore
+/// @param node The node receiving the reference
+/// @param reference_type Index of the reference type (UA_REFERENCETYPEINDEX_*)
+/// @param forward Direction of the reference
+/// @param target NodeId of the target node
+/// @param target_name Browse name of the target, used to compute the browse name hash
+/// @return The status of UA_Node_addReference
+UA_StatusCode address_space_add_reference(UA_Node* node, UA_Byte reference_type, UA_Boolean forward,
+                                          UA_NodeId target, UA_QualifiedName target_name);
+
+/// @brief Get the item configuration of a resolved item node
+/// @param address_space Pointer to the AddressSpace
+/// @param node Position of an item
+/// @return Pointer to the Item in the machine configuration
+const Item* address_space_item(const AddressSpace* address_space, const AddressSpaceNode* node);
+
+/// @brief Get the global index of an item, counted across all machines
+/// @param address_space Pointer to the AddressSpace
+/// @param node Position of an item
+/// @return Index in the range [0, address_space->item_count)
+size_t address_space_item_index(const AddressSpace* address_space, const AddressSpaceNode* node);
+
+/// @brief Find the position of an item from its global index
+/// @param address_space Pointer to the AddressSpace
+/// @param index Global index of the item
+/// @param node Output receiving the item position
+/// @return true if the index is in range, false otherwise
+bool address_space_item_at(const AddressSpace* address_space, size_t index, AddressSpaceNode* node);
+
+/// @brief Write the path of an item, "<machine>/<group>/<item>" after the names of the configuration
+/// @param address_space Pointer to the AddressSpace
+/// @param index Global index of the item
+/// @param buffer Output receiving the path, truncated to its size
+/// @param size Size of the buffer
+/// @return Length of the complete path, as snprintf, 0 if the index is out of range
+size_t address_space_item_path(const AddressSpace* address_space, size_t index, char* buffer, size_t size);
+
+/// @brief Find a machine, group or item from its path
+/// @param address_space Pointer to the AddressSpace
+/// @param path "<machine>", "<machine>/<group>" or "<machine>/<group>/<item>", not necessarily terminated
+/// @param length Length of the path
+/// @param node Output receiving the position
+/// @return true if the path belongs to the layout, false otherwise
+/// @note When several nodes share a path, the first one in configuration order is found.
+bool address_space_find_path(const AddressSpace* address_space, const char* path, size_t length, AddressSpaceNode* node);
+
+/// @brief Map an item type of the machine files to an OPC UA data type
+/// @param type Type name as written in the machine files (e.g. "System.Int16")
+/// @return The matching data type, or the Variant type (BaseDataType) when the name is unknown
+const UA_DataType* address_space_data_type(const char* type);
+
+/// @brief Free the memory allocated for the layout
+/// @param address_space Pointer to the AddressSpace structure to free
+/// @note The machine configurations themselves are not freed.
+void free_address_space(AddressSpace* address_space);
+
+#endif // ADDRESS_SPACE_H
@@ -0,0 +1,88 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "common.h"
+#include "gateway.h"
+
+#include <open62541/types.h>
+
+/// @brief Header file for the windowed aggregates of the groups
+/// @file aggregate.h
+/// @details A group listing "Aggregates" windows gets Min, Max, Mean, Count and StdDev items
+/// per numeric item and window (see machine_config.h). Each window is split in
+/// AGGREGATE_BUCKETS time buckets holding count, mean, sum of squared deviations (M2), min and
+/// max. A new value updates the current bucket with Welford's method; a bucket leaving the window
+/// is dropped. The statistics of a window merge its buckets with the pairwise formula of Chan et al.
+/// when it is published, so no running total accumulates rounding errors or cancels out for values
+/// with a large offset. Raw values are never kept nor rescanned.
+/// The aggregate items are refreshed every AGGREGATE_PUBLISH_INTERVAL through the gateway queues.
+
+/// @brief Number of buckets of a window, the window slides by window / AGGREGATE_BUCKETS
+#define AGGREGATE_BUCKETS 60
+
+/// @brief Interval of the aggregate refresh callback in milliseconds
+#define AGGREGATE_PUBLISH_INTERVAL 250.0
+
+typedef struct {
+    UA_UInt64 count;
+    UA_Double mean;
+    UA_Double m2;              ///< Sum of the squared deviations from the mean
+    UA_Double min;
+    UA_Double max;
+} AggregateBucket;
+
+typedef struct {
+    AggregateBucket buckets[AGGREGATE_BUCKETS];
+    UA_DateTime width;
+    UA_DateTime head_start;
+    size_t head;
+    UA_UInt64 count;           ///< Values in the buckets of the window
+    bool changed;
+} AggregateWindow;
+
+typedef struct {
+    size_t first_output;
+    size_t window_count;
+    AggregateWindow* windows;
+} AggregateSource;
+
+struct Aggregates {
+    Gateway* gateway;
+    size_t count;
+    size_t* by_item;
+    AggregateSource* sources;
+    UA_UInt64 callback_id;
+};
+
+/// @brief Item index of items without aggregates in `by_item`
+#define AGGREGATE_NONE ((size_t)-1)
+
+/// @brief Find the aggregated items of the layout and attach the aggregates to the gateway
+/// @param aggregates Pointer to the Aggregates structure to initialize
+/// @param gateway The gateway receiving the aggregate values, must outlive the aggregates
+void init_aggregates(Aggregates* aggregates, Gateway* gateway);
+
+/// @brief Add a value of an item to its windows
+/// @param aggregates The aggregates
+/// @param item Global index of the item
+/// @param value The value, ignored unless it is a good numeric or boolean scalar
+/// @param now Current time of the monotonic clock (UA_DateTime_nowMonotonic)
+void aggregates_update(Aggregates* aggregates, size_t item, const UA_DataValue* value, UA_DateTime now);
+
+/// @brief Push the aggregate values of the windows that changed into the gateway queues
+/// @param aggregates The aggregates
+/// @param now Current time of the monotonic clock (UA_DateTime_nowMonotonic)
+/// @return Number of windows published
+size_t aggregates_publish(Aggregates* aggregates, UA_DateTime now);
+
+/// @brief Add the aggregate refresh callback to the server
+/// @param aggregates The aggregates
+/// @param server Pointer to the UA_Server instance
+/// @return UA_STATUSCODE_GOOD on success
+UA_StatusCode aggregates_start(Aggregates* aggregates, UA_Server* server);
+
+/// @brief Detach the aggregates from the gateway and free them
+/// @param aggregates Pointer to the Aggregates structure to free
+void free_aggregates(Aggregates* aggregates);
+
+#endif // AGGREGATE_H
@@ -0,0 +1,100 @@
+#ifndef ALARMS_H
+#define ALARMS_H
+
+#include "common.h"
+#include "gateway.h"
+
+#include <open62541/server.h>
+
+/// @brief Header file for the limit alarms of the items
+/// @file alarms.h
+/// @details An item or a Group with "Limits" (HighHigh, High, Low, LowLow and a Hysteresis, see
+/// machine_config.h) gets an alarm in the gateway. The values published by gateway_publish are staged
+/// in columns, and the whole update set is evaluated in one pass at the end of the publish callback,
+/// with AVX or SSE2 when the CPU has them and in scalar code otherwise. A value enters a state when it
+/// reaches its limit and leaves it once it is back inside the limit by more than the Hysteresis, so a
+/// value hovering around a limit does not toggle the alarm.
+/// alarms_start creates one condition of ExclusiveLimitAlarmType per alarm, named after the path of its item.
+/// Its event is fired on the Server object only when the state of the alarm changes: SourceNode and
+/// SourceName name the item, ActiveState and LimitState/CurrentState give the new state, Severity is 900
+/// for HighHigh and LowLow, 500 for High and Low and 100 back to normal.
+/// Clients subscribe to the events of the Server object instead of monitoring every analog value.
+/// A value with a bad status is a quality transition: the condition becomes inactive with that Quality
+/// and severity 500, so an alarm never stays latched on a machine that went Bad, and the next value with
+/// a number fires the state it is in with a Good Quality. Strings and arrays leave the alarm unchanged.
+
+/// @brief Alarm of an item without limits
+#define ALARM_NONE SIZE_MAX
+
+typedef enum {
+    ALARM_LOW_LOW = -2,
+    ALARM_LOW = -1,
+    ALARM_NORMAL = 0,
+    ALARM_HIGH = 1,
+    ALARM_HIGH_HIGH = 2
+} AlarmLevel;
+
+typedef struct Alarms {
+    Gateway* gateway;
+    UA_Server* server;         ///< Server firing the events, NULL until alarms_start
+    UA_NodeId condition_type;  ///< ExclusiveLimitAlarmType
+    size_t count;              ///< Items with limits
+    size_t* items;             ///< Global index of the item of each alarm
+    const ItemLimits** limits; ///< Limits of each alarm, in the machine configuration
+    size_t* by_item;           ///< Alarm of each item, ALARM_NONE without limits
+    UA_NodeId* conditions;     ///< Condition of each alarm, null until alarms_start or when its creation failed
+    double* level;             ///< AlarmLevel of each alarm
+    UA_StatusCode* quality;    ///< Good, or the status of the bad value that made the state unknown
+    bool* is_staged;           ///< The alarm has a row in the current update set
+    size_t staged;             ///< Rows of the current update set, at most one per alarm
+    size_t* rows;              ///< Alarm of each row
+    bool* restored;            ///< The value of the row is the first with a number after a bad one
+    UA_DateTime* times;        ///< Source time of the value of each row
+    double* value;             ///< Columns of the evaluation, one row per staged value
+    double* high_high;
+    double* high;
+    double* low;
+    double* low_low;
+    double* hysteresis;
+    double* current;
+    double* next;
+    UA_UInt64 events;          ///< State and quality transitions
+} Alarms;
+
+/// @brief Create the alarms of the items with limits and attach them to the gateway
+/// @param alarms Pointer to the Alarms structure to initialize
+/// @param gateway The gateway, its published values are evaluated
+/// @note Nothing is attached when no item has limits.
+void init_alarms(Alarms* alarms, Gateway* gateway);
+
+/// @brief Create the conditions of the alarms on a server
+/// @param alarms The alarms
+/// @param server Pointer to the UA_Server instance
+/// @return UA_STATUSCODE_GOOD on success, or when there is no alarm
+/// @note An alarm whose condition cannot be created is still evaluated, without events, and a warning is logged.
+UA_StatusCode alarms_start(Alarms* alarms, UA_Server* server);
+
+/// @brief Stage a value published for an item
+/// @param alarms The alarms
+/// @param item Global index of the item
+/// @param value The value, only read
+/// @note An alarm staged twice in the same update set flushes the set first, so that no transition is lost.
+/// A value with a bad status is a quality transition, fired at once.
+void alarms_stage(Alarms* alarms, size_t item, const UA_DataValue* value);
+
+/// @brief Evaluate the staged values and fire the events of the alarms changing state
+/// @param alarms The alarms
+/// @return Number of transitions, quality restorations included
+size_t alarms_flush(Alarms* alarms);
+
+/// @brief Compute the next level of staged rows
+/// @param alarms The alarms, the value, limit, hysteresis and current columns are read
+/// @param count Number of rows to evaluate
+/// @note Fills the next column. Exposed for the tests, the flush calls it.
+void alarms_evaluate(Alarms* alarms, size_t count);
+
+/// @brief Detach the alarms from the gateway and free them
+/// @param alarms Pointer to the Alarms structure to free
+void free_alarms(Alarms* alarms);
+
+#endif // ALARMS_H
@@ -0,0 +1,35 @@
+#ifndef COMPILED_MACHINES_H
+#define COMPILED_MACHINES_H
+
+#include "common.h"
+#include "machine_config.h"
+
+/// @brief Header file for the machine configurations compiled into the server
+/// @file compiled_machines.h
+/// @details `make MACHINES=/path/to/machines` loads the machine files at build time with the same parser as the
+/// server (bin/compile_machines), writes them as static C tables and links them into bin/opcuaserver.
+/// Started without a machine folder, the server serves the compiled machines: no file is read or parsed and
+/// no configuration is allocated at startup. Started with a machine folder, it loads the folder as before,
+/// so a compiled binary can still serve other machines.
+///
+/// The generated file defines COMPILED_MACHINE_COUNT, COMPILED_MACHINES_SOURCE and the
+/// COMPILED_MACHINE_TABLE array, and is included by compiled_machines.c when COMPILED_MACHINES names it.
+
+/// @brief Load the machine configurations compiled into the server
+/// @param array_machine_config Output pointing to the static tables, marked as compiled
+/// @return false if the server was built without compiled machines
+/// @note free_array_machine_config only resets a compiled array.
+bool load_compiled_machine_config(ArrayMachineConfig* array_machine_config);
+
+/// @brief Folder the compiled machines were loaded from
+/// @return The path given at build time, NULL without compiled machines
+const char* compiled_machines_source(void);
+
+/// @brief Write machine configurations as C tables
+/// @param array_machine_config The configurations, as loaded by load_machine_config
+/// @param source Folder of the configurations, kept in the generated file
+/// @param out The generated C file
+/// @return false if writing failed
+bool write_compiled_machine_config(const ArrayMachineConfig* array_machine_config, const char* source, FILE* out);
+
+#endif // COMPILED_MACHINES_H
@@ -0,0 +1,132 @@
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include "common.h"
+
+#include <signal.h>
+#include <stdint.h>
+#include <json.h>
+#include <open62541/client.h>
+
+/// @brief Header file for the browse of an upstream server by bin/discover
+/// @file discovery.h
+/// @details Browses the subtree of a node breadth first and reads the DataType attribute of its variables.
+/// Each Browse, BrowseNext and Read request carries a batch of nodes (up to the operation limits of the
+/// server) and several requests are kept in flight on the session.
+/// A discovery only produces Subscriptions when it is complete: every object browsed to its last
+/// continuation point and every variable typed. A node answered with a transient status (timeout, no
+/// continuation point or resource left on the server) is sent again, up to DISCOVER_MAX_ATTEMPTS times;
+/// any other bad status, on the service or on a node, aborts the discovery.
+
+/// @brief Sends of a node before a transient status aborts the discovery
+#define DISCOVER_MAX_ATTEMPTS 5
+/// @brief References returned per node before a continuation point
+#define DISCOVER_MAX_REFERENCES 1000
+/// @brief Timeout of an iteration of the client while requests are in flight, in milliseconds
+#define DISCOVER_ITERATE_TIMEOUT 50
+
+typedef struct {
+    UA_NodeId node;
+    size_t parent;           ///< Index of the parent object, SIZE_MAX for the root
+    char* name;              ///< Browse name
+    size_t attempts;         ///< Browse requests that ended in a transient status
+} DiscoverObject;
+
+typedef struct {
+    UA_NodeId node;
+    size_t parent;           ///< Index of the object holding the variable
+    char* name;              ///< Browse name
+    UA_NodeId data_type;     ///< Null until the DataType attribute is read
+    size_t attempts;         ///< Read requests that ended in a transient status
+} DiscoverVariable;
+
+typedef struct {
+    UA_ByteString point;
+    size_t object;           ///< Object whose references continue
+} DiscoverContinuation;
+
+typedef struct {
+    UA_Client* client;
+    size_t browse_batch;
+    size_t read_batch;
+    size_t pipeline;
+    DiscoverObject* objects;
+    size_t object_count;
+    size_t object_capacity;
+    size_t browsed;          ///< Objects already sent in a Browse request
+    DiscoverVariable* variables;
+    size_t variable_count;
+    size_t variable_capacity;
+    size_t typed;            ///< Variables already sent in a Read request
+    DiscoverContinuation* continuations;
+    size_t continuation_count;
+    size_t continuation_capacity;
+    size_t* browse_retries;  ///< Objects to browse again from their first reference
+    size_t browse_retry_count;
+    size_t browse_retry_capacity;
+    size_t* read_retries;    ///< Variables to read again
+    size_t read_retry_count;
+    size_t read_retry_capacity;
+    size_t* seen;            ///< Open-addressing set of the nodes found, (index << 1 | is_variable) + 1, 0 if empty
+    size_t seen_count;
+    size_t seen_capacity;
+    size_t in_flight;
+    size_t requests;
+    size_t retries;          ///< Nodes sent again after a transient status
+    UA_StatusCode status;    ///< First error that aborted the discovery
+} Discovery;
+
+/// @brief Initialize a discovery of the subtree of a node
+/// @param discovery Pointer to the Discovery structure to initialize
+/// @param client Connected client, NULL when the results are fed with discovery_browsed and discovery_typed
+/// @param root Node whose subtree is browsed, copied
+/// @param root_name Browse name of the root, copied
+/// @param browse_batch Nodes per Browse and BrowseNext request
+/// @param read_batch Nodes per Read request
+/// @param pipeline Requests in flight on the session
+void init_discovery(Discovery* discovery, UA_Client* client, const UA_NodeId* root, const char* root_name,
+                    size_t browse_batch, size_t read_batch, size_t pipeline);
+
+/// @brief Browse the subtree and read the types of its variables
+/// @param discovery The discovery
+/// @param running Cleared by a signal handler to interrupt the discovery
+/// @return UA_STATUSCODE_GOOD when the discovery is complete, the status that aborted it otherwise
+/// @note Interrupted, the discovery ends with UA_STATUSCODE_BADSHUTDOWN. Requests still in flight when it is
+/// aborted are cancelled by disconnecting the client.
+UA_StatusCode discovery_run(Discovery* discovery, const volatile sig_atomic_t* running);
+
+/// @brief Collect the results of a Browse or BrowseNext request
+/// @param discovery The discovery
+/// @param objects Object of each node of the request
+/// @param count Number of nodes of the request
+/// @param service_result Service result of the response
+/// @param results Results of the response
+/// @param results_size Number of results
+/// @note Found nodes are added once, objects being reachable through several hierarchical references.
+/// Namespace 0, other servers and properties are skipped.
+void discovery_browsed(Discovery* discovery, const size_t* objects, size_t count, UA_StatusCode service_result,
+                       const UA_BrowseResult* results, size_t results_size);
+
+/// @brief Collect the results of a Read request of DataType attributes
+/// @param discovery The discovery
+/// @param variables Variable of each node of the request
+/// @param count Number of nodes of the request
+/// @param service_result Service result of the response
+/// @param results Results of the response
+/// @param results_size Number of results
+/// @note A variable whose DataType is not a NodeId stays untyped, the gateway serves it as a Variant.
+void discovery_typed(Discovery* discovery, const size_t* variables, size_t count, UA_StatusCode service_result,
+                     const UA_DataValue* results, size_t results_size);
+
+/// @brief Build the Subscriptions of the machine file, one Group per object holding variables
+/// @param discovery The discovery
+/// @return A new json array, NULL unless the discovery is complete
+/// @note A Group is named after the browse names of its object below the root, joined by dots, and holds
+/// one Item per variable with its NodeId and the type read from its DataType attribute.
+struct json_object* discovery_subscriptions(const Discovery* discovery);
+
+/// @brief Free the memory of a discovery
+/// @param discovery Pointer to the Discovery structure to free
+void free_discovery(Discovery* discovery);
+
+#endif // DISCOVERY_H
@@ -0,0 +1,117 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include "common.h"
+#include "gateway.h"
+
+#include <open62541/types.h>
+
+/// @brief Header file for the derived items computed from other items
+/// @file expression.h
+/// @details An item with an "Expression" (see machine_config.h) is compiled once at startup into a
+/// postfix program over the latest values of the items it references. References are written
+/// between braces: {ITEM} in the same group, {GROUP/ITEM} in the same machine or
+/// {MACHINE/GROUP/ITEM}. Operators are, by increasing precedence: `? :`, `||`, `&&`, `==` `!=`,
+/// `<` `<=` `>` `>=`, `+` `-`, `*` `/` `%`, unary `-` `!`, and the functions abs, min, max,
+/// sqrt, round. Booleans are 1 and 0. For each referenced item the gateway keeps the list of
+/// expressions depending on it, so a change re-evaluates those expressions only. A derived
+/// item is published when its result changes, and may itself be referenced by other expressions.
+
+/// @brief Maximum number of values on the evaluation stack of an expression
+#define EXPRESSION_MAX_STACK 32
+
+typedef enum {
+    EXPRESSION_CONSTANT,
+    EXPRESSION_ITEM,
+    EXPRESSION_NEGATE,
+    EXPRESSION_NOT,
+    EXPRESSION_ABS,
+    EXPRESSION_SQRT,
+    EXPRESSION_ROUND,
+    EXPRESSION_ADD,
+    EXPRESSION_SUBTRACT,
+    EXPRESSION_MULTIPLY,
+    EXPRESSION_DIVIDE,
+    EXPRESSION_MODULO,
+    EXPRESSION_LESS,
+    EXPRESSION_LESS_EQUAL,
+    EXPRESSION_GREATER,
+    EXPRESSION_GREATER_EQUAL,
+    EXPRESSION_EQUAL,
+    EXPRESSION_NOT_EQUAL,
+    EXPRESSION_AND,
+    EXPRESSION_OR,
+    EXPRESSION_MIN,
+    EXPRESSION_MAX,
+    EXPRESSION_SELECT
+} ExpressionOp;
+
+typedef struct {
+    ExpressionOp op;
+    union {
+        UA_Double constant;
+        size_t item;
+    } operand;
+} ExpressionInstruction;
+
+typedef struct {
+    size_t item;
+    const UA_DataType* type;
+    size_t length;
+    ExpressionInstruction* code;
+    bool has_result;
+    UA_Double result;
+    UA_StatusCode status;
+    UA_StatusCode error;  ///< Published instead of the result when the expression, or one it depends on, is dropped
+} Expression;
+
+struct Expressions {
+    Gateway* gateway;
+    size_t count;
+    Expression* expressions;
+    UA_Double* values;
+    bool* known;
+    size_t* dependents_offset;
+    size_t* dependents;
+};
+
+/// @brief Compile the text of an expression
+/// @param expression The expression receiving the program, its item and type are left untouched
+/// @param text Source text of the expression
+/// @param address_space Layout used to resolve the item references
+/// @param position Item owning the expression, references without machine or group are relative to it
+/// @param error Output receiving the reason of a failure
+/// @param error_size Size of the error buffer
+/// @return true on success, the caller frees the program with free_expression
+bool expression_compile(Expression* expression, const char* text, const AddressSpace* address_space,
+                        const AddressSpaceNode* position, char* error, size_t error_size);
+
+/// @brief Run the program of an expression
+/// @param expression A compiled expression
+/// @param values Latest value of every item, indexed by global item index
+/// @return The result, NAN or an infinity when it is undefined (e.g. division by zero)
+UA_Double expression_evaluate(const Expression* expression, const UA_Double* values);
+
+/// @brief Free the program of an expression
+/// @param expression The expression
+void free_expression(Expression* expression);
+
+/// @brief Compile the expressions of the layout and attach them to the gateway
+/// @param expressions Pointer to the Expressions structure to initialize
+/// @param gateway The gateway receiving the derived values, must outlive the expressions
+/// @note Expressions that fail to compile or take part in a reference cycle are reported and dropped, and so
+/// are the expressions depending on them: all are published once with BadConfigurationError. Expressions
+/// without reference are published right away.
+void init_expressions(Expressions* expressions, Gateway* gateway);
+
+/// @brief Re-evaluate the expressions depending on an item after it changed
+/// @param expressions The expressions
+/// @param item Global index of the item
+/// @param value The new value of the item
+void expressions_update(Expressions* expressions, size_t item, const UA_DataValue* value);
+
+/// @brief Detach the expressions from the gateway and free them
+/// @param expressions Pointer to the Expressions structure to free
+void free_expressions(Expressions* expressions);
+
+#endif // EXPRESSION_H
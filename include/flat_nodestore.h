@@ -0,0 +1,26 @@
+#ifndef FLAT_NODESTORE_H
+#define FLAT_NODESTORE_H
+
+#include "common.h"
+#include "address_space.h"
+
+#include <open62541/server.h>
+#include <open62541/plugin/nodestore.h>
+
+/// @brief Header file for the flat nodestore of the gateway namespaces
+/// @file flat_nodestore.h
+/// @details The gateway namespaces are not stored as nodes. Item values live in one array
+/// indexed by the global item index, the other attributes come from a few immutable templates
+/// shared per (data type, access level), and references follow from the Machine/Group/Item
+/// hierarchy. A short-lived node is assembled when the server asks for a gateway node and
+/// discarded when it is released. Every other node goes to the default nodestore.
+/// @note Gateway nodes are not visited by `iterate`, and references added to them by clients are not kept.
+
+/// @brief Install the flat gateway nodestore in a server configuration
+/// @param config Server configuration holding the default nodestore, which becomes the fallback
+/// @param address_space Layout of the gateway namespaces, must outlive the server
+/// @return UA_STATUSCODE_GOOD on success, UA_STATUSCODE_BADOUTOFMEMORY otherwise
+/// @note Must be called before `UA_Server_newWithConfig`. The nodestore is freed with the server.
+UA_StatusCode flat_nodestore_install(UA_ServerConfig* config, AddressSpace* address_space);
+
+#endif // FLAT_NODESTORE_H
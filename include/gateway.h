@@ -0,0 +1,166 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include "common.h"
+#include "address_space.h"
+#include "item_queue.h"
+#include "shm_table.h"
+
+#include <open62541/server.h>
+
+/// @brief Header file for the value pipeline between upstream and the address space
+/// @file gateway.h
+/// @details Values received from upstream are pushed into the bounded queue of their item.
+/// A repeated server callback publishes the queued values into the gateway nodes, one value
+/// per item and per turn so that a busy item cannot starve the others. Items wait in the list
+/// of the priority class of their Group; each round of the scheduler takes up to GATEWAY_WEIGHT_HIGH,
+/// GATEWAY_WEIGHT_NORMAL and GATEWAY_WEIGHT_LOW items from the classes in that order, so flags are
+/// published ahead of a burst of bulk data without starving it. The latency of each value, from
+/// reception to publish, is measured per class against the target of its Group and exposed below
+/// Objects/Gateway/Priorities, averaged over the recent values so that a class missing its target shows. Queue overflows are
+/// counted per Group and exposed below Objects/Gateway/QueueOverflows. When a shared-memory
+/// table is attached, published values are copied into it as well. When aggregates are
+/// attached, every value received is added to the windows of its item, even if it overflows.
+/// Likewise, attached expressions depending on an item are re-evaluated when it receives a value.
+/// The binary encoding of the current value of each item node is kept next to its queue:
+/// a value whose value and status encode to the same bytes is not written again, which spares the node
+/// write and the change detection of every monitored item on it. A timestamp-only change therefore leaves
+/// the node timestamps behind, like the default StatusValue trigger of the monitored items; the cached
+/// encoding takes the new timestamps. Such values are counted below Objects/Gateway/UnchangedValues.
+/// The same encodings serve the snapshot and the replication sync, so these never read the nodes back
+/// from the server. When a replication is attached, published values are
+/// streamed to the standby gateway. When alarms are attached, the values published by one call of
+/// gateway_publish are evaluated against the limits of their items together, at the end of the call.
+
+/// @brief Interval of the publish callback in milliseconds
+#define GATEWAY_PUBLISH_INTERVAL 10.0
+
+/// @brief Maximum number of values published per callback
+#define GATEWAY_PUBLISH_BUDGET 10000
+
+/// @brief Items taken from each priority class per scheduler round
+#define GATEWAY_WEIGHT_HIGH 8
+#define GATEWAY_WEIGHT_NORMAL 3
+#define GATEWAY_WEIGHT_LOW 1
+
+/// @brief Number of values weighted by the recent latency and late share of a priority class
+/// @note Both are exponential moving averages, each value weighs 1/GATEWAY_LATENCY_SAMPLES of the average.
+#define GATEWAY_LATENCY_SAMPLES 100
+
+/// @brief Size of the stack buffer encoding the published values, larger values are encoded on the heap
+#define GATEWAY_ENCODED_MAX 256
+
+/// @brief Namespace URI of the gateway diagnostic nodes
+#define GATEWAY_NAMESPACE "urn:opcuaserver:gateway"
+
+typedef struct Aggregates Aggregates;
+typedef struct Alarms Alarms;
+typedef struct Expressions Expressions;
+typedef struct Replication Replication;
+typedef struct ShardRing ShardRing;
+
+/// @brief Items with queued values of one priority class and their publish latencies
+typedef struct {
+    size_t* pending;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    UA_UInt64 published;
+    UA_UInt64 late;           ///< Values published after the target latency of their Group
+    UA_Double recent_late;    ///< Share of the recent values published late, from 0 to 1
+    UA_Double recent_latency; ///< Milliseconds from reception to publish of the recent values
+    UA_Double max_latency;    ///< Milliseconds from reception to publish
+} GatewayClass;
+
+typedef struct {
+    AddressSpace* address_space;
+    ItemQueue* queues;
+    bool* is_pending;
+    UA_Byte* item_class;
+    GatewayClass classes[PRIORITY_CLASS_COUNT];
+    size_t* machine_blocked;
+    size_t* first_group;      ///< First global group of each machine, the entry after the last machine is the group count
+    UA_UInt64* group_overflows;
+    UA_ByteString* encoded;   ///< Encoding of the current value of each item node, see gateway_written()
+    UA_UInt64 unchanged;
+    UA_UInt16 namespace_index;
+    UA_UInt64 callback_id;
+    ShmTable* shm;
+    Aggregates* aggregates;
+    Expressions* expressions;
+    Replication* replication;
+    Alarms* alarms;
+    ShardRing* shard;         ///< Set in a shard worker: values go to the front process instead of the queues
+} Gateway;
+
+/// @brief Initialize the queues of every item of the layout
+/// @param gateway Pointer to the Gateway structure to initialize
+/// @param address_space Layout of the gateway namespaces, must outlive the gateway
+/// @note Queue size and overflow policy come from the Group of each item.
+void init_gateway(Gateway* gateway, AddressSpace* address_space);
+
+/// @brief Queue a value received from upstream
+/// @param gateway The gateway
+/// @param item Global index of the item
+/// @param value The value, moved into the queue and reset
+/// @return true if the value was queued without loss, false if the queue overflowed or the item is unknown
+/// @note In a shard worker the value is written to the ring of the worker instead (see shard.h), a value the
+/// full ring drops counts as an overflow of its Group.
+bool gateway_push(Gateway* gateway, size_t item, UA_DataValue* value);
+
+/// @brief Queue the last known value of an item, e.g. restored from a snapshot
+/// @param gateway The gateway
+/// @param item Global index of the item
+/// @param value The value, moved into the queue and reset
+/// @return true if the value was queued without loss, false if the queue overflowed or the item is unknown
+/// @note Unlike gateway_push, the value is not a new sample: aggregate windows and expressions do not see it.
+bool gateway_preload(Gateway* gateway, size_t item, UA_DataValue* value);
+
+/// @brief Current value of an item node
+/// @param gateway The gateway
+/// @param item Global index of the item
+/// @param value Receives a copy of the value, without server timestamp
+/// @return false if the node holds no value yet or the item is unknown
+/// @note The value is decoded from the cache of unchanged values, the node itself is not read.
+bool gateway_current(const Gateway* gateway, size_t item, UA_DataValue* value);
+
+/// @brief Check if the upstream subscription of a machine must pause
+/// @param gateway The gateway
+/// @param machine Index of the machine in the layout
+/// @return true while one of the machine's Block queues is full
+bool gateway_machine_blocked(const Gateway* gateway, size_t machine);
+
+/// @brief Read a good numeric or boolean scalar as a double
+/// @param value The value to convert
+/// @param result The converted value
+/// @return false if the value has no usable number, e.g. a bad status, a string or an array
+bool gateway_value_to_double(const UA_DataValue* value, UA_Double* result);
+
+/// @brief Record a value written into an item node outside gateway_publish
+/// @param gateway The gateway
+/// @param item Global index of the item
+/// @param value The value now held by the node
+/// @note Every writer of an item node other than the gateway must call it: values equal to the cached
+/// encoding are not written, so a stale cache would hide the next upstream value from the node.
+void gateway_written(Gateway* gateway, size_t item, const UA_DataValue* value);
+
+/// @brief Publish queued values into the gateway nodes
+/// @param gateway The gateway
+/// @param server Pointer to the UA_Server instance
+/// @param budget Maximum number of values to publish
+/// @return Number of values published, unchanged values included
+/// @note The budget is shared by the priority classes with the weights GATEWAY_WEIGHT_HIGH, _NORMAL and _LOW.
+size_t gateway_publish(Gateway* gateway, UA_Server* server, size_t budget);
+
+/// @brief Add the diagnostic nodes and the publish callback to the server
+/// @param gateway The gateway
+/// @param server Pointer to the UA_Server instance, the machine namespaces must be registered
+/// @return UA_STATUSCODE_GOOD on success
+UA_StatusCode gateway_start(Gateway* gateway, UA_Server* server);
+
+/// @brief Free the memory allocated for the gateway
+/// @param gateway Pointer to the Gateway structure to free
+/// @note The server must be stopped first, the publish callback uses the gateway.
+void free_gateway(Gateway* gateway);
+
+#endif // GATEWAY_H
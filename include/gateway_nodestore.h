@@ -0,0 +1,33 @@
+#ifndef GATEWAY_NODESTORE_H
+#define GATEWAY_NODESTORE_H
+
+#include "common.h"
+#include "address_space.h"
+
+#include <open62541/server.h>
+#include <open62541/plugin/nodestore.h>
+
+/// @brief Header file for the lazy nodestore of the gateway namespaces
+/// @file gateway_nodestore.h
+/// @details The nodestore wraps the default nodestore of the server. Machine, group and item
+/// nodes are created from the AddressSpace layout the first time they are requested and are
+/// then kept in the default nodestore. Every other node (namespace 0, user nodes) goes
+/// straight to the default nodestore.
+
+/// @brief Install the lazy gateway nodestore in a server configuration
+/// @param config Server configuration holding the default nodestore, which becomes the fallback
+/// @param address_space Layout of the gateway namespaces, must outlive the server
+/// @return UA_STATUSCODE_GOOD on success, UA_STATUSCODE_BADOUTOFMEMORY otherwise
+/// @note Must be called before `UA_Server_newWithConfig`. The nodestore is freed with the server.
+UA_StatusCode gateway_nodestore_install(UA_ServerConfig* config, AddressSpace* address_space);
+
+/// @brief Create the node of a machine, group or item with all its references
+/// @param nodestore Nodestore allocating the node
+/// @param address_space Layout of the gateway namespaces
+/// @param position Position of the node in the layout
+/// @return The new node, or NULL on failure
+/// @note Item values are initialized with the status BadWaitingForInitialData.
+UA_Node* gateway_nodestore_build_node(const UA_Nodestore* nodestore, const AddressSpace* address_space,
+                                      const AddressSpaceNode* position);
+
+#endif // GATEWAY_NODESTORE_H
@@ -0,0 +1,62 @@
+#ifndef ITEM_QUEUE_H
+#define ITEM_QUEUE_H
+
+#include "common.h"
+#include "machine_config.h"
+
+#include <open62541/types.h>
+
+/// @brief Header file for the bounded value queue of an item
+/// @file item_queue.h
+/// @details Values received from upstream wait in the queue of their item until they are
+/// published in the address space. The queue never holds more than its capacity, the
+/// overflow policy of the item's Group decides which value is given up when it is full.
+/// Each value keeps its monotonic reception time, which the gateway uses to measure latencies.
+
+typedef struct {
+    UA_DataValue* values;
+    UA_DateTime* received;
+    UA_UInt32 capacity;
+    UA_UInt32 head;
+    UA_UInt32 count;
+    QueueOverflow overflow;
+    UA_UInt64 overflows;
+} ItemQueue;
+
+/// @brief Initialize an empty queue
+/// @param queue Pointer to the ItemQueue structure to initialize
+/// @param capacity Maximum number of queued values, at least 1
+/// @param overflow Policy applied when a value is pushed on a full queue
+/// @note The buffer is only allocated on the first push, items that never change cost no value memory.
+void init_item_queue(ItemQueue* queue, size_t capacity, QueueOverflow overflow);
+
+/// @brief Append a value to the queue
+/// @param queue The queue
+/// @param value The value to append, moved into the queue and reset
+/// @return true if the value was queued without loss, false if the queue overflowed
+/// @note On overflow, DropOldest drops the head, KeepLatest empties the queue and Block replaces the newest value.
+/// Block queues are not expected to overflow as long as the producer stops while `item_queue_full` is true.
+bool item_queue_push(ItemQueue* queue, UA_DataValue* value);
+
+/// @brief Remove the oldest value of the queue
+/// @param queue The queue
+/// @param value Output receiving the value, owned by the caller
+/// @return true if a value was returned, false if the queue is empty
+bool item_queue_pop(ItemQueue* queue, UA_DataValue* value);
+
+/// @brief Reception time of the oldest value of the queue
+/// @param queue The queue
+/// @return The monotonic time at which the value was pushed, 0 if the queue is empty
+UA_DateTime item_queue_oldest(const ItemQueue* queue);
+
+/// @brief Check if the queue is full
+/// @param queue The queue
+/// @return true if the next push overflows
+bool item_queue_full(const ItemQueue* queue);
+
+/// @brief Free the queued values and the buffer
+/// @param queue Pointer to the ItemQueue structure to free
+/// @note The queue keeps its capacity and policy and can be reused.
+void free_item_queue(ItemQueue* queue);
+
+#endif // ITEM_QUEUE_H
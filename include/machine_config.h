@@ -5,10 +5,53 @@
 #include "stack.h"
 #include <json.h>
 
+/// @brief Where the values of an item come from
+typedef enum {
+    ITEM_SOURCE_UPSTREAM,  ///< Monitored on the machine through its NodeId
+    ITEM_SOURCE_AGGREGATE, ///< Computed by the gateway over a window of another item of the group
+    ITEM_SOURCE_EXPRESSION ///< Computed by the gateway from other items each time one of them changes
+} ItemSource;
+
+/// @brief Statistic of an aggregate item
+typedef enum {
+    AGGREGATE_MIN,
+    AGGREGATE_MAX,
+    AGGREGATE_MEAN,
+    AGGREGATE_COUNT,
+    AGGREGATE_STDDEV,
+    AGGREGATE_STAT_COUNT
+} AggregateStat;
+
+/// @brief Maximum number of aggregate windows of a group
+#define MAX_AGGREGATE_WINDOWS 8
+
+/// @brief Alarm limits of an item, see alarms.h
+typedef struct {
+    bool enabled;         ///< At least one limit is set
+    double high_high;     ///< NAN when not set
+    double high;
+    double low;
+    double low_low;
+    double hysteresis;    ///< Distance a value must move back inside a limit to leave its state
+} ItemLimits;
+
 typedef struct {
     char* name;
     char* nodeId;
     char* type;
+    char* expression;     ///< Expressions: source text, e.g. "{VOLTAGE} * {CURRENT}"
+    ItemSource source;
+    size_t source_item;   ///< Aggregates: index in the group of the aggregated item
+    size_t window;        ///< Aggregates: index of the window in the group
+    AggregateStat stat;   ///< Aggregates: computed statistic
+    bool scaled;          ///< Published as raw * scale + offset in its type, see scaling.h
+    double scale;
+    double offset;
+    double min;           ///< Scaled items: range the values are clamped to
+    double max;
+    bool on_demand;       ///< Read on the machine when a client reads it instead of monitored, see on_demand.h
+    size_t ttl;           ///< Ondemand items: milliseconds a value read on the machine is served before reading again
+    ItemLimits limits;    ///< Alarm limits, from the item or its Group
 } Item;
 
 typedef struct {
@@ -17,9 +60,41 @@ typedef struct {
     Item* items;
 } ArrayItem;
 
+/// @brief What happens when a value arrives for an item whose queue is full
+typedef enum {
+    QUEUE_OVERFLOW_DROP_OLDEST, ///< The oldest queued value is dropped
+    QUEUE_OVERFLOW_KEEP_LATEST, ///< The queue is emptied and only the new value is kept
+    QUEUE_OVERFLOW_BLOCK        ///< The upstream subscription of the machine is paused until the queue drains
+} QueueOverflow;
+
+/// @brief Default time-to-live of the values of the ondemand items in milliseconds
+#define DEFAULT_ON_DEMAND_TTL 1000
+
+/// @brief Default number of values queued per item
+#define DEFAULT_QUEUE_SIZE 16
+
+/// @brief Scheduling class of a group, from the most to the least urgent
+typedef enum {
+    PRIORITY_HIGH,   ///< Interlocks and status flags
+    PRIORITY_NORMAL, ///< Default class
+    PRIORITY_LOW,    ///< Bulk process data
+    PRIORITY_CLASS_COUNT
+} PriorityClass;
+
+/// @brief Default target latency of each class in milliseconds, from reception to publish
+#define DEFAULT_TARGET_LATENCY_HIGH 20
+#define DEFAULT_TARGET_LATENCY_NORMAL 100
+#define DEFAULT_TARGET_LATENCY_LOW 1000
+
 typedef struct {
     char* name;
     ArrayItem items;
+    size_t queue_size;
+    QueueOverflow queue_overflow;
+    PriorityClass priority;
+    size_t target_latency;                 ///< Milliseconds from reception to publish
+    size_t window_count;
+    size_t windows[MAX_AGGREGATE_WINDOWS]; ///< Aggregate windows in milliseconds
 } Group;
 
 typedef struct {
@@ -39,6 +114,7 @@ typedef struct {
     size_t count;
     size_t capacity;
     MachineConfig* configs;
+    bool compiled;        ///< The configs are static tables linked into the binary, see compiled_machines.h
 } ArrayMachineConfig;
 
 
@@ -0,0 +1,113 @@
+#ifndef ON_DEMAND_H
+#define ON_DEMAND_H
+
+#include "common.h"
+#include "gateway.h"
+#include "upstream.h"
+
+#include <open62541/client.h>
+#include <open62541/server.h>
+
+/// @brief Header file for the items read on the machines when clients read them
+/// @file on_demand.h
+/// @details An item with `"Mode": "OnDemand"` has no monitored item on its machine. Its node calls
+/// on_demand_on_read before every Read of its value (samples of monitored items included):
+/// - while the last value read on the machine is younger than the Ttl of the item, the node value
+///   is served as is, the machine is not asked;
+/// - once it is older, the item is queued for a refresh and the Read gets the previous value, marked
+///   UncertainLastUsableValue until the refresh (BadWaitingForInitialData before the first refresh);
+/// - Reads of an item already queued or being read on the machine are merged into that refresh
+///   (single flight), so a report reading the same counters from many sessions costs one upstream read.
+/// Every ON_DEMAND_INTERVAL the queued items are sent as one Read request per machine, asynchronously
+/// on the upstream client of the machine. The results go through the same path as the notifications
+/// (scaling, queues, node, shared memory, replication) and restart the Ttl of their item.
+/// A failed request leaves its items expired, they are read again at the next client Read.
+/// The stack serves Reads synchronously, hence the previous value: a client reading again after the
+/// refresh, or a monitored item sampling the node, gets the fresh value.
+/// A report reading each item once per pass, with passes further apart than the Ttl, therefore never sees
+/// fresh data: every Read of the pass finds the value expired and gets the last usable one. Such a report
+/// reads each item again once the refresh is done (ON_DEMAND_INTERVAL plus the round trip to the machine),
+/// or its items use a Ttl longer than the pass interval.
+///
+/// Sharded (see shard.h) the front process has no upstream client, the ondemand items are then
+/// monitored by the workers like the other items.
+
+/// @brief Interval of the callback sending the queued refreshes in milliseconds
+#define ON_DEMAND_INTERVAL 10.0
+
+typedef enum {
+    ON_DEMAND_IDLE,      ///< The node value is served until it expires
+    ON_DEMAND_QUEUED,    ///< Waiting for the next request to its machine
+    ON_DEMAND_READING    ///< Sent, waiting for the response of its machine
+} OnDemandState;
+
+typedef struct OnDemand {
+    Gateway* gateway;
+    UpstreamMachine** machine_upstream;  ///< Upstream client of each machine, indexed by machine, NULL without URL
+    UA_DateTime* expires_at;             ///< Monotonic time the value of each item expires, indexed by item
+    UA_Byte* state;                      ///< OnDemandState of each item, indexed by item
+    size_t* queued;                      ///< Items waiting for a request
+    size_t queued_count;
+    size_t item_count;                   ///< Number of ondemand items
+    UA_UInt64 hits;                      ///< Reads served from the node value
+    UA_UInt64 merged;                    ///< Reads merged into a pending refresh
+    UA_UInt64 refreshes;                 ///< Items read on the machines
+    UA_UInt64 requests;                  ///< Read requests sent to the machines
+    UA_UInt64 callback_id;
+} OnDemand;
+
+/// @brief Attach the ondemand items to the upstream clients of their machines
+/// @param on_demand Pointer to the OnDemand structure to initialize
+/// @param gateway The gateway, its address space gets the OnDemand
+/// @param upstream The upstream clients, may be NULL; their ondemand items are no longer monitored
+/// @note Call before upstream_start so that the subscriptions leave the ondemand items out.
+void init_on_demand(OnDemand* on_demand, Gateway* gateway, Upstream* upstream);
+
+/// @brief Add the callback sending the queued refreshes
+/// @param on_demand The ondemand items
+/// @param server Pointer to the UA_Server instance
+/// @return UA_STATUSCODE_GOOD on success, or when there is no ondemand item
+UA_StatusCode on_demand_start(OnDemand* on_demand, UA_Server* server);
+
+/// @brief Value callback of the nodes of the ondemand items, called before each Read
+/// @param server Pointer to the UA_Server instance
+/// @param session_id The session reading the node
+/// @param session_context Context of the session
+/// @param node_id NodeId of the item
+/// @param node_context The AddressSpace of the item, set by the nodestores
+/// @param range Index range of the Read
+/// @param value Current value of the node, served to the client
+/// @note An expired good value is written back into the node as UncertainLastUsableValue and recorded with
+/// gateway_written, the Read serves it with that status.
+void on_demand_on_read(UA_Server* server, const UA_NodeId* session_id, void* session_context,
+                       const UA_NodeId* node_id, void* node_context, const UA_NumericRange* range,
+                       const UA_DataValue* value);
+
+/// @brief Account a Read of an ondemand item
+/// @param on_demand The ondemand items
+/// @param item Global index of the item
+/// @param now Monotonic time of the Read
+/// @return true if the item was queued for a refresh
+bool on_demand_touch(OnDemand* on_demand, size_t item, UA_DateTime now);
+
+/// @brief Send the queued refreshes, one Read request per machine
+/// @param on_demand The ondemand items
+/// @return Number of items sent
+/// @note Items of a machine whose session is not activated stay queued.
+size_t on_demand_flush(OnDemand* on_demand);
+
+/// @brief Store the result of a refresh
+/// @param on_demand The ondemand items
+/// @param item Global index of the item
+/// @param value The value read on the machine, only read; NULL when the request failed
+/// @param now Monotonic time of the response
+/// @note The value is pushed into the gateway through the upstream client of its machine (scaled items
+/// are staged for conversion) and served until now plus the Ttl of the item.
+void on_demand_complete(OnDemand* on_demand, size_t item, const UA_DataValue* value, UA_DateTime now);
+
+/// @brief Free the memory of the ondemand items
+/// @param on_demand Pointer to the OnDemand structure to free
+/// @note The upstream clients must be freed first, their pending requests complete into the OnDemand.
+void free_on_demand(OnDemand* on_demand);
+
+#endif // ON_DEMAND_H
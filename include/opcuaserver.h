@@ -3,6 +3,23 @@
 
 #include "common.h"
 #include "machine_config.h"
+#include "compiled_machines.h"
+#include "address_space.h"
+#include "gateway_nodestore.h"
+#include "flat_nodestore.h"
+#include "trace.h"
+#include "gateway.h"
+#include "aggregate.h"
+#include "alarms.h"
+#include "expression.h"
+#include "scaling.h"
+#include "upstream.h"
+#include "on_demand.h"
+#include "pool_allocator.h"
+#include "snapshot.h"
+#include "replication.h"
+#include "shard.h"
+#include "session_limits.h"
 
 #include <open62541/server.h>
 #include <open62541/server_config_default.h>
@@ -18,8 +35,10 @@ UA_ByteString loadFile(const char *const path);
 
 /// @brief Add a machine configuration to the server
 /// @param server Pointer to the UA_Server instance
-/// @param config Pointer to the MachineConfig structure to add
-/// @note This function will create the necessary nodes in the server address space based on the configuration provided.
-void AddMachineConfigToServer(UA_Server *server, ArrayMachineConfig *config);
+/// @param address_space Layout of the machine configurations to add
+/// @return UA_STATUSCODE_GOOD on success
+/// @note This function registers the machine namespaces and links the machines below the Objects folder.
+/// The machine, group and item nodes are created on first access by the gateway nodestore.
+UA_StatusCode AddMachineConfigToServer(UA_Server *server, AddressSpace *address_space);
 
 #endif // OPCUASERVER_H
\ No newline at end of file
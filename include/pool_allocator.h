@@ -0,0 +1,73 @@
+#ifndef POOL_ALLOCATOR_H
+#define POOL_ALLOCATOR_H
+
+#include "common.h"
+
+#include <open62541/types.h>
+
+/// @brief Header file for the size-class pool allocator of the OPC UA stack
+/// @file pool_allocator.h
+/// @details Small allocations (scalar payloads, DataValues, notifications) are served from per-thread
+/// free lists, one per size class, refilled by carving slabs of POOL_SLAB_SIZE bytes. Each block keeps
+/// a header naming its owner thread and size class: a block freed by its owner goes back to the local
+/// list, a block freed by another thread is pushed on the owner's lock-free return stack, which the
+/// owner drains when its list runs empty. Slabs are never returned to the system, so the heap stops
+/// growing once the pools reach the working set. Larger allocations go to malloc with the same header.
+/// The allocator plugs into open62541 through its malloc singletons, which requires building the stack
+/// with UA_ENABLE_MALLOC_SINGLETON (see the makefile).
+
+/// @brief Number of size classes, from 16 to 512 bytes
+#define POOL_CLASS_COUNT 10
+
+/// @brief Size of the slabs carved into blocks when a free list runs empty
+#define POOL_SLAB_SIZE (64 * 1024)
+
+/// @brief Usage of one size class, summed over the threads
+typedef struct {
+    size_t block_size;      ///< Payload size of the class, 0 for the allocations served by malloc
+    UA_UInt64 allocations;  ///< Blocks handed out
+    UA_UInt64 frees;        ///< Blocks returned, by their owner or by another thread
+    UA_UInt64 remote_frees; ///< Blocks returned by another thread than their owner
+    UA_UInt64 in_use;       ///< Blocks currently allocated
+    UA_UInt64 capacity;     ///< Blocks carved from slabs
+} PoolStats;
+
+/// @brief Route the allocations of open62541 to the pools
+/// @return true if installed, false if open62541 was built without UA_ENABLE_MALLOC_SINGLETON
+/// @note Must be called before the first allocation of the stack and never undone: memory obtained from the
+/// pools can only be released by pool_free. Depending on the open62541 build the singletons may be
+/// thread-local, the hooks then apply to the calling thread, which runs the server.
+bool pool_allocator_install(void);
+
+/// @brief Check if the pools serve the allocations of open62541
+/// @return true after a successful pool_allocator_install
+bool pool_allocator_installed(void);
+
+/// @brief Allocate a block from the pools of the calling thread
+/// @param size Requested size in bytes
+/// @return The block, NULL if the system is out of memory
+void* pool_malloc(size_t size);
+
+/// @brief Allocate a zeroed array from the pools
+/// @param count Number of elements
+/// @param size Size of an element
+/// @return The block, NULL if the system is out of memory or the size overflows
+void* pool_calloc(size_t count, size_t size);
+
+/// @brief Resize a block of the pools
+/// @param pointer Block of the pools or NULL
+/// @param size New size in bytes
+/// @return The resized block, NULL if the system is out of memory, the block is then left untouched
+void* pool_realloc(void* pointer, size_t size);
+
+/// @brief Return a block to the pools, from any thread
+/// @param pointer Block of the pools or NULL
+void pool_free(void* pointer);
+
+/// @brief Read the usage of the pools
+/// @param stats Array receiving one entry per size class followed by one entry for the large allocations
+/// @param count Capacity of the array, POOL_CLASS_COUNT + 1 for the complete statistics
+/// @return Number of entries written
+size_t pool_allocator_stats(PoolStats* stats, size_t count);
+
+#endif // POOL_ALLOCATOR_H
@@ -0,0 +1,175 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "common.h"
+#include "gateway.h"
+#include "upstream.h"
+
+#include <stdint.h>
+#include <open62541/server.h>
+
+/// @brief Header file for the hot-standby replication between two gateways
+/// @file replication.h
+/// @details Non-transparent redundancy: a primary and a standby gateway serve the same machine files,
+/// clients pick the server with the highest ServiceLevel. The primary listens on a Unix or TCP socket
+/// and streams to the standby every value it publishes for an upstream item, after a full copy of the
+/// current values when the standby connects. The standby pushes the values into its own gateway, so its
+/// nodes, shared-memory table, aggregates and expressions stay current, and keeps its upstream sessions
+/// and subscriptions open with publishing disabled (see upstream_set_publishing).
+/// When the primary closes the connection (exit or crash) or stays silent for REPLICATION_TIMEOUT, the
+/// standby takes over: it enables publishing upstream, raises its ServiceLevel and listens on the
+/// replication address for the next standby. A standby only takes over once it received a full copy of
+/// the values, or after REPLICATION_STARTUP_GRACE when it never reached a primary. Both gateways must
+/// load the same machine files, a standby whose layout differs from the primary's refuses the stream
+/// and never takes over.
+///
+/// Fencing: each takeover increments an epoch carried by the hello frames, which both ends of a
+/// connection send. A primary started while the address already answers starts as a standby, and a
+/// primary without standby connects to the address every REPLICATION_PROBE_INTERVAL to find another
+/// primary (e.g. a standby took over while this one hung). When two primaries meet, the one with the
+/// lower epoch, then the one not configured as primary, then the one with the lower instance identifier
+/// steps down and stays connected as the standby of the other.
+///
+/// Frames (host byte order, both processes run the same build): a ReplicationFrame followed by
+/// `length` bytes of payload, a ReplicationHello for REPLICATION_FRAME_HELLO and the OPC UA binary
+/// encoding of the DataValue of item `item` for REPLICATION_FRAME_VALUE.
+
+/// @brief Magic number of the hello frame
+#define REPLICATION_MAGIC 0x4F505552u
+
+/// @brief Version of the replication protocol
+#define REPLICATION_VERSION 2
+
+/// @brief Interval of the replication callback in milliseconds
+#define REPLICATION_INTERVAL 10.0
+
+/// @brief Delay between two heartbeats of an idle primary in milliseconds
+#define REPLICATION_HEARTBEAT 500
+
+/// @brief Silence of the primary after which the standby takes over in milliseconds
+#define REPLICATION_TIMEOUT 3000
+
+/// @brief Delay before the standby connects again in milliseconds
+#define REPLICATION_RETRY_DELAY 1000
+
+/// @brief Delay between two connections of a primary without standby looking for another primary in milliseconds
+#define REPLICATION_PROBE_INTERVAL 5000
+
+/// @brief Time after which a standby that never reached a primary takes over in milliseconds
+#define REPLICATION_STARTUP_GRACE 30000
+
+/// @brief Maximum size of the unsent stream, a standby falling further behind is resynchronized from the current values
+#define REPLICATION_BUFFER_MAX (64 * 1024 * 1024)
+
+/// @brief ServiceLevel of each role, clients prefer the highest
+#define REPLICATION_SERVICE_LEVEL_PRIMARY 255
+#define REPLICATION_SERVICE_LEVEL_STANDBY 100
+
+typedef enum {
+    REPLICATION_PRIMARY,
+    REPLICATION_STANDBY
+} ReplicationRole;
+
+typedef enum {
+    REPLICATION_FRAME_HELLO = 1,  ///< First frame of a connection
+    REPLICATION_FRAME_VALUE,      ///< Value of an item
+    REPLICATION_FRAME_SYNCED,     ///< End of the full copy of the current values
+    REPLICATION_FRAME_HEARTBEAT   ///< Sent by an idle primary
+} ReplicationFrameType;
+
+typedef struct {
+    uint8_t type;
+    uint8_t reserved[3];
+    uint32_t item;    ///< Global index of the item of a value frame
+    uint32_t length;  ///< Size of the payload
+} ReplicationFrame;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t item_count;
+    uint32_t layout_hash;  ///< Hash of the item paths and sources of the layout
+    uint8_t role;          ///< ReplicationRole of the sender
+    uint8_t configured;    ///< ReplicationRole of the sender at startup
+    uint8_t reserved[2];
+    uint32_t epoch;        ///< Takeovers seen by the sender
+    uint64_t instance;     ///< Identifier of the sender process
+} ReplicationHello;
+
+typedef struct Replication {
+    Gateway* gateway;
+    Upstream* upstream;
+    char* address;             ///< "unix:<path>" or "<host>:<port>"
+    ReplicationRole role;
+    ReplicationRole configured; ///< Role at startup, breaks the tie between two primaries of the same epoch
+    uint64_t instance;         ///< Identifier of the process and replication, breaks the last tie
+    uint32_t epoch;            ///< Takeovers seen by the pair, the primary of the highest epoch stays primary
+    int listener;              ///< Listening socket of the primary, -1 if none
+    int peer;                  ///< Connection to the other gateway, -1 if none
+    bool connecting;           ///< The standby waits for its connection to complete
+    bool accepted;             ///< The hello of the peer matched
+    bool probing;              ///< The primary connected to the address to look for another primary
+    bool synced;               ///< The standby received a full copy of the values at least once
+    bool yield;                ///< The peer is a primary that wins the tie, this one steps down
+    bool mismatch;             ///< The layout of the primary differs, the standby never takes over
+    bool resync;               ///< The primary sends the current values again once the buffer is drained
+    bool* replicated;          ///< Items whose values are streamed, the upstream ones
+    uint32_t layout_hash;
+    unsigned char* output;     ///< Frames not yet sent
+    size_t output_length;
+    size_t output_sent;
+    size_t output_capacity;
+    unsigned char* input;      ///< Bytes received, not yet a complete frame
+    size_t input_length;
+    size_t input_capacity;
+    UA_DateTime last_sent;
+    UA_DateTime last_received;
+    UA_DateTime retry_at;
+    UA_DateTime started;
+    UA_UInt64 sent;            ///< Values sent by the primary
+    UA_UInt64 applied;         ///< Values applied by the standby
+    UA_UInt64 callback_id;
+} Replication;
+
+/// @brief Initialize the replication of a gateway
+/// @param replication Pointer to the Replication structure to initialize
+/// @param gateway The gateway, its published values are streamed by a primary and fed by a standby
+/// @param upstream The upstream clients, enabled when a standby takes over, may be NULL
+/// @param address "unix:<path>" or "<host>:<port>", listened on by the primary and connected to by the standby
+/// @param role Role of the gateway at startup
+/// @note Attach the replication to the gateway (gateway->replication) for its values to be streamed.
+void init_replication(Replication* replication, Gateway* gateway, Upstream* upstream, const char* address,
+                      ReplicationRole role);
+
+/// @brief Set the redundancy state of the server and add the replication callback
+/// @param replication The replication
+/// @param server Pointer to the UA_Server instance
+/// @return UA_STATUSCODE_GOOD on success, an error if the primary cannot listen on the address
+/// @note A primary whose address already answers starts as the standby of the gateway answering.
+UA_StatusCode replication_start(Replication* replication, UA_Server* server);
+
+/// @brief Accept, connect, send and receive without blocking
+/// @param replication The replication
+/// @param server Pointer to the UA_Server instance
+/// @note Called by the replication callback, a standby may take over from here.
+void replication_iterate(Replication* replication, UA_Server* server);
+
+/// @brief Stream a value published by the gateway
+/// @param replication The replication
+/// @param item Global index of the item
+/// @param value The value
+/// @note Only a primary with a connected standby streams, and only the values of upstream items:
+/// the standby computes aggregates and expressions itself.
+void replication_publish(Replication* replication, size_t item, const UA_DataValue* value);
+
+/// @brief Check if the gateway is a standby
+/// @param replication The replication or NULL
+/// @return true until the standby takes over
+bool replication_standby(const Replication* replication);
+
+/// @brief Close the sockets and free the memory of the replication
+/// @param replication Pointer to the Replication structure to free
+/// @note The server must be stopped first, the replication callback uses the replication.
+void free_replication(Replication* replication);
+
+#endif // REPLICATION_H
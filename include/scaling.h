@@ -0,0 +1,80 @@
+#ifndef SCALING_H
+#define SCALING_H
+
+#include "common.h"
+#include "gateway.h"
+
+#include <stdint.h>
+#include <open62541/types.h>
+
+/// @brief Header file for the engineering-unit conversion of the upstream values
+/// @file scaling.h
+/// @details An item with a "Scale", an "Offset" or a "TargetType" (see machine_config.h) receives raw
+/// PLC values, e.g. Int16 counts, and publishes raw * Scale + Offset in its target type, System.Double
+/// by default. The result is clamped to the "Min" and "Max" of the item and to the range of an integer
+/// target type.
+/// The values of a machine are staged by the upstream data change callback instead of being pushed
+/// one by one, then converted in one pass per client iteration: the raw values and the parameters of
+/// their items are laid out in columns and the conversion, the clamp and the quality checks run over
+/// the columns with AVX or SSE2 when the CPU has them, and in scalar code otherwise.
+/// Quality: a clamped value is UncertainEngineeringUnitsExceeded, a value that is not a finite number
+/// (NaN, a string, an array...) is BadOutOfRange without value. A value whose status is already bad or
+/// uncertain keeps it.
+
+/// @brief Initial number of values staged per machine
+#define SCALING_INITIAL_CAPACITY 64
+
+/// @brief Flags of a converted value
+#define SCALING_EXCEEDED 0x1  ///< The value was clamped to the range of the item
+#define SCALING_INVALID  0x2  ///< The value is not a finite number
+
+typedef struct {
+    Gateway* gateway;
+    size_t first_item;        ///< Global index of the first item of the machine
+    size_t item_count;
+    const Item** items;       ///< Scaled items of the machine by index in the machine, NULL for the others
+    const UA_DataType** types;///< Target type of the scaled items by index in the machine
+    size_t count;             ///< Values staged
+    size_t capacity;
+    size_t* targets;          ///< Global index of the item of each staged value
+    UA_DataValue* values;     ///< Status and timestamps of each staged value, without variant
+    double* raw;              ///< Columns of the conversion, one row per staged value
+    double* scale;
+    double* offset;
+    double* low;
+    double* high;
+    double* converted;
+    uint8_t* flags;
+} ScalingBatch;
+
+/// @brief Prepare the conversion of the scaled items of a machine
+/// @param batch Pointer to the ScalingBatch structure to initialize
+/// @param gateway Gateway receiving the converted values, must outlive the batch
+/// @param machine Index of the machine in the address space
+/// @return false if the machine has no scaled item, the batch is then empty and stages nothing
+bool init_scaling_batch(ScalingBatch* batch, Gateway* gateway, size_t machine);
+
+/// @brief Stage a value received for an item
+/// @param batch The batch of the machine of the item
+/// @param item Global index of the item
+/// @param value The raw value, only read: its variant is converted at the next flush
+/// @return false if the item is not scaled, the value must then be pushed as is
+bool scaling_batch_add(ScalingBatch* batch, size_t item, const UA_DataValue* value);
+
+/// @brief Convert the staged values and push them into the gateway queues
+/// @param batch The batch
+/// @return Number of values pushed
+size_t scaling_batch_flush(ScalingBatch* batch);
+
+/// @brief Convert, clamp and check columns of raw values
+/// @param batch The batch, its raw, scale, offset, low and high columns are read
+/// @param count Number of rows to convert
+/// @note Fills the converted and flags columns. Exposed for the tests, the flush calls it.
+void scaling_convert(ScalingBatch* batch, size_t count);
+
+/// @brief Free the memory of a batch
+/// @param batch Pointer to the ScalingBatch structure to free
+/// @note Staged values not yet flushed are dropped.
+void free_scaling_batch(ScalingBatch* batch);
+
+#endif // SCALING_H
@@ -0,0 +1,125 @@
+#ifndef SESSION_LIMITS_H
+#define SESSION_LIMITS_H
+
+#include "common.h"
+#include "gateway.h"
+
+#include <open62541/server.h>
+#include <open62541/plugin/accesscontrol.h>
+#include <open62541/plugin/eventloop.h>
+
+/// @brief Header file for the per-session budgets of the downstream clients
+/// @file session_limits.h
+/// @details The `--session-operations`, `--server-operations` and `--session-bytes` options give each client
+/// session a budget of node operations and of value bytes per second. A 0 limit, the default, is not enforced.
+/// Node operations are the values read or written, the nodes browsed and the methods called by the services of
+/// the session. The samples of its monitored items are not charged: only the operations run while the server
+/// processes a message of a client connection are, the sampling runs from the timers of the server.
+/// Each session has a token bucket refilled every SESSION_LIMITS_ROUND and holding at most one second of budget.
+/// The refill rate of operations is the per-session limit, lowered to an equal share of the server limit between
+/// the sessions active in the last round, so a client reading in a tight loop gets no more than the others while
+/// the server is busy. The stack runs an operation as soon as its request is decoded and keeps no queue per
+/// session the gateway could serve in turn, so the buckets only decide whether an operation runs: the
+/// operations of a session past its budget are refused until its next refill. Reads, writes and calls are
+/// refused through the access control, which the stack answers with BadUserAccessDenied, and browsed nodes are
+/// left out of the result.
+/// The checks wrap the access control of the server configuration, whose own decisions still apply.
+
+/// @brief Interval between two refills in milliseconds
+#define SESSION_LIMITS_ROUND 100.0
+
+/// @brief Bytes charged for an operation besides its value
+#define SESSION_LIMITS_OPERATION_BYTES 32
+
+/// @brief Connection managers of the server whose messages are charged
+#define SESSION_LIMITS_MAX_MANAGERS 4
+
+typedef struct {
+    UA_UInt32 operations_per_second;        ///< Node operations of one session, 0 for no limit
+    UA_UInt32 server_operations_per_second; ///< Node operations of all sessions, shared fairly, 0 for no limit
+    UA_UInt32 bytes_per_second;             ///< Value bytes read by one session, 0 for no limit
+} SessionLimitsConfig;
+
+typedef struct {
+    UA_NodeId session_id;
+    UA_UInt32 hash;
+    UA_Double operations;  ///< Operations left in the bucket
+    UA_Double bytes;       ///< Bytes left in the bucket
+    UA_UInt64 used;        ///< Operations of the current round, refused ones included
+    UA_UInt64 refused;     ///< Operations refused since the session was activated
+    bool refused_in_round; ///< An operation was refused in the current round
+    bool throttled;        ///< An operation was refused in the last round
+} SessionBudget;
+
+typedef struct {
+    UA_ConnectionManager* manager;
+    UA_StatusCode (*open_connection)(UA_ConnectionManager* cm, const UA_KeyValueMap* params, void* application,
+                                     void* context, UA_ConnectionManager_connectionCallback callback);
+} SessionLimitsManager;
+
+typedef struct SessionLimits {
+    SessionLimitsConfig config;
+    Gateway* gateway;            ///< Gives the size of the item values, may be NULL
+    UA_AccessControl wrapped;    ///< Access control of the server configuration, asked first
+    size_t count;
+    size_t capacity;
+    SessionBudget* sessions;
+    size_t* index;               ///< Open-addressing map of the sessions by hash, position + 1, 0 if empty
+    size_t index_capacity;
+    UA_Double share;             ///< Operations per second of each session in the current round
+    UA_UInt64 refused;           ///< Operations refused, all sessions
+    UA_UInt64 callback_id;
+    SessionLimitsManager managers[SESSION_LIMITS_MAX_MANAGERS];
+    size_t manager_count;
+    UA_ConnectionManager_connectionCallback network_callback; ///< Callback of the server for the client messages
+    void* network_application;
+    bool services_only;          ///< The client messages are seen, the operations outside of them are not charged
+    bool in_service;             ///< A client message is being processed
+} SessionLimits;
+
+/// @brief Wrap the access control of a server configuration with the session budgets
+/// @param limits Pointer to the SessionLimits structure to initialize
+/// @param server_config Server configuration, loaded but not yet used to create the server
+/// @param config The limits
+/// @param gateway The gateway, gives the size of the item values, may be NULL
+/// @note Nothing is wrapped when no limit is set. The limits must outlive the server.
+void session_limits_install(SessionLimits* limits, UA_ServerConfig* server_config, const SessionLimitsConfig* config,
+                            Gateway* gateway);
+
+/// @brief Add the callback refilling the budgets and watch the client messages
+/// @param limits The installed limits
+/// @param server Pointer to the UA_Server instance, not yet started
+/// @return UA_STATUSCODE_GOOD on success, or when no limit is set
+/// @note The connection managers of the event loop are wrapped before the server opens its connections.
+/// Without connection manager to wrap, every operation is charged, the samples of the monitored items included.
+UA_StatusCode session_limits_start(SessionLimits* limits, UA_Server* server);
+
+/// @brief Give a budget to a new session
+/// @param limits The limits
+/// @param session_id The session
+/// @note Called when a session is activated, the session starts with a full bucket.
+void session_limits_open(SessionLimits* limits, const UA_NodeId* session_id);
+
+/// @brief Forget a closed session
+/// @param limits The limits
+/// @param session_id The session
+void session_limits_close(SessionLimits* limits, const UA_NodeId* session_id);
+
+/// @brief Charge an operation to a session
+/// @param limits The limits
+/// @param session_id The session
+/// @param bytes Size of the value of the operation
+/// @return false if the session is past its budget, the operation must then be refused
+bool session_limits_charge(SessionLimits* limits, const UA_NodeId* session_id, size_t bytes);
+
+/// @brief Refill the bucket of every session
+/// @param limits The limits
+/// @note Called every SESSION_LIMITS_ROUND by the limits callback.
+void session_limits_round(SessionLimits* limits);
+
+/// @brief Free the memory of the limits
+/// @param limits Pointer to the SessionLimits structure to free
+/// @note The server must be deleted first, its access control and its connection managers call the limits.
+void free_session_limits(SessionLimits* limits);
+
+#endif // SESSION_LIMITS_H
@@ -0,0 +1,137 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "common.h"
+#include "gateway.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <open62541/server.h>
+
+/// @brief Header file for the sharding of the machines across worker processes
+/// @file shard.h
+/// @details With --shards N the server process becomes a front: it keeps the address space, the
+/// endpoint, the queues, the aggregates and the expressions, and forks N workers that own the upstream
+/// clients. The machines are spread over the workers by number of items. A worker connects and
+/// subscribes to its machines like the single process does, converts the scaled values, and writes
+/// every value into its ring, a shared-memory byte ring read by the front.
+/// A worker that exits or crashes only takes down its own machines: their upstream items turn
+/// BadNoCommunication and the worker is forked again after SHARD_RESTART_DELAY.
+/// Backpressure is applied per machine: the front always drains the rings and publishes which machines
+/// are blocked (see QUEUE_OVERFLOW_BLOCK) in a mapping shared with the workers, whose worker then pauses
+/// the upstream subscription of that machine only, the other machines of the worker keep flowing.
+/// A worker also stops iterating its clients while its ring is more than half full. A value that does not
+/// fit in a full ring is dropped and counted as an overflow of its Group, like a value a full queue drops.
+/// A worker closes the descriptors inherited from the front (endpoint, client and replication sockets)
+/// before anything else.
+///
+/// Records (host byte order, both sides are the same build): a ShardRecord followed by the OPC UA
+/// binary encoding of the DataValue, padded to 8 bytes. A record never wraps: when it does not fit
+/// before the end of the ring, a SHARD_RECORD_WRAP record fills the end and it starts at offset 0.
+
+/// @brief Maximum number of workers
+#define SHARD_MAX 64
+
+/// @brief Size of the ring of a worker in bytes, a power of two
+#define SHARD_RING_SIZE (4 * 1024 * 1024)
+
+/// @brief Interval of the front callback reading the rings in milliseconds
+#define SHARD_INTERVAL 10.0
+
+/// @brief Delay before a worker that exited is forked again in milliseconds
+#define SHARD_RESTART_DELAY 1000
+
+/// @brief Item of the record filling the end of the ring
+#define SHARD_RECORD_WRAP UINT32_MAX
+
+typedef struct {
+    uint32_t item;    ///< Global index of the item, SHARD_RECORD_WRAP for the end of the ring
+    uint32_t length;  ///< Size of the encoded DataValue
+} ShardRecord;
+
+/// @brief Single-producer single-consumer ring, shared by a worker and the front
+typedef struct ShardRing {
+    _Alignas(64) _Atomic uint64_t head;  ///< Bytes written, only moved by the worker
+    _Alignas(64) _Atomic uint64_t tail;  ///< Bytes read, only moved by the front
+    _Alignas(64) _Atomic uint64_t dropped;
+    uint64_t size;                       ///< Size of data, a power of two
+    _Alignas(8) unsigned char data[];
+} ShardRing;
+
+typedef struct {
+    pid_t pid;             ///< Process of the worker, -1 while it is down
+    ShardRing* ring;
+    UA_DateTime restart_at;
+    UA_UInt64 restarts;
+} ShardWorker;
+
+typedef struct {
+    Gateway* gateway;
+    size_t count;
+    ShardWorker* workers;
+    size_t* machine_shard;  ///< Worker of each machine, indexed by machine
+    _Atomic uint64_t* overflows;  ///< Shared, values a worker dropped on a full ring, indexed by global group
+    _Atomic uint32_t* blocked;    ///< Shared, set by the front while a machine is blocked, indexed by machine
+    size_t shared_size;           ///< Size of the mapping of overflows and blocked
+    pid_t front;            ///< Process of the front
+    UA_UInt64 callback_id;
+    UA_UInt64 received;     ///< Values read from the rings
+} Shards;
+
+/// @brief Spread the machines over the workers and map their rings
+/// @param shards Pointer to the Shards structure to initialize
+/// @param gateway The gateway of the front, the workers start from a copy of it
+/// @param count Number of workers, at most SHARD_MAX
+/// @note The machines with an URL are assigned from the largest to the smallest to the worker with
+/// the fewest items so far. No process is forked before shard_start.
+void init_shards(Shards* shards, Gateway* gateway, size_t count);
+
+/// @brief Fork the workers and add the callback reading their rings
+/// @param shards The shards
+/// @param server Pointer to the UA_Server instance of the front
+/// @return UA_STATUSCODE_GOOD on success
+/// @note Call in place of upstream_start, before UA_Server_run_startup.
+UA_StatusCode shard_start(Shards* shards, UA_Server* server);
+
+/// @brief Read the rings of the workers and share the state of their machines with them
+/// @param shards The shards
+/// @return Number of values read
+/// @note Called by the front callback. Every ring is drained, a blocked machine does not hold back the other
+/// machines of its worker: its flag tells the worker to pause its subscription. The values the workers
+/// dropped on a full ring are added to the overflows of their Groups.
+size_t shard_exchange(Shards* shards);
+
+/// @brief Map a shared ring
+/// @param size Size of the data of the ring, a power of two
+/// @return The ring, NULL on failure
+ShardRing* shard_ring_create(size_t size);
+
+/// @brief Write a value into a ring
+/// @param ring The ring
+/// @param item Global index of the item
+/// @param value The value, only read
+/// @return false if the value cannot be encoded or the ring is full, the value is then dropped
+bool shard_ring_write(ShardRing* ring, size_t item, const UA_DataValue* value);
+
+/// @brief Push the values of a ring into a gateway
+/// @param ring The ring
+/// @param gateway The gateway receiving the values
+/// @return Number of values read
+size_t shard_ring_read(ShardRing* ring, Gateway* gateway);
+
+/// @brief Number of bytes that can be written into a ring
+/// @param ring The ring
+/// @return Free bytes, a record may still not fit when the end of the ring is too short
+size_t shard_ring_free(const ShardRing* ring);
+
+/// @brief Unmap a ring
+/// @param ring The ring or NULL
+void shard_ring_destroy(ShardRing* ring);
+
+/// @brief Stop the workers and free the memory of the shards
+/// @param shards Pointer to the Shards structure to free
+/// @note The server must be stopped first, the front callback uses the shards.
+void free_shards(Shards* shards);
+
+#endif // SHARD_H
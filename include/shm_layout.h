@@ -0,0 +1,65 @@
+#ifndef SHM_LAYOUT_H
+#define SHM_LAYOUT_H
+
+#include <stdint.h>
+
+/// @brief Header file for the layout of the shared-memory live value table
+/// @file shm_layout.h
+/// @details The segment starts with a ShmTableHeader, followed by the directory, the names
+/// and the slots. The directory is sorted by name, a name is "<machine>/<group>/<item>".
+/// Slot i holds the current value of the item with global index i. Each slot is protected
+/// by a seqlock: the writer makes `sequence` odd while it updates the slot, a reader retries
+/// when the sequence is odd or changed during its copy.
+/// @note This header only depends on the C standard library, consumers include it without open62541.
+
+#define SHM_TABLE_MAGIC 0x41555043u // "CPUA"
+#define SHM_TABLE_VERSION 1u
+
+/// @brief Number of bytes of a string value kept in a slot, longer strings are truncated
+#define SHM_TABLE_TEXT_SIZE 24
+
+typedef enum {
+    SHM_VALUE_EMPTY = 0,
+    SHM_VALUE_BOOLEAN = 1,  ///< value.i is 0 or 1
+    SHM_VALUE_INT = 2,      ///< value.i
+    SHM_VALUE_UINT = 3,     ///< value.u
+    SHM_VALUE_DOUBLE = 4,   ///< value.d
+    SHM_VALUE_DATETIME = 5, ///< value.i, OPC UA DateTime (100 ns since 1601-01-01)
+    SHM_VALUE_STRING = 6    ///< text, `length` bytes without terminating zero
+} ShmValueType;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t open;              ///< 1 while the gateway publishes, 0 once the segment is abandoned
+    uint32_t reserved;
+    uint64_t size;              ///< Size of the segment in bytes
+    uint64_t slot_count;
+    uint64_t directory_offset;  ///< Offset of slot_count ShmTableEntry, sorted by name
+    uint64_t names_offset;      ///< Offset of the names referenced by the directory
+    uint64_t slots_offset;      ///< Offset of slot_count ShmTableSlot, aligned on 64 bytes
+} ShmTableHeader;
+
+typedef struct {
+    uint32_t name_offset;       ///< Offset of the name from names_offset
+    uint32_t name_length;
+    uint64_t slot;
+} ShmTableEntry;
+
+/// @note A slot is 64 bytes so that two slots never share a cache line.
+typedef struct {
+    uint32_t sequence;
+    uint32_t status;            ///< OPC UA status code of the value
+    uint32_t type;              ///< ShmValueType
+    uint32_t length;            ///< Length of a string value in `text`
+    int64_t source_timestamp;   ///< OPC UA DateTime, 0 when unknown
+    int64_t server_timestamp;   ///< OPC UA DateTime, 0 when unknown
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+    } value;
+    char text[SHM_TABLE_TEXT_SIZE];
+} ShmTableSlot;
+
+#endif // SHM_LAYOUT_H
@@ -0,0 +1,65 @@
+#ifndef SHM_READER_H
+#define SHM_READER_H
+
+#include "shm_layout.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// @brief Header file for the reader library of the shared-memory live value table
+/// @file shm_reader.h
+/// @details Co-located consumers map the table read-only and read values without an OPC UA
+/// session. The library only depends on the C standard library and POSIX shared memory.
+
+typedef struct {
+    void* base;
+    size_t size;
+    const ShmTableHeader* header;
+    const ShmTableEntry* directory;
+    const char* names;
+    const ShmTableSlot* slots;
+} ShmReader;
+
+/// @brief Map the table published by the gateway
+/// @param reader Pointer to the ShmReader structure to initialize
+/// @param name Name of the segment as given to the gateway (e.g. "/opcuaserver")
+/// @return true on success, false if the segment does not exist or is not a value table
+bool shm_reader_open(ShmReader* reader, const char* name);
+
+/// @brief Find the slot of an item
+/// @param reader The reader
+/// @param path Item path "<machine>/<group>/<item>"
+/// @param slot Output receiving the slot index
+/// @return true if the item exists, false otherwise
+bool shm_reader_find(const ShmReader* reader, const char* path, size_t* slot);
+
+/// @brief Read a consistent copy of a slot
+/// @param reader The reader
+/// @param slot Index of the slot
+/// @param value Output receiving the copy
+/// @return true on success, false if the slot is out of range or kept changing during the copy
+bool shm_reader_read(const ShmReader* reader, size_t slot, ShmTableSlot* value);
+
+/// @brief Get the number of items of the table
+/// @param reader The reader
+/// @return Number of slots and directory entries
+size_t shm_reader_count(const ShmReader* reader);
+
+/// @brief Get the name of a directory entry
+/// @param reader The reader
+/// @param entry Index of the entry, in name order
+/// @param length Output receiving the length of the name, the name is not zero terminated
+/// @param slot Output receiving the slot of the entry
+/// @return Pointer to the name in the segment
+const char* shm_reader_entry(const ShmReader* reader, size_t entry, size_t* length, size_t* slot);
+
+/// @brief Check if the gateway abandoned the table
+/// @param reader The reader
+/// @return true once the gateway stopped, the reader should reopen the segment
+bool shm_reader_stale(const ShmReader* reader);
+
+/// @brief Unmap the table
+/// @param reader Pointer to the ShmReader structure to close
+void shm_reader_close(ShmReader* reader);
+
+#endif // SHM_READER_H
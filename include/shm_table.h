@@ -0,0 +1,42 @@
+#ifndef SHM_TABLE_H
+#define SHM_TABLE_H
+
+#include "common.h"
+#include "address_space.h"
+#include "shm_layout.h"
+
+#include <open62541/types.h>
+
+/// @brief Header file for the writer of the shared-memory live value table
+/// @file shm_table.h
+/// @details The gateway copies every published value into the slot of its item so that
+/// co-located consumers can read current values with the reader library (shm_reader.h).
+
+typedef struct {
+    char* name;
+    void* base;
+    size_t size;
+    ShmTableHeader* header;
+    ShmTableSlot* slots;
+} ShmTable;
+
+/// @brief Create the segment and write the directory of the layout
+/// @param table Pointer to the ShmTable structure to initialize
+/// @param name Name of the POSIX shared-memory segment (e.g. "/opcuaserver")
+/// @param address_space Layout of the gateway namespaces
+/// @return true on success, false otherwise
+/// @note A segment left by a previous run with the same name is replaced.
+bool shm_table_open(ShmTable* table, const char* name, const AddressSpace* address_space);
+
+/// @brief Copy a value into the slot of an item
+/// @param table The table
+/// @param slot Global index of the item
+/// @param value The value, only scalars of the built-in types are kept
+void shm_table_write(ShmTable* table, size_t slot, const UA_DataValue* value);
+
+/// @brief Mark the table abandoned, unmap and remove the segment
+/// @param table Pointer to the ShmTable structure to close
+/// @note Readers keep their mapping until they close it.
+void shm_table_close(ShmTable* table);
+
+#endif // SHM_TABLE_H
@@ -0,0 +1,75 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "common.h"
+#include "address_space.h"
+#include "gateway.h"
+
+#include <stdint.h>
+#include <open62541/server.h>
+
+/// @brief Header file for the last-known-value snapshot of the gateway items
+/// @file snapshot.h
+/// @details When the server stops, the current value of every item (value, status and
+/// timestamps) is written to a binary file. At the next start the file is mapped and the
+/// values are written back into the gateway nodes before the server listens, with a Good
+/// status downgraded to UncertainLastUsableValue, so clients read the last known values
+/// instead of BadWaitingForInitialData until the upstream machines deliver fresh ones.
+/// Records are keyed by item path ("<machine>/<group>/<item>"), so a snapshot survives
+/// items being added, removed or reordered in the machine files.
+///
+/// Layout (host byte order, the file is only meant for the host that wrote it):
+/// a SnapshotHeader, then `count` records made of a SnapshotRecord, the path bytes
+/// (not terminated) and the OPC UA binary encoding of the DataValue.
+
+/// @brief Magic bytes at the start of a snapshot
+#define SNAPSHOT_MAGIC "OPCUALKV"
+
+/// @brief Version of the snapshot layout
+#define SNAPSHOT_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;       ///< Number of records
+    int64_t written;      ///< UA_DateTime at which the snapshot was written
+} SnapshotHeader;
+
+typedef struct {
+    uint16_t path_length;
+    uint16_t reserved;
+    uint32_t value_length;
+} SnapshotRecord;
+
+/// @brief Write the values of the items to a snapshot file
+/// @param path Path of the snapshot, replaced atomically
+/// @param address_space Layout of the gateway namespaces
+/// @param values Value of every item, indexed by global item index, values without hasValue are skipped
+/// @return Number of values written, 0 with a message on failure
+size_t snapshot_write(const char* path, const AddressSpace* address_space, const UA_DataValue* values);
+
+/// @brief Read the values of a snapshot file for the items of a layout
+/// @param path Path of the snapshot
+/// @param address_space Layout of the gateway namespaces
+/// @param values Array of item_count values receiving the values found, others are left untouched
+/// @param written Receives the UA_DateTime at which the snapshot was written, may be NULL
+/// @return Number of values read, 0 if the file is missing or invalid
+/// @note Good values are returned with the status UncertainLastUsableValue.
+size_t snapshot_read(const char* path, const AddressSpace* address_space, UA_DataValue* values, UA_DateTime* written);
+
+/// @brief Save the current value of every gateway item
+/// @param path Path of the snapshot
+/// @param gateway The gateway, its cache of published values is saved
+/// @return Number of values saved
+/// @note Items that never received a value are not saved. The nodes are not read from the server.
+size_t snapshot_save(const char* path, const Gateway* gateway);
+
+/// @brief Restore the values of a snapshot into the gateway items
+/// @param path Path of the snapshot
+/// @param gateway The gateway, its nodes and shared-memory table receive the values
+/// @param server Pointer to the UA_Server instance, the machine namespaces must be registered
+/// @return Number of values restored
+/// @note Call before the upstream machines connect: fresh values simply replace the restored ones.
+size_t snapshot_restore(const char* path, Gateway* gateway, UA_Server* server);
+
+#endif // SNAPSHOT_H
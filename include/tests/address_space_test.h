@@ -0,0 +1,55 @@
+#ifndef ADDRESS_SPACE_TEST_H
+#define ADDRESS_SPACE_TEST_H
+
+#include "common_test.h"
+#include "../address_space.h"
+
+/// @brief Test initialization of the address space layout.
+/// @param None
+/// @return None
+/// @details This function tests the layout computed from the machine configurations of the fixtures.
+/// It checks that every machine is described and that items are counted across all groups and machines.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the address space test suite.
+/// @see init_address_space(), free_address_space()
+void test_init_address_space(void);
+
+/// @brief Test resolving NodeIds of the gateway namespaces.
+/// @param None
+/// @return None
+/// @details This function tests that machine, group and item NodeIds resolve to the right position.
+/// It checks that NodeIds outside the layout are rejected and that resolved positions convert back to the same NodeId.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the address space test suite.
+/// @see address_space_register_namespaces(), address_space_resolve(), address_space_node_id()
+void test_address_space_resolve(void);
+
+/// @brief Test the global item index of the layout.
+/// @param None
+/// @return None
+/// @details This function tests that every global item index maps to an item and back to the same index.
+/// It checks that indexes past the last item are rejected.
+/// @note This function is part of the address space test suite.
+/// @see address_space_item_at(), address_space_item_index()
+void test_address_space_item_index(void);
+
+/// @brief Test finding nodes from their paths.
+/// @param None
+/// @return None
+/// @details This function tests that machine, group and item paths resolve through the path index of the layout.
+/// It checks that the path of every item resolves back to the same item and that paths are compared on their length, not a terminator.
+/// It also ensures that unknown paths are rejected and that the memory is freed correctly after the test.
+/// @note This function is part of the address space test suite.
+/// @see address_space_find_path(), address_space_item_path()
+void test_address_space_find_path(void);
+
+/// @brief Test the mapping of item types to OPC UA data types.
+/// @param None
+/// @return None
+/// @details This function tests that the type names of the machine files map to the matching data types.
+/// It checks that unknown or missing type names fall back to the Variant type.
+/// @note This function is part of the address space test suite.
+/// @see address_space_data_type()
+void test_address_space_data_type(void);
+
+#endif // ADDRESS_SPACE_TEST_H
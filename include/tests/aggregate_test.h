@@ -0,0 +1,36 @@
+#ifndef AGGREGATE_TEST_H
+#define AGGREGATE_TEST_H
+
+#include "common_test.h"
+#include "../aggregate.h"
+
+/// @brief Test the aggregate items added by the machine configuration.
+/// @param None
+/// @return None
+/// @details This function tests that a group with aggregate windows gets one item per numeric item, window and statistic.
+/// It checks the names, types and positions of the aggregate items and that string items are not aggregated.
+/// @note This function is part of the aggregate test suite.
+/// @see load_machine_config()
+void test_aggregate_items(void);
+
+/// @brief Test the sliding windows of the aggregates.
+/// @param None
+/// @return None
+/// @details This function tests that Min, Max, Mean, Count and StdDev are published for each window of an item.
+/// It checks that values leaving the shortest window are expired while the longest window keeps them.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the aggregate test suite.
+/// @see init_aggregates(), aggregates_update(), aggregates_publish(), free_aggregates()
+void test_aggregate_windows(void);
+
+/// @brief Test the statistics of values with a large offset.
+/// @param None
+/// @return None
+/// @details This function tests that Mean and StdDev stay exact for values around 1e9 spread over several buckets.
+/// It checks that the statistics are still exact once a bucket with an outlier has left the window.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the aggregate test suite.
+/// @see aggregates_update(), aggregates_publish()
+void test_aggregate_large_offset(void);
+
+#endif // AGGREGATE_TEST_H
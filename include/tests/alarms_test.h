@@ -0,0 +1,50 @@
+#ifndef ALARMS_TEST_H
+#define ALARMS_TEST_H
+
+#include "common_test.h"
+#include "../alarms.h"
+
+/// @brief Test the loading of the limits and the creation of the alarms.
+/// @param None
+/// @return None
+/// @details This function tests that the Limits of a Group apply to its items without limits of their own
+/// and not to its aggregates, that the limits not set are NAN and that only the items with limits get an alarm.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the alarms test suite.
+/// @see load_machine_config(), init_alarms(), free_alarms()
+void test_alarms_items(void);
+
+/// @brief Test the state transitions of the alarms.
+/// @param None
+/// @return None
+/// @details This function tests that a value reaching a limit enters its state, that it leaves it only once it
+/// is back inside the limit by more than the Hysteresis, and that a value staying in its state is no transition.
+/// It checks that an item staged twice in the same update set keeps both transitions and that strings leave
+/// the state unchanged.
+/// @note This function is part of the alarms test suite.
+/// @see alarms_stage(), alarms_flush()
+void test_alarms_transitions(void);
+
+/// @brief Test the quality transitions of the alarms.
+/// @param None
+/// @return None
+/// @details This function tests that a bad value fires one quality transition that clears the state of the
+/// alarm instead of leaving it latched, and that further bad values fire nothing.
+/// It checks that the next value with a number fires its state with a Good quality, even when it is Normal,
+/// and that alarms_start creates one condition per alarm when open62541 has alarms and conditions.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the alarms test suite.
+/// @see alarms_start(), alarms_stage(), alarms_flush()
+void test_alarms_quality(void);
+
+/// @brief Test the evaluation kernel.
+/// @param None
+/// @return None
+/// @details This function tests that the vectorized evaluation gives the levels of the scalar rules for every
+/// batch length up to 13 rows, so that each remainder of the vector widths is covered.
+/// It checks values on the limits, within the hysteresis and limits that are not set.
+/// @note This function is part of the alarms test suite.
+/// @see alarms_evaluate()
+void test_alarms_evaluate(void);
+
+#endif // ALARMS_TEST_H
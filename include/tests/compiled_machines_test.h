@@ -0,0 +1,27 @@
+#ifndef COMPILED_MACHINES_TEST_H
+#define COMPILED_MACHINES_TEST_H
+
+#include "common_test.h"
+#include "../compiled_machines.h"
+
+/// @brief Test the generation of the compiled machine tables.
+/// @param None
+/// @return None
+/// @details This function tests that loaded machine configurations are written as C tables holding every
+/// setting of the machines, groups and items: queue, priority, aggregate windows, scaling and its infinite
+/// default range. It checks that the strings are escaped and that a group without items gets no table.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the compiled machines test suite.
+/// @see write_compiled_machine_config()
+void test_compiled_machines_write(void);
+
+/// @brief Test the loading of the compiled machines.
+/// @param None
+/// @return None
+/// @details This function tests that a server built without compiled machines loads none, and that freeing a
+/// compiled array only resets it, the static tables are not freed.
+/// @note This function is part of the compiled machines test suite.
+/// @see load_compiled_machine_config(), compiled_machines_source(), free_array_machine_config()
+void test_compiled_machines_load(void);
+
+#endif // COMPILED_MACHINES_TEST_H
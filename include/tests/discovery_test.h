@@ -0,0 +1,42 @@
+#ifndef DISCOVERY_TEST_H
+#define DISCOVERY_TEST_H
+
+#include "common_test.h"
+#include "../discovery.h"
+
+/// @brief Test the collection of browse and read results.
+/// @param None
+/// @return None
+/// @details This function tests that the objects and variables of a browse result are collected once, through
+/// their first reference and across continuation points, and that namespace 0 and properties are skipped.
+/// It checks that the Subscriptions hold one Group per object with variables, with the types read.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the discovery test suite.
+/// @see discovery_browsed(), discovery_typed(), discovery_subscriptions()
+void test_discovery_collect(void);
+
+/// @brief Test sending nodes again after a transient status.
+/// @param None
+/// @return None
+/// @details This function tests that an object answered with BadNoContinuationPoints is queued to be browsed
+/// again with smaller batches, and that a variable answered with BadTooManyOperations is queued to be read again.
+/// It checks that a node still failing after DISCOVER_MAX_ATTEMPTS sends aborts the discovery, which then
+/// builds no Subscriptions.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the discovery test suite.
+/// @see discovery_browsed(), discovery_typed(), discovery_subscriptions()
+void test_discovery_retry(void);
+
+/// @brief Test aborting a discovery on a bad status.
+/// @param None
+/// @return None
+/// @details This function tests that a node answered with a status that does not clear on its own, or a response
+/// with fewer results than nodes, aborts the discovery with that status.
+/// It checks that the results received after the abort are ignored and that no Subscriptions are built, so a
+/// machine file is never written from a partial discovery.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the discovery test suite.
+/// @see discovery_browsed(), discovery_subscriptions()
+void test_discovery_abort(void);
+
+#endif // DISCOVERY_TEST_H
@@ -0,0 +1,39 @@
+#ifndef EXPRESSION_TEST_H
+#define EXPRESSION_TEST_H
+
+#include "common_test.h"
+#include "../expression.h"
+
+/// @brief Test the compilation and evaluation of expressions.
+/// @param None
+/// @return None
+/// @details This function tests operator precedence, functions, the conditional operator and item references
+/// relative to the group, the machine or across machines.
+/// It checks that syntax errors and unknown items are reported.
+/// @note This function is part of the expression test suite.
+/// @see expression_compile(), expression_evaluate(), free_expression()
+void test_expression_compile(void);
+
+/// @brief Test the incremental evaluation of derived items.
+/// @param None
+/// @return None
+/// @details This function tests that a change re-evaluates the dependent expressions only and that results are
+/// published when they change, waiting for every referenced item first.
+/// It checks that constant expressions are published at startup and that cycles and invalid expressions are published Bad.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the expression test suite.
+/// @see init_expressions(), expressions_update(), free_expressions()
+void test_expressions_update(void);
+
+/// @brief Test the expressions taking part in a reference cycle.
+/// @param None
+/// @return None
+/// @details This function tests that only the members of a cycle are dropped, while the expressions reaching the
+/// cycle keep their program and are published with BadConfigurationError.
+/// It checks that the expressions outside the cycle are still evaluated.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the expression test suite.
+/// @see init_expressions(), expressions_update(), free_expressions()
+void test_expressions_cycles(void);
+
+#endif // EXPRESSION_TEST_H
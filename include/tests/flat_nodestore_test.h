@@ -0,0 +1,39 @@
+#ifndef FLAT_NODESTORE_TEST_H
+#define FLAT_NODESTORE_TEST_H
+
+#include "common_test.h"
+#include "../flat_nodestore.h"
+
+/// @brief Test releasing a view after its slot was replaced.
+/// @param None
+/// @return None
+/// @details This function tests that a view owns a copy of the item value: replacing the slot while the view is out
+/// leaves the view readable with the value it was assembled with.
+/// It checks that releasing the unwritten view afterwards keeps the replaced value in the slot.
+/// It also ensures that the nodestore and the memory are freed correctly after the test.
+/// @note This function is part of the flat nodestore test suite.
+/// @see flat_nodestore_install()
+void test_flat_nodestore_replace(void);
+
+/// @brief Test writing a value in place on a view.
+/// @param None
+/// @return None
+/// @details This function tests that a value written on a view, as the server does when it edits a node, moves into
+/// the slot when the view is released.
+/// It checks that releasing an older view of the same item afterwards does not undo the write.
+/// It also ensures that the nodestore and the memory are freed correctly after the test.
+/// @note This function is part of the flat nodestore test suite.
+/// @see flat_nodestore_install()
+void test_flat_nodestore_write(void);
+
+/// @brief Test the fixed structure of the gateway namespaces.
+/// @param None
+/// @return None
+/// @details This function tests that group views carry a HasComponent reference per item of the group.
+/// It checks that replacing a group, removing an item and inserting a node with a gateway NodeId are rejected.
+/// It also ensures that the nodestore and the memory are freed correctly after the test.
+/// @note This function is part of the flat nodestore test suite.
+/// @see flat_nodestore_install()
+void test_flat_nodestore_structure(void);
+
+#endif // FLAT_NODESTORE_TEST_H
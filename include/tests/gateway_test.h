@@ -0,0 +1,40 @@
+#ifndef GATEWAY_TEST_H
+#define GATEWAY_TEST_H
+
+#include "common_test.h"
+#include "../gateway.h"
+
+/// @brief Test the queues of the gateway.
+/// @param None
+/// @return None
+/// @details This function tests that pushed values are published one per item and per turn within the budget.
+/// It checks that a full Block queue pauses its machine until a value is published and that overflows are counted per Group.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the gateway test suite.
+/// @see init_gateway(), gateway_push(), gateway_publish(), gateway_machine_blocked(), free_gateway()
+void test_gateway_queues(void);
+
+/// @brief Test the cached encoding of the published values.
+/// @param None
+/// @return None
+/// @details This function tests that a scalar value with the same value and status as the last published value of its item
+/// is counted as unchanged instead of being written, even when its server or source timestamp differs.
+/// It checks that a new value or another item are published normally, that the cache follows them and their timestamps,
+/// and that a value written into the node by another writer than the gateway replaces the cached encoding.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the gateway test suite.
+/// @see gateway_push(), gateway_publish(), gateway_written(), free_gateway()
+void test_gateway_unchanged_values(void);
+
+/// @brief Test the priority classes of the gateway.
+/// @param None
+/// @return None
+/// @details This function tests that values of a High Group are published before the values of a Low Group queued earlier,
+/// and that a burst on a High item leaves the Low items one value per scheduler round instead of starving them.
+/// It checks the number of values published per class and that their latencies are measured.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the gateway test suite.
+/// @see gateway_push(), gateway_publish(), free_gateway()
+void test_gateway_priorities(void);
+
+#endif // GATEWAY_TEST_H
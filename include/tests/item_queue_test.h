@@ -0,0 +1,41 @@
+#ifndef ITEM_QUEUE_TEST_H
+#define ITEM_QUEUE_TEST_H
+
+#include "common_test.h"
+#include "../item_queue.h"
+
+/// @brief Test pushing and popping values in order.
+/// @param None
+/// @return None
+/// @details This function tests that values are popped in the order they were pushed and that an empty queue pops nothing.
+/// It checks that the reception time of the oldest value is kept with it.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the item queue test suite.
+/// @see init_item_queue(), item_queue_push(), item_queue_pop(), free_item_queue()
+void test_item_queue_fifo(void);
+
+/// @brief Test the DropOldest overflow policy.
+/// @param None
+/// @return None
+/// @details This function tests that a push on a full queue drops the oldest value and counts the overflow.
+/// @note This function is part of the item queue test suite.
+/// @see item_queue_push()
+void test_item_queue_drop_oldest(void);
+
+/// @brief Test the KeepLatest overflow policy.
+/// @param None
+/// @return None
+/// @details This function tests that a push on a full queue leaves only the new value and counts the overflow.
+/// @note This function is part of the item queue test suite.
+/// @see item_queue_push()
+void test_item_queue_keep_latest(void);
+
+/// @brief Test the Block overflow policy.
+/// @param None
+/// @return None
+/// @details This function tests that a full Block queue reports itself full and that a push past the bound replaces the newest value.
+/// @note This function is part of the item queue test suite.
+/// @see item_queue_push(), item_queue_full()
+void test_item_queue_block(void);
+
+#endif // ITEM_QUEUE_TEST_H
@@ -26,6 +26,17 @@ void test_init_array_machine_config(void);
 /// @see load_machine_config(), free_array_machine_config()
 void test_load_machine_config(void);
 
+/// @brief Test the fields of a loaded machine configuration.
+/// @param None
+/// @return None
+/// @details This function tests that machine, group and item fields are read from the machine files.
+/// It checks that the PascalCase keys and the "Subscriptions" array of the machine files are understood.
+/// It checks that the queue and priority settings of a group are read, whatever their case, and default when absent.
+/// It also verifies that the memory is freed correctly after the test.
+/// @note This function is part of the machine config test suite.
+/// @see load_machine_config(), free_array_machine_config()
+void test_load_machine_config_fields(void);
+
 /// @brief Test loading machine configuration from a non-existent file.
 /// @param None
 /// @return None
@@ -0,0 +1,41 @@
+#ifndef ON_DEMAND_TEST_H
+#define ON_DEMAND_TEST_H
+
+#include "common_test.h"
+#include "../on_demand.h"
+
+/// @brief Test the loading of the acquisition mode of the items.
+/// @param None
+/// @return None
+/// @details This function tests that Mode and Ttl are loaded in any case, that the Ttl defaults to
+/// DEFAULT_ON_DEMAND_TTL and that items computed by the gateway are never read on demand.
+/// It also ensures that the OnDemand counts the ondemand items and attaches itself to the address space.
+/// @note This function is part of the on-demand test suite.
+/// @see load_machine_config(), init_on_demand(), free_on_demand()
+void test_on_demand_items(void);
+
+/// @brief Test the read-through cache of the ondemand items.
+/// @param None
+/// @return None
+/// @details This function tests that the first Read of an item queues it once, that the Reads that follow
+/// are merged into the pending refresh, that a refresh pushes its value into the gateway and serves it
+/// until its Ttl has passed, and that a failed refresh leaves the item expired.
+/// It checks that items of a machine without client are dropped from the queue.
+/// @note This function is part of the on-demand test suite.
+/// @see on_demand_touch(), on_demand_flush(), on_demand_complete()
+void test_on_demand_single_flight(void);
+
+/// @brief Test serving an expired value as the last usable one.
+/// @param None
+/// @return None
+/// @details This function tests that a Read finding the value of an item past its Ttl queues the item and
+/// writes the value back as UncertainLastUsableValue, recorded as the current value of the item, while a
+/// Read within the Ttl leaves the value good.
+/// It checks that a value that is not good, such as BadWaitingForInitialData before the first refresh, is
+/// not marked.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the on-demand test suite.
+/// @see on_demand_on_read(), gateway_current()
+void test_on_demand_stale(void);
+
+#endif // ON_DEMAND_TEST_H
@@ -0,0 +1,27 @@
+#ifndef POOL_ALLOCATOR_TEST_H
+#define POOL_ALLOCATOR_TEST_H
+
+#include "common_test.h"
+#include "../pool_allocator.h"
+
+/// @brief Test the size classes of the pool allocator.
+/// @param None
+/// @return None
+/// @details This function tests that a freed block is handed out again for the next request of the same class,
+/// that the counters of the class follow the allocations, and that large requests are served by malloc.
+/// It also checks that calloc zeroes its block and that realloc keeps the block within its class and moves it,
+/// contents included, when it grows beyond.
+/// @note This function is part of the pool allocator test suite.
+/// @see pool_malloc(), pool_calloc(), pool_realloc(), pool_free(), pool_allocator_stats()
+void test_pool_allocator_classes(void);
+
+/// @brief Test the blocks freed by another thread than their owner.
+/// @param None
+/// @return None
+/// @details This function tests that blocks allocated by the test thread and freed by a worker thread are counted
+/// as remote frees, and that the owner takes them back from its return stack once its free list runs empty.
+/// @note This function is part of the pool allocator test suite.
+/// @see pool_malloc(), pool_free(), pool_allocator_stats()
+void test_pool_allocator_remote_free(void);
+
+#endif // POOL_ALLOCATOR_TEST_H
@@ -0,0 +1,32 @@
+#ifndef REPLICATION_TEST_H
+#define REPLICATION_TEST_H
+
+#include "common_test.h"
+#include "../replication.h"
+
+/// @brief Test streaming the values of a primary gateway to a standby.
+/// @param None
+/// @return None
+/// @details This function tests that a standby connected over a Unix socket exchanges hellos with the primary, receives
+/// the copy of the current values and then every value the primary publishes for an upstream item, queued into its own gateway.
+/// It checks that the standby does not stream the values it applies and that it takes over, listening on the
+/// replication address, as soon as the primary closes the connection.
+/// It also ensures that the sockets, the server and the memory are freed correctly after the test.
+/// @note This function is part of the replication test suite.
+/// @see init_replication(), replication_start(), replication_iterate(), replication_publish(), free_replication()
+void test_replication_stream(void);
+
+/// @brief Test that two gateways of a pair never stay primary together.
+/// @param None
+/// @return None
+/// @details This function tests that a standby which never reached a primary ignores the silence until the startup grace
+/// period is over, then takes over with a new epoch.
+/// It checks that a primary cut from its address by this takeover finds the new primary on its next probe, steps down to
+/// its standby (lower epoch) and receives the copy of the values, and that a primary started while the address answers
+/// starts as a standby.
+/// It also ensures that the sockets, the server and the memory are freed correctly after the test.
+/// @note This function is part of the replication test suite.
+/// @see replication_start(), replication_iterate(), replication_standby(), free_replication()
+void test_replication_fencing(void);
+
+#endif // REPLICATION_TEST_H
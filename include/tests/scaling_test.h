@@ -0,0 +1,29 @@
+#ifndef SCALING_TEST_H
+#define SCALING_TEST_H
+
+#include "common_test.h"
+#include "../scaling.h"
+
+/// @brief Test the engineering-unit conversion of the scaled items.
+/// @param None
+/// @return None
+/// @details This function tests that Scale, Offset, Min, Max and TargetType are loaded and that staged raw values
+/// are pushed converted into the target type of their item, clamped to its range and to the range of the type.
+/// It checks that clamped values are uncertain, that values without a number are BadOutOfRange, that bad values
+/// keep their status and that unscaled items are not staged.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the scaling test suite.
+/// @see init_scaling_batch(), scaling_batch_add(), scaling_batch_flush(), free_scaling_batch()
+void test_scaling_items(void);
+
+/// @brief Test the conversion kernel.
+/// @param None
+/// @return None
+/// @details This function tests that the vectorized conversion gives the results and the flags of the scalar
+/// formula for every batch length up to 13 rows, so that each remainder of the vector widths is covered.
+/// It checks clamped, NaN and infinite values.
+/// @note This function is part of the scaling test suite.
+/// @see scaling_convert()
+void test_scaling_convert(void);
+
+#endif // SCALING_TEST_H
@@ -0,0 +1,42 @@
+#ifndef SESSION_LIMITS_TEST_H
+#define SESSION_LIMITS_TEST_H
+
+#include "common_test.h"
+#include "../session_limits.h"
+
+/// @brief Test the index of the sessions.
+/// @param None
+/// @return None
+/// @details This function tests that many sessions opened and closed in any order keep their own budget: each
+/// session left open is refused after its own operations, and the closed ones are no longer charged.
+/// It checks that a session opened twice keeps one budget and that a closed session opened again gets a new one.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the session limits test suite.
+/// @see session_limits_open(), session_limits_close(), session_limits_charge(), free_session_limits()
+void test_session_limits_sessions(void);
+
+/// @brief Test charging the operations of the services only.
+/// @param None
+/// @return None
+/// @details This function tests that the access control wrapped by the limits charges the reads of a session
+/// while a client message is processed, and refuses them past its budget with an access level of 0.
+/// It checks that the reads made outside of a client message, the samples of the monitored items, are granted
+/// without being charged, and that every read is charged when the client messages are not seen.
+/// @note This function is part of the session limits test suite.
+/// @see session_limits_install(), session_limits_open(), free_session_limits()
+void test_session_limits_services(void);
+
+/// @brief Test the fair share of the budgets between the sessions.
+/// @param None
+/// @return None
+/// @details This function tests that a session reading in a loop is refused past its budget while the other
+/// sessions keep theirs, that the server limit is shared between the sessions active in the last round, and that
+/// the byte budget refuses the operations of a session reading large values.
+/// It checks that the sessions not activated through the limits are never refused.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the session limits test suite.
+/// @see session_limits_install(), session_limits_open(), session_limits_charge(), session_limits_round(),
+/// session_limits_close(), free_session_limits()
+void test_session_limits_fair_share(void);
+
+#endif // SESSION_LIMITS_TEST_H
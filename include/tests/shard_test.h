@@ -0,0 +1,41 @@
+#ifndef SHARD_TEST_H
+#define SHARD_TEST_H
+
+#include "common_test.h"
+#include "../shard.h"
+
+/// @brief Test the ring between a shard worker and the front.
+/// @param None
+/// @return None
+/// @details This function tests that values written into a ring are pushed in order into the gateway queues of
+/// their items, including when the records wrap around the end of the ring.
+/// It checks that a value written into a full ring is dropped and counted, and that a gateway attached to a ring
+/// writes its values into it instead of its queues and counts the values the full ring drops as Group overflows.
+/// It also ensures that the ring and the memory are freed correctly after the test.
+/// @note This function is part of the shard test suite.
+/// @see shard_ring_create(), shard_ring_write(), shard_ring_read(), shard_ring_free(), shard_ring_destroy()
+void test_shard_ring(void);
+
+/// @brief Test the assignment of the machines to the workers.
+/// @param None
+/// @return None
+/// @details This function tests that the machines are spread over the workers by number of items and that each
+/// worker gets a ring without being forked.
+/// It also ensures that the rings and the memory are freed correctly after the test.
+/// @note This function is part of the shard test suite.
+/// @see init_shards(), free_shards()
+void test_shard_assignment(void);
+
+/// @brief Test the backpressure of the machines of a worker.
+/// @param None
+/// @return None
+/// @details This function tests that the front drains the ring of a worker while one of its machines is blocked,
+/// so the values of the other machines of the worker keep flowing, and that the blocked machine is flagged in the
+/// state shared with the worker until its queue drains.
+/// It checks that the values a worker dropped on its full ring are added to the overflows of their Groups.
+/// It also ensures that the rings and the memory are freed correctly after the test.
+/// @note This function is part of the shard test suite.
+/// @see shard_exchange(), init_shards(), free_shards()
+void test_shard_backpressure(void);
+
+#endif // SHARD_TEST_H
@@ -0,0 +1,18 @@
+#ifndef SHM_TABLE_TEST_H
+#define SHM_TABLE_TEST_H
+
+#include "common_test.h"
+#include "../shm_table.h"
+#include "../shm_reader.h"
+
+/// @brief Test reading values written in the shared-memory table.
+/// @param None
+/// @return None
+/// @details This function tests that the reader finds every item of the fixtures by name and reads the values written by the gateway.
+/// It checks that items without a value report BadWaitingForInitialData and that unknown names are not found.
+/// It also checks that the reader sees the table abandoned once the gateway closes it.
+/// @note This function is part of the shared-memory table test suite.
+/// @see shm_table_open(), shm_table_write(), shm_reader_open(), shm_reader_find(), shm_reader_read()
+void test_shm_table_read_write(void);
+
+#endif // SHM_TABLE_TEST_H
@@ -0,0 +1,32 @@
+#ifndef SNAPSHOT_TEST_H
+#define SNAPSHOT_TEST_H
+
+#include "common_test.h"
+#include "../snapshot.h"
+
+/// @brief Test writing and reading a snapshot of item values.
+/// @param None
+/// @return None
+/// @details This function tests that the values of a layout are read back by item path into another layout
+/// where items were added, removed and reordered.
+/// It checks that values, source timestamps and bad statuses are kept, that good values come back as
+/// UncertainLastUsableValue, that items without value in the snapshot are left untouched and that the
+/// time of the snapshot is returned.
+/// It also checks that missing or foreign files are ignored and that the memory is freed correctly after the test.
+/// @note This function is part of the snapshot test suite.
+/// @see snapshot_write(), snapshot_read()
+void test_snapshot_round_trip(void);
+
+/// @brief Test saving the gateway values and restoring them into another gateway.
+/// @param None
+/// @return None
+/// @details This function tests that the values published by a gateway are saved from its cache of published values,
+/// without reading the nodes, and that items which never received a value are not saved.
+/// It checks that the restored values are published by the other gateway as UncertainLastUsableValue and become
+/// its current values.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the snapshot test suite.
+/// @see snapshot_save(), snapshot_restore(), gateway_preload(), gateway_current()
+void test_snapshot_gateway(void);
+
+#endif // SNAPSHOT_TEST_H
@@ -0,0 +1,35 @@
+#ifndef TRACE_TEST_H
+#define TRACE_TEST_H
+
+#include "common_test.h"
+#include "../trace.h"
+
+/// @brief Test that spans are ignored when no trace is open.
+/// @param None
+/// @return None
+/// @details This function tests that begin and end calls without an open trace do nothing and write no file.
+/// @note This function is part of the trace test suite.
+/// @see trace_begin(), trace_end(), trace_enabled()
+void test_trace_disabled(void);
+
+/// @brief Test the Chrome trace file of nested spans.
+/// @param None
+/// @return None
+/// @details This function tests that nested spans are written as complete events in the order they began.
+/// It checks that inner spans lie within their parent span and that details are written as arguments.
+/// It also checks that spans still open are ended when the trace is closed.
+/// @note This function is part of the trace test suite.
+/// @see trace_open(), trace_begin(), trace_end(), trace_close()
+void test_trace_nested_spans(void);
+
+/// @brief Test the Chrome trace file of detached spans.
+/// @param None
+/// @return None
+/// @details This function tests that spans started with trace_start end in any order, each on its own row,
+/// and that a span still running when the trace is closed is ended then.
+/// It also checks that trace_start returns TRACE_NO_SPAN without an open trace.
+/// @note This function is part of the trace test suite.
+/// @see trace_start(), trace_finish(), trace_close()
+void test_trace_detached_spans(void);
+
+#endif // TRACE_TEST_H
@@ -0,0 +1,52 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "common.h"
+
+/// @brief Header file for the startup phase tracing
+/// @file trace.h
+/// @details Spans are recorded in memory between `trace_open` and `trace_close`, then written
+/// as a Chrome trace (JSON object format) that chrome://tracing and Perfetto can load.
+/// Spans nest: a span begun inside another one is shown below it. When no trace is open,
+/// `trace_begin` and `trace_end` return immediately.
+/// Phases that overlap without nesting, such as the connections of the machines, are recorded with
+/// `trace_start` and `trace_finish` and shown each on its own row.
+
+/// @brief Maximum nesting depth of spans, deeper spans are not recorded
+#define TRACE_MAX_DEPTH 32
+
+/// @brief Span returned by `trace_start` when no trace is open
+#define TRACE_NO_SPAN SIZE_MAX
+
+/// @brief Start recording spans
+/// @param path Path of the trace file written by `trace_close`
+/// @note Calling it again while a trace is open has no effect.
+void trace_open(const char* path);
+
+/// @brief Check if spans are being recorded
+/// @return true between `trace_open` and `trace_close`
+bool trace_enabled(void);
+
+/// @brief Begin a span
+/// @param name Name of the span, copied
+/// @param detail Optional detail shown in the span arguments (a file path for instance), copied, may be NULL
+void trace_begin(const char* name, const char* detail);
+
+/// @brief End the innermost open span
+void trace_end(void);
+
+/// @brief Start a span that does not nest, ended by `trace_finish` in any order
+/// @param name Name of the span, copied
+/// @param detail Optional detail shown in the span arguments, copied, may be NULL
+/// @return The span, TRACE_NO_SPAN when no trace is open
+size_t trace_start(const char* name, const char* detail);
+
+/// @brief End a span started by `trace_start`
+/// @param span The span, TRACE_NO_SPAN or a span already ended are ignored
+void trace_finish(size_t span);
+
+/// @brief End the remaining spans, write the trace file and stop recording
+/// @return true if the trace file was written or no trace was open, false otherwise
+bool trace_close(void);
+
+#endif // TRACE_H
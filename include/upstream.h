@@ -0,0 +1,128 @@
+#ifndef UPSTREAM_H
+#define UPSTREAM_H
+
+#include "common.h"
+#include "gateway.h"
+#include "scaling.h"
+
+#include <open62541/client.h>
+#include <open62541/server.h>
+
+/// @brief Header file for the upstream subscriptions of the machines
+/// @file upstream.h
+/// @details One client per machine connects to the machine URL and creates one subscription
+/// per Group with a monitored item per Item. Data changes are pushed into the gateway queues.
+/// The clients are iterated from a repeated server callback. While a Block queue of a machine
+/// is full the publishing of its subscriptions is disabled: the machine's server holds the notifications
+/// back, and the client keeps being iterated so that keepalives, secure channel renewals and ondemand
+/// reads go on. Notifications already on their way when publishing stops may still overflow the queue.
+/// Subscriptions and monitored items are created with asynchronous requests, so a slow machine never
+/// holds the server loop. The NodeIds are parsed once: a Group without a valid one gets no subscription,
+/// and an item rejected by the machine is logged and gets the status of the rejection.
+/// A machine whose subscriptions cannot be created is subscribed again after UPSTREAM_RECONNECT_DELAY.
+/// A standby gateway connects and subscribes like the primary but with publishing disabled: the
+/// machines keep sampling and the sessions stay warm, and enabling publishing on failover delivers
+/// the current values without reconnecting.
+/// The values of scaled items are staged while a client is iterated and converted together once its
+/// notifications are read (see scaling.h).
+
+/// @brief Interval of the upstream callback in milliseconds
+#define UPSTREAM_ITERATE_INTERVAL 10.0
+
+/// @brief Delay before reconnecting a machine in milliseconds
+#define UPSTREAM_RECONNECT_DELAY 5000
+
+/// @brief Time after upstream_start past which the machines still connecting no longer delay upstream_started,
+/// in milliseconds
+#define UPSTREAM_STARTUP_TIMEOUT 30000
+
+typedef struct UpstreamMachine UpstreamMachine;
+
+typedef struct {
+    UpstreamMachine* upstream_machine;
+    size_t group;                           ///< Index of the Group in the machine configuration
+    UA_MonitoredItemCreateRequest* create;  ///< One request per item with a valid NodeId
+    size_t* items;                          ///< Global index of the item of each request
+    size_t count;
+} UpstreamGroup;
+
+struct UpstreamMachine {
+    UA_Client* client;
+    Gateway* gateway;
+    size_t machine;
+    bool subscribed;
+    bool subscribing;          ///< Subscription requests in flight
+    bool failed;               ///< A request of the current setup failed
+    bool connecting;           ///< Connection started and session not activated yet
+    bool started;              ///< Subscribed, or failed to connect or subscribe, at least once
+    size_t connect_span;       ///< Trace span of the connection, TRACE_NO_SPAN when not recorded
+    size_t subscribe_span;     ///< Trace span of the subscription setup, TRACE_NO_SPAN when not recorded
+    bool publishing;           ///< Subscriptions are created with publishing enabled
+    bool paused;               ///< Publishing disabled while a Block queue of the machine is full
+    bool on_demand;            ///< The ondemand items are read by on_demand.h instead of monitored
+    UpstreamGroup* groups;     ///< Groups with monitored items, parsed by upstream_start
+    size_t group_count;
+    size_t pending;            ///< Groups of the current setup still waiting for a response
+    UA_UInt32* subscriptions;  ///< Ids of the subscriptions of the current session, one per Group
+    size_t subscription_count;
+    UA_DateTime retry_at;
+    UA_DateTime subscribe_at;  ///< Next attempt to subscribe after a failed one
+    ScalingBatch scaling;      ///< Values of the scaled items received during the current iteration
+};
+
+typedef struct {
+    Gateway* gateway;
+    size_t count;
+    UpstreamMachine* machines;
+    UA_UInt64 callback_id;
+    UA_DateTime startup_deadline;  ///< Monotonic time past which upstream_started is true
+} Upstream;
+
+/// @brief Create one client per machine with an URL
+/// @param upstream Pointer to the Upstream structure to initialize
+/// @param gateway Gateway receiving the values, must outlive the upstream clients
+void init_upstream(Upstream* upstream, Gateway* gateway);
+
+/// @brief Create one client per selected machine with an URL
+/// @param upstream Pointer to the Upstream structure to initialize
+/// @param gateway Gateway receiving the values, must outlive the upstream clients
+/// @param selected Machines to connect, indexed by machine, NULL for every machine
+void init_upstream_machines(Upstream* upstream, Gateway* gateway, const bool* selected);
+
+/// @brief Connect the machines and add the upstream callback to the server
+/// @param upstream The upstream clients
+/// @param server Pointer to the UA_Server instance, NULL when the caller iterates the clients with upstream_iterate
+/// @return UA_STATUSCODE_GOOD on success
+/// @note Connections are asynchronous, a machine that cannot be reached is retried every UPSTREAM_RECONNECT_DELAY.
+UA_StatusCode upstream_start(Upstream* upstream, UA_Server* server);
+
+/// @brief Read the notifications of the machines and keep their sessions and subscriptions up
+/// @param upstream The upstream clients
+/// @note Called by the upstream callback, or by the loop of a shard worker that has no server.
+void upstream_iterate(Upstream* upstream);
+
+/// @brief Push a value received from a machine into the gateway
+/// @param upstream_machine The machine
+/// @param item Global index of the item
+/// @param value The value, only read
+/// @note Values of scaled items are staged and pushed when the iteration of the client ends.
+void upstream_push(UpstreamMachine* upstream_machine, size_t item, const UA_DataValue* value);
+
+/// @brief Check if the machines are past their startup
+/// @param upstream The upstream clients
+/// @return true once every machine has connected and subscribed, or failed to, since upstream_start, or once
+/// UPSTREAM_STARTUP_TIMEOUT has passed
+/// @note The startup trace is closed then, so that it covers the connections and subscriptions of the machines.
+bool upstream_started(const Upstream* upstream);
+
+/// @brief Enable or disable the publishing of the upstream subscriptions
+/// @param upstream The upstream clients
+/// @param publishing false to keep the subscriptions without notifications, true to resume them
+/// @note Applies to the subscriptions already created and to the ones created later.
+void upstream_set_publishing(Upstream* upstream, bool publishing);
+
+/// @brief Disconnect and free the upstream clients
+/// @param upstream Pointer to the Upstream structure to free
+void free_upstream(Upstream* upstream);
+
+#endif // UPSTREAM_H
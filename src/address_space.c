@@ -0,0 +1,588 @@
+#include "../include/address_space.h"
+
+#include <open62541/plugin/log_stdout.h>
+
+typedef struct {
+    const char* name;
+    size_t type_index;
+} TypeMapping;
+
+static const TypeMapping TYPE_MAPPINGS[] = {
+    {"System.Boolean", UA_TYPES_BOOLEAN},
+    {"System.SByte", UA_TYPES_SBYTE},
+    {"System.Byte", UA_TYPES_BYTE},
+    {"System.Int16", UA_TYPES_INT16},
+    {"System.UInt16", UA_TYPES_UINT16},
+    {"System.Int32", UA_TYPES_INT32},
+    {"System.UInt32", UA_TYPES_UINT32},
+    {"System.Int64", UA_TYPES_INT64},
+    {"System.UInt64", UA_TYPES_UINT64},
+    {"System.Single", UA_TYPES_FLOAT},
+    {"System.Double", UA_TYPES_DOUBLE},
+    {"System.String", UA_TYPES_STRING},
+    {"System.DateTime", UA_TYPES_DATETIME},
+};
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static size_t _find_group(const AddressSpaceMachine* machine, size_t item);
+static UA_UInt32 _hash_path(const char* path, size_t length);
+static bool _path_position(const AddressSpace* address_space, UA_UInt32 key, AddressSpaceNode* node);
+static size_t _node_path(const AddressSpace* address_space, const AddressSpaceNode* node, char* buffer, size_t size);
+static void _index_paths(AddressSpace* address_space);
+
+
+/// @brief Find the group containing an item
+/// @param machine The machine owning the item
+/// @param item Index of the item inside the machine
+/// @return Index of the group containing the item
+/// @note Binary search for the last group whose first item is not after the item, which skips empty groups.
+static size_t _find_group(const AddressSpaceMachine* machine, size_t item){
+    size_t low = 0;
+    size_t high = machine->config->groups.count;
+
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (machine->group_first_item[middle] <= item) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/// @brief FNV-1a hash of a path
+static UA_UInt32 _hash_path(const char* path, size_t length){
+    UA_UInt32 hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/// @brief Decode the node of a slot of the path index
+/// @param address_space Pointer to the AddressSpace
+/// @param key The node of the slot, (kind + 1) << 30 | global index
+/// @param node Output receiving the position
+/// @return false for an empty slot
+static bool _path_position(const AddressSpace* address_space, UA_UInt32 key, AddressSpaceNode* node){
+
+    size_t index = key & 0x3FFFFFFFu;
+    size_t low = 0;
+    size_t high = address_space->count;
+
+    switch (key >> 30) {
+        case ADDRESS_SPACE_NODE_MACHINE + 1:
+            node->kind = ADDRESS_SPACE_NODE_MACHINE;
+            node->machine = index;
+            node->group = 0;
+            node->item = 0;
+            return true;
+        case ADDRESS_SPACE_NODE_GROUP + 1:
+            // Last machine whose first group is not after the group, which skips machines without groups
+            while (high - low > 1) {
+                size_t middle = low + (high - low) / 2;
+                if (address_space->machines[middle].first_group <= index) {
+                    low = middle;
+                } else {
+                    high = middle;
+                }
+            }
+            node->kind = ADDRESS_SPACE_NODE_GROUP;
+            node->machine = low;
+            node->group = index - address_space->machines[low].first_group;
+            node->item = 0;
+            return true;
+        case ADDRESS_SPACE_NODE_ITEM + 1:
+            return address_space_item_at(address_space, index, node);
+        default:
+            return false;
+    }
+}
+
+/// @brief Write the path of a machine, group or item
+/// @param address_space Pointer to the AddressSpace
+/// @param node Position of the node
+/// @param buffer Output receiving the path, truncated to its size
+/// @param size Size of the buffer
+/// @return Length of the complete path, as snprintf
+static size_t _node_path(const AddressSpace* address_space, const AddressSpaceNode* node, char* buffer, size_t size){
+
+    const MachineConfig* config = address_space->machines[node->machine].config;
+    const char* machine = config->name ? config->name : "";
+    const char* group;
+    int length;
+
+    if (node->kind == ADDRESS_SPACE_NODE_ITEM) {
+        return address_space_item_path(address_space, address_space_item_index(address_space, node), buffer, size);
+    }
+
+    if (node->kind == ADDRESS_SPACE_NODE_MACHINE) {
+        length = snprintf(buffer, size, "%s", machine);
+    } else {
+        group = config->groups.groups[node->group].name;
+        length = snprintf(buffer, size, "%s/%s", machine, group ? group : "");
+    }
+
+    return length > 0 ? (size_t)length : 0;
+}
+
+/// @brief Build the path index of the machines, groups and items
+/// @param address_space Pointer to the AddressSpace with its machines laid out
+/// @note The table is kept at most half full, so unsuccessful lookups stop at an empty slot quickly.
+static void _index_paths(AddressSpace* address_space){
+
+    size_t count = address_space->count + address_space->group_count + address_space->item_count;
+    size_t duplicates = 0;
+    size_t mask;
+    char buffer[ADDRESS_SPACE_MAX_PATH];
+    char other[ADDRESS_SPACE_MAX_PATH];
+
+    // Global indexes share the 30 low bits of a slot with the kind
+    if (count > 0x3FFFFFFFu) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Too many nodes to index their paths");
+        return;
+    }
+
+    address_space->path_capacity = 16;
+    while (address_space->path_capacity < count * 2) address_space->path_capacity *= 2;
+    mask = address_space->path_capacity - 1;
+
+    address_space->paths = (AddressSpacePath*)calloc(address_space->path_capacity, sizeof(AddressSpacePath));
+    if (!address_space->paths) {
+        fprintf(stderr, "Failed to allocate memory for the AddressSpace paths\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (UA_UInt32 kind = ADDRESS_SPACE_NODE_MACHINE; kind <= ADDRESS_SPACE_NODE_ITEM; kind++) {
+        size_t total = kind == ADDRESS_SPACE_NODE_MACHINE ? address_space->count
+                     : kind == ADDRESS_SPACE_NODE_GROUP ? address_space->group_count
+                     : address_space->item_count;
+
+        for (size_t i = 0; i < total; i++) {
+            AddressSpacePath entry = {0, (kind + 1) << 30 | (UA_UInt32)i};
+            AddressSpaceNode node;
+            size_t length;
+            size_t slot;
+            bool duplicate = false;
+
+            _path_position(address_space, entry.node, &node);
+            length = _node_path(address_space, &node, buffer, sizeof(buffer));
+            if (length >= sizeof(buffer)) continue;
+
+            entry.hash = _hash_path(buffer, length);
+            for (slot = entry.hash & mask; address_space->paths[slot].node != 0; slot = (slot + 1) & mask) {
+                AddressSpaceNode existing;
+
+                if (address_space->paths[slot].hash != entry.hash) continue;
+
+                _path_position(address_space, address_space->paths[slot].node, &existing);
+                if (_node_path(address_space, &existing, other, sizeof(other)) == length &&
+                    memcmp(buffer, other, length) == 0) {
+                    duplicate = true;
+                    break;
+                }
+            }
+
+            if (duplicate) {
+                duplicates++;
+                continue;
+            }
+
+            address_space->paths[slot] = entry;
+        }
+    }
+
+    if (duplicates > 0) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                       "%zu paths are used by several nodes, they resolve to the first one", duplicates);
+    }
+}
+
+/// @brief Initialize the layout of the gateway namespaces
+/// @param address_space Pointer to the AddressSpace structure to initialize
+/// @param config Machine configurations described by the layout
+/// @note The configurations must outlive the layout. Namespaces are only known after `address_space_register_namespaces`.
+void init_address_space(AddressSpace* address_space, ArrayMachineConfig* config){
+
+    if (!address_space || !config) return;
+
+    memset(address_space, 0, sizeof(AddressSpace));
+    address_space->config = config;
+    address_space->count = config->count;
+
+    if (config->count == 0) return;
+
+    address_space->machines = (AddressSpaceMachine*)calloc(config->count, sizeof(AddressSpaceMachine));
+    if (!address_space->machines) {
+        fprintf(stderr, "Failed to allocate memory for AddressSpace\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t m = 0; m < config->count; m++) {
+        AddressSpaceMachine* machine = &address_space->machines[m];
+        ArrayGroup* groups = &config->configs[m].groups;
+
+        machine->config = &config->configs[m];
+        machine->first_item = address_space->item_count;
+        machine->first_group = address_space->group_count;
+        machine->group_first_item = (size_t*)malloc(sizeof(size_t) * (groups->count + 1));
+        if (!machine->group_first_item) {
+            fprintf(stderr, "Failed to allocate memory for AddressSpaceMachine\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t g = 0; g < groups->count; g++) {
+            machine->group_first_item[g] = machine->item_count;
+            machine->item_count += groups->groups[g].items.count;
+        }
+        machine->group_first_item[groups->count] = machine->item_count;
+
+        address_space->item_count += machine->item_count;
+        address_space->group_count += groups->count;
+    }
+
+    _index_paths(address_space);
+}
+
+/// @brief Register one namespace per machine in the server
+/// @param address_space Pointer to the initialized AddressSpace
+/// @param server Pointer to the UA_Server instance
+/// @note Machines sharing a namespace URI with a previous machine are not reachable and a warning is logged.
+void address_space_register_namespaces(AddressSpace* address_space, UA_Server* server){
+
+    UA_UInt16 max_index = 0;
+
+    if (!address_space || !server) return;
+
+    for (size_t m = 0; m < address_space->count; m++) {
+        MachineConfig* config = address_space->machines[m].config;
+        const char* uri = config->namespace ? config->namespace : config->name;
+
+        if (!uri) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                           "Machine %zu has neither a namespace nor a name, it is not exposed", m);
+            continue;
+        }
+
+        address_space->machines[m].namespace_index = UA_Server_addNamespace(server, uri);
+        if (address_space->machines[m].namespace_index > max_index) {
+            max_index = address_space->machines[m].namespace_index;
+        }
+    }
+
+    free(address_space->by_namespace);
+    address_space->namespace_count = (size_t)max_index + 1;
+    address_space->by_namespace = (AddressSpaceMachine**)calloc(address_space->namespace_count, sizeof(AddressSpaceMachine*));
+    if (!address_space->by_namespace) {
+        fprintf(stderr, "Failed to allocate memory for AddressSpace namespaces\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t m = 0; m < address_space->count; m++) {
+        AddressSpaceMachine* machine = &address_space->machines[m];
+
+        // Namespace 0 is the standard namespace, it never belongs to a machine
+        if (machine->namespace_index == 0) continue;
+
+        if (address_space->by_namespace[machine->namespace_index]) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                           "Machine %s reuses namespace %u, it is not exposed",
+                           machine->config->name ? machine->config->name : "", machine->namespace_index);
+            machine->namespace_index = 0;
+            continue;
+        }
+
+        address_space->by_namespace[machine->namespace_index] = machine;
+    }
+}
+
+/// @brief Resolve a NodeId to a machine, group or item of the layout
+/// @param address_space Pointer to the AddressSpace to search
+/// @param node_id The NodeId to resolve
+/// @param node Output receiving the resolved position
+/// @return true if the NodeId belongs to the gateway namespaces, false otherwise
+/// @note For items, `node->item` is the index of the item inside its machine.
+bool address_space_resolve(const AddressSpace* address_space, const UA_NodeId* node_id, AddressSpaceNode* node){
+
+    const AddressSpaceMachine* machine;
+    size_t group_count;
+    size_t identifier;
+
+    if (!address_space || !node_id || !node) return false;
+    if (node_id->identifierType != UA_NODEIDTYPE_NUMERIC) return false;
+    if (node_id->namespaceIndex >= address_space->namespace_count) return false;
+
+    machine = address_space->by_namespace[node_id->namespaceIndex];
+    if (!machine) return false;
+
+    identifier = node_id->identifier.numeric;
+    group_count = machine->config->groups.count;
+
+    node->machine = (size_t)(machine - address_space->machines);
+    node->group = 0;
+    node->item = 0;
+
+    if (identifier == ADDRESS_SPACE_MACHINE_ID) {
+        node->kind = ADDRESS_SPACE_NODE_MACHINE;
+        return true;
+    }
+
+    if (identifier < ADDRESS_SPACE_FIRST_GROUP_ID) return false;
+    identifier -= ADDRESS_SPACE_FIRST_GROUP_ID;
+
+    if (identifier < group_count) {
+        node->kind = ADDRESS_SPACE_NODE_GROUP;
+        node->group = identifier;
+        return true;
+    }
+
+    identifier -= group_count;
+    if (identifier >= machine->item_count) return false;
+
+    node->kind = ADDRESS_SPACE_NODE_ITEM;
+    node->item = identifier;
+    node->group = _find_group(machine, identifier);
+
+    return true;
+}
+
+/// @brief Build the NodeId of a machine, group or item of the layout
+/// @param address_space Pointer to the AddressSpace
+/// @param node The position to convert
+/// @return The numeric NodeId of the node (no memory is allocated)
+UA_NodeId address_space_node_id(const AddressSpace* address_space, const AddressSpaceNode* node){
+
+    const AddressSpaceMachine* machine = &address_space->machines[node->machine];
+
+    switch (node->kind) {
+        case ADDRESS_SPACE_NODE_MACHINE:
+            return UA_NODEID_NUMERIC(machine->namespace_index, ADDRESS_SPACE_MACHINE_ID);
+        case ADDRESS_SPACE_NODE_GROUP:
+            return UA_NODEID_NUMERIC(machine->namespace_index, (UA_UInt32)(ADDRESS_SPACE_FIRST_GROUP_ID + node->group));
+        case ADDRESS_SPACE_NODE_ITEM:
+        default:
+            return UA_NODEID_NUMERIC(machine->namespace_index,
+                                     (UA_UInt32)(ADDRESS_SPACE_FIRST_GROUP_ID + machine->config->groups.count + node->item));
+    }
+}
+
+/// @brief Get the browse name of a machine, group or item
+/// @param address_space Pointer to the AddressSpace
+/// @param node Position of the node
+/// @return A browse name pointing into the machine configuration (no memory is allocated)
+UA_QualifiedName address_space_browse_name(const AddressSpace* address_space, const AddressSpaceNode* node){
+
+    const AddressSpaceMachine* machine = &address_space->machines[node->machine];
+    const char* name = NULL;
+
+    switch (node->kind) {
+        case ADDRESS_SPACE_NODE_MACHINE:
+            name = machine->config->name;
+            break;
+        case ADDRESS_SPACE_NODE_GROUP:
+            name = machine->config->groups.groups[node->group].name;
+            break;
+        case ADDRESS_SPACE_NODE_ITEM:
+            name = address_space_item(address_space, node)->name;
+            break;
+    }
+
+    return UA_QUALIFIEDNAME(machine->namespace_index, (char*)(name ? name : ""));
+}
+
+/// @brief Link the machine objects of the layout below the Objects folder
+/// @param server Pointer to the UA_Server instance
+/// @param address_space Layout with registered namespaces
+/// @return UA_STATUSCODE_GOOD on success
+/// @note Only the Objects folder is modified through the nodestore, the machine nodes are provided by the gateway nodestore.
+UA_StatusCode address_space_link_machines(UA_Server* server, const AddressSpace* address_space){
+
+    UA_ServerConfig* config = UA_Server_getConfig(server);
+    UA_NodeId objects = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    AddressSpaceNode machine = {0};
+    UA_StatusCode retval;
+    UA_Node* node = NULL;
+
+    retval = config->nodestore.getNodeCopy(config->nodestore.context, &objects, &node);
+    if (retval != UA_STATUSCODE_GOOD) return retval;
+
+    machine.kind = ADDRESS_SPACE_NODE_MACHINE;
+    for (machine.machine = 0; machine.machine < address_space->count; machine.machine++) {
+        if (address_space->machines[machine.machine].namespace_index == 0) continue;
+
+        retval |= address_space_add_reference(node, UA_REFERENCETYPEINDEX_ORGANIZES, true,
+                                              address_space_node_id(address_space, &machine),
+                                              address_space_browse_name(address_space, &machine));
+    }
+
+    if (retval != UA_STATUSCODE_GOOD) {
+        config->nodestore.deleteNode(config->nodestore.context, node);
+        return retval;
+    }
+
+    return config->nodestore.replaceNode(config->nodestore.context, node);
+}
+
+/// @brief Add a reference to a node built by a gateway nodestore
+/// @param node The node receiving the reference
+/// @param reference_type Index of the reference type (UA_REFERENCETYPEINDEX_*)
+/// @param forward Direction of the reference
+/// @param target NodeId of the target node
+/// @param target_name Browse name of the target, used to compute the browse name hash
+/// @return The status of UA_Node_addReference
+UA_StatusCode address_space_add_reference(UA_Node* node, UA_Byte reference_type, UA_Boolean forward,
+                                          UA_NodeId target, UA_QualifiedName target_name){
+    UA_ExpandedNodeId expanded = UA_EXPANDEDNODEID_NULL;
+    expanded.nodeId = target;
+
+    return UA_Node_addReference(node, reference_type, forward, &expanded, UA_QualifiedName_hash(&target_name));
+}
+
+/// @brief Get the item configuration of a resolved item node
+/// @param address_space Pointer to the AddressSpace
+/// @param node Position of an item
+/// @return Pointer to the Item in the machine configuration
+const Item* address_space_item(const AddressSpace* address_space, const AddressSpaceNode* node){
+
+    const AddressSpaceMachine* machine = &address_space->machines[node->machine];
+    const Group* group = &machine->config->groups.groups[node->group];
+
+    return &group->items.items[node->item - machine->group_first_item[node->group]];
+}
+
+/// @brief Get the global index of an item, counted across all machines
+/// @param address_space Pointer to the AddressSpace
+/// @param node Position of an item
+/// @return Index in the range [0, address_space->item_count)
+size_t address_space_item_index(const AddressSpace* address_space, const AddressSpaceNode* node){
+    return address_space->machines[node->machine].first_item + node->item;
+}
+
+/// @brief Find the position of an item from its global index
+/// @param address_space Pointer to the AddressSpace
+/// @param index Global index of the item
+/// @param node Output receiving the item position
+/// @return true if the index is in range, false otherwise
+bool address_space_item_at(const AddressSpace* address_space, size_t index, AddressSpaceNode* node){
+
+    size_t low = 0;
+    size_t high;
+
+    if (!address_space || !node || index >= address_space->item_count) return false;
+
+    high = address_space->count;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (address_space->machines[middle].first_item <= index) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    node->kind = ADDRESS_SPACE_NODE_ITEM;
+    node->machine = low;
+    node->item = index - address_space->machines[low].first_item;
+    node->group = _find_group(&address_space->machines[low], node->item);
+
+    return true;
+}
+
+/// @brief Write the path of an item, "<machine>/<group>/<item>" after the names of the configuration
+/// @param address_space Pointer to the AddressSpace
+/// @param index Global index of the item
+/// @param buffer Output receiving the path, truncated to its size
+/// @param size Size of the buffer
+/// @return Length of the complete path, as snprintf, 0 if the index is out of range
+size_t address_space_item_path(const AddressSpace* address_space, size_t index, char* buffer, size_t size){
+
+    AddressSpaceNode position;
+    const MachineConfig* config;
+    const char* group;
+    const Item* item;
+    int length;
+
+    if (!address_space_item_at(address_space, index, &position)) return 0;
+
+    config = address_space->machines[position.machine].config;
+    group = config->groups.groups[position.group].name;
+    item = address_space_item(address_space, &position);
+
+    length = snprintf(buffer, size, "%s/%s/%s", config->name ? config->name : "", group ? group : "",
+                      item->name ? item->name : "");
+
+    return length > 0 ? (size_t)length : 0;
+}
+
+/// @brief Find a machine, group or item from its path
+/// @param address_space Pointer to the AddressSpace
+/// @param path "<machine>", "<machine>/<group>" or "<machine>/<group>/<item>", not necessarily terminated
+/// @param length Length of the path
+/// @param node Output receiving the position
+/// @return true if the path belongs to the layout, false otherwise
+/// @note When several nodes share a path, the first one in configuration order is found.
+bool address_space_find_path(const AddressSpace* address_space, const char* path, size_t length, AddressSpaceNode* node){
+
+    char buffer[ADDRESS_SPACE_MAX_PATH];
+    UA_UInt32 hash;
+    size_t mask;
+
+    if (!address_space || !path || !node || !address_space->paths) return false;
+    if (length >= sizeof(buffer)) return false;
+
+    hash = _hash_path(path, length);
+    mask = address_space->path_capacity - 1;
+
+    // Hashes are compared first, the path is only rebuilt for the candidates
+    for (size_t slot = hash & mask; address_space->paths[slot].node != 0; slot = (slot + 1) & mask) {
+        if (address_space->paths[slot].hash != hash) continue;
+
+        _path_position(address_space, address_space->paths[slot].node, node);
+        if (_node_path(address_space, node, buffer, sizeof(buffer)) == length && memcmp(buffer, path, length) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// @brief Map an item type of the machine files to an OPC UA data type
+/// @param type Type name as written in the machine files (e.g. "System.Int16")
+/// @return The matching data type, or the Variant type (BaseDataType) when the name is unknown
+const UA_DataType* address_space_data_type(const char* type){
+
+    if (type) {
+        for (size_t i = 0; i < sizeof(TYPE_MAPPINGS) / sizeof(TYPE_MAPPINGS[0]); i++) {
+            if (strcmp(TYPE_MAPPINGS[i].name, type) == 0) {
+                return &UA_TYPES[TYPE_MAPPINGS[i].type_index];
+            }
+        }
+    }
+
+    return &UA_TYPES[UA_TYPES_VARIANT];
+}
+
+/// @brief Free the memory allocated for the layout
+/// @param address_space Pointer to the AddressSpace structure to free
+/// @note The machine configurations themselves are not freed.
+void free_address_space(AddressSpace* address_space){
+
+    if (!address_space) return;
+
+    if (address_space->machines != NULL) {
+        for (size_t m = 0; m < address_space->count; m++) {
+            free(address_space->machines[m].group_first_item);
+        }
+        free(address_space->machines);
+    }
+
+    free(address_space->by_namespace);
+    free(address_space->paths);
+    memset(address_space, 0, sizeof(AddressSpace));
+}
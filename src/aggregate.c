@@ -0,0 +1,304 @@
+#include "../include/aggregate.h"
+
+#include <math.h>
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void _advance(AggregateWindow* window, UA_DateTime now);
+static void _merge(AggregateBucket* into, const AggregateBucket* from);
+static void _publish_window(Aggregates* aggregates, size_t first, const AggregateWindow* window);
+static void _push(Aggregates* aggregates, size_t item, const void* value, const UA_DataType* type, UA_StatusCode status);
+static void _publish_callback(UA_Server* server, void* data);
+
+
+/// @brief Slide a window to the current time, expiring the buckets left behind
+/// @param window The window
+/// @param now Current time of the monotonic clock
+static void _advance(AggregateWindow* window, UA_DateTime now){
+
+    UA_DateTime steps;
+
+    if (window->head_start == 0) {
+        window->head_start = now;
+        return;
+    }
+
+    if (now < window->head_start + window->width) return;
+
+    steps = (now - window->head_start) / window->width;
+
+    if (steps >= AGGREGATE_BUCKETS) {
+        if (window->count > 0) window->changed = true;
+        memset(window->buckets, 0, sizeof(window->buckets));
+        window->count = 0;
+        window->head_start = now;
+        return;
+    }
+
+    for (UA_DateTime s = 0; s < steps; s++) {
+        AggregateBucket* bucket;
+
+        window->head = (window->head + 1) % AGGREGATE_BUCKETS;
+        bucket = &window->buckets[window->head];
+        if (bucket->count == 0) continue;
+
+        window->count -= bucket->count;
+        memset(bucket, 0, sizeof(AggregateBucket));
+        window->changed = true;
+    }
+
+    window->head_start += steps * window->width;
+}
+
+/// @brief Merge the statistics of a bucket into others
+/// @param into The merged statistics, updated
+/// @param from The bucket to add
+/// @note Pairwise update of Chan et al.: the means are combined by weight and M2 gains the spread between them.
+static void _merge(AggregateBucket* into, const AggregateBucket* from){
+
+    UA_Double count;
+    UA_Double delta;
+
+    if (from->count == 0) return;
+
+    if (into->count == 0) {
+        *into = *from;
+        return;
+    }
+
+    count = (UA_Double)into->count + (UA_Double)from->count;
+    delta = from->mean - into->mean;
+    into->mean += delta * (UA_Double)from->count / count;
+    into->m2 += from->m2 + delta * delta * (UA_Double)into->count * (UA_Double)from->count / count;
+    if (from->min < into->min) into->min = from->min;
+    if (from->max > into->max) into->max = from->max;
+    into->count += from->count;
+}
+
+/// @brief Queue one aggregate value in the gateway
+/// @param aggregates The aggregates
+/// @param item Global index of the aggregate item
+/// @param value The value, copied
+/// @param type Data type of the value
+/// @param status Status of the value
+static void _push(Aggregates* aggregates, size_t item, const void* value, const UA_DataType* type, UA_StatusCode status){
+
+    UA_DataValue data_value;
+
+    UA_DataValue_init(&data_value);
+    if (UA_Variant_setScalarCopy(&data_value.value, value, type) != UA_STATUSCODE_GOOD) return;
+
+    data_value.hasValue = true;
+    data_value.status = status;
+    data_value.hasStatus = status != UA_STATUSCODE_GOOD;
+    data_value.sourceTimestamp = UA_DateTime_now();
+    data_value.hasSourceTimestamp = true;
+
+    gateway_push(aggregates->gateway, item, &data_value);
+}
+
+/// @brief Queue the statistics of a window in the gateway
+/// @param aggregates The aggregates
+/// @param first Global index of the Min item of the window, the other statistics follow
+/// @param window The window
+static void _publish_window(Aggregates* aggregates, size_t first, const AggregateWindow* window){
+
+    UA_StatusCode status = window->count > 0 ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADNODATA;
+    UA_UInt32 count = window->count > UA_UINT32_MAX ? UA_UINT32_MAX : (UA_UInt32)window->count;
+    AggregateBucket total = {0};
+    UA_Double stddev = 0.0;
+
+    for (size_t b = 0; b < AGGREGATE_BUCKETS && window->count > 0; b++) {
+        _merge(&total, &window->buckets[b]);
+    }
+
+    if (total.count > 0 && total.m2 > 0.0) stddev = sqrt(total.m2 / (UA_Double)total.count);
+
+    _push(aggregates, first + AGGREGATE_MIN, &total.min, &UA_TYPES[UA_TYPES_DOUBLE], status);
+    _push(aggregates, first + AGGREGATE_MAX, &total.max, &UA_TYPES[UA_TYPES_DOUBLE], status);
+    _push(aggregates, first + AGGREGATE_MEAN, &total.mean, &UA_TYPES[UA_TYPES_DOUBLE], status);
+    _push(aggregates, first + AGGREGATE_COUNT, &count, &UA_TYPES[UA_TYPES_UINT32], UA_STATUSCODE_GOOD);
+    _push(aggregates, first + AGGREGATE_STDDEV, &stddev, &UA_TYPES[UA_TYPES_DOUBLE], status);
+}
+
+/// @brief Repeated server callback refreshing the aggregate items
+/// @param server Pointer to the UA_Server instance
+/// @param data The aggregates
+static void _publish_callback(UA_Server* server, void* data){
+    (void)server;
+    aggregates_publish((Aggregates*)data, UA_DateTime_nowMonotonic());
+}
+
+/// @brief Find the aggregated items of the layout and attach the aggregates to the gateway
+/// @param aggregates Pointer to the Aggregates structure to initialize
+/// @param gateway The gateway receiving the aggregate values, must outlive the aggregates
+/// @note The aggregate items of a group are laid out per source item, then window, then statistic.
+void init_aggregates(Aggregates* aggregates, Gateway* gateway){
+
+    AddressSpace* address_space;
+    size_t source = 0;
+
+    if (!aggregates || !gateway || !gateway->address_space) return;
+
+    memset(aggregates, 0, sizeof(Aggregates));
+    aggregates->gateway = gateway;
+    address_space = gateway->address_space;
+
+    for (size_t m = 0; m < address_space->count; m++) {
+        ArrayGroup* groups = &address_space->machines[m].config->groups;
+
+        for (size_t g = 0; g < groups->count; g++) {
+            ArrayItem* items = &groups->groups[g].items;
+
+            for (size_t i = 0; i < items->count; i++) {
+                if (items->items[i].source == ITEM_SOURCE_AGGREGATE && items->items[i].window == 0 &&
+                    items->items[i].stat == AGGREGATE_MIN) aggregates->count++;
+            }
+        }
+    }
+
+    if (aggregates->count == 0) return;
+
+    aggregates->by_item = (size_t*)malloc(address_space->item_count * sizeof(size_t));
+    aggregates->sources = (AggregateSource*)calloc(aggregates->count, sizeof(AggregateSource));
+    if (!aggregates->by_item || !aggregates->sources) {
+        fprintf(stderr, "Failed to allocate memory for Aggregates\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < address_space->item_count; i++) aggregates->by_item[i] = AGGREGATE_NONE;
+
+    for (size_t m = 0; m < address_space->count; m++) {
+        AddressSpaceMachine* machine = &address_space->machines[m];
+        ArrayGroup* groups = &machine->config->groups;
+
+        for (size_t g = 0; g < groups->count; g++) {
+            Group* group = &groups->groups[g];
+            size_t first_item = machine->first_item + machine->group_first_item[g];
+
+            for (size_t i = 0; i < group->items.count; i++) {
+                Item* item = &group->items.items[i];
+                AggregateSource* entry;
+
+                if (item->source != ITEM_SOURCE_AGGREGATE || item->window != 0 || item->stat != AGGREGATE_MIN) continue;
+
+                entry = &aggregates->sources[source];
+                entry->first_output = first_item + i;
+                entry->window_count = group->window_count;
+                entry->windows = (AggregateWindow*)calloc(group->window_count, sizeof(AggregateWindow));
+                if (!entry->windows) {
+                    fprintf(stderr, "Failed to allocate memory for Aggregates\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                for (size_t w = 0; w < group->window_count; w++) {
+                    entry->windows[w].width = (UA_DateTime)group->windows[w] * UA_DATETIME_MSEC / AGGREGATE_BUCKETS;
+                    if (entry->windows[w].width == 0) entry->windows[w].width = 1;
+                    entry->windows[w].changed = true;
+                }
+
+                aggregates->by_item[first_item + item->source_item] = source++;
+            }
+        }
+    }
+
+    gateway->aggregates = aggregates;
+}
+
+/// @brief Add a value of an item to its windows
+/// @param aggregates The aggregates
+/// @param item Global index of the item
+/// @param value The value, ignored unless it is a good numeric or boolean scalar
+/// @param now Current time of the monotonic clock (UA_DateTime_nowMonotonic)
+void aggregates_update(Aggregates* aggregates, size_t item, const UA_DataValue* value, UA_DateTime now){
+
+    AggregateSource* source;
+    UA_Double number;
+
+    if (!aggregates || !aggregates->by_item || !value || item >= aggregates->gateway->address_space->item_count) return;
+    if (aggregates->by_item[item] == AGGREGATE_NONE || !gateway_value_to_double(value, &number)) return;
+
+    source = &aggregates->sources[aggregates->by_item[item]];
+
+    for (size_t w = 0; w < source->window_count; w++) {
+        AggregateWindow* window = &source->windows[w];
+        AggregateBucket* bucket;
+        UA_Double delta;
+
+        _advance(window, now);
+        bucket = &window->buckets[window->head];
+
+        if (bucket->count == 0 || number < bucket->min) bucket->min = number;
+        if (bucket->count == 0 || number > bucket->max) bucket->max = number;
+
+        // Welford: the mean moves by a share of the deviation, M2 adds the deviations before and after
+        bucket->count++;
+        delta = number - bucket->mean;
+        bucket->mean += delta / (UA_Double)bucket->count;
+        bucket->m2 += delta * (number - bucket->mean);
+
+        window->count++;
+        window->changed = true;
+    }
+}
+
+/// @brief Push the aggregate values of the windows that changed into the gateway queues
+/// @param aggregates The aggregates
+/// @param now Current time of the monotonic clock (UA_DateTime_nowMonotonic)
+/// @return Number of windows published
+size_t aggregates_publish(Aggregates* aggregates, UA_DateTime now){
+
+    size_t published = 0;
+
+    if (!aggregates) return 0;
+
+    for (size_t s = 0; s < aggregates->count; s++) {
+        AggregateSource* source = &aggregates->sources[s];
+
+        for (size_t w = 0; w < source->window_count; w++) {
+            AggregateWindow* window = &source->windows[w];
+
+            _advance(window, now);
+            if (!window->changed) continue;
+
+            window->changed = false;
+            _publish_window(aggregates, source->first_output + w * AGGREGATE_STAT_COUNT, window);
+            published++;
+        }
+    }
+
+    return published;
+}
+
+/// @brief Add the aggregate refresh callback to the server
+/// @param aggregates The aggregates
+/// @param server Pointer to the UA_Server instance
+/// @return UA_STATUSCODE_GOOD on success, nothing is added when no group has aggregates
+UA_StatusCode aggregates_start(Aggregates* aggregates, UA_Server* server){
+
+    if (!aggregates || !server) return UA_STATUSCODE_BADINTERNALERROR;
+    if (aggregates->count == 0) return UA_STATUSCODE_GOOD;
+
+    return UA_Server_addRepeatedCallback(server, _publish_callback, aggregates, AGGREGATE_PUBLISH_INTERVAL,
+                                         &aggregates->callback_id);
+}
+
+/// @brief Detach the aggregates from the gateway and free them
+/// @param aggregates Pointer to the Aggregates structure to free
+/// @note The server must be stopped first, the refresh callback uses the aggregates.
+void free_aggregates(Aggregates* aggregates){
+
+    if (!aggregates) return;
+
+    if (aggregates->gateway && aggregates->gateway->aggregates == aggregates) {
+        aggregates->gateway->aggregates = NULL;
+    }
+
+    for (size_t s = 0; s < aggregates->count && aggregates->sources; s++) {
+        free(aggregates->sources[s].windows);
+    }
+
+    free(aggregates->sources);
+    free(aggregates->by_item);
+    memset(aggregates, 0, sizeof(Aggregates));
+}
@@ -0,0 +1,577 @@
+#include "../include/alarms.h"
+
+#include <open62541/plugin/log_stdout.h>
+
+#include <math.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define ALARMS_X86 1
+#endif
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void _evaluate_scalar(Alarms* alarms, size_t first, size_t count);
+#ifdef ALARMS_X86
+static size_t _evaluate_sse2(Alarms* alarms, size_t count);
+static size_t _evaluate_avx(Alarms* alarms, size_t count);
+#endif
+static void _lose_quality(Alarms* alarms, size_t alarm, const UA_DataValue* value);
+static void _transition(Alarms* alarms, size_t row, AlarmLevel previous, AlarmLevel level);
+static void _fire(Alarms* alarms, size_t alarm, UA_DateTime time, AlarmLevel level, UA_UInt16 severity,
+                  const char* message);
+#ifdef UA_ENABLE_SUBSCRIPTIONS_ALARMS_CONDITIONS
+static void _create_condition(Alarms* alarms, size_t alarm);
+static void _set_field(Alarms* alarms, size_t alarm, const char* field, const void* value, const UA_DataType* type);
+static void _write_field(UA_Server* server, const UA_NodeId* condition, const char* field, const void* value,
+                         const UA_DataType* type);
+static void _update_condition(Alarms* alarms, size_t alarm, UA_DateTime time, AlarmLevel level, UA_UInt16 severity,
+                              const char* message);
+#endif
+
+
+/// @brief Maximum depth of the browse path of a condition field
+#define ALARMS_FIELD_DEPTH 4
+/// @brief Severity of the event of an alarm whose item lost its quality
+#define ALARMS_QUALITY_SEVERITY 500
+
+/// @brief Names, severities and states of the levels, indexed by level + 2
+static const char* const LEVEL_NAMES[] = {"LowLow", "Low", "Normal", "High", "HighHigh"};
+static const UA_UInt16 LEVEL_SEVERITIES[] = {900, 500, 100, 500, 900};
+static const UA_UInt32 LEVEL_STATES[] = {
+    UA_NS0ID_EXCLUSIVELIMITSTATEMACHINETYPE_LOWLOW, UA_NS0ID_EXCLUSIVELIMITSTATEMACHINETYPE_LOW, 0,
+    UA_NS0ID_EXCLUSIVELIMITSTATEMACHINETYPE_HIGH, UA_NS0ID_EXCLUSIVELIMITSTATEMACHINETYPE_HIGHHIGH
+};
+
+
+/// @brief Create the alarms of the items with limits and attach them to the gateway
+/// @param alarms Pointer to the Alarms structure to initialize
+/// @param gateway The gateway, its published values are evaluated
+/// @note Nothing is attached when no item has limits.
+void init_alarms(Alarms* alarms, Gateway* gateway){
+
+    AddressSpace* address_space;
+    size_t count = 0;
+
+    if (!alarms || !gateway) return;
+
+    memset(alarms, 0, sizeof(Alarms));
+    alarms->gateway = gateway;
+    alarms->condition_type = UA_NODEID_NUMERIC(0, UA_NS0ID_EXCLUSIVELIMITALARMTYPE);
+    address_space = gateway->address_space;
+
+    for (size_t i = 0; i < address_space->item_count; i++) {
+        AddressSpaceNode node;
+
+        if (address_space_item_at(address_space, i, &node) && address_space_item(address_space, &node)->limits.enabled)
+            count++;
+    }
+
+    if (count == 0) return;
+
+    alarms->items = (size_t*)calloc(count, sizeof(size_t));
+    alarms->limits = (const ItemLimits**)calloc(count, sizeof(ItemLimits*));
+    alarms->by_item = (size_t*)calloc(address_space->item_count, sizeof(size_t));
+    alarms->conditions = (UA_NodeId*)calloc(count, sizeof(UA_NodeId));
+    alarms->level = (double*)calloc(count, sizeof(double));
+    alarms->quality = (UA_StatusCode*)calloc(count, sizeof(UA_StatusCode));
+    alarms->is_staged = (bool*)calloc(count, sizeof(bool));
+    alarms->rows = (size_t*)calloc(count, sizeof(size_t));
+    alarms->restored = (bool*)calloc(count, sizeof(bool));
+    alarms->times = (UA_DateTime*)calloc(count, sizeof(UA_DateTime));
+    alarms->value = (double*)calloc(count, sizeof(double));
+    alarms->high_high = (double*)calloc(count, sizeof(double));
+    alarms->high = (double*)calloc(count, sizeof(double));
+    alarms->low = (double*)calloc(count, sizeof(double));
+    alarms->low_low = (double*)calloc(count, sizeof(double));
+    alarms->hysteresis = (double*)calloc(count, sizeof(double));
+    alarms->current = (double*)calloc(count, sizeof(double));
+    alarms->next = (double*)calloc(count, sizeof(double));
+
+    if (!alarms->items || !alarms->limits || !alarms->by_item || !alarms->conditions || !alarms->level ||
+        !alarms->quality || !alarms->is_staged || !alarms->rows || !alarms->restored || !alarms->times ||
+        !alarms->value || !alarms->high_high || !alarms->high || !alarms->low || !alarms->low_low ||
+        !alarms->hysteresis || !alarms->current || !alarms->next) {
+        fprintf(stderr, "Failed to allocate memory for Alarms\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < address_space->item_count; i++) {
+        AddressSpaceNode node;
+        const Item* item;
+
+        alarms->by_item[i] = ALARM_NONE;
+        if (!address_space_item_at(address_space, i, &node)) continue;
+
+        item = address_space_item(address_space, &node);
+        if (!item->limits.enabled) continue;
+
+        alarms->by_item[i] = alarms->count;
+        alarms->items[alarms->count] = i;
+        alarms->limits[alarms->count] = &item->limits;
+        alarms->count++;
+    }
+
+    gateway->alarms = alarms;
+}
+
+/// @brief Create the conditions of the alarms on a server
+/// @param alarms The alarms
+/// @param server Pointer to the UA_Server instance
+/// @return UA_STATUSCODE_GOOD on success, or when there is no alarm
+/// @note An alarm whose condition cannot be created is still evaluated, without events, and a warning is logged.
+/// So are all the alarms when open62541 is built without UA_ENABLE_SUBSCRIPTIONS_ALARMS_CONDITIONS.
+UA_StatusCode alarms_start(Alarms* alarms, UA_Server* server){
+
+    if (!alarms || !server) return UA_STATUSCODE_BADINTERNALERROR;
+    if (alarms->count == 0) return UA_STATUSCODE_GOOD;
+
+    alarms->server = server;
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS_ALARMS_CONDITIONS
+    for (size_t alarm = 0; alarm < alarms->count; alarm++) {
+        _create_condition(alarms, alarm);
+    }
+#else
+    UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                   "open62541 was built without UA_ENABLE_SUBSCRIPTIONS_ALARMS_CONDITIONS, "
+                   "the alarms are evaluated without events");
+#endif
+
+    return UA_STATUSCODE_GOOD;
+}
+
+/// @brief Stage a value published for an item
+/// @param alarms The alarms
+/// @param item Global index of the item
+/// @param value The value, only read
+/// @note An alarm staged twice in the same update set flushes the set first, so that no transition is lost.
+/// A value with a bad status is a quality transition, fired at once.
+void alarms_stage(Alarms* alarms, size_t item, const UA_DataValue* value){
+
+    const ItemLimits* limits;
+    size_t alarm;
+    size_t row;
+    double number;
+
+    if (!alarms || !alarms->by_item || item >= alarms->gateway->address_space->item_count) return;
+
+    alarm = alarms->by_item[item];
+    if (alarm == ALARM_NONE) return;
+
+    if (!gateway_value_to_double(value, &number)) {
+        if (value->hasStatus && UA_StatusCode_isBad(value->status)) _lose_quality(alarms, alarm, value);
+        return;
+    }
+
+    if (alarms->is_staged[alarm]) alarms_flush(alarms);
+
+    limits = alarms->limits[alarm];
+    row = alarms->staged++;
+    alarms->rows[row] = alarm;
+    alarms->times[row] = value->hasSourceTimestamp ? value->sourceTimestamp : UA_DateTime_now();
+    alarms->value[row] = number;
+    alarms->high_high[row] = limits->high_high;
+    alarms->high[row] = limits->high;
+    alarms->low[row] = limits->low;
+    alarms->low_low[row] = limits->low_low;
+    alarms->hysteresis[row] = limits->hysteresis;
+    alarms->current[row] = alarms->level[alarm];
+    alarms->restored[row] = alarms->quality[alarm] != UA_STATUSCODE_GOOD;
+    alarms->quality[alarm] = UA_STATUSCODE_GOOD;
+    alarms->is_staged[alarm] = true;
+}
+
+/// @brief Fire the quality transition of an alarm receiving a bad value
+/// @param alarms The alarms
+/// @param alarm The alarm
+/// @param value The bad value
+/// @note The state of the item is unknown: the alarm leaves its state instead of staying latched, and is
+/// evaluated from Normal again with the next value with a number. Further bad values fire nothing.
+static void _lose_quality(Alarms* alarms, size_t alarm, const UA_DataValue* value){
+
+    AddressSpace* address_space = alarms->gateway->address_space;
+    AlarmLevel previous = (AlarmLevel)alarms->level[alarm];
+    UA_DateTime time = value->hasSourceTimestamp ? value->sourceTimestamp : UA_DateTime_now();
+    char path[ADDRESS_SPACE_MAX_PATH];
+    char message[ADDRESS_SPACE_MAX_PATH + 96];
+
+    if (alarms->quality[alarm] != UA_STATUSCODE_GOOD) return;
+
+    // The staged value came first
+    if (alarms->is_staged[alarm]) alarms_flush(alarms);
+
+    alarms->quality[alarm] = value->status;
+    alarms->level[alarm] = ALARM_NORMAL;
+
+    address_space_item_path(address_space, alarms->items[alarm], path, sizeof(path));
+    snprintf(message, sizeof(message), "%s quality %s, state unknown (was %s)", path,
+             UA_StatusCode_name(value->status), LEVEL_NAMES[previous + 2]);
+    _fire(alarms, alarm, time, ALARM_NORMAL, ALARMS_QUALITY_SEVERITY, message);
+}
+
+/// @brief Evaluate rows one at a time
+/// @param alarms The alarms
+/// @param first First row to evaluate
+/// @param count End of the rows to evaluate
+/// @note A limit that is not set is NAN, every comparison with it is false.
+static void _evaluate_scalar(Alarms* alarms, size_t first, size_t count){
+
+    for (size_t i = first; i < count; i++) {
+        double value = alarms->value[i];
+        double current = alarms->current[i];
+        double hysteresis = alarms->hysteresis[i];
+        bool high_high = value >= alarms->high_high[i] || (current >= 2.0 && value > alarms->high_high[i] - hysteresis);
+        bool high = value >= alarms->high[i] || (current >= 1.0 && value > alarms->high[i] - hysteresis);
+        bool low_low = value <= alarms->low_low[i] || (current <= -2.0 && value < alarms->low_low[i] + hysteresis);
+        bool low = value <= alarms->low[i] || (current <= -1.0 && value < alarms->low[i] + hysteresis);
+
+        alarms->next[i] = high_high ? 2.0 : high ? 1.0 : low_low ? -2.0 : low ? -1.0 : 0.0;
+    }
+}
+
+#ifdef ALARMS_X86
+/// @brief Evaluate rows two at a time
+/// @return Number of rows evaluated, the remaining ones are left to the scalar code
+static size_t _evaluate_sse2(Alarms* alarms, size_t count){
+
+    size_t i = 0;
+
+    for (; i + 2 <= count; i += 2) {
+        __m128d value = _mm_loadu_pd(alarms->value + i);
+        __m128d current = _mm_loadu_pd(alarms->current + i);
+        __m128d hysteresis = _mm_loadu_pd(alarms->hysteresis + i);
+        __m128d high_high = _mm_loadu_pd(alarms->high_high + i);
+        __m128d high = _mm_loadu_pd(alarms->high + i);
+        __m128d low = _mm_loadu_pd(alarms->low + i);
+        __m128d low_low = _mm_loadu_pd(alarms->low_low + i);
+        __m128d is_high_high = _mm_or_pd(_mm_cmpge_pd(value, high_high),
+                                         _mm_and_pd(_mm_cmpge_pd(current, _mm_set1_pd(2.0)),
+                                                    _mm_cmpgt_pd(value, _mm_sub_pd(high_high, hysteresis))));
+        __m128d is_high = _mm_or_pd(_mm_cmpge_pd(value, high),
+                                    _mm_and_pd(_mm_cmpge_pd(current, _mm_set1_pd(1.0)),
+                                               _mm_cmpgt_pd(value, _mm_sub_pd(high, hysteresis))));
+        __m128d is_low_low = _mm_or_pd(_mm_cmple_pd(value, low_low),
+                                       _mm_and_pd(_mm_cmple_pd(current, _mm_set1_pd(-2.0)),
+                                                  _mm_cmplt_pd(value, _mm_add_pd(low_low, hysteresis))));
+        __m128d is_low = _mm_or_pd(_mm_cmple_pd(value, low),
+                                   _mm_and_pd(_mm_cmple_pd(current, _mm_set1_pd(-1.0)),
+                                              _mm_cmplt_pd(value, _mm_add_pd(low, hysteresis))));
+        __m128d result = _mm_and_pd(is_low, _mm_set1_pd(-1.0));
+
+        // From the weakest state to the strongest, a later state overrides an earlier one
+        result = _mm_or_pd(_mm_and_pd(is_low_low, _mm_set1_pd(-2.0)), _mm_andnot_pd(is_low_low, result));
+        result = _mm_or_pd(_mm_and_pd(is_high, _mm_set1_pd(1.0)), _mm_andnot_pd(is_high, result));
+        result = _mm_or_pd(_mm_and_pd(is_high_high, _mm_set1_pd(2.0)), _mm_andnot_pd(is_high_high, result));
+        _mm_storeu_pd(alarms->next + i, result);
+    }
+
+    return i;
+}
+
+/// @brief Evaluate rows four at a time
+/// @return Number of rows evaluated, the remaining ones are left to the scalar code
+__attribute__((target("avx")))
+static size_t _evaluate_avx(Alarms* alarms, size_t count){
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m256d value = _mm256_loadu_pd(alarms->value + i);
+        __m256d current = _mm256_loadu_pd(alarms->current + i);
+        __m256d hysteresis = _mm256_loadu_pd(alarms->hysteresis + i);
+        __m256d high_high = _mm256_loadu_pd(alarms->high_high + i);
+        __m256d high = _mm256_loadu_pd(alarms->high + i);
+        __m256d low = _mm256_loadu_pd(alarms->low + i);
+        __m256d low_low = _mm256_loadu_pd(alarms->low_low + i);
+        __m256d is_high_high = _mm256_or_pd(_mm256_cmp_pd(value, high_high, _CMP_GE_OQ),
+                                            _mm256_and_pd(_mm256_cmp_pd(current, _mm256_set1_pd(2.0), _CMP_GE_OQ),
+                                                          _mm256_cmp_pd(value, _mm256_sub_pd(high_high, hysteresis),
+                                                                        _CMP_GT_OQ)));
+        __m256d is_high = _mm256_or_pd(_mm256_cmp_pd(value, high, _CMP_GE_OQ),
+                                       _mm256_and_pd(_mm256_cmp_pd(current, _mm256_set1_pd(1.0), _CMP_GE_OQ),
+                                                     _mm256_cmp_pd(value, _mm256_sub_pd(high, hysteresis),
+                                                                   _CMP_GT_OQ)));
+        __m256d is_low_low = _mm256_or_pd(_mm256_cmp_pd(value, low_low, _CMP_LE_OQ),
+                                          _mm256_and_pd(_mm256_cmp_pd(current, _mm256_set1_pd(-2.0), _CMP_LE_OQ),
+                                                        _mm256_cmp_pd(value, _mm256_add_pd(low_low, hysteresis),
+                                                                      _CMP_LT_OQ)));
+        __m256d is_low = _mm256_or_pd(_mm256_cmp_pd(value, low, _CMP_LE_OQ),
+                                      _mm256_and_pd(_mm256_cmp_pd(current, _mm256_set1_pd(-1.0), _CMP_LE_OQ),
+                                                    _mm256_cmp_pd(value, _mm256_add_pd(low, hysteresis), _CMP_LT_OQ)));
+        __m256d result = _mm256_and_pd(is_low, _mm256_set1_pd(-1.0));
+
+        result = _mm256_blendv_pd(result, _mm256_set1_pd(-2.0), is_low_low);
+        result = _mm256_blendv_pd(result, _mm256_set1_pd(1.0), is_high);
+        result = _mm256_blendv_pd(result, _mm256_set1_pd(2.0), is_high_high);
+        _mm256_storeu_pd(alarms->next + i, result);
+    }
+
+    return i;
+}
+#endif
+
+/// @brief Compute the next level of staged rows
+/// @param alarms The alarms, the value, limit, hysteresis and current columns are read
+/// @param count Number of rows to evaluate
+/// @note Fills the next column. Exposed for the tests, the flush calls it.
+void alarms_evaluate(Alarms* alarms, size_t count){
+
+    size_t done = 0;
+
+    if (!alarms || count > alarms->count) return;
+
+#ifdef ALARMS_X86
+    done = __builtin_cpu_supports("avx") ? _evaluate_avx(alarms, count) : _evaluate_sse2(alarms, count);
+#endif
+    _evaluate_scalar(alarms, done, count);
+}
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS_ALARMS_CONDITIONS
+/// @brief Create the condition of an alarm
+/// @param alarms The alarms, started
+/// @param alarm The alarm
+/// @note On failure a warning is logged and the condition stays null.
+static void _create_condition(Alarms* alarms, size_t alarm){
+
+    AddressSpace* address_space = alarms->gateway->address_space;
+    size_t item = alarms->items[alarm];
+    AddressSpaceNode node;
+    UA_NodeId source;
+    UA_String source_name;
+    UA_Boolean enabled = true;
+    UA_LocalizedText text;
+    UA_StatusCode retval;
+    char path[ADDRESS_SPACE_MAX_PATH];
+
+    address_space_item_at(address_space, item, &node);
+    address_space_item_path(address_space, item, path, sizeof(path));
+
+    // The Server object is the source: item nodes are views of the gateway nodestore and keep no
+    // HasCondition reference, SourceNode and SourceName name the item instead
+    retval = UA_Server_createCondition(alarms->server, UA_NODEID_NULL, alarms->condition_type,
+                                       UA_QUALIFIEDNAME(0, path), UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER),
+                                       UA_NODEID_NULL, &alarms->conditions[alarm]);
+    if (retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "Failed to create the alarm condition of %s: %s",
+                       path, UA_StatusCode_name(retval));
+        alarms->conditions[alarm] = UA_NODEID_NULL;
+        return;
+    }
+
+    source = address_space_node_id(address_space, &node);
+    source_name = UA_STRING(path);
+    text = UA_LOCALIZEDTEXT("", "Enabled");
+    _set_field(alarms, alarm, "SourceNode", &source, &UA_TYPES[UA_TYPES_NODEID]);
+    _set_field(alarms, alarm, "SourceName", &source_name, &UA_TYPES[UA_TYPES_STRING]);
+    _set_field(alarms, alarm, "EnabledState", &text, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    _write_field(alarms->server, &alarms->conditions[alarm], "EnabledState/Id", &enabled,
+                 &UA_TYPES[UA_TYPES_BOOLEAN]);
+}
+
+/// @brief Set a field of the condition of an alarm
+/// @param alarms The alarms
+/// @param alarm The alarm
+/// @param field Browse name of the field, e.g. "Severity"
+/// @param value The value of the field
+/// @param type Type of the value
+static void _set_field(Alarms* alarms, size_t alarm, const char* field, const void* value, const UA_DataType* type){
+
+    UA_Variant variant;
+
+    UA_Variant_setScalar(&variant, (void*)(uintptr_t)value, type);
+    UA_Server_setConditionField(alarms->server, alarms->conditions[alarm], &variant,
+                                UA_QUALIFIEDNAME(0, (char*)(uintptr_t)field));
+}
+
+/// @brief Write a field of a condition below its direct fields
+/// @param server Pointer to the UA_Server instance
+/// @param condition The condition node
+/// @param field Browse path of the field below the condition, e.g. "LimitState/CurrentState/Id"
+/// @param value The value of the field
+/// @param type Type of the value
+/// @note Fields missing from the condition type are skipped.
+static void _write_field(UA_Server* server, const UA_NodeId* condition, const char* field, const void* value,
+                         const UA_DataType* type){
+
+    UA_QualifiedName path[ALARMS_FIELD_DEPTH];
+    UA_BrowsePathResult result;
+    UA_Variant variant;
+    size_t depth = 0;
+    char names[64];
+    char* next = names;
+
+    snprintf(names, sizeof(names), "%s", field);
+    while (next && depth < ALARMS_FIELD_DEPTH) {
+        char* name = next;
+
+        next = strchr(name, '/');
+        if (next) *next++ = '\0';
+        path[depth++] = UA_QUALIFIEDNAME(0, name);
+    }
+
+    result = UA_Server_browseSimplifiedBrowsePath(server, *condition, depth, path);
+    if (result.statusCode == UA_STATUSCODE_GOOD && result.targetsSize > 0) {
+        UA_Variant_setScalar(&variant, (void*)(uintptr_t)value, type);
+        UA_Server_writeValue(server, result.targets[0].targetId.nodeId, variant);
+    }
+
+    UA_BrowsePathResult_clear(&result);
+}
+
+/// @brief Update the condition of an alarm and fire its event on the Server object
+/// @param alarms The alarms, started
+/// @param alarm The alarm
+/// @param time Source time of the value
+/// @param level Level of the alarm, its ActiveState and LimitState
+/// @param severity Severity of the event
+/// @param message Message of the event
+/// @note The Quality of the condition is the quality of the alarm.
+static void _update_condition(Alarms* alarms, size_t alarm, UA_DateTime time, AlarmLevel level, UA_UInt16 severity,
+                              const char* message){
+
+    UA_NodeId* condition = &alarms->conditions[alarm];
+    UA_NodeId state = UA_NODEID_NULL;
+    UA_LocalizedText text;
+    UA_Variant variant;
+    UA_Boolean active = level != ALARM_NORMAL;
+    UA_StatusCode retval;
+
+    text = UA_LOCALIZEDTEXT("", (char*)(uintptr_t)message);
+    _set_field(alarms, alarm, "Time", &time, &UA_TYPES[UA_TYPES_DATETIME]);
+    _set_field(alarms, alarm, "Severity", &severity, &UA_TYPES[UA_TYPES_UINT16]);
+    _set_field(alarms, alarm, "Message", &text, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    _set_field(alarms, alarm, "Retain", &active, &UA_TYPES[UA_TYPES_BOOLEAN]);
+    _set_field(alarms, alarm, "Quality", &alarms->quality[alarm], &UA_TYPES[UA_TYPES_STATUSCODE]);
+    UA_Variant_setScalar(&variant, &time, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_Server_setConditionVariableFieldProperty(alarms->server, *condition, &variant, UA_QUALIFIEDNAME(0, "Quality"),
+                                                UA_QUALIFIEDNAME(0, "SourceTimestamp"));
+
+    text = UA_LOCALIZEDTEXT("", active ? "Active" : "Inactive");
+    _set_field(alarms, alarm, "ActiveState", &text, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    UA_Variant_setScalar(&variant, &active, &UA_TYPES[UA_TYPES_BOOLEAN]);
+    UA_Server_setConditionVariableFieldProperty(alarms->server, *condition, &variant,
+                                                UA_QUALIFIEDNAME(0, "ActiveState"), UA_QUALIFIEDNAME(0, "Id"));
+
+    // Inactive, the LimitState has no current state
+    if (active) state = UA_NODEID_NUMERIC(0, LEVEL_STATES[level + 2]);
+    text = UA_LOCALIZEDTEXT("", active ? (char*)LEVEL_NAMES[level + 2] : "");
+    _write_field(alarms->server, condition, "LimitState/CurrentState", &text, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    _write_field(alarms->server, condition, "LimitState/CurrentState/Id", &state, &UA_TYPES[UA_TYPES_NODEID]);
+
+    retval = UA_Server_triggerConditionEvent(alarms->server, *condition, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER), NULL);
+    if (retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "Failed to fire the alarm event: %s (%s)",
+                       UA_StatusCode_name(retval), message);
+    }
+}
+
+#endif
+
+/// @brief Fire the event of a state transition
+/// @param alarms The alarms
+/// @param row Row of the transition in the update set
+/// @param previous Level before the value
+/// @param level Level after the value
+/// @note A row restoring the quality of its alarm fires even when the level is unchanged.
+static void _transition(Alarms* alarms, size_t row, AlarmLevel previous, AlarmLevel level){
+
+    AddressSpace* address_space = alarms->gateway->address_space;
+    size_t alarm = alarms->rows[row];
+    const ItemLimits* limits = alarms->limits[alarm];
+    const double thresholds[] = {limits->low_low, limits->low, NAN, limits->high, limits->high_high};
+    char path[ADDRESS_SPACE_MAX_PATH];
+    char message[ADDRESS_SPACE_MAX_PATH + 96];
+
+    address_space_item_path(address_space, alarms->items[alarm], path, sizeof(path));
+
+    if (level != ALARM_NORMAL) {
+        snprintf(message, sizeof(message), "%s %s: %g (limit %g)", path, LEVEL_NAMES[level + 2],
+                 alarms->value[row], thresholds[level + 2]);
+    } else if (previous != ALARM_NORMAL) {
+        snprintf(message, sizeof(message), "%s back to Normal from %s: %g", path, LEVEL_NAMES[previous + 2],
+                 alarms->value[row]);
+    } else {
+        snprintf(message, sizeof(message), "%s quality Good, Normal: %g", path, alarms->value[row]);
+    }
+
+    _fire(alarms, alarm, alarms->times[row], level, LEVEL_SEVERITIES[level + 2], message);
+}
+
+/// @brief Count the event of an alarm and fire it on its condition
+/// @param alarms The alarms
+/// @param alarm The alarm
+/// @param time Source time of the value
+/// @param level Level of the alarm
+/// @param severity Severity of the event
+/// @param message Message of the event
+static void _fire(Alarms* alarms, size_t alarm, UA_DateTime time, AlarmLevel level, UA_UInt16 severity,
+                  const char* message){
+
+    alarms->events++;
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS_ALARMS_CONDITIONS
+    if (alarms->server && !UA_NodeId_isNull(&alarms->conditions[alarm])) {
+        _update_condition(alarms, alarm, time, level, severity, message);
+    }
+#else
+    (void)alarm; (void)time; (void)level; (void)severity; (void)message;
+#endif
+}
+
+/// @brief Evaluate the staged values and fire the events of the alarms changing state
+/// @param alarms The alarms
+/// @return Number of transitions, quality restorations included
+size_t alarms_flush(Alarms* alarms){
+
+    size_t transitions = 0;
+
+    if (!alarms || alarms->staged == 0) return 0;
+
+    alarms_evaluate(alarms, alarms->staged);
+
+    for (size_t row = 0; row < alarms->staged; row++) {
+        size_t alarm = alarms->rows[row];
+
+        alarms->is_staged[alarm] = false;
+        if (alarms->next[row] == alarms->current[row] && !alarms->restored[row]) continue;
+
+        alarms->level[alarm] = alarms->next[row];
+        _transition(alarms, row, (AlarmLevel)alarms->current[row], (AlarmLevel)alarms->next[row]);
+        transitions++;
+    }
+
+    alarms->staged = 0;
+    return transitions;
+}
+
+/// @brief Detach the alarms from the gateway and free them
+/// @param alarms Pointer to the Alarms structure to free
+void free_alarms(Alarms* alarms){
+
+    if (!alarms) return;
+
+    if (alarms->gateway && alarms->gateway->alarms == alarms) {
+        alarms->gateway->alarms = NULL;
+    }
+
+    free(alarms->items);
+    free(alarms->limits);
+    free(alarms->by_item);
+    free(alarms->conditions);
+    free(alarms->level);
+    free(alarms->quality);
+    free(alarms->is_staged);
+    free(alarms->rows);
+    free(alarms->restored);
+    free(alarms->times);
+    free(alarms->value);
+    free(alarms->high_high);
+    free(alarms->high);
+    free(alarms->low);
+    free(alarms->low_low);
+    free(alarms->hysteresis);
+    free(alarms->current);
+    free(alarms->next);
+    memset(alarms, 0, sizeof(Alarms));
+}
@@ -0,0 +1,206 @@
+#include "../include/compiled_machines.h"
+
+#include <math.h>
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void _write_string(FILE* out, const char* string);
+static void _write_double(FILE* out, double value);
+static void _write_items(FILE* out, size_t machine, size_t group, const ArrayItem* items);
+static void _write_groups(FILE* out, size_t machine, const ArrayGroup* groups);
+
+/// @brief Names of the enumerations in the generated tables, indexed by value
+static const char* const ITEM_SOURCES[] = {"ITEM_SOURCE_UPSTREAM", "ITEM_SOURCE_AGGREGATE", "ITEM_SOURCE_EXPRESSION"};
+static const char* const AGGREGATE_STATS[] = {"AGGREGATE_MIN", "AGGREGATE_MAX", "AGGREGATE_MEAN", "AGGREGATE_COUNT",
+                                              "AGGREGATE_STDDEV"};
+static const char* const QUEUE_OVERFLOWS[] = {"QUEUE_OVERFLOW_DROP_OLDEST", "QUEUE_OVERFLOW_KEEP_LATEST",
+                                              "QUEUE_OVERFLOW_BLOCK"};
+static const char* const PRIORITY_CLASSES[] = {"PRIORITY_HIGH", "PRIORITY_NORMAL", "PRIORITY_LOW"};
+
+#ifdef COMPILED_MACHINES
+#include COMPILED_MACHINES
+#else
+#define COMPILED_MACHINE_COUNT 0
+#define COMPILED_MACHINES_SOURCE NULL
+static MachineConfig COMPILED_MACHINE_TABLE[1];
+#endif
+
+
+/// @brief Load the machine configurations compiled into the server
+/// @param array_machine_config Output pointing to the static tables, marked as compiled
+/// @return false if the server was built without compiled machines
+/// @note free_array_machine_config only resets a compiled array.
+bool load_compiled_machine_config(ArrayMachineConfig* array_machine_config){
+
+    memset(array_machine_config, 0, sizeof(ArrayMachineConfig));
+    if (COMPILED_MACHINE_COUNT == 0) {
+        return false;
+    }
+
+    array_machine_config->count = COMPILED_MACHINE_COUNT;
+    array_machine_config->capacity = COMPILED_MACHINE_COUNT;
+    array_machine_config->configs = COMPILED_MACHINE_TABLE;
+    array_machine_config->compiled = true;
+
+    return true;
+}
+
+/// @brief Folder the compiled machines were loaded from
+/// @return The path given at build time, NULL without compiled machines
+const char* compiled_machines_source(void){
+    return COMPILED_MACHINES_SOURCE;
+}
+
+/// @brief Write a C string literal, every byte outside printable ASCII is escaped
+static void _write_string(FILE* out, const char* string){
+
+    if (!string) {
+        fputs("NULL", out);
+        return;
+    }
+
+    fputc('"', out);
+    for (const unsigned char* c = (const unsigned char*)string; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(out, "\\%c", *c);
+        } else if (*c < 0x20 || *c >= 0x7f || *c == '?') {
+            fprintf(out, "\\%03o", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/// @brief Write a double that reads back to the same value
+static void _write_double(FILE* out, double value){
+
+    if (isnan(value)) {
+        fputs("NAN", out);
+    } else if (isinf(value)) {
+        fputs(value < 0 ? "-INFINITY" : "INFINITY", out);
+    } else {
+        fprintf(out, "%.17g", value);
+    }
+}
+
+/// @brief Write the items of a group as ITEMS_<machine>_<group>
+static void _write_items(FILE* out, size_t machine, size_t group, const ArrayItem* items){
+
+    fprintf(out, "static Item ITEMS_%zu_%zu[] = {\n", machine, group);
+    for (size_t i = 0; i < items->count; i++) {
+        const Item* item = &items->items[i];
+
+        fputs("    {.name = ", out);
+        _write_string(out, item->name);
+        fputs(", .nodeId = ", out);
+        _write_string(out, item->nodeId);
+        fputs(", .type = ", out);
+        _write_string(out, item->type);
+        fputs(", .expression = ", out);
+        _write_string(out, item->expression);
+        fprintf(out, ",\n     .source = %s, .source_item = %zu, .window = %zu, .stat = %s, .scaled = %s",
+                ITEM_SOURCES[item->source], item->source_item, item->window, AGGREGATE_STATS[item->stat],
+                item->scaled ? "true" : "false");
+        fputs(", .scale = ", out);
+        _write_double(out, item->scale);
+        fputs(", .offset = ", out);
+        _write_double(out, item->offset);
+        fputs(", .min = ", out);
+        _write_double(out, item->min);
+        fputs(", .max = ", out);
+        _write_double(out, item->max);
+        fprintf(out, ",\n     .on_demand = %s, .ttl = %zu", item->on_demand ? "true" : "false", item->ttl);
+        if (item->limits.enabled) {
+            fputs(",\n     .limits = {.enabled = true, .high_high = ", out);
+            _write_double(out, item->limits.high_high);
+            fputs(", .high = ", out);
+            _write_double(out, item->limits.high);
+            fputs(", .low = ", out);
+            _write_double(out, item->limits.low);
+            fputs(", .low_low = ", out);
+            _write_double(out, item->limits.low_low);
+            fputs(", .hysteresis = ", out);
+            _write_double(out, item->limits.hysteresis);
+            fputc('}', out);
+        }
+        fputs("},\n", out);
+    }
+    fputs("};\n\n", out);
+}
+
+/// @brief Write the groups of a machine as GROUPS_<machine>, after the items they point to
+static void _write_groups(FILE* out, size_t machine, const ArrayGroup* groups){
+
+    for (size_t g = 0; g < groups->count; g++) {
+        if (groups->groups[g].items.count > 0) {
+            _write_items(out, machine, g, &groups->groups[g].items);
+        }
+    }
+
+    fprintf(out, "static Group GROUPS_%zu[] = {\n", machine);
+    for (size_t g = 0; g < groups->count; g++) {
+        const Group* group = &groups->groups[g];
+
+        fputs("    {.name = ", out);
+        _write_string(out, group->name);
+        if (group->items.count > 0) {
+            fprintf(out, ", .items = {%zu, %zu, ITEMS_%zu_%zu}", group->items.count, group->items.count, machine, g);
+        } else {
+            fputs(", .items = {0, 0, NULL}", out);
+        }
+        fprintf(out, ",\n     .queue_size = %zu, .queue_overflow = %s, .priority = %s, .target_latency = %zu",
+                group->queue_size, QUEUE_OVERFLOWS[group->queue_overflow], PRIORITY_CLASSES[group->priority],
+                group->target_latency);
+        fprintf(out, ", .window_count = %zu, .windows = {", group->window_count);
+        for (size_t w = 0; w < group->window_count; w++) {
+            fprintf(out, "%s%zu", w > 0 ? ", " : "", group->windows[w]);
+        }
+        fputs("}},\n", out);
+    }
+    fputs("};\n\n", out);
+}
+
+/// @brief Write machine configurations as C tables
+/// @param array_machine_config The configurations, as loaded by load_machine_config
+/// @param source Folder of the configurations, kept in the generated file
+/// @param out The generated C file
+/// @return false if writing failed
+bool write_compiled_machine_config(const ArrayMachineConfig* array_machine_config, const char* source, FILE* out){
+
+    fputs("// Machine configurations compiled into the server by bin/compile_machines, do not edit\n", out);
+    fputs("// Included by src/compiled_machines.c\n\n", out);
+    fprintf(out, "#define COMPILED_MACHINE_COUNT %zu\n", array_machine_config->count);
+    fputs("#define COMPILED_MACHINES_SOURCE ", out);
+    _write_string(out, source);
+    fputs("\n\n", out);
+
+    for (size_t m = 0; m < array_machine_config->count; m++) {
+        if (array_machine_config->configs[m].groups.count > 0) {
+            _write_groups(out, m, &array_machine_config->configs[m].groups);
+        }
+    }
+
+    fputs("static MachineConfig COMPILED_MACHINE_TABLE[] = {\n", out);
+    for (size_t m = 0; m < array_machine_config->count; m++) {
+        const MachineConfig* machine = &array_machine_config->configs[m];
+
+        fputs("    {.name = ", out);
+        _write_string(out, machine->name);
+        fputs(", .url = ", out);
+        _write_string(out, machine->url);
+        fputs(", .namespace = ", out);
+        _write_string(out, machine->namespace);
+        if (machine->groups.count > 0) {
+            fprintf(out, ", .groups = {%zu, %zu, GROUPS_%zu}},\n", machine->groups.count, machine->groups.count, m);
+        } else {
+            fputs(", .groups = {0, 0, NULL}},\n", out);
+        }
+    }
+    if (array_machine_config->count == 0) {
+        fputs("    {0},\n", out);
+    }
+    fputs("};\n", out);
+
+    return ferror(out) == 0;
+}
@@ -0,0 +1,691 @@
+#include "../include/discovery.h"
+
+typedef struct {
+    Discovery* discovery;
+    size_t* nodes;           ///< Browse and BrowseNext: object of each node, Read: variable of each node
+    size_t count;
+} DiscoverRequest;
+
+static const struct {
+    UA_UInt32 id;
+    const char* name;
+} TYPE_NAMES[] = {
+    {UA_NS0ID_BOOLEAN, "System.Boolean"},
+    {UA_NS0ID_SBYTE, "System.SByte"},
+    {UA_NS0ID_BYTE, "System.Byte"},
+    {UA_NS0ID_INT16, "System.Int16"},
+    {UA_NS0ID_UINT16, "System.UInt16"},
+    {UA_NS0ID_INT32, "System.Int32"},
+    {UA_NS0ID_UINT32, "System.UInt32"},
+    {UA_NS0ID_INT64, "System.Int64"},
+    {UA_NS0ID_UINT64, "System.UInt64"},
+    {UA_NS0ID_FLOAT, "System.Single"},
+    {UA_NS0ID_DOUBLE, "System.Double"},
+    {UA_NS0ID_STRING, "System.String"},
+    {UA_NS0ID_DATETIME, "System.DateTime"}
+};
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static char* _string_dup(const UA_String* string);
+static void* _reserve(void* array, size_t count, size_t* capacity, size_t size);
+static const UA_NodeId* _seen_node(const Discovery* discovery, size_t entry);
+static void _seen_add(Discovery* discovery, size_t entry);
+static bool _seen_contains(const Discovery* discovery, const UA_NodeId* node);
+static void _add_object(Discovery* discovery, const UA_NodeId* node, size_t parent, char* name);
+static void _add_variable(Discovery* discovery, const UA_NodeId* node, size_t parent, char* name);
+static void _fail(Discovery* discovery, UA_StatusCode status);
+static bool _transient(UA_StatusCode status);
+static void _retry(Discovery* discovery, bool object, size_t index, UA_StatusCode status);
+static void _collect(Discovery* discovery, size_t object, const UA_BrowseResult* result);
+static DiscoverRequest* _new_request(Discovery* discovery, size_t count);
+static void _free_request(DiscoverRequest* request);
+static void _on_browse(UA_Client* client, void* userdata, UA_UInt32 request_id, UA_BrowseResponse* response);
+static void _on_browse_next(UA_Client* client, void* userdata, UA_UInt32 request_id, UA_BrowseNextResponse* response);
+static void _on_read(UA_Client* client, void* userdata, UA_UInt32 request_id, UA_ReadResponse* response);
+static bool _send_browse(Discovery* discovery);
+static bool _send_read(Discovery* discovery);
+static void _pump(Discovery* discovery, bool (*send)(Discovery*), const volatile sig_atomic_t* running);
+static bool _complete(const Discovery* discovery);
+static const char* _type_name(const UA_NodeId* data_type);
+static void _group_name(const Discovery* discovery, size_t object, char* buffer, size_t size);
+
+
+/// @brief Copy a UA_String into a terminated string
+static char* _string_dup(const UA_String* string){
+
+    char* copy = (char*)malloc(string->length + 1);
+
+    if (!copy) {
+        fprintf(stderr, "Failed to allocate memory for a name\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (string->length > 0) memcpy(copy, string->data, string->length);
+    copy[string->length] = '\0';
+
+    return copy;
+}
+
+/// @brief Grow an array of the discovery to hold one more element
+static void* _reserve(void* array, size_t count, size_t* capacity, size_t size){
+
+    if (count < *capacity) return array;
+
+    *capacity = *capacity ? *capacity * 2 : 256;
+    array = realloc(array, *capacity * size);
+    if (!array) {
+        fprintf(stderr, "Failed to allocate memory for the discovery\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return array;
+}
+
+/// @brief NodeId of an entry of the seen set
+static const UA_NodeId* _seen_node(const Discovery* discovery, size_t entry){
+
+    size_t index = (entry - 1) >> 1;
+
+    return (entry - 1) & 1 ? &discovery->variables[index].node : &discovery->objects[index].node;
+}
+
+/// @brief Add an entry to the seen set, which is kept at most half full
+static void _seen_add(Discovery* discovery, size_t entry){
+
+    size_t mask;
+    size_t slot;
+
+    if ((discovery->seen_count + 1) * 2 > discovery->seen_capacity) {
+        size_t* old = discovery->seen;
+        size_t old_capacity = discovery->seen_capacity;
+
+        discovery->seen_capacity = old_capacity ? old_capacity * 2 : 1024;
+        discovery->seen = (size_t*)calloc(discovery->seen_capacity, sizeof(size_t));
+        if (!discovery->seen) {
+            fprintf(stderr, "Failed to allocate memory for the discovery\n");
+            exit(EXIT_FAILURE);
+        }
+
+        discovery->seen_count = 0;
+        for (size_t s = 0; s < old_capacity; s++) {
+            if (old[s] != 0) _seen_add(discovery, old[s]);
+        }
+        free(old);
+    }
+
+    mask = discovery->seen_capacity - 1;
+    for (slot = UA_NodeId_hash(_seen_node(discovery, entry)) & mask; discovery->seen[slot] != 0; slot = (slot + 1) & mask);
+
+    discovery->seen[slot] = entry;
+    discovery->seen_count++;
+}
+
+/// @brief Check if a node was already found
+static bool _seen_contains(const Discovery* discovery, const UA_NodeId* node){
+
+    size_t mask;
+
+    if (discovery->seen_capacity == 0) return false;
+
+    mask = discovery->seen_capacity - 1;
+    for (size_t slot = UA_NodeId_hash(node) & mask; discovery->seen[slot] != 0; slot = (slot + 1) & mask) {
+        if (UA_NodeId_equal(_seen_node(discovery, discovery->seen[slot]), node)) return true;
+    }
+
+    return false;
+}
+
+static void _add_object(Discovery* discovery, const UA_NodeId* node, size_t parent, char* name){
+
+    DiscoverObject* object;
+
+    discovery->objects = (DiscoverObject*)_reserve(discovery->objects, discovery->object_count,
+                                                   &discovery->object_capacity, sizeof(DiscoverObject));
+    object = &discovery->objects[discovery->object_count];
+    UA_NodeId_copy(node, &object->node);
+    object->parent = parent;
+    object->name = name;
+    object->attempts = 0;
+
+    _seen_add(discovery, (discovery->object_count << 1) + 1);
+    discovery->object_count++;
+}
+
+static void _add_variable(Discovery* discovery, const UA_NodeId* node, size_t parent, char* name){
+
+    DiscoverVariable* variable;
+
+    discovery->variables = (DiscoverVariable*)_reserve(discovery->variables, discovery->variable_count,
+                                                       &discovery->variable_capacity, sizeof(DiscoverVariable));
+    variable = &discovery->variables[discovery->variable_count];
+    UA_NodeId_copy(node, &variable->node);
+    UA_NodeId_init(&variable->data_type);
+    variable->parent = parent;
+    variable->name = name;
+    variable->attempts = 0;
+
+    _seen_add(discovery, (discovery->variable_count << 1 | 1) + 1);
+    discovery->variable_count++;
+}
+
+/// @brief Abort the discovery, the first error is kept
+static void _fail(Discovery* discovery, UA_StatusCode status){
+
+    if (discovery->status == UA_STATUSCODE_GOOD) discovery->status = status;
+}
+
+/// @brief Check if a status may clear when the node is sent again
+static bool _transient(UA_StatusCode status){
+
+    switch (status) {
+        case UA_STATUSCODE_BADTIMEOUT:
+        case UA_STATUSCODE_BADREQUESTTIMEOUT:
+        case UA_STATUSCODE_BADRESOURCEUNAVAILABLE:
+        case UA_STATUSCODE_BADTOOMANYOPERATIONS:
+        case UA_STATUSCODE_BADNOCONTINUATIONPOINTS:
+        case UA_STATUSCODE_BADCONTINUATIONPOINTINVALID:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// @brief Queue an object to browse again or a variable to read again after a bad status
+/// @param discovery The discovery
+/// @param object true for an object, false for a variable
+/// @param index Index of the object or the variable
+/// @param status The status of the node or of the service
+/// @note An object is browsed again from its first reference, the references already collected are found
+/// in the seen set. A server short of continuation points or of operations gets smaller batches.
+static void _retry(Discovery* discovery, bool object, size_t index, UA_StatusCode status){
+
+    size_t* attempts = object ? &discovery->objects[index].attempts : &discovery->variables[index].attempts;
+
+    if (!_transient(status) || ++*attempts >= DISCOVER_MAX_ATTEMPTS) {
+        _fail(discovery, status);
+        return;
+    }
+
+    if (status == UA_STATUSCODE_BADNOCONTINUATIONPOINTS && discovery->browse_batch > 1) discovery->browse_batch /= 2;
+    if (status == UA_STATUSCODE_BADTOOMANYOPERATIONS) {
+        if (object && discovery->browse_batch > 1) discovery->browse_batch /= 2;
+        if (!object && discovery->read_batch > 1) discovery->read_batch /= 2;
+    }
+
+    if (object) {
+        discovery->browse_retries = (size_t*)_reserve(discovery->browse_retries, discovery->browse_retry_count,
+                                                      &discovery->browse_retry_capacity, sizeof(size_t));
+        discovery->browse_retries[discovery->browse_retry_count++] = index;
+    } else {
+        discovery->read_retries = (size_t*)_reserve(discovery->read_retries, discovery->read_retry_count,
+                                                    &discovery->read_retry_capacity, sizeof(size_t));
+        discovery->read_retries[discovery->read_retry_count++] = index;
+    }
+    discovery->retries++;
+}
+
+/// @brief Sort the references of a good browse result into variables and objects still to browse
+static void _collect(Discovery* discovery, size_t object, const UA_BrowseResult* result){
+
+    const UA_NodeId has_property = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
+
+    for (size_t r = 0; r < result->referencesSize; r++) {
+        const UA_ReferenceDescription* reference = &result->references[r];
+        const UA_NodeId* target = &reference->nodeId.nodeId;
+
+        // Namespace 0 (the Server object), other servers and the properties of the objects are not items
+        if (target->namespaceIndex == 0 || reference->nodeId.serverIndex != 0 ||
+            UA_NodeId_equal(&reference->referenceTypeId, &has_property) || _seen_contains(discovery, target)) {
+            continue;
+        }
+
+        if (reference->nodeClass == UA_NODECLASS_VARIABLE) {
+            _add_variable(discovery, target, object, _string_dup(&reference->browseName.name));
+        } else if (reference->nodeClass == UA_NODECLASS_OBJECT) {
+            _add_object(discovery, target, object, _string_dup(&reference->browseName.name));
+        }
+    }
+
+    if (result->continuationPoint.length > 0) {
+        DiscoverContinuation* continuation;
+
+        discovery->continuations = (DiscoverContinuation*)_reserve(discovery->continuations, discovery->continuation_count,
+                                                                   &discovery->continuation_capacity,
+                                                                   sizeof(DiscoverContinuation));
+        continuation = &discovery->continuations[discovery->continuation_count++];
+        UA_ByteString_copy(&result->continuationPoint, &continuation->point);
+        continuation->object = object;
+    }
+}
+
+/// @brief Collect the results of a Browse or BrowseNext request
+/// @param discovery The discovery
+/// @param objects Object of each node of the request
+/// @param count Number of nodes of the request
+/// @param service_result Service result of the response
+/// @param results Results of the response
+/// @param results_size Number of results
+/// @note Found nodes are added once, objects being reachable through several hierarchical references.
+/// Namespace 0, other servers and properties are skipped.
+void discovery_browsed(Discovery* discovery, const size_t* objects, size_t count, UA_StatusCode service_result,
+                       const UA_BrowseResult* results, size_t results_size){
+
+    if (discovery->status != UA_STATUSCODE_GOOD) return;
+
+    if (service_result != UA_STATUSCODE_GOOD) {
+        for (size_t i = 0; i < count; i++) _retry(discovery, true, objects[i], service_result);
+        return;
+    }
+
+    // A server answering a part of the nodes cannot be told apart from one that lost them
+    if (results_size != count) {
+        _fail(discovery, UA_STATUSCODE_BADUNEXPECTEDERROR);
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (results[i].statusCode != UA_STATUSCODE_GOOD) {
+            _retry(discovery, true, objects[i], results[i].statusCode);
+        } else {
+            _collect(discovery, objects[i], &results[i]);
+        }
+    }
+}
+
+/// @brief Collect the results of a Read request of DataType attributes
+/// @param discovery The discovery
+/// @param variables Variable of each node of the request
+/// @param count Number of nodes of the request
+/// @param service_result Service result of the response
+/// @param results Results of the response
+/// @param results_size Number of results
+/// @note A variable whose DataType is not a NodeId stays untyped, the gateway serves it as a Variant.
+void discovery_typed(Discovery* discovery, const size_t* variables, size_t count, UA_StatusCode service_result,
+                     const UA_DataValue* results, size_t results_size){
+
+    if (discovery->status != UA_STATUSCODE_GOOD) return;
+
+    if (service_result != UA_STATUSCODE_GOOD) {
+        for (size_t i = 0; i < count; i++) _retry(discovery, false, variables[i], service_result);
+        return;
+    }
+
+    if (results_size != count) {
+        _fail(discovery, UA_STATUSCODE_BADUNEXPECTEDERROR);
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const UA_DataValue* result = &results[i];
+        DiscoverVariable* variable = &discovery->variables[variables[i]];
+
+        if (result->hasStatus && result->status != UA_STATUSCODE_GOOD) {
+            _retry(discovery, false, variables[i], result->status);
+        } else if (result->hasValue && UA_Variant_hasScalarType(&result->value, &UA_TYPES[UA_TYPES_NODEID])) {
+            UA_NodeId_clear(&variable->data_type);
+            UA_NodeId_copy((const UA_NodeId*)result->value.data, &variable->data_type);
+        }
+    }
+}
+
+static DiscoverRequest* _new_request(Discovery* discovery, size_t count){
+
+    DiscoverRequest* request = (DiscoverRequest*)calloc(1, sizeof(DiscoverRequest));
+
+    if (request) request->nodes = (size_t*)malloc(count * sizeof(size_t));
+    if (!request || !request->nodes) {
+        fprintf(stderr, "Failed to allocate memory for a request\n");
+        exit(EXIT_FAILURE);
+    }
+
+    request->discovery = discovery;
+    request->count = count;
+
+    return request;
+}
+
+static void _free_request(DiscoverRequest* request){
+
+    free(request->nodes);
+    free(request);
+}
+
+static void _on_browse(UA_Client* client, void* userdata, UA_UInt32 request_id, UA_BrowseResponse* response){
+
+    DiscoverRequest* request = (DiscoverRequest*)userdata;
+
+    (void)client;
+    (void)request_id;
+
+    request->discovery->in_flight--;
+    discovery_browsed(request->discovery, request->nodes, request->count, response->responseHeader.serviceResult,
+                      response->results, response->resultsSize);
+    _free_request(request);
+}
+
+static void _on_browse_next(UA_Client* client, void* userdata, UA_UInt32 request_id, UA_BrowseNextResponse* response){
+
+    DiscoverRequest* request = (DiscoverRequest*)userdata;
+
+    (void)client;
+    (void)request_id;
+
+    request->discovery->in_flight--;
+    discovery_browsed(request->discovery, request->nodes, request->count, response->responseHeader.serviceResult,
+                      response->results, response->resultsSize);
+    _free_request(request);
+}
+
+static void _on_read(UA_Client* client, void* userdata, UA_UInt32 request_id, UA_ReadResponse* response){
+
+    DiscoverRequest* request = (DiscoverRequest*)userdata;
+
+    (void)client;
+    (void)request_id;
+
+    request->discovery->in_flight--;
+    discovery_typed(request->discovery, request->nodes, request->count, response->responseHeader.serviceResult,
+                    response->results, response->resultsSize);
+    _free_request(request);
+}
+
+/// @brief Send the next BrowseNext or Browse request
+/// @return false when there is nothing left to send or the request failed
+/// @note Continuation points go first so the server releases them early, then the objects to browse again.
+static bool _send_browse(Discovery* discovery){
+
+    DiscoverRequest* context;
+    UA_StatusCode retval;
+    size_t count;
+
+    if (discovery->continuation_count > 0) {
+        UA_BrowseNextRequest request;
+
+        count = discovery->continuation_count < discovery->browse_batch ? discovery->continuation_count : discovery->browse_batch;
+        context = _new_request(discovery, count);
+
+        UA_BrowseNextRequest_init(&request);
+        request.continuationPoints = (UA_ByteString*)UA_Array_new(count, &UA_TYPES[UA_TYPES_BYTESTRING]);
+        if (!request.continuationPoints) {
+            fprintf(stderr, "Failed to allocate memory for a request\n");
+            exit(EXIT_FAILURE);
+        }
+        request.continuationPointsSize = count;
+
+        // The points move into the request
+        for (size_t i = 0; i < count; i++) {
+            DiscoverContinuation* continuation = &discovery->continuations[--discovery->continuation_count];
+
+            request.continuationPoints[i] = continuation->point;
+            context->nodes[i] = continuation->object;
+        }
+
+        retval = UA_Client_sendAsyncBrowseNextRequest(discovery->client, &request, _on_browse_next, context, NULL);
+        UA_BrowseNextRequest_clear(&request);
+    } else if (discovery->browse_retry_count > 0 || discovery->browsed < discovery->object_count) {
+        UA_BrowseRequest request;
+
+        count = discovery->browse_retry_count > 0 ? discovery->browse_retry_count : discovery->object_count - discovery->browsed;
+        if (count > discovery->browse_batch) count = discovery->browse_batch;
+        context = _new_request(discovery, count);
+
+        UA_BrowseRequest_init(&request);
+        request.requestedMaxReferencesPerNode = DISCOVER_MAX_REFERENCES;
+        request.nodesToBrowse = (UA_BrowseDescription*)UA_Array_new(count, &UA_TYPES[UA_TYPES_BROWSEDESCRIPTION]);
+        if (!request.nodesToBrowse) {
+            fprintf(stderr, "Failed to allocate memory for a request\n");
+            exit(EXIT_FAILURE);
+        }
+        request.nodesToBrowseSize = count;
+
+        for (size_t i = 0; i < count; i++) {
+            UA_BrowseDescription* description = &request.nodesToBrowse[i];
+
+            context->nodes[i] = discovery->browse_retry_count > 0 ? discovery->browse_retries[--discovery->browse_retry_count] :
+                                                                    discovery->browsed++;
+            UA_NodeId_copy(&discovery->objects[context->nodes[i]].node, &description->nodeId);
+            description->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+            description->includeSubtypes = true;
+            description->browseDirection = UA_BROWSEDIRECTION_FORWARD;
+            description->nodeClassMask = UA_NODECLASS_OBJECT | UA_NODECLASS_VARIABLE;
+            description->resultMask = UA_BROWSERESULTMASK_REFERENCETYPEID | UA_BROWSERESULTMASK_NODECLASS |
+                                      UA_BROWSERESULTMASK_BROWSENAME;
+        }
+
+        retval = UA_Client_sendAsyncBrowseRequest(discovery->client, &request, _on_browse, context, NULL);
+        UA_BrowseRequest_clear(&request);
+    } else {
+        return false;
+    }
+
+    if (retval != UA_STATUSCODE_GOOD) {
+        _free_request(context);
+        _fail(discovery, retval);
+        return false;
+    }
+
+    discovery->in_flight++;
+    discovery->requests++;
+    return true;
+}
+
+/// @brief Send the next Read request of the DataType attributes, the variables to read again first
+/// @return false when there is nothing left to send or the request failed
+static bool _send_read(Discovery* discovery){
+
+    DiscoverRequest* context;
+    UA_ReadRequest request;
+    UA_StatusCode retval;
+    size_t count;
+
+    if (discovery->read_retry_count == 0 && discovery->typed >= discovery->variable_count) return false;
+
+    count = discovery->read_retry_count > 0 ? discovery->read_retry_count : discovery->variable_count - discovery->typed;
+    if (count > discovery->read_batch) count = discovery->read_batch;
+    context = _new_request(discovery, count);
+
+    UA_ReadRequest_init(&request);
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+    request.nodesToRead = (UA_ReadValueId*)UA_Array_new(count, &UA_TYPES[UA_TYPES_READVALUEID]);
+    if (!request.nodesToRead) {
+        fprintf(stderr, "Failed to allocate memory for a request\n");
+        exit(EXIT_FAILURE);
+    }
+    request.nodesToReadSize = count;
+
+    for (size_t i = 0; i < count; i++) {
+        context->nodes[i] = discovery->read_retry_count > 0 ? discovery->read_retries[--discovery->read_retry_count] :
+                                                              discovery->typed++;
+        UA_NodeId_copy(&discovery->variables[context->nodes[i]].node, &request.nodesToRead[i].nodeId);
+        request.nodesToRead[i].attributeId = UA_ATTRIBUTEID_DATATYPE;
+    }
+
+    retval = UA_Client_sendAsyncReadRequest(discovery->client, &request, _on_read, context, NULL);
+    UA_ReadRequest_clear(&request);
+
+    if (retval != UA_STATUSCODE_GOOD) {
+        _free_request(context);
+        _fail(discovery, retval);
+        return false;
+    }
+
+    discovery->in_flight++;
+    discovery->requests++;
+    return true;
+}
+
+/// @brief Keep up to `pipeline` requests in flight until there is nothing left to send
+static void _pump(Discovery* discovery, bool (*send)(Discovery*), const volatile sig_atomic_t* running){
+
+    while (*running && discovery->status == UA_STATUSCODE_GOOD) {
+        UA_StatusCode retval;
+
+        while (discovery->in_flight < discovery->pipeline && send(discovery));
+        if (discovery->in_flight == 0) break;
+
+        retval = UA_Client_run_iterate(discovery->client, DISCOVER_ITERATE_TIMEOUT);
+        if (retval != UA_STATUSCODE_GOOD) _fail(discovery, retval);
+    }
+}
+
+/// @brief Initialize a discovery of the subtree of a node
+/// @param discovery Pointer to the Discovery structure to initialize
+/// @param client Connected client, NULL when the results are fed with discovery_browsed and discovery_typed
+/// @param root Node whose subtree is browsed, copied
+/// @param root_name Browse name of the root, copied
+/// @param browse_batch Nodes per Browse and BrowseNext request
+/// @param read_batch Nodes per Read request
+/// @param pipeline Requests in flight on the session
+void init_discovery(Discovery* discovery, UA_Client* client, const UA_NodeId* root, const char* root_name,
+                    size_t browse_batch, size_t read_batch, size_t pipeline){
+
+    UA_String name = UA_STRING((char*)root_name);
+
+    memset(discovery, 0, sizeof(Discovery));
+    discovery->client = client;
+    discovery->browse_batch = browse_batch > 0 ? browse_batch : 1;
+    discovery->read_batch = read_batch > 0 ? read_batch : 1;
+    discovery->pipeline = pipeline > 0 ? pipeline : 1;
+
+    _add_object(discovery, root, SIZE_MAX, _string_dup(&name));
+}
+
+/// @brief Browse the subtree and read the types of its variables
+/// @param discovery The discovery
+/// @param running Cleared by a signal handler to interrupt the discovery
+/// @return UA_STATUSCODE_GOOD when the discovery is complete, the status that aborted it otherwise
+/// @note Interrupted, the discovery ends with UA_STATUSCODE_BADSHUTDOWN. Requests still in flight when it is
+/// aborted are cancelled by disconnecting the client.
+UA_StatusCode discovery_run(Discovery* discovery, const volatile sig_atomic_t* running){
+
+    _pump(discovery, _send_browse, running);
+    _pump(discovery, _send_read, running);
+    if (!*running) _fail(discovery, UA_STATUSCODE_BADSHUTDOWN);
+
+    // Pending callbacks use the discovery, they complete or are cancelled by the disconnection
+    while (discovery->in_flight > 0 && UA_Client_run_iterate(discovery->client, DISCOVER_ITERATE_TIMEOUT) == UA_STATUSCODE_GOOD);
+    if (discovery->in_flight > 0) UA_Client_disconnect(discovery->client);
+
+    if (discovery->status == UA_STATUSCODE_GOOD && !_complete(discovery)) _fail(discovery, UA_STATUSCODE_BADUNEXPECTEDERROR);
+
+    return discovery->status;
+}
+
+/// @brief Check that every object was browsed to its last reference and every variable was typed
+static bool _complete(const Discovery* discovery){
+
+    return discovery->status == UA_STATUSCODE_GOOD && discovery->in_flight == 0 &&
+           discovery->continuation_count == 0 && discovery->browse_retry_count == 0 &&
+           discovery->read_retry_count == 0 && discovery->browsed == discovery->object_count &&
+           discovery->typed == discovery->variable_count;
+}
+
+/// @brief Type name of the machine files for a DataType, NULL when the gateway has no matching type
+static const char* _type_name(const UA_NodeId* data_type){
+
+    if (data_type->namespaceIndex != 0 || data_type->identifierType != UA_NODEIDTYPE_NUMERIC) return NULL;
+
+    for (size_t t = 0; t < sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]); t++) {
+        if (TYPE_NAMES[t].id == data_type->identifier.numeric) return TYPE_NAMES[t].name;
+    }
+
+    return NULL;
+}
+
+/// @brief Name of the Group of an object, the browse names below the root joined by dots
+static void _group_name(const Discovery* discovery, size_t object, char* buffer, size_t size){
+
+    const DiscoverObject* node = &discovery->objects[object];
+    size_t length = 0;
+
+    buffer[0] = '\0';
+    if (node->parent != SIZE_MAX && node->parent != 0) {
+        _group_name(discovery, node->parent, buffer, size);
+        length = strlen(buffer);
+        if (length + 1 < size) {
+            buffer[length++] = '.';
+            buffer[length] = '\0';
+        }
+    }
+
+    snprintf(buffer + length, size - length, "%s", node->name);
+}
+
+/// @brief Build the Subscriptions of the machine file, one Group per object holding variables
+/// @param discovery The discovery
+/// @return A new json array, NULL unless the discovery is complete
+/// @note A Group is named after the browse names of its object below the root, joined by dots, and holds
+/// one Item per variable with its NodeId and the type read from its DataType attribute.
+struct json_object* discovery_subscriptions(const Discovery* discovery){
+
+    struct json_object* subscriptions;
+    struct json_object** groups;
+    char name[1024];
+
+    if (!_complete(discovery)) return NULL;
+
+    subscriptions = json_object_new_array();
+    groups = (struct json_object**)calloc(discovery->object_count + 1, sizeof(struct json_object*));
+    if (!groups) {
+        fprintf(stderr, "Failed to allocate memory for the groups\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t v = 0; v < discovery->variable_count; v++) {
+        const DiscoverVariable* variable = &discovery->variables[v];
+        struct json_object* item = json_object_new_object();
+        struct json_object* items;
+        const char* type = _type_name(&variable->data_type);
+        UA_String node_id = UA_STRING_NULL;
+
+        if (!groups[variable->parent]) {
+            groups[variable->parent] = json_object_new_object();
+            _group_name(discovery, variable->parent, name, sizeof(name));
+            json_object_object_add(groups[variable->parent], "Name", json_object_new_string(name));
+            json_object_object_add(groups[variable->parent], "Items", json_object_new_array());
+        }
+
+        UA_NodeId_print(&variable->node, &node_id);
+        json_object_object_add(item, "Name", json_object_new_string(variable->name));
+        json_object_object_add(item, "NodeId", json_object_new_string_len((const char*)node_id.data, (int)node_id.length));
+        // Without a Type the gateway serves the item as a Variant
+        if (type) json_object_object_add(item, "Type", json_object_new_string(type));
+        UA_String_clear(&node_id);
+
+        json_object_object_get_ex(groups[variable->parent], "Items", &items);
+        json_object_array_add(items, item);
+    }
+
+    // Groups follow the breadth-first order of their objects
+    for (size_t o = 0; o < discovery->object_count; o++) {
+        if (groups[o]) json_object_array_add(subscriptions, groups[o]);
+    }
+    free(groups);
+
+    return subscriptions;
+}
+
+/// @brief Free the memory of a discovery
+/// @param discovery Pointer to the Discovery structure to free
+void free_discovery(Discovery* discovery){
+
+    for (size_t o = 0; o < discovery->object_count; o++) {
+        UA_NodeId_clear(&discovery->objects[o].node);
+        free(discovery->objects[o].name);
+    }
+    for (size_t v = 0; v < discovery->variable_count; v++) {
+        UA_NodeId_clear(&discovery->variables[v].node);
+        UA_NodeId_clear(&discovery->variables[v].data_type);
+        free(discovery->variables[v].name);
+    }
+    for (size_t c = 0; c < discovery->continuation_count; c++) UA_ByteString_clear(&discovery->continuations[c].point);
+
+    free(discovery->objects);
+    free(discovery->variables);
+    free(discovery->continuations);
+    free(discovery->browse_retries);
+    free(discovery->read_retries);
+    free(discovery->seen);
+    memset(discovery, 0, sizeof(Discovery));
+}
@@ -0,0 +1,912 @@
+#include "../include/expression.h"
+
+#include <open62541/plugin/log_stdout.h>
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+
+typedef struct {
+    const char* text;
+    const char* cursor;
+    const AddressSpace* address_space;
+    const AddressSpaceNode* position;
+    ExpressionInstruction* code;
+    size_t length;
+    size_t capacity;
+    size_t depth;
+    char* error;
+    size_t error_size;
+    bool failed;
+} ExpressionParser;
+
+typedef struct {
+    const size_t* by_item;  ///< Expression of each item, expressions->count for the other items
+    size_t* order;          ///< Visit order of each expression, 0 until visited
+    size_t* low;            ///< Smallest visit order reachable from each expression on the stack
+    size_t* stack;
+    size_t depth;
+    bool* on_stack;
+    size_t visited;
+    bool* cyclic;           ///< The expression is a member of a reference cycle
+} ExpressionComponents;
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void _fail(ExpressionParser* parser, const char* format, ...);
+static void _emit(ExpressionParser* parser, ExpressionOp op, UA_Double constant, size_t item);
+static bool _accept(ExpressionParser* parser, const char* token);
+static bool _resolve(ExpressionParser* parser, const char* reference, size_t* index);
+static void _parse_reference(ExpressionParser* parser);
+static void _parse_function(ExpressionParser* parser);
+static void _parse_primary(ExpressionParser* parser);
+static void _parse_unary(ExpressionParser* parser);
+static void _parse_binary(ExpressionParser* parser, int level);
+static void _parse_ternary(ExpressionParser* parser);
+static bool _is_numeric(const UA_DataType* type);
+static bool _references(const Expression* expression, size_t item);
+static void _strong_connect(Expressions* expressions, ExpressionComponents* components, size_t e);
+static void _report_cycle(Expressions* expressions, const ExpressionComponents* components, size_t first);
+static void _drop_dependents(Expressions* expressions);
+static void _evaluate(Expressions* expressions, Expression* expression);
+
+
+/// @brief Binary operators per precedence level, from the loosest to the tightest
+static const struct {
+    const char* token;
+    ExpressionOp op;
+    int level;
+} BINARY_OPERATORS[] = {
+    {"||", EXPRESSION_OR, 0},
+    {"&&", EXPRESSION_AND, 1},
+    {"==", EXPRESSION_EQUAL, 2},
+    {"!=", EXPRESSION_NOT_EQUAL, 2},
+    {"<=", EXPRESSION_LESS_EQUAL, 3},
+    {">=", EXPRESSION_GREATER_EQUAL, 3},
+    {"<", EXPRESSION_LESS, 3},
+    {">", EXPRESSION_GREATER, 3},
+    {"+", EXPRESSION_ADD, 4},
+    {"-", EXPRESSION_SUBTRACT, 4},
+    {"*", EXPRESSION_MULTIPLY, 5},
+    {"/", EXPRESSION_DIVIDE, 5},
+    {"%", EXPRESSION_MODULO, 5}
+};
+
+/// @brief Number of binary precedence levels
+#define BINARY_LEVELS 6
+
+/// @brief Functions of the expressions
+static const struct {
+    const char* name;
+    ExpressionOp op;
+    size_t arguments;
+} FUNCTIONS[] = {
+    {"abs", EXPRESSION_ABS, 1},
+    {"sqrt", EXPRESSION_SQRT, 1},
+    {"round", EXPRESSION_ROUND, 1},
+    {"min", EXPRESSION_MIN, 2},
+    {"max", EXPRESSION_MAX, 2}
+};
+
+/// @brief Record the first compilation error with its position in the text
+/// @param parser The parser
+/// @param format printf-like format of the error
+static void _fail(ExpressionParser* parser, const char* format, ...){
+
+    char message[256];
+    va_list arguments;
+
+    if (parser->failed) return;
+    parser->failed = true;
+
+    va_start(arguments, format);
+    vsnprintf(message, sizeof(message), format, arguments);
+    va_end(arguments);
+
+    snprintf(parser->error, parser->error_size, "%s at offset %zu", message, (size_t)(parser->cursor - parser->text));
+}
+
+/// @brief Append an instruction to the program and track the depth of the evaluation stack
+/// @param parser The parser
+/// @param op The operation
+/// @param constant Operand of EXPRESSION_CONSTANT
+/// @param item Operand of EXPRESSION_ITEM
+static void _emit(ExpressionParser* parser, ExpressionOp op, UA_Double constant, size_t item){
+
+    ExpressionInstruction* instruction;
+
+    if (parser->failed) return;
+
+    if (parser->length == parser->capacity) {
+        parser->capacity = parser->capacity ? parser->capacity * 2 : 8;
+        parser->code = (ExpressionInstruction*)realloc(parser->code, parser->capacity * sizeof(ExpressionInstruction));
+        if (!parser->code) {
+            fprintf(stderr, "Failed to allocate memory for Expression\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    instruction = &parser->code[parser->length++];
+    instruction->op = op;
+    if (op == EXPRESSION_ITEM) {
+        instruction->operand.item = item;
+    } else {
+        instruction->operand.constant = constant;
+    }
+
+    switch (op) {
+        case EXPRESSION_CONSTANT:
+        case EXPRESSION_ITEM:
+            if (++parser->depth > EXPRESSION_MAX_STACK) _fail(parser, "Expression nested too deeply");
+            break;
+        case EXPRESSION_NEGATE:
+        case EXPRESSION_NOT:
+        case EXPRESSION_ABS:
+        case EXPRESSION_SQRT:
+        case EXPRESSION_ROUND:
+            break;
+        case EXPRESSION_SELECT:
+            parser->depth -= 2;
+            break;
+        default:
+            parser->depth--;
+            break;
+    }
+}
+
+/// @brief Consume a token if the text continues with it
+/// @param parser The parser
+/// @param token The token
+/// @return true if the token was consumed
+static bool _accept(ExpressionParser* parser, const char* token){
+
+    size_t length = strlen(token);
+
+    while (isspace((unsigned char)*parser->cursor)) parser->cursor++;
+
+    if (strncmp(parser->cursor, token, length) != 0) return false;
+
+    parser->cursor += length;
+    return true;
+}
+
+/// @brief Find the global index of a referenced item
+/// @param parser The parser
+/// @param reference "ITEM", "GROUP/ITEM" or "MACHINE/GROUP/ITEM"
+/// @param index Output receiving the global item index
+/// @return true if the item exists
+static bool _resolve(ExpressionParser* parser, const char* reference, size_t* index){
+
+    const AddressSpace* address_space = parser->address_space;
+    const AddressSpaceMachine* entry;
+    const ArrayItem* items;
+    const char* parts[3] = {0};
+    char buffer[512];
+    size_t count = 0;
+    size_t machine = parser->position->machine;
+    size_t group = parser->position->group;
+    char* part;
+    char* next;
+
+    snprintf(buffer, sizeof(buffer), "%s", reference);
+
+    for (part = buffer; part && count < 3; part = next) {
+        next = strchr(part, '/');
+        if (next) *next++ = '\0';
+        parts[count++] = part;
+        if (!next) break;
+    }
+    if (next) return false;
+
+    if (count == 3) {
+        for (machine = 0; machine < address_space->count; machine++) {
+            const char* name = address_space->machines[machine].config->name;
+            if (name && strcmp(name, parts[0]) == 0) break;
+        }
+        if (machine == address_space->count) return false;
+    }
+
+    if (count >= 2) {
+        const ArrayGroup* groups = &address_space->machines[machine].config->groups;
+
+        for (group = 0; group < groups->count; group++) {
+            if (groups->groups[group].name && strcmp(groups->groups[group].name, parts[count - 2]) == 0) break;
+        }
+        if (group == groups->count) return false;
+    }
+
+    entry = &address_space->machines[machine];
+    items = &entry->config->groups.groups[group].items;
+
+    for (size_t i = 0; i < items->count; i++) {
+        if (items->items[i].name && strcmp(items->items[i].name, parts[count - 1]) == 0) {
+            *index = entry->first_item + entry->group_first_item[group] + i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// @brief Parse an item reference between braces
+/// @param parser The parser, positioned after the opening brace
+static void _parse_reference(ExpressionParser* parser){
+
+    const char* end = strchr(parser->cursor, '}');
+    char reference[512];
+    size_t index;
+
+    if (!end || (size_t)(end - parser->cursor) >= sizeof(reference)) {
+        _fail(parser, "Unterminated item reference");
+        return;
+    }
+
+    memcpy(reference, parser->cursor, (size_t)(end - parser->cursor));
+    reference[end - parser->cursor] = '\0';
+
+    if (!_resolve(parser, reference, &index)) {
+        _fail(parser, "Unknown item {%s}", reference);
+        return;
+    }
+
+    parser->cursor = end + 1;
+    _emit(parser, EXPRESSION_ITEM, 0.0, index);
+}
+
+/// @brief Parse a function call
+/// @param parser The parser, positioned on the function name
+static void _parse_function(ExpressionParser* parser){
+
+    const char* start = parser->cursor;
+    size_t length = 0;
+
+    while (isalpha((unsigned char)start[length])) length++;
+
+    for (size_t f = 0; f < sizeof(FUNCTIONS) / sizeof(FUNCTIONS[0]); f++) {
+        if (strlen(FUNCTIONS[f].name) != length || strncmp(FUNCTIONS[f].name, start, length) != 0) continue;
+
+        parser->cursor += length;
+        if (!_accept(parser, "(")) {
+            _fail(parser, "Expected ( after %s", FUNCTIONS[f].name);
+            return;
+        }
+        for (size_t a = 0; a < FUNCTIONS[f].arguments; a++) {
+            if (a > 0 && !_accept(parser, ",")) {
+                _fail(parser, "%s expects %zu arguments", FUNCTIONS[f].name, FUNCTIONS[f].arguments);
+                return;
+            }
+            _parse_ternary(parser);
+        }
+        if (!_accept(parser, ")")) {
+            _fail(parser, "Expected )");
+            return;
+        }
+
+        _emit(parser, FUNCTIONS[f].op, 0.0, 0);
+        return;
+    }
+
+    _fail(parser, "Unknown function %.*s", (int)length, start);
+}
+
+/// @brief Parse a number, a boolean, a reference, a function call or a parenthesized expression
+/// @param parser The parser
+static void _parse_primary(ExpressionParser* parser){
+
+    char* end;
+    UA_Double constant;
+
+    if (parser->failed) return;
+
+    if (_accept(parser, "(")) {
+        _parse_ternary(parser);
+        if (!_accept(parser, ")")) _fail(parser, "Expected )");
+        return;
+    }
+
+    if (_accept(parser, "{")) {
+        _parse_reference(parser);
+        return;
+    }
+
+    if (_accept(parser, "true")) {
+        _emit(parser, EXPRESSION_CONSTANT, 1.0, 0);
+        return;
+    }
+
+    if (_accept(parser, "false")) {
+        _emit(parser, EXPRESSION_CONSTANT, 0.0, 0);
+        return;
+    }
+
+    if (isalpha((unsigned char)*parser->cursor)) {
+        _parse_function(parser);
+        return;
+    }
+
+    constant = strtod(parser->cursor, &end);
+    if (end == parser->cursor) {
+        _fail(parser, *parser->cursor ? "Unexpected character '%c'" : "Unexpected end of expression", *parser->cursor);
+        return;
+    }
+
+    parser->cursor = end;
+    _emit(parser, EXPRESSION_CONSTANT, constant, 0);
+}
+
+/// @brief Parse the unary operators
+/// @param parser The parser
+static void _parse_unary(ExpressionParser* parser){
+
+    if (_accept(parser, "-")) {
+        _parse_unary(parser);
+        _emit(parser, EXPRESSION_NEGATE, 0.0, 0);
+    } else if (_accept(parser, "!")) {
+        _parse_unary(parser);
+        _emit(parser, EXPRESSION_NOT, 0.0, 0);
+    } else if (_accept(parser, "+")) {
+        _parse_unary(parser);
+    } else {
+        _parse_primary(parser);
+    }
+}
+
+/// @brief Parse the left-associative binary operators of a precedence level and the tighter ones
+/// @param parser The parser
+/// @param level Precedence level, see BINARY_OPERATORS
+static void _parse_binary(ExpressionParser* parser, int level){
+
+    bool matched = true;
+
+    if (level == BINARY_LEVELS) {
+        _parse_unary(parser);
+        return;
+    }
+
+    _parse_binary(parser, level + 1);
+
+    while (matched && !parser->failed) {
+        matched = false;
+
+        for (size_t o = 0; o < sizeof(BINARY_OPERATORS) / sizeof(BINARY_OPERATORS[0]); o++) {
+            if (BINARY_OPERATORS[o].level != level || !_accept(parser, BINARY_OPERATORS[o].token)) continue;
+
+            _parse_binary(parser, level + 1);
+            _emit(parser, BINARY_OPERATORS[o].op, 0.0, 0);
+            matched = true;
+            break;
+        }
+    }
+}
+
+/// @brief Parse a conditional expression, the loosest construct
+/// @param parser The parser
+static void _parse_ternary(ExpressionParser* parser){
+
+    _parse_binary(parser, 0);
+
+    if (parser->failed || !_accept(parser, "?")) return;
+
+    _parse_ternary(parser);
+    if (!_accept(parser, ":")) {
+        _fail(parser, "Expected :");
+        return;
+    }
+    _parse_ternary(parser);
+    _emit(parser, EXPRESSION_SELECT, 0.0, 0);
+}
+
+/// @brief Compile the text of an expression
+/// @param expression The expression receiving the program, its item and type are left untouched
+/// @param text Source text of the expression
+/// @param address_space Layout used to resolve the item references
+/// @param position Item owning the expression, references without machine or group are relative to it
+/// @param error Output receiving the reason of a failure
+/// @param error_size Size of the error buffer
+/// @return true on success, the caller frees the program with free_expression
+bool expression_compile(Expression* expression, const char* text, const AddressSpace* address_space,
+                        const AddressSpaceNode* position, char* error, size_t error_size){
+
+    ExpressionParser parser = {0};
+
+    if (!expression || !text || !address_space || !position) return false;
+
+    parser.text = parser.cursor = text;
+    parser.address_space = address_space;
+    parser.position = position;
+    parser.error = error;
+    parser.error_size = error_size;
+
+    _parse_ternary(&parser);
+
+    while (isspace((unsigned char)*parser.cursor)) parser.cursor++;
+    if (*parser.cursor != '\0') _fail(&parser, "Unexpected character '%c'", *parser.cursor);
+
+    if (parser.failed) {
+        free(parser.code);
+        expression->code = NULL;
+        expression->length = 0;
+        return false;
+    }
+
+    expression->code = parser.code;
+    expression->length = parser.length;
+    return true;
+}
+
+/// @brief Run the program of an expression
+/// @param expression A compiled expression
+/// @param values Latest value of every item, indexed by global item index
+/// @return The result, NAN or an infinity when it is undefined (e.g. division by zero)
+UA_Double expression_evaluate(const Expression* expression, const UA_Double* values){
+
+    UA_Double stack[EXPRESSION_MAX_STACK];
+    size_t top = 0;
+
+    if (!expression || !expression->code) return NAN;
+
+    for (size_t i = 0; i < expression->length; i++) {
+        const ExpressionInstruction* instruction = &expression->code[i];
+        UA_Double* a;
+        UA_Double b;
+
+        switch (instruction->op) {
+            case EXPRESSION_CONSTANT: stack[top++] = instruction->operand.constant; continue;
+            case EXPRESSION_ITEM:     stack[top++] = values[instruction->operand.item]; continue;
+            case EXPRESSION_NEGATE:   stack[top - 1] = -stack[top - 1]; continue;
+            case EXPRESSION_NOT:      stack[top - 1] = stack[top - 1] == 0.0; continue;
+            case EXPRESSION_ABS:      stack[top - 1] = fabs(stack[top - 1]); continue;
+            case EXPRESSION_SQRT:     stack[top - 1] = sqrt(stack[top - 1]); continue;
+            case EXPRESSION_ROUND:    stack[top - 1] = round(stack[top - 1]); continue;
+            case EXPRESSION_SELECT:
+                top -= 2;
+                stack[top - 1] = stack[top - 1] != 0.0 ? stack[top] : stack[top + 1];
+                continue;
+            default:
+                break;
+        }
+
+        b = stack[--top];
+        a = &stack[top - 1];
+
+        switch (instruction->op) {
+            case EXPRESSION_ADD:           *a = *a + b; break;
+            case EXPRESSION_SUBTRACT:      *a = *a - b; break;
+            case EXPRESSION_MULTIPLY:      *a = *a * b; break;
+            case EXPRESSION_DIVIDE:        *a = *a / b; break;
+            case EXPRESSION_MODULO:        *a = fmod(*a, b); break;
+            case EXPRESSION_LESS:          *a = *a < b; break;
+            case EXPRESSION_LESS_EQUAL:    *a = *a <= b; break;
+            case EXPRESSION_GREATER:       *a = *a > b; break;
+            case EXPRESSION_GREATER_EQUAL: *a = *a >= b; break;
+            case EXPRESSION_EQUAL:         *a = *a == b; break;
+            case EXPRESSION_NOT_EQUAL:     *a = *a != b; break;
+            case EXPRESSION_AND:           *a = *a != 0.0 && b != 0.0; break;
+            case EXPRESSION_OR:            *a = *a != 0.0 || b != 0.0; break;
+            case EXPRESSION_MIN:           *a = fmin(*a, b); break;
+            case EXPRESSION_MAX:           *a = fmax(*a, b); break;
+            default: break;
+        }
+    }
+
+    return top == 1 ? stack[0] : NAN;
+}
+
+/// @brief Free the program of an expression
+/// @param expression The expression
+void free_expression(Expression* expression){
+
+    if (!expression) return;
+
+    free(expression->code);
+    expression->code = NULL;
+    expression->length = 0;
+}
+
+/// @brief Check if a data type can hold the result of an expression
+/// @param type The data type of the derived item
+/// @return true for Boolean and the numeric types
+static bool _is_numeric(const UA_DataType* type){
+    return type->typeKind <= UA_DATATYPEKIND_DOUBLE;
+}
+
+/// @brief Check if an expression references an item
+/// @param expression The expression
+/// @param item Global index of the item
+/// @return true if the program reads the item
+static bool _references(const Expression* expression, size_t item){
+
+    for (size_t i = 0; i < expression->length; i++) {
+        if (expression->code[i].op == EXPRESSION_ITEM && expression->code[i].operand.item == item) return true;
+    }
+    return false;
+}
+
+/// @brief Visit an expression for the strongly connected components of the reference graph (Tarjan)
+/// @param expressions The expressions
+/// @param components State of the search
+/// @param e Index of the expression to visit, not visited yet
+/// @note A component of several expressions, or of one expression referencing itself, is a cycle: its members
+/// are flagged in components->cyclic and reported. Expressions merely reaching a cycle are not members.
+static void _strong_connect(Expressions* expressions, ExpressionComponents* components, size_t e){
+
+    Expression* expression = &expressions->expressions[e];
+    size_t first;
+
+    components->order[e] = components->low[e] = ++components->visited;
+    components->stack[components->depth++] = e;
+    components->on_stack[e] = true;
+
+    for (size_t i = 0; i < expression->length; i++) {
+        size_t next;
+
+        if (expression->code[i].op != EXPRESSION_ITEM) continue;
+
+        next = components->by_item[expression->code[i].operand.item];
+        if (next == expressions->count) continue;
+
+        if (components->order[next] == 0) {
+            _strong_connect(expressions, components, next);
+            if (components->low[next] < components->low[e]) components->low[e] = components->low[next];
+        } else if (components->on_stack[next] && components->order[next] < components->low[e]) {
+            components->low[e] = components->order[next];
+        }
+    }
+
+    if (components->low[e] != components->order[e]) return;
+
+    // The component is the top of the stack down to the expression
+    first = components->depth;
+    do {
+        first--;
+        components->on_stack[components->stack[first]] = false;
+    } while (components->stack[first] != e);
+
+    if (components->depth - first > 1 || _references(expression, expression->item)) {
+        for (size_t i = first; i < components->depth; i++) components->cyclic[components->stack[i]] = true;
+        _report_cycle(expressions, components, first);
+    }
+
+    components->depth = first;
+}
+
+/// @brief Log the members of a reference cycle
+/// @param expressions The expressions
+/// @param components State of the search, the cycle is on the stack from first to the top
+static void _report_cycle(Expressions* expressions, const ExpressionComponents* components, size_t first){
+
+    AddressSpace* address_space = expressions->gateway->address_space;
+    char names[512];
+    size_t length = 0;
+
+    names[0] = '\0';
+    for (size_t i = first; i < components->depth && length < sizeof(names); i++) {
+        AddressSpaceNode position;
+        const char* name;
+
+        address_space_item_at(address_space, expressions->expressions[components->stack[i]].item, &position);
+        name = address_space_item(address_space, &position)->name;
+        length += (size_t)snprintf(names + length, sizeof(names) - length, "%s%s", length > 0 ? ", " : "",
+                                   name ? name : "");
+    }
+
+    if (components->depth - first == 1) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Expression of item %s references itself", names);
+    } else {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Expressions of items %s reference each other",
+                       names);
+    }
+}
+
+/// @brief Mark Bad the expressions depending, directly or not, on a dropped expression
+/// @param expressions The expressions, with their dependency lists
+/// @note A dropped expression has an error status: it failed to compile or was a member of a cycle.
+/// Its dependents keep their program but are published with the same status, instead of waiting forever
+/// for a value that never comes.
+static void _drop_dependents(Expressions* expressions){
+
+    AddressSpace* address_space = expressions->gateway->address_space;
+    size_t* queue;
+    size_t head = 0;
+    size_t tail = 0;
+
+    queue = (size_t*)malloc(expressions->count * sizeof(size_t));
+    if (!queue) {
+        fprintf(stderr, "Failed to allocate memory for Expressions\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t e = 0; e < expressions->count; e++) {
+        if (expressions->expressions[e].error != UA_STATUSCODE_GOOD) queue[tail++] = e;
+    }
+
+    while (head < tail) {
+        Expression* dropped = &expressions->expressions[queue[head++]];
+        size_t item = dropped->item;
+
+        for (size_t d = expressions->dependents_offset[item]; d < expressions->dependents_offset[item + 1]; d++) {
+            Expression* dependent = &expressions->expressions[expressions->dependents[d]];
+            AddressSpaceNode position;
+            const char* name;
+            const char* dropped_name;
+
+            if (dependent->error != UA_STATUSCODE_GOOD) continue;
+
+            dependent->error = dropped->error;
+            queue[tail++] = expressions->dependents[d];
+
+            address_space_item_at(address_space, dependent->item, &position);
+            name = address_space_item(address_space, &position)->name;
+            address_space_item_at(address_space, item, &position);
+            dropped_name = address_space_item(address_space, &position)->name;
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                           "Expression of item %s depends on item %s, which is not evaluated",
+                           name ? name : "", dropped_name ? dropped_name : "");
+        }
+    }
+
+    free(queue);
+}
+
+/// @brief Evaluate an expression and publish its result if it changed
+/// @param expressions The expressions
+/// @param expression The expression
+/// @note Until every referenced item has a numeric value, the result is BadWaitingForInitialData. A dropped
+/// expression, or one depending on it, is published with its error status instead.
+static void _evaluate(Expressions* expressions, Expression* expression){
+
+    UA_DataValue value;
+    UA_Double result = 0.0;
+    UA_StatusCode status = UA_STATUSCODE_GOOD;
+    union {
+        UA_Boolean boolean;
+        UA_SByte sbyte;
+        UA_Byte byte;
+        UA_Int16 int16;
+        UA_UInt16 uint16;
+        UA_Int32 int32;
+        UA_UInt32 uint32;
+        UA_Int64 int64;
+        UA_UInt64 uint64;
+        UA_Float float_value;
+        UA_Double double_value;
+    } scalar;
+
+    if (!expression->code && expression->error == UA_STATUSCODE_GOOD) return;
+
+    status = expression->error;
+    for (size_t i = 0; i < expression->length && status == UA_STATUSCODE_GOOD; i++) {
+        if (expression->code[i].op == EXPRESSION_ITEM && !expressions->known[expression->code[i].operand.item]) {
+            status = UA_STATUSCODE_BADWAITINGFORINITIALDATA;
+        }
+    }
+
+    if (status == UA_STATUSCODE_GOOD) {
+        result = expression_evaluate(expression, expressions->values);
+        if (!isfinite(result)) {
+            result = 0.0;
+            status = UA_STATUSCODE_BADOUTOFRANGE;
+        }
+    }
+
+    if (expression->has_result && expression->result == result && expression->status == status) return;
+
+    expression->has_result = true;
+    expression->result = result;
+    expression->status = status;
+
+    switch (expression->type->typeKind) {
+        case UA_DATATYPEKIND_BOOLEAN: scalar.boolean = result != 0.0; break;
+        case UA_DATATYPEKIND_SBYTE:   scalar.sbyte = (UA_SByte)llround(result); break;
+        case UA_DATATYPEKIND_BYTE:    scalar.byte = (UA_Byte)llround(result); break;
+        case UA_DATATYPEKIND_INT16:   scalar.int16 = (UA_Int16)llround(result); break;
+        case UA_DATATYPEKIND_UINT16:  scalar.uint16 = (UA_UInt16)llround(result); break;
+        case UA_DATATYPEKIND_INT32:   scalar.int32 = (UA_Int32)llround(result); break;
+        case UA_DATATYPEKIND_UINT32:  scalar.uint32 = (UA_UInt32)llround(result); break;
+        case UA_DATATYPEKIND_INT64:   scalar.int64 = (UA_Int64)llround(result); break;
+        case UA_DATATYPEKIND_UINT64:  scalar.uint64 = (UA_UInt64)llround(result); break;
+        case UA_DATATYPEKIND_FLOAT:   scalar.float_value = (UA_Float)result; break;
+        default:                      scalar.double_value = result; break;
+    }
+
+    UA_DataValue_init(&value);
+    if (UA_Variant_setScalarCopy(&value.value, &scalar, expression->type) != UA_STATUSCODE_GOOD) return;
+
+    value.hasValue = true;
+    value.status = status;
+    value.hasStatus = status != UA_STATUSCODE_GOOD;
+    value.sourceTimestamp = UA_DateTime_now();
+    value.hasSourceTimestamp = true;
+
+    gateway_push(expressions->gateway, expression->item, &value);
+}
+
+/// @brief Compile the expressions of the layout and attach them to the gateway
+/// @param expressions Pointer to the Expressions structure to initialize
+/// @param gateway The gateway receiving the derived values, must outlive the expressions
+/// @note Expressions that fail to compile or take part in a reference cycle are reported and dropped, and so
+/// are the expressions depending on them: all are published once with BadConfigurationError. Expressions
+/// without reference are published right away.
+void init_expressions(Expressions* expressions, Gateway* gateway){
+
+    AddressSpace* address_space;
+    ExpressionComponents components = {0};
+    size_t* by_item;
+    size_t index = 0;
+    size_t e = 0;
+    char error[512];
+
+    if (!expressions || !gateway || !gateway->address_space) return;
+
+    memset(expressions, 0, sizeof(Expressions));
+    expressions->gateway = gateway;
+    address_space = gateway->address_space;
+
+    for (size_t m = 0; m < address_space->count; m++) {
+        ArrayGroup* groups = &address_space->machines[m].config->groups;
+
+        for (size_t g = 0; g < groups->count; g++) {
+            for (size_t i = 0; i < groups->groups[g].items.count; i++) {
+                if (groups->groups[g].items.items[i].source == ITEM_SOURCE_EXPRESSION) expressions->count++;
+            }
+        }
+    }
+
+    if (expressions->count == 0) return;
+
+    expressions->expressions = (Expression*)calloc(expressions->count, sizeof(Expression));
+    expressions->values = (UA_Double*)calloc(address_space->item_count, sizeof(UA_Double));
+    expressions->known = (bool*)calloc(address_space->item_count, sizeof(bool));
+    expressions->dependents_offset = (size_t*)calloc(address_space->item_count + 1, sizeof(size_t));
+    by_item = (size_t*)malloc(address_space->item_count * sizeof(size_t));
+    components.order = (size_t*)calloc(expressions->count, sizeof(size_t));
+    components.low = (size_t*)calloc(expressions->count, sizeof(size_t));
+    components.stack = (size_t*)calloc(expressions->count, sizeof(size_t));
+    components.on_stack = (bool*)calloc(expressions->count, sizeof(bool));
+    components.cyclic = (bool*)calloc(expressions->count, sizeof(bool));
+    if (!expressions->expressions || !expressions->values || !expressions->known || !expressions->dependents_offset ||
+        !by_item || !components.order || !components.low || !components.stack || !components.on_stack ||
+        !components.cyclic) {
+        fprintf(stderr, "Failed to allocate memory for Expressions\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < address_space->item_count; i++) by_item[i] = expressions->count;
+
+    // Compile every expression once the whole layout is known, references may cross machines
+    for (size_t m = 0; m < address_space->count; m++) {
+        ArrayGroup* groups = &address_space->machines[m].config->groups;
+
+        for (size_t g = 0; g < groups->count; g++) {
+            ArrayItem* items = &groups->groups[g].items;
+
+            for (size_t i = 0; i < items->count; i++, index++) {
+                AddressSpaceNode position = {ADDRESS_SPACE_NODE_ITEM, m, g, i};
+                Expression* expression;
+
+                if (items->items[i].source != ITEM_SOURCE_EXPRESSION) continue;
+
+                expression = &expressions->expressions[e];
+                expression->item = index;
+                expression->type = address_space_data_type(items->items[i].type);
+                by_item[index] = e++;
+
+                if (!_is_numeric(expression->type)) {
+                    UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Expression item %s must have a numeric or boolean type",
+                                   items->items[i].name ? items->items[i].name : "");
+                } else if (!expression_compile(expression, items->items[i].expression, address_space, &position,
+                                               error, sizeof(error))) {
+                    UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Invalid expression of item %s: %s",
+                                   items->items[i].name ? items->items[i].name : "", error);
+                    expression->error = UA_STATUSCODE_BADCONFIGURATIONERROR;
+                }
+            }
+        }
+    }
+
+    // Only the members of a cycle are dropped, the expressions reaching it are marked by _drop_dependents
+    components.by_item = by_item;
+    for (e = 0; e < expressions->count; e++) {
+        if (components.order[e] == 0) _strong_connect(expressions, &components, e);
+    }
+    for (e = 0; e < expressions->count; e++) {
+        if (!components.cyclic[e]) continue;
+
+        free_expression(&expressions->expressions[e]);
+        expressions->expressions[e].error = UA_STATUSCODE_BADCONFIGURATIONERROR;
+    }
+
+    // Dependency lists, an item referenced twice by an expression lists it once
+    for (size_t pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            for (size_t i = 0; i < address_space->item_count; i++) {
+                expressions->dependents_offset[i + 1] += expressions->dependents_offset[i];
+            }
+            expressions->dependents = (size_t*)malloc((expressions->dependents_offset[address_space->item_count] + 1) * sizeof(size_t));
+            if (!expressions->dependents) {
+                fprintf(stderr, "Failed to allocate memory for Expressions\n");
+                exit(EXIT_FAILURE);
+            }
+            memset(by_item, 0, address_space->item_count * sizeof(size_t));
+        }
+
+        for (e = 0; e < expressions->count; e++) {
+            Expression* expression = &expressions->expressions[e];
+
+            for (size_t i = 0; i < expression->length; i++) {
+                size_t item = expression->code[i].operand.item;
+                bool duplicate = false;
+
+                if (expression->code[i].op != EXPRESSION_ITEM) continue;
+                for (size_t j = 0; j < i && !duplicate; j++) {
+                    duplicate = expression->code[j].op == EXPRESSION_ITEM && expression->code[j].operand.item == item;
+                }
+                if (duplicate) continue;
+
+                if (pass == 0) {
+                    expressions->dependents_offset[item + 1]++;
+                } else {
+                    expressions->dependents[expressions->dependents_offset[item] + by_item[item]++] = e;
+                }
+            }
+        }
+    }
+
+    free(by_item);
+    free(components.order);
+    free(components.low);
+    free(components.stack);
+    free(components.on_stack);
+    free(components.cyclic);
+
+    _drop_dependents(expressions);
+    gateway->expressions = expressions;
+
+    for (e = 0; e < expressions->count; e++) {
+        Expression* expression = &expressions->expressions[e];
+        bool constant = true;
+
+        for (size_t i = 0; i < expression->length && constant; i++) constant = expression->code[i].op != EXPRESSION_ITEM;
+        if (constant || expression->error != UA_STATUSCODE_GOOD) _evaluate(expressions, expression);
+    }
+}
+
+/// @brief Re-evaluate the expressions depending on an item after it changed
+/// @param expressions The expressions
+/// @param item Global index of the item
+/// @param value The new value of the item
+void expressions_update(Expressions* expressions, size_t item, const UA_DataValue* value){
+
+    if (!expressions || !expressions->dependents_offset || !value) return;
+    if (item >= expressions->gateway->address_space->item_count) return;
+    if (expressions->dependents_offset[item] == expressions->dependents_offset[item + 1]) return;
+
+    expressions->known[item] = gateway_value_to_double(value, &expressions->values[item]);
+
+    for (size_t d = expressions->dependents_offset[item]; d < expressions->dependents_offset[item + 1]; d++) {
+        _evaluate(expressions, &expressions->expressions[expressions->dependents[d]]);
+    }
+}
+
+/// @brief Detach the expressions from the gateway and free them
+/// @param expressions Pointer to the Expressions structure to free
+/// @note The server must be stopped first, values pushed by upstream re-evaluate the expressions.
+void free_expressions(Expressions* expressions){
+
+    if (!expressions) return;
+
+    if (expressions->gateway && expressions->gateway->expressions == expressions) {
+        expressions->gateway->expressions = NULL;
+    }
+
+    for (size_t e = 0; e < expressions->count && expressions->expressions; e++) {
+        free_expression(&expressions->expressions[e]);
+    }
+
+    free(expressions->expressions);
+    free(expressions->values);
+    free(expressions->known);
+    free(expressions->dependents_offset);
+    free(expressions->dependents);
+    memset(expressions, 0, sizeof(Expressions));
+}
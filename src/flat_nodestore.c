@@ -0,0 +1,524 @@
+#include "../include/flat_nodestore.h"
+#include "../include/gateway_nodestore.h"
+#include "../include/on_demand.h"
+
+#include <open62541/plugin/log_stdout.h>
+
+typedef struct {
+    const UA_DataType* type;
+    UA_Byte access_level;
+    UA_VariableNode node;
+} FlatTemplate;
+
+typedef struct {
+    UA_Nodestore fallback;
+    AddressSpace* address_space;
+    size_t template_count;
+    FlatTemplate* templates;
+    UA_UInt16* item_templates;
+    UA_DataValue* values;
+} FlatNodestore;
+
+/// @brief Node handed to the server for a gateway NodeId, freed on release
+/// @note `node` must stay the first member, the server only sees its address.
+typedef struct {
+    UA_Node node;
+    size_t item;
+    UA_DataValue served;  ///< Copy of the item value when the view was assembled, to detect a write
+} FlatView;
+
+/// @brief Item index of views on machine and group objects
+#define FLAT_NO_ITEM ((size_t)-1)
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static UA_UInt16 _find_template(FlatNodestore* store, const UA_DataType* type, UA_Byte access_level);
+static UA_StatusCode _add_kind(UA_Node* node, UA_Byte reference_type, UA_Boolean inverse, size_t count);
+static void _set_target(UA_NodeReferenceKind* kind, size_t index, UA_NodeId target, UA_QualifiedName target_name);
+static UA_StatusCode _set_references(FlatNodestore* store, UA_Node* node, const AddressSpaceNode* position,
+                                     UA_ReferenceTypeSet references, UA_BrowseDirection direction);
+static const UA_Node* _get_view(FlatNodestore* store, const AddressSpaceNode* position,
+                                UA_ReferenceTypeSet references, UA_BrowseDirection direction);
+static void _free_view(FlatView* view);
+
+static void _clear(void* context);
+static UA_Node* _new_node(void* context, UA_NodeClass node_class);
+static void _delete_node(void* context, UA_Node* node);
+static const UA_Node* _get_node(void* context, const UA_NodeId* node_id, UA_UInt32 attribute_mask,
+                                UA_ReferenceTypeSet references, UA_BrowseDirection direction);
+static const UA_Node* _get_node_from_ptr(void* context, UA_NodePointer pointer, UA_UInt32 attribute_mask,
+                                         UA_ReferenceTypeSet references, UA_BrowseDirection direction);
+static void _release_node(void* context, const UA_Node* node);
+static UA_StatusCode _get_node_copy(void* context, const UA_NodeId* node_id, UA_Node** out_node);
+static UA_StatusCode _insert_node(void* context, UA_Node* node, UA_NodeId* added_node_id);
+static UA_StatusCode _replace_node(void* context, UA_Node* node);
+static UA_StatusCode _remove_node(void* context, const UA_NodeId* node_id);
+static const UA_NodeId* _get_reference_type_id(void* context, UA_Byte reference_type_index);
+static void _iterate(void* context, UA_NodestoreVisitor visitor, void* visitor_context);
+
+
+/// @brief Find or create the template of a (data type, access level) pair
+/// @param store The flat nodestore
+/// @param type Data type of the items using the template
+/// @param access_level Access level of the items using the template
+/// @return Index of the template
+static UA_UInt16 _find_template(FlatNodestore* store, const UA_DataType* type, UA_Byte access_level){
+
+    FlatTemplate* template;
+
+    for (size_t i = 0; i < store->template_count; i++) {
+        if (store->templates[i].type == type && store->templates[i].access_level == access_level) {
+            return (UA_UInt16)i;
+        }
+    }
+
+    store->templates = (FlatTemplate*)realloc(store->templates, sizeof(FlatTemplate) * (store->template_count + 1));
+    if (!store->templates) {
+        fprintf(stderr, "Failed to allocate memory for FlatTemplate\n");
+        exit(EXIT_FAILURE);
+    }
+
+    template = &store->templates[store->template_count];
+    memset(template, 0, sizeof(FlatTemplate));
+    template->type = type;
+    template->access_level = access_level;
+    template->node.head.nodeClass = UA_NODECLASS_VARIABLE;
+    template->node.dataType = type->typeId;
+    template->node.valueRank = UA_VALUERANK_SCALAR;
+    template->node.accessLevel = access_level;
+    template->node.valueSource = UA_VALUESOURCE_DATA;
+
+    return (UA_UInt16)store->template_count++;
+}
+
+/// @brief Append an empty reference kind to a view
+/// @param node The view receiving the references
+/// @param reference_type Index of the reference type (UA_REFERENCETYPEINDEX_*)
+/// @param inverse Direction of the references
+/// @param count Number of targets of the kind
+/// @return UA_STATUSCODE_GOOD on success, UA_STATUSCODE_BADOUTOFMEMORY otherwise
+/// @note The arrays are allocated with UA_malloc so that UA_Node_deleteReferences can free them.
+static UA_StatusCode _add_kind(UA_Node* node, UA_Byte reference_type, UA_Boolean inverse, size_t count){
+
+    UA_NodeReferenceKind* kind = &node->head.references[node->head.referencesSize];
+
+    memset(kind, 0, sizeof(UA_NodeReferenceKind));
+    kind->referenceTypeIndex = reference_type;
+    kind->isInverse = inverse;
+    kind->hasRefTree = false;
+
+    if (count == 0) {
+        node->head.referencesSize++;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    kind->targets.array = (UA_ReferenceTarget*)UA_calloc(count, sizeof(UA_ReferenceTarget));
+    if (!kind->targets.array) return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    kind->targetsSize = count;
+    node->head.referencesSize++;
+
+    return UA_STATUSCODE_GOOD;
+}
+
+/// @brief Set one target of a reference kind
+/// @param kind The reference kind
+/// @param index Index of the target in the kind
+/// @param target NodeId of the target
+/// @param target_name Browse name of the target
+static void _set_target(UA_NodeReferenceKind* kind, size_t index, UA_NodeId target, UA_QualifiedName target_name){
+
+    UA_ReferenceTarget* reference_target = &kind->targets.array[index];
+
+    // Numeric NodeIds of the layout fit in an immediate pointer, the copy only allocates otherwise
+    UA_NodePointer_copy(UA_NodePointer_fromNodeId(&target), &reference_target->targetId);
+    reference_target->targetNameHash = UA_QualifiedName_hash(&target_name);
+}
+
+/// @brief Build the references of a view implied by the Machine/Group/Item hierarchy
+/// @param store The flat nodestore
+/// @param node The view
+/// @param position Position of the view in the layout
+/// @param references Reference types requested by the server
+/// @param direction Reference direction requested by the server
+/// @return UA_STATUSCODE_GOOD on success
+/// @note Children of a group are written in one pass over the group's item range.
+static UA_StatusCode _set_references(FlatNodestore* store, UA_Node* node, const AddressSpaceNode* position,
+                                     UA_ReferenceTypeSet references, UA_BrowseDirection direction){
+
+    const AddressSpace* address_space = store->address_space;
+    const AddressSpaceMachine* machine = &address_space->machines[position->machine];
+    bool forward = direction != UA_BROWSEDIRECTION_INVERSE;
+    bool inverse = direction != UA_BROWSEDIRECTION_FORWARD;
+    AddressSpaceNode relative = *position;
+    UA_NodeReferenceKind* kind;
+    UA_StatusCode retval;
+
+    node->head.references = (UA_NodeReferenceKind*)UA_calloc(3, sizeof(UA_NodeReferenceKind));
+    if (!node->head.references) return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    if (forward && UA_ReferenceTypeSet_contains(&references, UA_REFERENCETYPEINDEX_HASTYPEDEFINITION)) {
+        retval = _add_kind(node, UA_REFERENCETYPEINDEX_HASTYPEDEFINITION, false, 1);
+        if (retval != UA_STATUSCODE_GOOD) return retval;
+
+        kind = &node->head.references[node->head.referencesSize - 1];
+        if (position->kind == ADDRESS_SPACE_NODE_ITEM) {
+            _set_target(kind, 0, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                        UA_QUALIFIEDNAME(0, "BaseDataVariableType"));
+        } else {
+            _set_target(kind, 0, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), UA_QUALIFIEDNAME(0, "BaseObjectType"));
+        }
+    }
+
+    if (position->kind == ADDRESS_SPACE_NODE_MACHINE) {
+        if (inverse && UA_ReferenceTypeSet_contains(&references, UA_REFERENCETYPEINDEX_ORGANIZES)) {
+            retval = _add_kind(node, UA_REFERENCETYPEINDEX_ORGANIZES, true, 1);
+            if (retval != UA_STATUSCODE_GOOD) return retval;
+
+            kind = &node->head.references[node->head.referencesSize - 1];
+            _set_target(kind, 0, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), UA_QUALIFIEDNAME(0, "Objects"));
+        }
+    } else if (inverse && UA_ReferenceTypeSet_contains(&references, UA_REFERENCETYPEINDEX_HASCOMPONENT)) {
+        retval = _add_kind(node, UA_REFERENCETYPEINDEX_HASCOMPONENT, true, 1);
+        if (retval != UA_STATUSCODE_GOOD) return retval;
+
+        relative.kind = position->kind == ADDRESS_SPACE_NODE_ITEM ? ADDRESS_SPACE_NODE_GROUP : ADDRESS_SPACE_NODE_MACHINE;
+        kind = &node->head.references[node->head.referencesSize - 1];
+        _set_target(kind, 0, address_space_node_id(address_space, &relative),
+                    address_space_browse_name(address_space, &relative));
+    }
+
+    if (position->kind == ADDRESS_SPACE_NODE_ITEM || !forward ||
+        !UA_ReferenceTypeSet_contains(&references, UA_REFERENCETYPEINDEX_HASCOMPONENT)) {
+        return UA_STATUSCODE_GOOD;
+    }
+
+    relative = *position;
+    if (position->kind == ADDRESS_SPACE_NODE_MACHINE) {
+        retval = _add_kind(node, UA_REFERENCETYPEINDEX_HASCOMPONENT, false, machine->config->groups.count);
+        if (retval != UA_STATUSCODE_GOOD) return retval;
+
+        kind = &node->head.references[node->head.referencesSize - 1];
+        relative.kind = ADDRESS_SPACE_NODE_GROUP;
+        for (relative.group = 0; relative.group < machine->config->groups.count; relative.group++) {
+            _set_target(kind, relative.group, address_space_node_id(address_space, &relative),
+                        address_space_browse_name(address_space, &relative));
+        }
+    } else {
+        size_t first = machine->group_first_item[position->group];
+        size_t last = machine->group_first_item[position->group + 1];
+
+        retval = _add_kind(node, UA_REFERENCETYPEINDEX_HASCOMPONENT, false, last - first);
+        if (retval != UA_STATUSCODE_GOOD) return retval;
+
+        kind = &node->head.references[node->head.referencesSize - 1];
+        relative.kind = ADDRESS_SPACE_NODE_ITEM;
+        for (relative.item = first; relative.item < last; relative.item++) {
+            _set_target(kind, relative.item - first, address_space_node_id(address_space, &relative),
+                        address_space_browse_name(address_space, &relative));
+        }
+    }
+
+    return UA_STATUSCODE_GOOD;
+}
+
+/// @brief Assemble the short-lived node of a machine, group or item
+/// @param store The flat nodestore
+/// @param position Position of the node in the layout
+/// @param references Reference types requested by the server
+/// @param direction Reference direction requested by the server
+/// @return The view, or NULL on failure
+/// @note The view owns a copy of the item value, a slot replaced while the view is out never frees its memory.
+static const UA_Node* _get_view(FlatNodestore* store, const AddressSpaceNode* position,
+                                UA_ReferenceTypeSet references, UA_BrowseDirection direction){
+
+    FlatView* view = (FlatView*)calloc(1, sizeof(FlatView));
+    UA_QualifiedName browse_name = address_space_browse_name(store->address_space, position);
+
+    if (!view) return NULL;
+
+    if (position->kind == ADDRESS_SPACE_NODE_ITEM) {
+        size_t index = address_space_item_index(store->address_space, position);
+        UA_DataValue* slot = &store->values[index];
+
+        memcpy(&view->node.variableNode, &store->templates[store->item_templates[index]].node, sizeof(UA_VariableNode));
+        UA_DataValue_init(&view->node.variableNode.value.data.value);
+        if (UA_DataValue_copy(slot, &view->node.variableNode.value.data.value) != UA_STATUSCODE_GOOD ||
+            UA_DataValue_copy(slot, &view->served) != UA_STATUSCODE_GOOD) {
+            UA_DataValue_clear(&view->node.variableNode.value.data.value);
+            free(view);
+            return NULL;
+        }
+        view->item = index;
+
+        // Reads of an ondemand item refresh it on its machine once its Ttl has passed
+        if (address_space_item(store->address_space, position)->on_demand) {
+            view->node.variableNode.value.data.callback.onRead = on_demand_on_read;
+            view->node.head.context = (void*)store->address_space;
+        }
+    } else {
+        view->node.head.nodeClass = UA_NODECLASS_OBJECT;
+        view->item = FLAT_NO_ITEM;
+    }
+
+    // The names point into the machine configuration, they are never freed with the view
+    view->node.head.nodeId = address_space_node_id(store->address_space, position);
+    view->node.head.browseName = browse_name;
+    view->node.head.displayName.text = browse_name.name;
+
+    if (_set_references(store, &view->node, position, references, direction) != UA_STATUSCODE_GOOD) {
+        _free_view(view);
+        return NULL;
+    }
+
+    return &view->node;
+}
+
+/// @brief Free a view with its copies of the item value
+/// @param view The view
+static void _free_view(FlatView* view){
+
+    if (view->item != FLAT_NO_ITEM) {
+        UA_DataValue_clear(&view->node.variableNode.value.data.value);
+        UA_DataValue_clear(&view->served);
+    }
+
+    UA_Node_deleteReferences(&view->node);
+    free(view);
+}
+
+/// @brief Free the flat nodestore and its fallback nodestore
+/// @param context The flat nodestore
+static void _clear(void* context){
+    FlatNodestore* store = (FlatNodestore*)context;
+    size_t item_count = store->address_space->item_count;
+
+    UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                "Flat nodestore held %zu gateway items with %zu templates (%zu bytes per item)",
+                item_count, store->template_count, sizeof(UA_DataValue) + sizeof(UA_UInt16));
+
+    for (size_t i = 0; i < item_count; i++) {
+        UA_DataValue_clear(&store->values[i]);
+    }
+
+    free(store->values);
+    free(store->item_templates);
+    free(store->templates);
+
+    store->fallback.clear(store->fallback.context);
+    free(store);
+}
+
+static UA_Node* _new_node(void* context, UA_NodeClass node_class){
+    FlatNodestore* store = (FlatNodestore*)context;
+    return store->fallback.newNode(store->fallback.context, node_class);
+}
+
+static void _delete_node(void* context, UA_Node* node){
+    FlatNodestore* store = (FlatNodestore*)context;
+    store->fallback.deleteNode(store->fallback.context, node);
+}
+
+static const UA_Node* _get_node(void* context, const UA_NodeId* node_id, UA_UInt32 attribute_mask,
+                                UA_ReferenceTypeSet references, UA_BrowseDirection direction){
+    FlatNodestore* store = (FlatNodestore*)context;
+    AddressSpaceNode position;
+
+    if (address_space_resolve(store->address_space, node_id, &position)) {
+        return _get_view(store, &position, references, direction);
+    }
+
+    return store->fallback.getNode(store->fallback.context, node_id, attribute_mask, references, direction);
+}
+
+static const UA_Node* _get_node_from_ptr(void* context, UA_NodePointer pointer, UA_UInt32 attribute_mask,
+                                         UA_ReferenceTypeSet references, UA_BrowseDirection direction){
+    FlatNodestore* store = (FlatNodestore*)context;
+    AddressSpaceNode position;
+    UA_NodeId node_id;
+
+    if (UA_NodePointer_isLocal(pointer)) {
+        node_id = UA_NodePointer_toNodeId(pointer);
+        if (address_space_resolve(store->address_space, &node_id, &position)) {
+            return _get_view(store, &position, references, direction);
+        }
+    }
+
+    return store->fallback.getNodeFromPtr(store->fallback.context, pointer, attribute_mask, references, direction);
+}
+
+/// @brief Release a node obtained with getNode
+/// @param context The flat nodestore
+/// @param node The node to release
+/// @note The server writes values in place on the node it got. A view whose value differs from the value
+/// it was assembled with has been written, its value then moves into the slot; other views leave the slot
+/// alone, so that releasing an old view never undoes a later replace.
+static void _release_node(void* context, const UA_Node* node){
+    FlatNodestore* store = (FlatNodestore*)context;
+    AddressSpaceNode position;
+    UA_DataValue* value;
+    FlatView* view;
+
+    if (!node || !address_space_resolve(store->address_space, &node->head.nodeId, &position)) {
+        store->fallback.releaseNode(store->fallback.context, node);
+        return;
+    }
+
+    view = (FlatView*)(uintptr_t)node;
+    value = &view->node.variableNode.value.data.value;
+    if (view->item != FLAT_NO_ITEM && UA_order(value, &view->served, &UA_TYPES[UA_TYPES_DATAVALUE]) != UA_ORDER_EQ) {
+        UA_DataValue_clear(&store->values[view->item]);
+        memcpy(&store->values[view->item], value, sizeof(UA_DataValue));
+        UA_DataValue_init(value);
+    }
+
+    _free_view(view);
+}
+
+static UA_StatusCode _get_node_copy(void* context, const UA_NodeId* node_id, UA_Node** out_node){
+    FlatNodestore* store = (FlatNodestore*)context;
+    AddressSpaceNode position;
+    UA_StatusCode retval;
+    UA_Node* node;
+
+    if (!address_space_resolve(store->address_space, node_id, &position)) {
+        return store->fallback.getNodeCopy(store->fallback.context, node_id, out_node);
+    }
+
+    node = gateway_nodestore_build_node(&store->fallback, store->address_space, &position);
+    if (!node) return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    if (position.kind == ADDRESS_SPACE_NODE_ITEM) {
+        size_t index = address_space_item_index(store->address_space, &position);
+
+        UA_DataValue_clear(&node->variableNode.value.data.value);
+        retval = UA_DataValue_copy(&store->values[index], &node->variableNode.value.data.value);
+        if (retval != UA_STATUSCODE_GOOD) {
+            store->fallback.deleteNode(store->fallback.context, node);
+            return retval;
+        }
+    }
+
+    *out_node = node;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode _insert_node(void* context, UA_Node* node, UA_NodeId* added_node_id){
+    FlatNodestore* store = (FlatNodestore*)context;
+    AddressSpaceNode position;
+
+    if (address_space_resolve(store->address_space, &node->head.nodeId, &position)) {
+        store->fallback.deleteNode(store->fallback.context, node);
+        return UA_STATUSCODE_BADNODEIDEXISTS;
+    }
+
+    return store->fallback.insertNode(store->fallback.context, node, added_node_id);
+}
+
+/// @brief Replace a node with an edited copy
+/// @param context The flat nodestore
+/// @param node The edited copy, always consumed
+/// @return UA_STATUSCODE_GOOD on success
+/// @note Only the value of gateway items can change, the structure of the gateway namespaces is fixed.
+static UA_StatusCode _replace_node(void* context, UA_Node* node){
+    FlatNodestore* store = (FlatNodestore*)context;
+    AddressSpaceNode position;
+    UA_DataValue* slot;
+
+    if (!address_space_resolve(store->address_space, &node->head.nodeId, &position)) {
+        return store->fallback.replaceNode(store->fallback.context, node);
+    }
+
+    if (position.kind != ADDRESS_SPACE_NODE_ITEM) {
+        store->fallback.deleteNode(store->fallback.context, node);
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    }
+
+    slot = &store->values[address_space_item_index(store->address_space, &position)];
+    UA_DataValue_clear(slot);
+    memcpy(slot, &node->variableNode.value.data.value, sizeof(UA_DataValue));
+    UA_DataValue_init(&node->variableNode.value.data.value);
+
+    store->fallback.deleteNode(store->fallback.context, node);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode _remove_node(void* context, const UA_NodeId* node_id){
+    FlatNodestore* store = (FlatNodestore*)context;
+    AddressSpaceNode position;
+
+    if (address_space_resolve(store->address_space, node_id, &position)) return UA_STATUSCODE_BADNOTSUPPORTED;
+
+    return store->fallback.removeNode(store->fallback.context, node_id);
+}
+
+static const UA_NodeId* _get_reference_type_id(void* context, UA_Byte reference_type_index){
+    FlatNodestore* store = (FlatNodestore*)context;
+    return store->fallback.getReferenceTypeId(store->fallback.context, reference_type_index);
+}
+
+static void _iterate(void* context, UA_NodestoreVisitor visitor, void* visitor_context){
+    FlatNodestore* store = (FlatNodestore*)context;
+    store->fallback.iterate(store->fallback.context, visitor, visitor_context);
+}
+
+/// @brief Install the flat gateway nodestore in a server configuration
+/// @param config Server configuration holding the default nodestore, which becomes the fallback
+/// @param address_space Layout of the gateway namespaces, must outlive the server
+/// @return UA_STATUSCODE_GOOD on success, UA_STATUSCODE_BADOUTOFMEMORY otherwise
+/// @note Must be called before `UA_Server_newWithConfig`. The nodestore is freed with the server.
+UA_StatusCode flat_nodestore_install(UA_ServerConfig* config, AddressSpace* address_space){
+
+    FlatNodestore* store;
+    size_t index = 0;
+
+    if (!config || !address_space) return UA_STATUSCODE_BADINTERNALERROR;
+
+    store = (FlatNodestore*)calloc(1, sizeof(FlatNodestore));
+    if (!store) return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    store->values = (UA_DataValue*)calloc(address_space->item_count + 1, sizeof(UA_DataValue));
+    store->item_templates = (UA_UInt16*)calloc(address_space->item_count + 1, sizeof(UA_UInt16));
+    if (!store->values || !store->item_templates) {
+        free(store->values);
+        free(store->item_templates);
+        free(store);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    for (size_t m = 0; m < address_space->count; m++) {
+        ArrayGroup* groups = &address_space->machines[m].config->groups;
+
+        for (size_t g = 0; g < groups->count; g++) {
+            ArrayItem* items = &groups->groups[g].items;
+
+            for (size_t i = 0; i < items->count; i++, index++) {
+                store->item_templates[index] = _find_template(store, address_space_data_type(items->items[i].type),
+                                                              UA_ACCESSLEVELMASK_READ);
+
+                // No upstream value has been received yet
+                store->values[index].hasStatus = true;
+                store->values[index].status = UA_STATUSCODE_BADWAITINGFORINITIALDATA;
+            }
+        }
+    }
+
+    store->fallback = config->nodestore;
+    store->address_space = address_space;
+
+    config->nodestore.context = store;
+    config->nodestore.clear = _clear;
+    config->nodestore.newNode = _new_node;
+    config->nodestore.deleteNode = _delete_node;
+    config->nodestore.getNode = _get_node;
+    config->nodestore.getNodeFromPtr = _get_node_from_ptr;
+    config->nodestore.releaseNode = _release_node;
+    config->nodestore.getNodeCopy = _get_node_copy;
+    config->nodestore.insertNode = _insert_node;
+    config->nodestore.replaceNode = _replace_node;
+    config->nodestore.removeNode = _remove_node;
+    config->nodestore.getReferenceTypeId = _get_reference_type_id;
+    config->nodestore.iterate = _iterate;
+
+    return UA_STATUSCODE_GOOD;
+}
@@ -0,0 +1,806 @@
+#include "../include/gateway.h"
+#include "../include/aggregate.h"
+#include "../include/alarms.h"
+#include "../include/expression.h"
+#include "../include/pool_allocator.h"
+#include "../include/replication.h"
+#include "../include/shard.h"
+
+#include <open62541/plugin/log_stdout.h>
+
+#include <math.h>
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void _mark_pending(Gateway* gateway, size_t item);
+static bool _publish_next(Gateway* gateway, UA_Server* server, GatewayClass* class);
+static void _publish_callback(UA_Server* server, void* data);
+static bool _unchanged(Gateway* gateway, size_t item, const UA_DataValue* value);
+static bool _queue(Gateway* gateway, size_t item, UA_DataValue* value);
+static UA_StatusCode _read_counter(UA_Server* server, const UA_NodeId* session_id, void* session_context,
+                                   const UA_NodeId* node_id, void* node_context, UA_Boolean source_timestamp,
+                                   const UA_NumericRange* range, UA_DataValue* value);
+static UA_StatusCode _add_object(UA_Server* server, UA_UInt16 ns, const UA_NodeId parent, const char* id,
+                                 const char* name, UA_NodeId type);
+static UA_StatusCode _read_pool(UA_Server* server, const UA_NodeId* session_id, void* session_context,
+                                const UA_NodeId* node_id, void* node_context, UA_Boolean source_timestamp,
+                                const UA_NumericRange* range, UA_DataValue* value);
+static void _add_pool_nodes(UA_Server* server, UA_UInt16 ns);
+static UA_StatusCode _read_latency(UA_Server* server, const UA_NodeId* session_id, void* session_context,
+                                   const UA_NodeId* node_id, void* node_context, UA_Boolean source_timestamp,
+                                   const UA_NumericRange* range, UA_DataValue* value);
+static void _add_priority_nodes(Gateway* gateway, UA_Server* server, UA_UInt16 ns);
+static UA_StatusCode _translate_paths(UA_Server* server, const UA_NodeId* session_id, void* session_context,
+                                     const UA_NodeId* method_id, void* method_context, const UA_NodeId* object_id,
+                                     void* object_context, size_t input_size, const UA_Variant* input,
+                                     size_t output_size, UA_Variant* output);
+static UA_StatusCode _add_translate_method(Gateway* gateway, UA_Server* server, UA_UInt16 ns);
+
+/// @brief Counters of a pool exposed below Gateway/Pools
+static const char* POOL_FIELDS[] = {"Allocations", "Frees", "RemoteFrees", "InUse", "Capacity"};
+#define POOL_FIELD_COUNT (sizeof(POOL_FIELDS) / sizeof(POOL_FIELDS[0]))
+
+/// @brief Names of the priority classes below Gateway/Priorities
+static const char* PRIORITY_NAMES[PRIORITY_CLASS_COUNT] = {"High", "Normal", "Low"};
+
+
+/// @brief Append an item to the round-robin list of its priority class
+/// @param gateway The gateway
+/// @param item Global index of the item
+/// @note An item is at most once in the lists, so a list never holds more items than its class.
+static void _mark_pending(Gateway* gateway, size_t item){
+
+    GatewayClass* class;
+    size_t tail;
+
+    if (gateway->is_pending[item]) return;
+
+    class = &gateway->classes[gateway->item_class[item]];
+    tail = (class->head + class->count) % class->capacity;
+    class->pending[tail] = item;
+    class->count++;
+    gateway->is_pending[item] = true;
+}
+
+/// @brief Publish the oldest value of the next item of a priority class
+/// @param gateway The gateway
+/// @param server Pointer to the UA_Server instance
+/// @param class The priority class, with at least one pending item
+/// @return true if a value was published
+static bool _publish_next(Gateway* gateway, UA_Server* server, GatewayClass* class){
+
+    AddressSpace* address_space = gateway->address_space;
+    size_t item = class->pending[class->head];
+    ItemQueue* queue = &gateway->queues[item];
+    bool was_full = item_queue_full(queue);
+    AddressSpaceNode position;
+    UA_DataValue value;
+    UA_DateTime received;
+    UA_Double latency;
+    UA_Double weight;
+    UA_StatusCode retval;
+    Group* group;
+    bool late;
+
+    class->head = (class->head + 1) % class->capacity;
+    class->count--;
+    gateway->is_pending[item] = false;
+
+    received = item_queue_oldest(queue);
+    if (!item_queue_pop(queue, &value)) return false;
+
+    address_space_item_at(address_space, item, &position);
+    group = &address_space->machines[position.machine].config->groups.groups[position.group];
+    if (was_full && queue->overflow == QUEUE_OVERFLOW_BLOCK) {
+        gateway->machine_blocked[position.machine]--;
+    }
+
+    if (_unchanged(gateway, item, &value)) {
+        gateway->unchanged++;
+    } else {
+        // Machines without a namespace of their own are not exposed
+        if (address_space->machines[position.machine].namespace_index != 0) {
+            retval = UA_Server_writeDataValue(server, address_space_node_id(address_space, &position), value);
+            if (retval != UA_STATUSCODE_GOOD) {
+                UA_LOG_DEBUG(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Failed to publish item %zu: %s",
+                             item, UA_StatusCode_name(retval));
+            }
+        }
+
+        if (gateway->shm) shm_table_write(gateway->shm, item, &value);
+        if (gateway->replication) replication_publish(gateway->replication, item, &value);
+        if (gateway->alarms) alarms_stage(gateway->alarms, item, &value);
+    }
+
+    UA_DataValue_clear(&value);
+
+    // Moving averages over the last GATEWAY_LATENCY_SAMPLES values, plain means until then
+    latency = (UA_Double)(UA_DateTime_nowMonotonic() - received) / UA_DATETIME_MSEC;
+    late = latency > (UA_Double)group->target_latency;
+    class->published++;
+    weight = 1.0 / (UA_Double)(class->published < GATEWAY_LATENCY_SAMPLES ? class->published : GATEWAY_LATENCY_SAMPLES);
+    class->recent_latency += (latency - class->recent_latency) * weight;
+    class->recent_late += ((late ? 1.0 : 0.0) - class->recent_late) * weight;
+    if (latency > class->max_latency) class->max_latency = latency;
+    if (late) class->late++;
+
+    // Back at the end of the turn, the other items of the class publish one value first
+    if (queue->count > 0) _mark_pending(gateway, item);
+
+    return true;
+}
+
+/// @brief Repeated server callback publishing the queued values
+/// @param server Pointer to the UA_Server instance
+/// @param data The gateway
+static void _publish_callback(UA_Server* server, void* data){
+    gateway_publish((Gateway*)data, server, GATEWAY_PUBLISH_BUDGET);
+}
+
+/// @brief Compare a value with the encoding of the current value of its item node
+/// @param gateway The gateway
+/// @param item Global index of the item
+/// @param value The value about to be written into the node
+/// @return true if the value and status encode to the cached bytes, the cache holds the new encoding either way
+/// @note Only the value and the status are compared: upstream servers stamp every notification, resent or not.
+/// The server timestamp is left out of the encoding; the source timestamp and picoseconds end it, so on a match
+/// they are patched in place and the cache keeps the latest ones. Values encoding to more than
+/// GATEWAY_ENCODED_MAX bytes are encoded on the heap, empty values drop the cache.
+static bool _unchanged(Gateway* gateway, size_t item, const UA_DataValue* value){
+
+    // Encoding mask bits of the source timestamp and picoseconds, see the DataValue binary encoding
+    static const UA_Byte source_time = 0x04 | 0x10;
+
+    UA_Byte buffer[GATEWAY_ENCODED_MAX];
+    UA_ByteString encoded = {sizeof(buffer), buffer};
+    UA_ByteString large = UA_BYTESTRING_NULL;
+    UA_ByteString* cached = &gateway->encoded[item];
+    UA_DataValue key = *value;
+    size_t stamp = 0;
+    size_t cached_stamp = 0;
+    bool same;
+
+    key.hasServerTimestamp = false;
+    key.hasServerPicoseconds = false;
+
+    if (UA_Variant_isEmpty(&value->value)) {
+        UA_ByteString_clear(cached);
+        return false;
+    }
+
+    if (UA_encodeBinary(&key, &UA_TYPES[UA_TYPES_DATAVALUE], &encoded) != UA_STATUSCODE_GOOD) {
+        if (UA_ByteString_allocBuffer(&large, UA_calcSizeBinary(&key, &UA_TYPES[UA_TYPES_DATAVALUE])) != UA_STATUSCODE_GOOD ||
+            UA_encodeBinary(&key, &UA_TYPES[UA_TYPES_DATAVALUE], &large) != UA_STATUSCODE_GOOD) {
+            UA_ByteString_clear(&large);
+            UA_ByteString_clear(cached);
+            return false;
+        }
+        encoded = large;
+    }
+
+    // Length of the source timestamp and picoseconds ending each encoding
+    if (key.hasSourceTimestamp) stamp += sizeof(UA_DateTime);
+    if (key.hasSourcePicoseconds) stamp += sizeof(UA_UInt16);
+    if (cached->length > 0) {
+        if (cached->data[0] & 0x04) cached_stamp += sizeof(UA_DateTime);
+        if (cached->data[0] & 0x10) cached_stamp += sizeof(UA_UInt16);
+    }
+
+    same = cached->length > 0 && cached->length - cached_stamp == encoded.length - stamp &&
+           (cached->data[0] & ~source_time) == (encoded.data[0] & ~source_time) &&
+           memcmp(cached->data + 1, encoded.data + 1, encoded.length - stamp - 1) == 0;
+
+    if (same && cached->length == encoded.length) {
+        // Only the timestamps may differ
+        cached->data[0] = encoded.data[0];
+        memcpy(cached->data + encoded.length - stamp, encoded.data + encoded.length - stamp, stamp);
+    } else if (large.data) {
+        // The heap encoding becomes the cache
+        UA_ByteString_clear(cached);
+        *cached = large;
+        large = UA_BYTESTRING_NULL;
+    } else {
+        if (cached->length != encoded.length) {
+            UA_ByteString_clear(cached);
+            if (UA_ByteString_allocBuffer(cached, encoded.length) != UA_STATUSCODE_GOOD) return false;
+        }
+        memcpy(cached->data, encoded.data, encoded.length);
+    }
+    UA_ByteString_clear(&large);
+
+    return same;
+}
+
+/// @brief Queue a value of an item and update the blocked machines and the overflow counters
+/// @param gateway The gateway
+/// @param item Global index of the item
+/// @param value The value, moved into the queue and reset
+/// @return true if the value was queued without loss
+static bool _queue(Gateway* gateway, size_t item, UA_DataValue* value){
+
+    ItemQueue* queue = &gateway->queues[item];
+    bool was_full = item_queue_full(queue);
+    bool lossless = item_queue_push(queue, value);
+    AddressSpaceNode position;
+
+    if (!lossless || (queue->overflow == QUEUE_OVERFLOW_BLOCK && !was_full && item_queue_full(queue))) {
+        address_space_item_at(gateway->address_space, item, &position);
+
+        if (!lossless) {
+            gateway->group_overflows[gateway->first_group[position.machine] + position.group]++;
+        } else {
+            gateway->machine_blocked[position.machine]++;
+        }
+    }
+
+    _mark_pending(gateway, item);
+
+    return lossless;
+}
+
+/// @brief Data source reading a UInt64 counter of the gateway
+/// @note The node context points to the counter.
+static UA_StatusCode _read_counter(UA_Server* server, const UA_NodeId* session_id, void* session_context,
+                                   const UA_NodeId* node_id, void* node_context, UA_Boolean source_timestamp,
+                                   const UA_NumericRange* range, UA_DataValue* value){
+    (void)server; (void)session_id; (void)session_context; (void)node_id; (void)source_timestamp; (void)range;
+
+    value->hasValue = true;
+    return UA_Variant_setScalarCopy(&value->value, node_context, &UA_TYPES[UA_TYPES_UINT64]);
+}
+
+/// @brief Add an object below a parent node of the gateway namespace
+/// @param server Pointer to the UA_Server instance
+/// @param ns Index of the gateway namespace
+/// @param parent NodeId of the parent node
+/// @param id String identifier of the new object
+/// @param name Browse name of the new object
+/// @param type Type definition of the new object
+/// @return The status of UA_Server_addObjectNode
+static UA_StatusCode _add_object(UA_Server* server, UA_UInt16 ns, const UA_NodeId parent, const char* id,
+                                 const char* name, UA_NodeId type){
+
+    UA_ObjectAttributes attributes = UA_ObjectAttributes_default;
+    UA_NodeId reference = UA_NODEID_NUMERIC(0, parent.namespaceIndex == 0 ? UA_NS0ID_ORGANIZES : UA_NS0ID_HASCOMPONENT);
+
+    attributes.displayName = UA_LOCALIZEDTEXT("", (char*)name);
+
+    return UA_Server_addObjectNode(server, UA_NODEID_STRING(ns, (char*)id), parent, reference,
+                                   UA_QUALIFIEDNAME(ns, (char*)name), type, attributes, NULL, NULL);
+}
+
+/// @brief Data source reading a counter of the pool allocator
+/// @note The node context encodes the pool index times POOL_FIELD_COUNT plus the index of the counter.
+static UA_StatusCode _read_pool(UA_Server* server, const UA_NodeId* session_id, void* session_context,
+                                const UA_NodeId* node_id, void* node_context, UA_Boolean source_timestamp,
+                                const UA_NumericRange* range, UA_DataValue* value){
+    (void)server; (void)session_id; (void)session_context; (void)node_id; (void)source_timestamp; (void)range;
+
+    PoolStats stats[POOL_CLASS_COUNT + 1];
+    size_t index = (size_t)(uintptr_t)node_context;
+    PoolStats* pool = &stats[index / POOL_FIELD_COUNT];
+    UA_UInt64 counters[POOL_FIELD_COUNT];
+
+    pool_allocator_stats(stats, POOL_CLASS_COUNT + 1);
+    counters[0] = pool->allocations;
+    counters[1] = pool->frees;
+    counters[2] = pool->remote_frees;
+    counters[3] = pool->in_use;
+    counters[4] = pool->capacity;
+
+    value->hasValue = true;
+    return UA_Variant_setScalarCopy(&value->value, &counters[index % POOL_FIELD_COUNT], &UA_TYPES[UA_TYPES_UINT64]);
+}
+
+/// @brief Add the counters of the pool allocator below Gateway/Pools
+/// @param server Pointer to the UA_Server instance
+/// @param ns Index of the gateway namespace
+/// @note One object per size class, named after its block size, and one named Large for the allocations served by malloc.
+static void _add_pool_nodes(UA_Server* server, UA_UInt16 ns){
+
+    UA_VariableAttributes attributes = UA_VariableAttributes_default;
+    UA_DataSource source = {0};
+    PoolStats stats[POOL_CLASS_COUNT + 1];
+    UA_StatusCode retval;
+    char pool_id[64];
+    char pool_name[32];
+    char id[96];
+
+    if (_add_object(server, ns, UA_NODEID_STRING(ns, "Gateway"), "Gateway/Pools", "Pools",
+                    UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE)) != UA_STATUSCODE_GOOD) return;
+
+    source.read = _read_pool;
+    attributes.dataType = UA_TYPES[UA_TYPES_UINT64].typeId;
+    attributes.valueRank = UA_VALUERANK_SCALAR;
+    attributes.accessLevel = UA_ACCESSLEVELMASK_READ;
+
+    pool_allocator_stats(stats, POOL_CLASS_COUNT + 1);
+
+    for (size_t p = 0; p <= POOL_CLASS_COUNT; p++) {
+        if (p < POOL_CLASS_COUNT) snprintf(pool_name, sizeof(pool_name), "%zu", stats[p].block_size);
+        else snprintf(pool_name, sizeof(pool_name), "Large");
+
+        snprintf(pool_id, sizeof(pool_id), "Gateway/Pools/%s", pool_name);
+        if (_add_object(server, ns, UA_NODEID_STRING(ns, "Gateway/Pools"), pool_id, pool_name,
+                        UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE)) != UA_STATUSCODE_GOOD) continue;
+
+        for (size_t f = 0; f < POOL_FIELD_COUNT; f++) {
+            snprintf(id, sizeof(id), "%s/%s", pool_id, POOL_FIELDS[f]);
+            attributes.displayName = UA_LOCALIZEDTEXT("", (char*)POOL_FIELDS[f]);
+
+            retval = UA_Server_addDataSourceVariableNode(server, UA_NODEID_STRING(ns, id), UA_NODEID_STRING(ns, pool_id),
+                                                         UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                                         UA_QUALIFIEDNAME(ns, (char*)POOL_FIELDS[f]),
+                                                         UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE), attributes,
+                                                         source, (void*)(uintptr_t)(p * POOL_FIELD_COUNT + f), NULL);
+            if (retval != UA_STATUSCODE_GOOD) {
+                UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Failed to add the pool counter %s: %s",
+                               id, UA_StatusCode_name(retval));
+            }
+        }
+    }
+}
+
+/// @brief Data source reading a latency of a priority class in milliseconds, or its recent late share
+/// @note The node context points to the Double.
+static UA_StatusCode _read_latency(UA_Server* server, const UA_NodeId* session_id, void* session_context,
+                                   const UA_NodeId* node_id, void* node_context, UA_Boolean source_timestamp,
+                                   const UA_NumericRange* range, UA_DataValue* value){
+    (void)server; (void)session_id; (void)session_context; (void)node_id; (void)source_timestamp; (void)range;
+
+    value->hasValue = true;
+    return UA_Variant_setScalarCopy(&value->value, node_context, &UA_TYPES[UA_TYPES_DOUBLE]);
+}
+
+/// @brief Add the publish counters and latencies of the priority classes below Gateway/Priorities
+/// @param gateway The gateway
+/// @param server Pointer to the UA_Server instance
+/// @param ns Index of the gateway namespace
+static void _add_priority_nodes(Gateway* gateway, UA_Server* server, UA_UInt16 ns){
+
+    UA_VariableAttributes attributes = UA_VariableAttributes_default;
+    UA_DataSource counter = {0};
+    UA_DataSource latency = {0};
+    UA_StatusCode retval;
+    char class_id[64];
+    char id[96];
+
+    if (_add_object(server, ns, UA_NODEID_STRING(ns, "Gateway"), "Gateway/Priorities", "Priorities",
+                    UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE)) != UA_STATUSCODE_GOOD) return;
+
+    counter.read = _read_counter;
+    latency.read = _read_latency;
+    attributes.valueRank = UA_VALUERANK_SCALAR;
+    attributes.accessLevel = UA_ACCESSLEVELMASK_READ;
+
+    for (size_t c = 0; c < PRIORITY_CLASS_COUNT; c++) {
+        GatewayClass* class = &gateway->classes[c];
+        const char* names[] = {"Published", "LateValues", "RecentLateRatio", "RecentLatency", "MaxLatency"};
+        void* contexts[] = {&class->published, &class->late, &class->recent_late, &class->recent_latency,
+                            &class->max_latency};
+
+        snprintf(class_id, sizeof(class_id), "Gateway/Priorities/%s", PRIORITY_NAMES[c]);
+        if (_add_object(server, ns, UA_NODEID_STRING(ns, "Gateway/Priorities"), class_id, PRIORITY_NAMES[c],
+                        UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE)) != UA_STATUSCODE_GOOD) continue;
+
+        for (size_t f = 0; f < sizeof(names) / sizeof(names[0]); f++) {
+            bool is_counter = f < 2;
+
+            snprintf(id, sizeof(id), "%s/%s", class_id, names[f]);
+            attributes.displayName = UA_LOCALIZEDTEXT("", (char*)names[f]);
+            attributes.dataType = UA_TYPES[is_counter ? UA_TYPES_UINT64 : UA_TYPES_DOUBLE].typeId;
+
+            retval = UA_Server_addDataSourceVariableNode(server, UA_NODEID_STRING(ns, id), UA_NODEID_STRING(ns, class_id),
+                                                         UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                                         UA_QUALIFIEDNAME(ns, (char*)names[f]),
+                                                         UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE), attributes,
+                                                         is_counter ? counter : latency, contexts[f], NULL);
+            if (retval != UA_STATUSCODE_GOOD) {
+                UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Failed to add the priority counter %s: %s",
+                               id, UA_StatusCode_name(retval));
+            }
+        }
+    }
+}
+
+/// @brief Initialize the queues of every item of the layout
+/// @param gateway Pointer to the Gateway structure to initialize
+/// @param address_space Layout of the gateway namespaces, must outlive the gateway
+/// @note Queue size and overflow policy come from the Group of each item.
+void init_gateway(Gateway* gateway, AddressSpace* address_space){
+
+    size_t item_count;
+    size_t group_count = 0;
+    size_t index = 0;
+    GatewayClass* class;
+
+    if (!gateway || !address_space) return;
+
+    memset(gateway, 0, sizeof(Gateway));
+    gateway->address_space = address_space;
+    item_count = address_space->item_count;
+
+    gateway->queues = (ItemQueue*)calloc(item_count + 1, sizeof(ItemQueue));
+    gateway->is_pending = (bool*)calloc(item_count + 1, sizeof(bool));
+    gateway->item_class = (UA_Byte*)calloc(item_count + 1, sizeof(UA_Byte));
+    gateway->machine_blocked = (size_t*)calloc(address_space->count + 1, sizeof(size_t));
+    gateway->first_group = (size_t*)calloc(address_space->count + 1, sizeof(size_t));
+    gateway->encoded = (UA_ByteString*)calloc(item_count + 1, sizeof(UA_ByteString));
+
+    if (!gateway->queues || !gateway->is_pending || !gateway->item_class || !gateway->machine_blocked || !gateway->first_group ||
+        !gateway->encoded) {
+        fprintf(stderr, "Failed to allocate memory for Gateway\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t m = 0; m < address_space->count; m++) {
+        ArrayGroup* groups = &address_space->machines[m].config->groups;
+
+        gateway->first_group[m] = group_count;
+        group_count += groups->count;
+
+        for (size_t g = 0; g < groups->count; g++) {
+            for (size_t i = 0; i < groups->groups[g].items.count; i++, index++) {
+                init_item_queue(&gateway->queues[index], groups->groups[g].queue_size, groups->groups[g].queue_overflow);
+                gateway->item_class[index] = (UA_Byte)groups->groups[g].priority;
+                gateway->classes[groups->groups[g].priority].capacity++;
+            }
+        }
+    }
+
+    for (size_t c = 0; c < PRIORITY_CLASS_COUNT; c++) {
+        class = &gateway->classes[c];
+        class->pending = (size_t*)calloc(class->capacity + 1, sizeof(size_t));
+        if (!class->pending) {
+            fprintf(stderr, "Failed to allocate memory for Gateway\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // The entry after the last machine is the number of groups
+    gateway->first_group[address_space->count] = group_count;
+    gateway->group_overflows = (UA_UInt64*)calloc(group_count + 1, sizeof(UA_UInt64));
+    if (!gateway->group_overflows) {
+        fprintf(stderr, "Failed to allocate memory for Gateway\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/// @brief Queue a value received from upstream
+/// @param gateway The gateway
+/// @param item Global index of the item
+/// @param value The value, moved into the queue and reset
+/// @return true if the value was queued without loss, false if the queue overflowed or the item is unknown
+/// @note In a shard worker the value is written to the ring of the worker instead (see shard.h), a value the
+/// full ring drops counts as an overflow of its Group.
+bool gateway_push(Gateway* gateway, size_t item, UA_DataValue* value){
+
+    bool lossless;
+
+    if (!gateway || !value || item >= gateway->address_space->item_count) {
+        if (value) UA_DataValue_clear(value);
+        return false;
+    }
+
+    if (gateway->shard) {
+        lossless = shard_ring_write(gateway->shard, item, value);
+        if (!lossless) {
+            AddressSpaceNode position;
+
+            address_space_item_at(gateway->address_space, item, &position);
+            gateway->group_overflows[gateway->first_group[position.machine] + position.group]++;
+        }
+        UA_DataValue_clear(value);
+        return lossless;
+    }
+
+    if (gateway->aggregates) aggregates_update(gateway->aggregates, item, value, UA_DateTime_nowMonotonic());
+    if (gateway->expressions) expressions_update(gateway->expressions, item, value);
+
+    return _queue(gateway, item, value);
+}
+
+/// @brief Queue the last known value of an item, e.g. restored from a snapshot
+/// @param gateway The gateway
+/// @param item Global index of the item
+/// @param value The value, moved into the queue and reset
+/// @return true if the value was queued without loss, false if the queue overflowed or the item is unknown
+/// @note Unlike gateway_push, the value is not a new sample: aggregate windows and expressions do not see it.
+bool gateway_preload(Gateway* gateway, size_t item, UA_DataValue* value){
+
+    if (!gateway || !value || item >= gateway->address_space->item_count) {
+        if (value) UA_DataValue_clear(value);
+        return false;
+    }
+
+    return _queue(gateway, item, value);
+}
+
+/// @brief Current value of an item node
+/// @param gateway The gateway
+/// @param item Global index of the item
+/// @param value Receives a copy of the value, without server timestamp
+/// @return false if the node holds no value yet or the item is unknown
+/// @note The value is decoded from the cache of unchanged values, the node itself is not read.
+bool gateway_current(const Gateway* gateway, size_t item, UA_DataValue* value){
+
+    if (!gateway || !value || item >= gateway->address_space->item_count || gateway->encoded[item].length == 0) return false;
+
+    return UA_decodeBinary(&gateway->encoded[item], value, &UA_TYPES[UA_TYPES_DATAVALUE], NULL) == UA_STATUSCODE_GOOD;
+}
+
+/// @brief Check if the upstream subscription of a machine must pause
+/// @param gateway The gateway
+/// @param machine Index of the machine in the layout
+/// @return true while one of the machine's Block queues is full
+bool gateway_machine_blocked(const Gateway* gateway, size_t machine){
+    return gateway && machine < gateway->address_space->count && gateway->machine_blocked[machine] > 0;
+}
+
+/// @brief Read a good numeric or boolean scalar as a double
+/// @param value The value to convert
+/// @param result The converted value
+/// @return false if the value has no usable number, e.g. a bad status, a string or an array
+bool gateway_value_to_double(const UA_DataValue* value, UA_Double* result){
+
+    const UA_Variant* variant = &value->value;
+
+    if (!value->hasValue || UA_Variant_isEmpty(variant) || !UA_Variant_isScalar(variant)) return false;
+    if (value->hasStatus && UA_StatusCode_isBad(value->status)) return false;
+
+    switch (variant->type->typeKind) {
+        case UA_DATATYPEKIND_BOOLEAN: *result = *(UA_Boolean*)variant->data ? 1.0 : 0.0; break;
+        case UA_DATATYPEKIND_SBYTE:   *result = *(UA_SByte*)variant->data; break;
+        case UA_DATATYPEKIND_BYTE:    *result = *(UA_Byte*)variant->data; break;
+        case UA_DATATYPEKIND_INT16:   *result = *(UA_Int16*)variant->data; break;
+        case UA_DATATYPEKIND_UINT16:  *result = *(UA_UInt16*)variant->data; break;
+        case UA_DATATYPEKIND_INT32:   *result = *(UA_Int32*)variant->data; break;
+        case UA_DATATYPEKIND_UINT32:  *result = *(UA_UInt32*)variant->data; break;
+        case UA_DATATYPEKIND_INT64:   *result = (UA_Double)*(UA_Int64*)variant->data; break;
+        case UA_DATATYPEKIND_UINT64:  *result = (UA_Double)*(UA_UInt64*)variant->data; break;
+        case UA_DATATYPEKIND_FLOAT:   *result = *(UA_Float*)variant->data; break;
+        case UA_DATATYPEKIND_DOUBLE:  *result = *(UA_Double*)variant->data; break;
+        default: return false;
+    }
+
+    return !isnan(*result);
+}
+
+/// @brief Record a value written into an item node outside gateway_publish
+/// @param gateway The gateway
+/// @param item Global index of the item
+/// @param value The value now held by the node
+/// @note Keeps the cache of unchanged values on the node: the next queued value is compared with this one.
+void gateway_written(Gateway* gateway, size_t item, const UA_DataValue* value){
+
+    if (!gateway || !value || item >= gateway->address_space->item_count) return;
+
+    _unchanged(gateway, item, value);
+}
+
+/// @brief Publish queued values into the gateway nodes
+/// @param gateway The gateway
+/// @param server Pointer to the UA_Server instance
+/// @param budget Maximum number of values to publish
+/// @return Number of values published
+size_t gateway_publish(Gateway* gateway, UA_Server* server, size_t budget){
+
+    static const size_t weights[PRIORITY_CLASS_COUNT] = {
+        GATEWAY_WEIGHT_HIGH, GATEWAY_WEIGHT_NORMAL, GATEWAY_WEIGHT_LOW
+    };
+    size_t published = 0;
+    bool pending = true;
+
+    if (!gateway || !server) return 0;
+
+    // Weighted rounds: a class without pending items leaves its share to the others
+    while (published < budget && pending) {
+        pending = false;
+
+        for (size_t c = 0; c < PRIORITY_CLASS_COUNT && published < budget; c++) {
+            GatewayClass* class = &gateway->classes[c];
+
+            for (size_t turn = 0; turn < weights[c] && published < budget && class->count > 0; turn++) {
+                if (_publish_next(gateway, server, class)) published++;
+            }
+            if (class->count > 0) pending = true;
+        }
+    }
+
+    // The limits are checked once over the whole update set
+    if (gateway->alarms) alarms_flush(gateway->alarms);
+
+    return published;
+}
+
+/// @brief Method callback of Gateway/TranslatePaths
+/// @details Resolves a batch of "<machine>/<group>/<item>" paths from the path index of the layout,
+/// without the reference walk of TranslateBrowsePathsToNodeIds. Unknown paths give a null NodeId.
+/// The batch is bounded by maxNodesPerTranslateBrowsePathsToNodeIds like the service.
+/// @note The service itself still walks the references: open62541 has no hook to replace a service handler.
+static UA_StatusCode _translate_paths(UA_Server* server, const UA_NodeId* session_id, void* session_context,
+                                     const UA_NodeId* method_id, void* method_context, const UA_NodeId* object_id,
+                                     void* object_context, size_t input_size, const UA_Variant* input,
+                                     size_t output_size, UA_Variant* output){
+
+    Gateway* gateway = (Gateway*)method_context;
+    UA_UInt32 limit = UA_Server_getConfig(server)->maxNodesPerTranslateBrowsePathsToNodeIds;
+    const UA_String* paths;
+    UA_NodeId* node_ids;
+    size_t count;
+
+    (void)session_id;
+    (void)session_context;
+    (void)method_id;
+    (void)object_id;
+    (void)object_context;
+
+    if (input_size != 1 || output_size != 1) return UA_STATUSCODE_BADARGUMENTSMISSING;
+    if (!UA_Variant_hasArrayType(&input[0], &UA_TYPES[UA_TYPES_STRING])) return UA_STATUSCODE_BADTYPEMISMATCH;
+
+    paths = (const UA_String*)input[0].data;
+    count = input[0].arrayLength;
+    if (limit != 0 && count > limit) return UA_STATUSCODE_BADTOOMANYOPERATIONS;
+    if (count == 0) return UA_STATUSCODE_BADNOTHINGTODO;
+
+    node_ids = (UA_NodeId*)UA_Array_new(count, &UA_TYPES[UA_TYPES_NODEID]);
+    if (!node_ids) return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    for (size_t i = 0; i < count; i++) {
+        AddressSpaceNode position;
+
+        // Machines without a namespace of their own are not exposed
+        if (address_space_find_path(gateway->address_space, (const char*)paths[i].data, paths[i].length, &position) &&
+            gateway->address_space->machines[position.machine].namespace_index != 0) {
+            node_ids[i] = address_space_node_id(gateway->address_space, &position);
+        }
+    }
+
+    UA_Variant_setArray(&output[0], node_ids, count, &UA_TYPES[UA_TYPES_NODEID]);
+    return UA_STATUSCODE_GOOD;
+}
+
+/// @brief Add the Gateway/TranslatePaths method
+/// @param gateway The gateway
+/// @param server Pointer to the UA_Server instance
+/// @param ns Index of the gateway namespace
+/// @return The status of UA_Server_addMethodNode
+static UA_StatusCode _add_translate_method(Gateway* gateway, UA_Server* server, UA_UInt16 ns){
+
+    UA_MethodAttributes attributes = UA_MethodAttributes_default;
+    UA_Argument input;
+    UA_Argument output;
+
+    UA_Argument_init(&input);
+    input.name = UA_STRING("Paths");
+    input.description = UA_LOCALIZEDTEXT("", "Paths \"<machine>/<group>/<item>\", \"<machine>/<group>\" or \"<machine>\"");
+    input.dataType = UA_TYPES[UA_TYPES_STRING].typeId;
+    input.valueRank = UA_VALUERANK_ONE_DIMENSION;
+
+    UA_Argument_init(&output);
+    output.name = UA_STRING("NodeIds");
+    output.description = UA_LOCALIZEDTEXT("", "NodeId of each path, null for unknown paths");
+    output.dataType = UA_TYPES[UA_TYPES_NODEID].typeId;
+    output.valueRank = UA_VALUERANK_ONE_DIMENSION;
+
+    attributes.displayName = UA_LOCALIZEDTEXT("", "TranslatePaths");
+    attributes.executable = true;
+    attributes.userExecutable = true;
+
+    return UA_Server_addMethodNode(server, UA_NODEID_STRING(ns, "Gateway/TranslatePaths"), UA_NODEID_STRING(ns, "Gateway"),
+                                   UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT), UA_QUALIFIEDNAME(ns, "TranslatePaths"),
+                                   attributes, _translate_paths, 1, &input, 1, &output, gateway, NULL);
+}
+
+/// @brief Add the diagnostic nodes and the publish callback to the server
+/// @param gateway The gateway
+/// @param server Pointer to the UA_Server instance, the machine namespaces must be registered
+/// @return UA_STATUSCODE_GOOD on success
+UA_StatusCode gateway_start(Gateway* gateway, UA_Server* server){
+
+    UA_VariableAttributes attributes = UA_VariableAttributes_default;
+    UA_DataSource source = {0};
+    UA_StatusCode retval;
+    UA_UInt16 ns;
+    char id[512];
+    char machine_id[512];
+
+    if (!gateway || !server) return UA_STATUSCODE_BADINTERNALERROR;
+
+    ns = gateway->namespace_index = UA_Server_addNamespace(server, GATEWAY_NAMESPACE);
+
+    retval = _add_object(server, ns, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), "Gateway", "Gateway",
+                         UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE));
+    retval |= _add_object(server, ns, UA_NODEID_STRING(ns, "Gateway"), "Gateway/QueueOverflows", "QueueOverflows",
+                          UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE));
+    if (retval != UA_STATUSCODE_GOOD) return retval;
+
+    source.read = _read_counter;
+    attributes.dataType = UA_TYPES[UA_TYPES_UINT64].typeId;
+    attributes.valueRank = UA_VALUERANK_SCALAR;
+    attributes.accessLevel = UA_ACCESSLEVELMASK_READ;
+
+    attributes.displayName = UA_LOCALIZEDTEXT("", "UnchangedValues");
+    retval = UA_Server_addDataSourceVariableNode(server, UA_NODEID_STRING(ns, "Gateway/UnchangedValues"),
+                                                 UA_NODEID_STRING(ns, "Gateway"), UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                                 UA_QUALIFIEDNAME(ns, "UnchangedValues"),
+                                                 UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE), attributes,
+                                                 source, &gateway->unchanged, NULL);
+    if (retval != UA_STATUSCODE_GOOD) return retval;
+
+    retval = _add_translate_method(gateway, server, ns);
+    if (retval != UA_STATUSCODE_GOOD) return retval;
+
+    for (size_t m = 0; m < gateway->address_space->count; m++) {
+        MachineConfig* config = gateway->address_space->machines[m].config;
+        const char* machine_name = config->name ? config->name : "";
+
+        snprintf(machine_id, sizeof(machine_id), "Gateway/QueueOverflows/%s", machine_name);
+        retval = _add_object(server, ns, UA_NODEID_STRING(ns, "Gateway/QueueOverflows"), machine_id, machine_name,
+                             UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE));
+        if (retval != UA_STATUSCODE_GOOD) continue;
+
+        for (size_t g = 0; g < config->groups.count; g++) {
+            const char* group_name = config->groups.groups[g].name ? config->groups.groups[g].name : "";
+
+            snprintf(id, sizeof(id), "%s/%s", machine_id, group_name);
+            attributes.displayName = UA_LOCALIZEDTEXT("", (char*)group_name);
+
+            retval = UA_Server_addDataSourceVariableNode(server, UA_NODEID_STRING(ns, id), UA_NODEID_STRING(ns, machine_id),
+                                                         UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                                         UA_QUALIFIEDNAME(ns, (char*)group_name),
+                                                         UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE), attributes,
+                                                         source, &gateway->group_overflows[gateway->first_group[m] + g], NULL);
+            if (retval != UA_STATUSCODE_GOOD) {
+                UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Failed to add the overflow counter of %s: %s",
+                               id, UA_StatusCode_name(retval));
+            }
+        }
+    }
+
+    _add_priority_nodes(gateway, server, ns);
+    if (pool_allocator_installed()) _add_pool_nodes(server, ns);
+
+    return UA_Server_addRepeatedCallback(server, _publish_callback, gateway, GATEWAY_PUBLISH_INTERVAL,
+                                         &gateway->callback_id);
+}
+
+/// @brief Free the memory allocated for the gateway
+/// @param gateway Pointer to the Gateway structure to free
+/// @note The server must be stopped first, the publish callback uses the gateway.
+void free_gateway(Gateway* gateway){
+
+    UA_UInt64 overflows = 0;
+
+    if (!gateway || !gateway->address_space) return;
+
+    if (gateway->queues != NULL) {
+        for (size_t i = 0; i < gateway->address_space->item_count; i++) {
+            overflows += gateway->queues[i].overflows;
+            free_item_queue(&gateway->queues[i]);
+        }
+    }
+
+    if (gateway->encoded != NULL) {
+        for (size_t i = 0; i < gateway->address_space->item_count; i++) {
+            UA_ByteString_clear(&gateway->encoded[i]);
+        }
+    }
+
+    if (overflows > 0) {
+        UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "%llu values were lost to queue overflows",
+                    (unsigned long long)overflows);
+    }
+
+    free(gateway->queues);
+    for (size_t c = 0; c < PRIORITY_CLASS_COUNT; c++) {
+        free(gateway->classes[c].pending);
+    }
+    free(gateway->is_pending);
+    free(gateway->item_class);
+    free(gateway->machine_blocked);
+    free(gateway->first_group);
+    free(gateway->group_overflows);
+    free(gateway->encoded);
+    memset(gateway, 0, sizeof(Gateway));
+}
@@ -0,0 +1,273 @@
+#include "../include/gateway_nodestore.h"
+#include "../include/on_demand.h"
+
+#include <open62541/plugin/log_stdout.h>
+
+typedef struct {
+    UA_Nodestore fallback;
+    AddressSpace* address_space;
+    size_t materialized;
+} GatewayNodestore;
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static bool _materialize(GatewayNodestore* store, const UA_NodeId* node_id);
+
+static void _clear(void* context);
+static UA_Node* _new_node(void* context, UA_NodeClass node_class);
+static void _delete_node(void* context, UA_Node* node);
+static const UA_Node* _get_node(void* context, const UA_NodeId* node_id, UA_UInt32 attribute_mask,
+                                UA_ReferenceTypeSet references, UA_BrowseDirection direction);
+static const UA_Node* _get_node_from_ptr(void* context, UA_NodePointer pointer, UA_UInt32 attribute_mask,
+                                         UA_ReferenceTypeSet references, UA_BrowseDirection direction);
+static void _release_node(void* context, const UA_Node* node);
+static UA_StatusCode _get_node_copy(void* context, const UA_NodeId* node_id, UA_Node** out_node);
+static UA_StatusCode _insert_node(void* context, UA_Node* node, UA_NodeId* added_node_id);
+static UA_StatusCode _replace_node(void* context, UA_Node* node);
+static UA_StatusCode _remove_node(void* context, const UA_NodeId* node_id);
+static const UA_NodeId* _get_reference_type_id(void* context, UA_Byte reference_type_index);
+static void _iterate(void* context, UA_NodestoreVisitor visitor, void* visitor_context);
+
+
+/// @brief Create the node of a machine, group or item with all its references
+/// @param nodestore Nodestore allocating the node
+/// @param address_space Layout of the gateway namespaces
+/// @param position Position of the node in the layout
+/// @return The new node, or NULL on failure
+/// @note Item values are initialized with the status BadWaitingForInitialData.
+UA_Node* gateway_nodestore_build_node(const UA_Nodestore* nodestore, const AddressSpace* address_space,
+                                      const AddressSpaceNode* position){
+
+    const AddressSpaceMachine* machine = &address_space->machines[position->machine];
+    UA_QualifiedName browse_name = address_space_browse_name(address_space, position);
+    UA_NodeId node_id = address_space_node_id(address_space, position);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    AddressSpaceNode child = *position;
+    AddressSpaceNode parent = *position;
+    UA_Node* node;
+
+    if (position->kind == ADDRESS_SPACE_NODE_ITEM) {
+        const Item* item = address_space_item(address_space, position);
+        UA_VariableAttributes attributes = UA_VariableAttributes_default;
+
+        node = nodestore->newNode(nodestore->context, UA_NODECLASS_VARIABLE);
+        if (!node) return NULL;
+
+        attributes.displayName.text = browse_name.name;
+        attributes.dataType = address_space_data_type(item->type)->typeId;
+        attributes.valueRank = UA_VALUERANK_SCALAR;
+        attributes.accessLevel = UA_ACCESSLEVELMASK_READ;
+        retval |= UA_Node_setAttributes(node, &attributes, &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES]);
+
+        // No upstream value has been received yet
+        node->variableNode.value.data.value.hasStatus = true;
+        node->variableNode.value.data.value.status = UA_STATUSCODE_BADWAITINGFORINITIALDATA;
+
+        // Reads of an ondemand item refresh it on its machine once its Ttl has passed
+        if (item->on_demand) {
+            node->variableNode.value.data.callback.onRead = on_demand_on_read;
+            node->head.context = (void*)address_space;
+        }
+
+        parent.kind = ADDRESS_SPACE_NODE_GROUP;
+        retval |= address_space_add_reference(node, UA_REFERENCETYPEINDEX_HASCOMPONENT, false,
+                                              address_space_node_id(address_space, &parent),
+                                              address_space_browse_name(address_space, &parent));
+        retval |= address_space_add_reference(node, UA_REFERENCETYPEINDEX_HASTYPEDEFINITION, true,
+                                              UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                              UA_QUALIFIEDNAME(0, "BaseDataVariableType"));
+    } else {
+        UA_ObjectAttributes attributes = UA_ObjectAttributes_default;
+
+        node = nodestore->newNode(nodestore->context, UA_NODECLASS_OBJECT);
+        if (!node) return NULL;
+
+        attributes.displayName.text = browse_name.name;
+        retval |= UA_Node_setAttributes(node, &attributes, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+        retval |= address_space_add_reference(node, UA_REFERENCETYPEINDEX_HASTYPEDEFINITION, true,
+                                              UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                              UA_QUALIFIEDNAME(0, "BaseObjectType"));
+
+        if (position->kind == ADDRESS_SPACE_NODE_MACHINE) {
+            retval |= address_space_add_reference(node, UA_REFERENCETYPEINDEX_ORGANIZES, false,
+                                                  UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                                  UA_QUALIFIEDNAME(0, "Objects"));
+
+            child.kind = ADDRESS_SPACE_NODE_GROUP;
+            for (child.group = 0; child.group < machine->config->groups.count; child.group++) {
+                retval |= address_space_add_reference(node, UA_REFERENCETYPEINDEX_HASCOMPONENT, true,
+                                                      address_space_node_id(address_space, &child),
+                                                      address_space_browse_name(address_space, &child));
+            }
+        } else {
+            parent.kind = ADDRESS_SPACE_NODE_MACHINE;
+            retval |= address_space_add_reference(node, UA_REFERENCETYPEINDEX_HASCOMPONENT, false,
+                                                  address_space_node_id(address_space, &parent),
+                                                  address_space_browse_name(address_space, &parent));
+
+            child.kind = ADDRESS_SPACE_NODE_ITEM;
+            for (child.item = machine->group_first_item[position->group];
+                 child.item < machine->group_first_item[position->group + 1]; child.item++) {
+                retval |= address_space_add_reference(node, UA_REFERENCETYPEINDEX_HASCOMPONENT, true,
+                                                      address_space_node_id(address_space, &child),
+                                                      address_space_browse_name(address_space, &child));
+            }
+        }
+    }
+
+    retval |= UA_NodeId_copy(&node_id, &node->head.nodeId);
+    retval |= UA_QualifiedName_copy(&browse_name, &node->head.browseName);
+
+    if (retval != UA_STATUSCODE_GOOD) {
+        nodestore->deleteNode(nodestore->context, node);
+        return NULL;
+    }
+
+    return node;
+}
+
+/// @brief Create a gateway node in the fallback nodestore if the NodeId belongs to the layout
+/// @param store The gateway nodestore
+/// @param node_id The NodeId that was not found in the fallback nodestore
+/// @return true if the node was created, false if the NodeId is not a gateway node
+static bool _materialize(GatewayNodestore* store, const UA_NodeId* node_id){
+
+    AddressSpaceNode position;
+    UA_Node* node;
+
+    if (!address_space_resolve(store->address_space, node_id, &position)) return false;
+
+    node = gateway_nodestore_build_node(&store->fallback, store->address_space, &position);
+    if (!node) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                     "Failed to create gateway node ns=%u;i=%u", node_id->namespaceIndex, node_id->identifier.numeric);
+        return false;
+    }
+
+    // The fallback nodestore takes ownership of the node, even on failure
+    if (store->fallback.insertNode(store->fallback.context, node, NULL) != UA_STATUSCODE_GOOD) return false;
+
+    store->materialized++;
+    return true;
+}
+
+/// @brief Free the gateway nodestore and its fallback nodestore
+/// @param context The gateway nodestore
+static void _clear(void* context){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+
+    UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_SERVER,
+                "%zu of %zu gateway items were materialized", store->materialized, store->address_space->item_count);
+
+    store->fallback.clear(store->fallback.context);
+    free(store);
+}
+
+static UA_Node* _new_node(void* context, UA_NodeClass node_class){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+    return store->fallback.newNode(store->fallback.context, node_class);
+}
+
+static void _delete_node(void* context, UA_Node* node){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+    store->fallback.deleteNode(store->fallback.context, node);
+}
+
+static const UA_Node* _get_node(void* context, const UA_NodeId* node_id, UA_UInt32 attribute_mask,
+                                UA_ReferenceTypeSet references, UA_BrowseDirection direction){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+    const UA_Node* node = store->fallback.getNode(store->fallback.context, node_id, attribute_mask, references, direction);
+
+    if (node || !_materialize(store, node_id)) return node;
+
+    return store->fallback.getNode(store->fallback.context, node_id, attribute_mask, references, direction);
+}
+
+static const UA_Node* _get_node_from_ptr(void* context, UA_NodePointer pointer, UA_UInt32 attribute_mask,
+                                         UA_ReferenceTypeSet references, UA_BrowseDirection direction){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+    const UA_Node* node = store->fallback.getNodeFromPtr(store->fallback.context, pointer, attribute_mask, references, direction);
+    UA_NodeId node_id;
+
+    if (node || !UA_NodePointer_isLocal(pointer)) return node;
+
+    node_id = UA_NodePointer_toNodeId(pointer);
+    if (!_materialize(store, &node_id)) return NULL;
+
+    return store->fallback.getNodeFromPtr(store->fallback.context, pointer, attribute_mask, references, direction);
+}
+
+static void _release_node(void* context, const UA_Node* node){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+    store->fallback.releaseNode(store->fallback.context, node);
+}
+
+static UA_StatusCode _get_node_copy(void* context, const UA_NodeId* node_id, UA_Node** out_node){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+    UA_StatusCode retval = store->fallback.getNodeCopy(store->fallback.context, node_id, out_node);
+
+    if (retval != UA_STATUSCODE_BADNODEIDUNKNOWN || !_materialize(store, node_id)) return retval;
+
+    return store->fallback.getNodeCopy(store->fallback.context, node_id, out_node);
+}
+
+static UA_StatusCode _insert_node(void* context, UA_Node* node, UA_NodeId* added_node_id){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+    return store->fallback.insertNode(store->fallback.context, node, added_node_id);
+}
+
+static UA_StatusCode _replace_node(void* context, UA_Node* node){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+    return store->fallback.replaceNode(store->fallback.context, node);
+}
+
+static UA_StatusCode _remove_node(void* context, const UA_NodeId* node_id){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+    return store->fallback.removeNode(store->fallback.context, node_id);
+}
+
+static const UA_NodeId* _get_reference_type_id(void* context, UA_Byte reference_type_index){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+    return store->fallback.getReferenceTypeId(store->fallback.context, reference_type_index);
+}
+
+/// @brief Visit every node of the nodestore
+/// @note Only materialized gateway nodes are visited, iterating must not create the whole address space.
+static void _iterate(void* context, UA_NodestoreVisitor visitor, void* visitor_context){
+    GatewayNodestore* store = (GatewayNodestore*)context;
+    store->fallback.iterate(store->fallback.context, visitor, visitor_context);
+}
+
+/// @brief Install the lazy gateway nodestore in a server configuration
+/// @param config Server configuration holding the default nodestore, which becomes the fallback
+/// @param address_space Layout of the gateway namespaces, must outlive the server
+/// @return UA_STATUSCODE_GOOD on success, UA_STATUSCODE_BADOUTOFMEMORY otherwise
+/// @note Must be called before `UA_Server_newWithConfig`. The nodestore is freed with the server.
+UA_StatusCode gateway_nodestore_install(UA_ServerConfig* config, AddressSpace* address_space){
+
+    GatewayNodestore* store;
+
+    if (!config || !address_space) return UA_STATUSCODE_BADINTERNALERROR;
+
+    store = (GatewayNodestore*)calloc(1, sizeof(GatewayNodestore));
+    if (!store) return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    store->fallback = config->nodestore;
+    store->address_space = address_space;
+
+    config->nodestore.context = store;
+    config->nodestore.clear = _clear;
+    config->nodestore.newNode = _new_node;
+    config->nodestore.deleteNode = _delete_node;
+    config->nodestore.getNode = _get_node;
+    config->nodestore.getNodeFromPtr = _get_node_from_ptr;
+    config->nodestore.releaseNode = _release_node;
+    config->nodestore.getNodeCopy = _get_node_copy;
+    config->nodestore.insertNode = _insert_node;
+    config->nodestore.replaceNode = _replace_node;
+    config->nodestore.removeNode = _remove_node;
+    config->nodestore.getReferenceTypeId = _get_reference_type_id;
+    config->nodestore.iterate = _iterate;
+
+    return UA_STATUSCODE_GOOD;
+}
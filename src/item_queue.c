@@ -0,0 +1,116 @@
+#include "../include/item_queue.h"
+
+
+/// @brief Initialize an empty queue
+/// @param queue Pointer to the ItemQueue structure to initialize
+/// @param capacity Maximum number of queued values, at least 1
+/// @param overflow Policy applied when a value is pushed on a full queue
+/// @note The buffer is only allocated on the first push, items that never change cost no value memory.
+void init_item_queue(ItemQueue* queue, size_t capacity, QueueOverflow overflow){
+
+    if (!queue) return;
+
+    memset(queue, 0, sizeof(ItemQueue));
+    queue->capacity = capacity > 0 ? (UA_UInt32)capacity : 1;
+    queue->overflow = overflow;
+}
+
+/// @brief Append a value to the queue
+/// @param queue The queue
+/// @param value The value to append, moved into the queue and reset
+/// @return true if the value was queued without loss, false if the queue overflowed
+/// @note On overflow, DropOldest drops the head, KeepLatest empties the queue and Block replaces the newest value.
+/// Block queues are not expected to overflow as long as the producer stops while `item_queue_full` is true.
+bool item_queue_push(ItemQueue* queue, UA_DataValue* value){
+
+    bool lossless = true;
+
+    if (!queue->values) {
+        queue->values = (UA_DataValue*)calloc(queue->capacity, sizeof(UA_DataValue));
+        queue->received = (UA_DateTime*)calloc(queue->capacity, sizeof(UA_DateTime));
+        if (!queue->values || !queue->received) {
+            fprintf(stderr, "Failed to allocate memory for ItemQueue\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (queue->count == queue->capacity) {
+        queue->overflows++;
+        lossless = false;
+
+        switch (queue->overflow) {
+            case QUEUE_OVERFLOW_DROP_OLDEST:
+                UA_DataValue_clear(&queue->values[queue->head]);
+                queue->head = (queue->head + 1) % queue->capacity;
+                queue->count--;
+                break;
+            case QUEUE_OVERFLOW_KEEP_LATEST:
+                for (UA_UInt32 i = 0; i < queue->count; i++) {
+                    UA_DataValue_clear(&queue->values[(queue->head + i) % queue->capacity]);
+                }
+                queue->head = 0;
+                queue->count = 0;
+                break;
+            case QUEUE_OVERFLOW_BLOCK:
+                queue->count--;
+                UA_DataValue_clear(&queue->values[(queue->head + queue->count) % queue->capacity]);
+                break;
+        }
+    }
+
+    queue->values[(queue->head + queue->count) % queue->capacity] = *value;
+    queue->received[(queue->head + queue->count) % queue->capacity] = UA_DateTime_nowMonotonic();
+    queue->count++;
+    UA_DataValue_init(value);
+
+    return lossless;
+}
+
+/// @brief Remove the oldest value of the queue
+/// @param queue The queue
+/// @param value Output receiving the value, owned by the caller
+/// @return true if a value was returned, false if the queue is empty
+bool item_queue_pop(ItemQueue* queue, UA_DataValue* value){
+
+    if (queue->count == 0) return false;
+
+    *value = queue->values[queue->head];
+    UA_DataValue_init(&queue->values[queue->head]);
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+
+    return true;
+}
+
+/// @brief Reception time of the oldest value of the queue
+/// @param queue The queue
+/// @return The monotonic time at which the value was pushed, 0 if the queue is empty
+UA_DateTime item_queue_oldest(const ItemQueue* queue){
+    return queue->count > 0 ? queue->received[queue->head] : 0;
+}
+
+/// @brief Check if the queue is full
+/// @param queue The queue
+/// @return true if the next push overflows
+bool item_queue_full(const ItemQueue* queue){
+    return queue->count == queue->capacity;
+}
+
+/// @brief Free the queued values and the buffer
+/// @param queue Pointer to the ItemQueue structure to free
+/// @note The queue keeps its capacity and policy and can be reused.
+void free_item_queue(ItemQueue* queue){
+
+    if (!queue || !queue->values) return;
+
+    for (UA_UInt32 i = 0; i < queue->count; i++) {
+        UA_DataValue_clear(&queue->values[(queue->head + i) % queue->capacity]);
+    }
+
+    free(queue->values);
+    free(queue->received);
+    queue->values = NULL;
+    queue->received = NULL;
+    queue->head = 0;
+    queue->count = 0;
+}
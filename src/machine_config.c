@@ -1,6 +1,10 @@
 #include "../include/machine_config.h"
+#include "../include/trace.h"
+#include <ctype.h>
 #include <dirent.h>
 #include <limits.h>
+#include <math.h>
+#include <strings.h>
 
 
 
@@ -9,11 +13,37 @@
 static void _init_array_item(ArrayItem* array_item, size_t initial_capacity);
 static void _init_array_group(ArrayGroup* array_group, size_t initial_capacity);
 static void _check_size_machine_config(ArrayMachineConfig* array_machine_config);
+static bool _get_field(struct json_object* object, const char* key, struct json_object** value);
 
+static void _parse_scaling(struct json_object* item_json, Item* item);
+static void _parse_mode(struct json_object* item_json, Item* item);
+static void _parse_limits(struct json_object* limits_json, ItemLimits* limits, const char* name);
 static void _parse_items(struct json_object* array_item_json, ArrayItem* array_item);
+static void _parse_queue(struct json_object* queue_json, Group* group);
+static size_t _parse_window(struct json_object* window_json, char* label, size_t label_size);
+static void _parse_aggregates(struct json_object* aggregates_json, Group* group);
+static void _parse_priority(struct json_object* group_json, Group* group);
 static void _parse_groups(struct json_object* array_group_json, ArrayGroup* array_group);
 static void _parse_machine_config(struct json_object* machine_config_json, ArrayMachineConfig* array_machine_config);
 
+/// @brief Look up a field of a JSON object by its camelCase or PascalCase name
+/// @param object The JSON object to search
+/// @param key The field name in camelCase (e.g. "nodeId")
+/// @param value Output pointer receiving the field value
+/// @return true if the field exists, false otherwise
+/// @note Hand written machine files use PascalCase keys ("Name", "NodeId"), both spellings are accepted.
+static bool _get_field(struct json_object* object, const char* key, struct json_object** value){
+
+    char pascal_key[64];
+
+    if (json_object_object_get_ex(object, key, value)) return true;
+
+    snprintf(pascal_key, sizeof(pascal_key), "%s", key);
+    pascal_key[0] = (char)toupper((unsigned char)pascal_key[0]);
+
+    return json_object_object_get_ex(object, pascal_key, value);
+}
+
 /// @brief Check and resize the array of machine configurations if necessary
 /// @param array_machine_config Pointer to the ArrayMachineConfig structure to check
 /// @note This function will double the capacity of the array if the current count reaches the capacity.
@@ -28,6 +58,8 @@ static void _check_size_machine_config(ArrayMachineConfig* array_machine_config)
             fprintf(stderr, "Failed to reallocate memory for MachineConfig\n");
             exit(EXIT_FAILURE);
         }
+        memset(array_machine_config->configs + array_machine_config->capacity, 0,
+               sizeof(MachineConfig) * (new_capacity - array_machine_config->capacity));
         array_machine_config->capacity = new_capacity;
     }
 }
@@ -54,6 +86,7 @@ static void _init_array_group(ArrayGroup* array_group, size_t initial_capacity)
         free(array_group);
         exit(EXIT_FAILURE);
     }
+    memset(array_group->groups, 0, sizeof(Group) * initial_capacity);
 }
 
 /// @brief Initialize an array of items
@@ -78,6 +111,7 @@ static void _init_array_item(ArrayItem* array_item, size_t initial_capacity){
         free(array_item);
         exit(EXIT_FAILURE);
     }
+    memset(array_item->items, 0, sizeof(Item) * initial_capacity);
 }
 
 /// @brief Free the memory allocated for an array of items
@@ -98,6 +132,9 @@ void free_array_item(ArrayItem* array){
             if (array->items[i].type != NULL){
                 free(array->items[i].type);
             }
+            if (array->items[i].expression != NULL){
+                free(array->items[i].expression);
+            }
         }
 
         free(array->items);
@@ -139,6 +176,12 @@ void free_array_machine_config(ArrayMachineConfig* array){
     
     if(!array) return;
 
+    // Compiled configs live in static tables
+    if(array->compiled){
+        memset(array, 0, sizeof(ArrayMachineConfig));
+        return;
+    }
+
     if(array->configs != NULL){
         for (size_t i = 0; i < array->count; i++) {
 
@@ -191,21 +234,331 @@ static void _parse_items(struct json_object* array_item_json, ArrayItem* array_i
     for(int i = 0; i < array_length; i++){
         item_obj = json_object_array_get_idx(array_item_json, i);
         
-        if (json_object_object_get_ex(item_obj, "name", &temp)){
+        if (_get_field(item_obj, "name", &temp)){
             array_item->items[i].name = strdup(json_object_get_string(temp));
         }
-        if (json_object_object_get_ex(item_obj, "nodeId", &temp)){
+        if (_get_field(item_obj, "nodeId", &temp)){
             array_item->items[i].nodeId = strdup(json_object_get_string(temp));
         }
-        if (json_object_object_get_ex(item_obj, "type", &temp)){
+        if (_get_field(item_obj, "type", &temp)){
             array_item->items[i].type = strdup(json_object_get_string(temp));
         }
+        if (_get_field(item_obj, "expression", &temp)){
+            array_item->items[i].expression = strdup(json_object_get_string(temp));
+            array_item->items[i].source = ITEM_SOURCE_EXPRESSION;
+            if (!array_item->items[i].type) array_item->items[i].type = strdup("System.Double");
+        }
+        _parse_scaling(item_obj, &array_item->items[i]);
+        _parse_mode(item_obj, &array_item->items[i]);
+        if (_get_field(item_obj, "limits", &temp)){
+            _parse_limits(temp, &array_item->items[i].limits, array_item->items[i].name);
+        }
 
         array_item->count++;
     }
 }
 
 
+/// @brief Parse the engineering-unit conversion of an item from JSON
+/// @param item_json The JSON object of the item, e.g. {"Type": "System.Int16", "Scale": 0.1, "Offset": -40, "Max": 150}
+/// @param item The item receiving the settings
+/// @note An item with a Scale, an Offset or a TargetType is scaled: its type becomes the TargetType,
+/// System.Double by default, and the Type of the file is the raw type read on the machine.
+static void _parse_scaling(struct json_object* item_json, Item* item){
+
+    struct json_object* temp;
+
+    item->scale = 1.0;
+    item->offset = 0.0;
+    item->min = -INFINITY;
+    item->max = INFINITY;
+
+    if (item->source != ITEM_SOURCE_UPSTREAM) return;
+
+    if (_get_field(item_json, "scale", &temp)){
+        item->scale = json_object_get_double(temp);
+        item->scaled = true;
+    }
+    if (_get_field(item_json, "offset", &temp)){
+        item->offset = json_object_get_double(temp);
+        item->scaled = true;
+    }
+    if (_get_field(item_json, "min", &temp)){
+        item->min = json_object_get_double(temp);
+    }
+    if (_get_field(item_json, "max", &temp)){
+        item->max = json_object_get_double(temp);
+    }
+    if (_get_field(item_json, "targetType", &temp)){
+        free(item->type);
+        item->type = strdup(json_object_get_string(temp));
+        item->scaled = true;
+    } else if (item->scaled) {
+        free(item->type);
+        item->type = strdup("System.Double");
+    }
+
+    if (item->scaled && !(item->min <= item->max)) {
+        fprintf(stderr, "Invalid range [%g, %g] for item %s, the values are not clamped\n",
+                item->min, item->max, item->name ? item->name : "");
+        item->min = -INFINITY;
+        item->max = INFINITY;
+    }
+}
+
+/// @brief Parse the acquisition mode of an item from JSON
+/// @param item_json The JSON object of the item, e.g. {"Mode": "OnDemand", "Ttl": "30s"}
+/// @param item The item receiving the settings
+/// @note Modes are Subscribe (default) and OnDemand, in any case. The Ttl is a duration like the aggregate
+/// windows, a number is in seconds. Only upstream items can be read on demand.
+static void _parse_mode(struct json_object* item_json, Item* item){
+
+    struct json_object* temp;
+    char label[32];
+    const char* mode;
+
+    item->ttl = DEFAULT_ON_DEMAND_TTL;
+
+    if (!_get_field(item_json, "mode", &temp)) return;
+
+    mode = json_object_get_string(temp);
+    if (strcasecmp(mode, "ondemand") == 0) {
+        item->on_demand = true;
+    } else if (strcasecmp(mode, "subscribe") != 0) {
+        fprintf(stderr, "Unknown mode %s for item %s, the item is subscribed\n", mode, item->name ? item->name : "");
+    }
+
+    if (item->on_demand && item->source != ITEM_SOURCE_UPSTREAM) {
+        fprintf(stderr, "Item %s is computed by the gateway, it cannot be read on demand\n", item->name ? item->name : "");
+        item->on_demand = false;
+    }
+
+    if (item->on_demand && _get_field(item_json, "ttl", &temp)) {
+        size_t ttl = _parse_window(temp, label, sizeof(label));
+        if (ttl > 0) {
+            item->ttl = ttl;
+        } else {
+            fprintf(stderr, "Invalid Ttl for item %s, %d ms is used\n", item->name ? item->name : "",
+                    DEFAULT_ON_DEMAND_TTL);
+        }
+    }
+}
+
+/// @brief Parse alarm limits from JSON
+/// @param limits_json The JSON object of the limits, e.g. {"HighHigh": 95, "High": 80, "Low": 10, "Hysteresis": 2}
+/// @param limits The limits receiving the settings
+/// @param name Name of the item or Group, for the warnings
+/// @note Limits that are not set are NAN. Limits out of order (LowLow <= Low < High <= HighHigh) are
+/// reported but kept; a negative Hysteresis is reset to 0.
+static void _parse_limits(struct json_object* limits_json, ItemLimits* limits, const char* name){
+
+    static const char* const keys[] = {"highHigh", "high", "low", "lowLow"};
+    double* values[] = {&limits->high_high, &limits->high, &limits->low, &limits->low_low};
+    struct json_object* temp;
+    double top = INFINITY;
+
+    memset(limits, 0, sizeof(ItemLimits));
+
+    for (size_t k = 0; k < 4; k++) {
+        *values[k] = NAN;
+        if (_get_field(limits_json, keys[k], &temp)) {
+            *values[k] = json_object_get_double(temp);
+            limits->enabled = true;
+        }
+    }
+    if (_get_field(limits_json, "hysteresis", &temp)) {
+        limits->hysteresis = json_object_get_double(temp);
+    }
+
+    if (!limits->enabled) {
+        fprintf(stderr, "No limit set for %s, it raises no alarm\n", name ? name : "");
+        return;
+    }
+
+    // From HighHigh down to LowLow, every limit set is at most the one above it
+    for (size_t k = 0; k < 4; k++) {
+        if (isnan(*values[k])) continue;
+        if (*values[k] > top || (k == 2 && *values[k] == top)) {
+            fprintf(stderr, "Limits of %s are not in order LowLow <= Low < High <= HighHigh\n", name ? name : "");
+            break;
+        }
+        top = *values[k];
+    }
+
+    if (!(limits->hysteresis >= 0.0)) {
+        fprintf(stderr, "Invalid Hysteresis for %s, 0 is used\n", name ? name : "");
+        limits->hysteresis = 0.0;
+    }
+}
+
+/// @brief Parse the queue settings of a group from JSON
+/// @param queue_json The JSON object containing the queue settings, e.g. {"Size": 16, "Overflow": "DropOldest"}
+/// @param group The group receiving the settings
+/// @note Missing or invalid settings keep their default value.
+static void _parse_queue(struct json_object* queue_json, Group* group){
+
+    struct json_object* temp;
+    const char* overflow;
+
+    if (!queue_json) return;
+
+    if (_get_field(queue_json, "size", &temp) && json_object_get_int(temp) > 0){
+        group->queue_size = (size_t)json_object_get_int(temp);
+    }
+
+    if (_get_field(queue_json, "overflow", &temp)){
+        overflow = json_object_get_string(temp);
+
+        if (strcasecmp(overflow, "DropOldest") == 0) {
+            group->queue_overflow = QUEUE_OVERFLOW_DROP_OLDEST;
+        } else if (strcasecmp(overflow, "KeepLatest") == 0) {
+            group->queue_overflow = QUEUE_OVERFLOW_KEEP_LATEST;
+        } else if (strcasecmp(overflow, "Block") == 0) {
+            group->queue_overflow = QUEUE_OVERFLOW_BLOCK;
+        } else {
+            fprintf(stderr, "Unknown queue overflow policy %s for group %s\n", overflow, group->name ? group->name : "");
+        }
+    }
+}
+
+/// @brief Parse the duration of an aggregate window
+/// @param window_json A number of seconds or a string with a unit, e.g. "500ms", "1s", "15min", "1h"
+/// @param label Output receiving the window label used in the aggregate item names
+/// @param label_size Size of the label buffer
+/// @return Duration in milliseconds, 0 if the duration is invalid
+static size_t _parse_window(struct json_object* window_json, char* label, size_t label_size){
+
+    const char* text = json_object_get_string(window_json);
+    char* unit = NULL;
+    double value;
+
+    value = strtod(text, &unit);
+    if (value <= 0) return 0;
+
+    if (json_object_is_type(window_json, json_type_int) || json_object_is_type(window_json, json_type_double)) {
+        snprintf(label, label_size, "%gs", value);
+        return (size_t)(value * 1000);
+    }
+
+    snprintf(label, label_size, "%s", text);
+
+    if (strcmp(unit, "ms") == 0) return (size_t)value;
+    if (strcmp(unit, "s") == 0) return (size_t)(value * 1000);
+    if (strcmp(unit, "min") == 0) return (size_t)(value * 60000);
+    if (strcmp(unit, "h") == 0) return (size_t)(value * 3600000);
+
+    return 0;
+}
+
+/// @brief Parse the aggregate windows of a group and add its aggregate items
+/// @param aggregates_json The JSON array of windows, e.g. ["1s", "1min", "15min"]
+/// @param group The group, its items must be parsed
+/// @note Each numeric item gets one Double item per window and statistic, named "<item>.<window>.<statistic>",
+/// appended after the configured items (Count is a UInt32).
+static void _parse_aggregates(struct json_object* aggregates_json, Group* group){
+
+    static const char* stat_names[AGGREGATE_STAT_COUNT] = {"Min", "Max", "Mean", "Count", "StdDev"};
+    char labels[MAX_AGGREGATE_WINDOWS][32];
+    char name[256];
+    size_t source_count = group->items.count;
+    size_t aggregated = 0;
+    size_t length;
+    Item* item;
+
+    if (!aggregates_json || !json_object_is_type(aggregates_json, json_type_array)) return;
+
+    length = json_object_array_length(aggregates_json);
+    for (size_t w = 0; w < length && group->window_count < MAX_AGGREGATE_WINDOWS; w++) {
+        size_t window = _parse_window(json_object_array_get_idx(aggregates_json, w),
+                                      labels[group->window_count], sizeof(labels[0]));
+
+        if (window == 0) {
+            fprintf(stderr, "Invalid aggregate window %s for group %s\n",
+                    json_object_get_string(json_object_array_get_idx(aggregates_json, w)), group->name ? group->name : "");
+            continue;
+        }
+
+        group->windows[group->window_count++] = window;
+    }
+
+    for (size_t i = 0; i < source_count; i++) {
+        const char* type = group->items.items[i].type;
+        if (!type || (strcmp(type, "System.String") != 0 && strcmp(type, "System.DateTime") != 0)) aggregated++;
+    }
+
+    if (group->window_count == 0 || aggregated == 0) return;
+
+    group->items.capacity = source_count + aggregated * group->window_count * AGGREGATE_STAT_COUNT;
+    group->items.items = (Item*)realloc(group->items.items, sizeof(Item) * group->items.capacity);
+    if (!group->items.items) {
+        fprintf(stderr, "Failed to allocate memory for aggregate items\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(&group->items.items[source_count], 0, sizeof(Item) * (group->items.capacity - source_count));
+
+    for (size_t i = 0; i < source_count; i++) {
+        const char* type = group->items.items[i].type;
+
+        if (type && (strcmp(type, "System.String") == 0 || strcmp(type, "System.DateTime") == 0)) continue;
+
+        for (size_t w = 0; w < group->window_count; w++) {
+            for (int stat = 0; stat < AGGREGATE_STAT_COUNT; stat++) {
+                item = &group->items.items[group->items.count++];
+
+                snprintf(name, sizeof(name), "%s.%s.%s", group->items.items[i].name ? group->items.items[i].name : "",
+                         labels[w], stat_names[stat]);
+                item->name = strdup(name);
+                item->type = strdup(stat == AGGREGATE_COUNT ? "System.UInt32" : "System.Double");
+                item->source = ITEM_SOURCE_AGGREGATE;
+                item->source_item = i;
+                item->window = w;
+                item->stat = (AggregateStat)stat;
+            }
+        }
+    }
+}
+
+/// @brief Parse the scheduling class and target latency of a group from JSON
+/// @param group_json The JSON object of the group, e.g. {"Priority": "High", "TargetLatency": "20ms"}
+/// @param group The group receiving the settings
+/// @note The target latency defaults to the one of the class and uses the syntax of the aggregate windows.
+static void _parse_priority(struct json_object* group_json, Group* group){
+
+    static const size_t default_latencies[PRIORITY_CLASS_COUNT] = {
+        DEFAULT_TARGET_LATENCY_HIGH, DEFAULT_TARGET_LATENCY_NORMAL, DEFAULT_TARGET_LATENCY_LOW
+    };
+    struct json_object* temp;
+    const char* priority;
+    char label[32];
+
+    group->priority = PRIORITY_NORMAL;
+
+    if (_get_field(group_json, "priority", &temp)){
+        priority = json_object_get_string(temp);
+
+        if (strcasecmp(priority, "High") == 0) {
+            group->priority = PRIORITY_HIGH;
+        } else if (strcasecmp(priority, "Low") == 0) {
+            group->priority = PRIORITY_LOW;
+        } else if (strcasecmp(priority, "Normal") != 0) {
+            fprintf(stderr, "Unknown priority %s for group %s\n", priority, group->name ? group->name : "");
+        }
+    }
+
+    group->target_latency = default_latencies[group->priority];
+
+    if (_get_field(group_json, "targetLatency", &temp)){
+        size_t latency = _parse_window(temp, label, sizeof(label));
+
+        if (latency > 0) {
+            group->target_latency = latency;
+        } else {
+            fprintf(stderr, "Invalid target latency %s for group %s\n", json_object_get_string(temp),
+                    group->name ? group->name : "");
+        }
+    }
+}
+
 /// @brief Parse groups from JSON
 /// @param array_group_json The JSON array containing group information
 /// @param array_group The array to store parsed group information
@@ -230,12 +583,32 @@ static void _parse_groups(struct json_object* array_group_json, ArrayGroup* arra
     for(int i = 0; i < array_length; i++){
         group_obj = json_object_array_get_idx(array_group_json, i);
 
-        if (json_object_object_get_ex(group_obj, "name", &temp)){
+        array_group->groups[i].queue_size = DEFAULT_QUEUE_SIZE;
+        array_group->groups[i].queue_overflow = QUEUE_OVERFLOW_DROP_OLDEST;
+
+        if (_get_field(group_obj, "name", &temp)){
             array_group->groups[i].name = strdup(json_object_get_string(temp));
         }
-        if (json_object_object_get_ex(group_obj, "items", &temp)){
+        if (_get_field(group_obj, "items", &temp)){
             _parse_items(temp, &array_group->groups[i].items);
         }
+        if (_get_field(group_obj, "queue", &temp)){
+            _parse_queue(temp, &array_group->groups[i]);
+        }
+        _parse_priority(group_obj, &array_group->groups[i]);
+        // Limits of the Group apply to its items without limits of their own, not to its aggregates
+        if (_get_field(group_obj, "limits", &temp)){
+            ItemLimits limits;
+
+            _parse_limits(temp, &limits, array_group->groups[i].name);
+            for (size_t k = 0; k < array_group->groups[i].items.count; k++) {
+                if (!array_group->groups[i].items.items[k].limits.enabled)
+                    array_group->groups[i].items.items[k].limits = limits;
+            }
+        }
+        if (_get_field(group_obj, "aggregates", &temp)){
+            _parse_aggregates(temp, &array_group->groups[i]);
+        }
         array_group->count++;
     }
 }
@@ -252,19 +625,20 @@ static void _parse_machine_config(struct json_object* machine_config_json, Array
 
     _check_size_machine_config(array_machine_config);
 
-    if(json_object_object_get_ex(machine_config_json,"name",&temp)){
+    if(_get_field(machine_config_json,"name",&temp)){
         array_machine_config->configs[array_machine_config->count].name = strdup(json_object_get_string(temp));
     }
 
-    if(json_object_object_get_ex(machine_config_json,"url",&temp)){
+    if(_get_field(machine_config_json,"url",&temp)){
         array_machine_config->configs[array_machine_config->count].url = strdup(json_object_get_string(temp));
     }
 
-    if (json_object_object_get_ex(machine_config_json,"namespace",&temp)){
+    if (_get_field(machine_config_json,"namespace",&temp)){
         array_machine_config->configs[array_machine_config->count].namespace = strdup(json_object_get_string(temp));
     }
 
-    if (json_object_object_get_ex(machine_config_json,"groups",&temp)){
+    // Groups are called "Subscriptions" in the machine files
+    if (_get_field(machine_config_json,"groups",&temp) || _get_field(machine_config_json,"subscriptions",&temp)){
         _parse_groups(temp, &array_machine_config->configs[array_machine_config->count].groups);
     }
 
@@ -309,12 +683,15 @@ void load_machine_config(const char* folder_path, ArrayMachineConfig* array_mach
     
     if (!folder_path || !array_machine_config) return;
 
+    trace_begin("load_machine_config", folder_path);
+
     init_array_machine_config(array_machine_config, 8); // Initialize with a default capacity
     stack = create_stack();
 
     if (!stack) {
         fprintf(stderr, "Failed to create stack\n");
         free_array_machine_config(array_machine_config);
+        trace_end();
         return;
     }
 
@@ -345,12 +722,16 @@ void load_machine_config(const char* folder_path, ArrayMachineConfig* array_mach
 
                 if (ext && strcmp(ext,".json") == 0){ 
 
+                    trace_begin("parse machine file", path);
+
                     struct json_object* parsed_json = json_object_from_file(path);
                     if (parsed_json) {
                         _parse_machine_config(parsed_json, array_machine_config);
                         // Ensure JSON object is properly released
                         int ref_count = json_object_put(parsed_json);
                     }
+
+                    trace_end();
                 }
             }
         }
@@ -360,5 +741,6 @@ void load_machine_config(const char* folder_path, ArrayMachineConfig* array_mach
     }
     
     destroy_stack(stack);
+    trace_end();
 }
 
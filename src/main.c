@@ -1,5 +1,6 @@
 #include "../include/opcuaserver.h"
 #include <signal.h>
+#include <getopt.h>
 
 static volatile UA_Boolean running = true;
 
@@ -8,42 +9,267 @@ static void stopHandler(int sig){
     running = false;
 }
 
+static void usage(const char *program){
+    UA_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                 "Usage: %s [--nodestore lazy|flat] [--trace <trace.json>] [--shm <name>] [--pool] [--snapshot <file>] "
+                 "[--replicate unix:<path>|<host>:<port> [--standby]] [--shards <count>] "
+                 "[--session-operations <per second>] [--server-operations <per second>] [--session-bytes <per second>] "
+                 "<server-config.json5> [<machine-folder>]", program);
+    UA_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                 "The machine folder can only be left out when machines are compiled in (make MACHINES=<folder>)");
+}
+
 int main(int argc, char *argv[]) {
 
     UA_ByteString json_config = UA_BYTESTRING_NULL;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     UA_Server *server = NULL;
+    UA_ServerConfig config;
     ArrayMachineConfig machine_config = {0};
+    AddressSpace address_space = {0};
+    Gateway gateway = {0};
+    Upstream upstream = {0};
+    OnDemand on_demand = {0};
+    Aggregates aggregates = {0};
+    Alarms alarms = {0};
+    Expressions expressions = {0};
+    const char *server_config_path = NULL;
+    const char *trace_path = NULL;
+    const char *shm_name = NULL;
+    const char *snapshot_path = NULL;
+    const char *replication_address = NULL;
+    Replication replication = {0};
+    Shards shards = {0};
+    SessionLimits session_limits = {0};
+    SessionLimitsConfig session_limits_config = {0};
+    size_t shard_count = 0;
+    ShmTable shm = {0};
+    bool flat_nodestore = false;
+    bool pool = false;
+    bool standby = false;
+    int option;
+
+    static const struct option options[] = {
+        {"nodestore", required_argument, NULL, 'n'},
+        {"trace", required_argument, NULL, 't'},
+        {"shm", required_argument, NULL, 's'},
+        {"pool", no_argument, NULL, 'p'},
+        {"snapshot", required_argument, NULL, 'l'},
+        {"replicate", required_argument, NULL, 'r'},
+        {"standby", no_argument, NULL, 'b'},
+        {"shards", required_argument, NULL, 'w'},
+        {"session-operations", required_argument, NULL, 'q'},
+        {"server-operations", required_argument, NULL, 'Q'},
+        {"session-bytes", required_argument, NULL, 'y'},
+        {NULL, 0, NULL, 0}
+    };
 
     signal(SIGINT, stopHandler);
     signal(SIGTERM, stopHandler);
 
-    if(argc >= 3) {
+    while((option = getopt_long(argc, argv, "n:t:s:pl:r:bw:q:Q:y:", options, NULL)) != -1) {
+        if(option == 't') {
+            trace_path = optarg;
+        } else if(option == 's') {
+            shm_name = optarg;
+        } else if(option == 'p') {
+            pool = true;
+        } else if(option == 'l') {
+            snapshot_path = optarg;
+        } else if(option == 'r') {
+            replication_address = optarg;
+        } else if(option == 'b') {
+            standby = true;
+        } else if(option == 'w') {
+            shard_count = strtoul(optarg, NULL, 10);
+            if(shard_count == 0 || shard_count > SHARD_MAX) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if(option == 'q') {
+            session_limits_config.operations_per_second = (UA_UInt32)strtoul(optarg, NULL, 10);
+        } else if(option == 'Q') {
+            session_limits_config.server_operations_per_second = (UA_UInt32)strtoul(optarg, NULL, 10);
+        } else if(option == 'y') {
+            session_limits_config.bytes_per_second = (UA_UInt32)strtoul(optarg, NULL, 10);
+        } else if(option == 'n' && strcmp(optarg, "flat") == 0) {
+            flat_nodestore = true;
+        } else if(option != 'n' || strcmp(optarg, "lazy") != 0) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* A standby needs the upstream clients in its own process to take over */
+    if((standby && !replication_address) || (standby && shard_count > 0)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* The pools must serve the stack before its first allocation */
+    if(pool && !pool_allocator_install())
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                       "open62541 was built without UA_ENABLE_MALLOC_SINGLETON, the pool allocator is disabled");
+
+    /* Startup phases are traced until the server listens */
+    trace_open(trace_path);
+    trace_begin("startup", NULL);
+
+    if(argc - optind >= 1) {
         /* Load server config */
-        json_config = loadFile(argv[1]);
+        server_config_path = argv[optind];
+        json_config = loadFile(server_config_path);
         if(json_config.length == 0) {
             UA_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
-                         "Failed to load server config from file: %s", argv[1]);
+                         "Failed to load server config from file: %s", server_config_path);
+            trace_close();
             return EXIT_FAILURE;
         }
 
-        load_machine_config(argv[2], &machine_config);
+        /* Without a machine folder, the machines compiled into the binary are served */
+        if(argc - optind >= 2) {
+            load_machine_config(argv[optind + 1], &machine_config);
+        } else if(load_compiled_machine_config(&machine_config)) {
+            UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Serving the machines compiled from %s",
+                        compiled_machines_source());
+        } else {
+            usage(argv[0]);
+            UA_ByteString_clear(&json_config);
+            trace_close();
+            return EXIT_FAILURE;
+        }
 
     } else {
+        usage(argv[0]);
+        trace_close();
+        return EXIT_FAILURE;
+    }
+
+    /* Load the server config and serve the machines from the gateway nodestore */
+    /* The security policies and their certificates are loaded with the config */
+    memset(&config, 0, sizeof(UA_ServerConfig));
+    trace_begin("UA_ServerConfig_loadFromFile", server_config_path);
+    retval = UA_ServerConfig_loadFromFile(&config, json_config);
+    trace_end();
+    if(retval != UA_STATUSCODE_GOOD) {
         UA_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
-                     "Missing argument. Argument are "
-                     "<server-config.json5>");
+                     "Invalid server config in file: %s", server_config_path);
+        UA_ByteString_clear(&json_config);
+        free_array_machine_config(&machine_config);
+        trace_close();
         return EXIT_FAILURE;
     }
 
-    server = UA_Server_newFromFile(json_config);
-   
-    retval = UA_Server_run(server, &running);
+    /* The session budgets wrap the access control of the loaded config */
+    session_limits_install(&session_limits, &config, &session_limits_config, &gateway);
+
+    trace_begin("init_address_space", NULL);
+    init_address_space(&address_space, &machine_config);
+    trace_end();
+
+    trace_begin("nodestore install", flat_nodestore ? "flat" : "lazy");
+    if(flat_nodestore)
+        retval = flat_nodestore_install(&config, &address_space);
+    else
+        retval = gateway_nodestore_install(&config, &address_space);
+    trace_end();
+
+    trace_begin("UA_Server_newWithConfig", NULL);
+    if(retval == UA_STATUSCODE_GOOD)
+        server = UA_Server_newWithConfig(&config);
+    trace_end();
+    if(!server) {
+        UA_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Failed to create the server");
+        UA_ServerConfig_clean(&config);
+        UA_ByteString_clear(&json_config);
+        free_address_space(&address_space);
+        free_array_machine_config(&machine_config);
+        trace_close();
+        return EXIT_FAILURE;
+    }
+
+    trace_begin("AddMachineConfigToServer", NULL);
+    retval = AddMachineConfigToServer(server, &address_space);
+    trace_end();
+
+    /* Values flow from the upstream subscriptions through the item queues into the nodes */
+    init_gateway(&gateway, &address_space);
+    if(shm_name && shm_table_open(&shm, shm_name, &address_space))
+        gateway.shm = &shm;
+    init_aggregates(&aggregates, &gateway);
+    init_expressions(&expressions, &gateway);
+    init_alarms(&alarms, &gateway);
+    /* Sharded, the upstream clients run in the worker processes and monitor the ondemand items too */
+    if(shard_count > 0) {
+        init_shards(&shards, &gateway, shard_count);
+    } else {
+        init_upstream(&upstream, &gateway);
+        init_on_demand(&on_demand, &gateway, &upstream);
+    }
+    /* A standby keeps its upstream subscriptions silent and takes the values of the primary */
+    if(replication_address) {
+        init_replication(&replication, &gateway, &upstream, replication_address,
+                         standby ? REPLICATION_STANDBY : REPLICATION_PRIMARY);
+        gateway.replication = &replication;
+        upstream_set_publishing(&upstream, !standby);
+    }
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = gateway_start(&gateway, server);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = aggregates_start(&aggregates, server);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = alarms_start(&alarms, server);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = session_limits_start(&session_limits, server);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = on_demand_start(&on_demand, server);
+    /* Last known values are served until the machines deliver fresh ones */
+    if(retval == UA_STATUSCODE_GOOD && snapshot_path) {
+        trace_begin("snapshot_restore", snapshot_path);
+        snapshot_restore(snapshot_path, &gateway, server);
+        trace_end();
+    }
+    if(retval == UA_STATUSCODE_GOOD && replication_address)
+        retval = replication_start(&replication, server);
+    if(retval == UA_STATUSCODE_GOOD && shard_count > 0)
+        retval = shard_start(&shards, server);
+    else if(retval == UA_STATUSCODE_GOOD)
+        retval = upstream_start(&upstream, server);
+
+    if(retval == UA_STATUSCODE_GOOD) {
+        trace_begin("UA_Server_run_startup", NULL);
+        retval = UA_Server_run_startup(server);
+        trace_end();
+    }
+
+    if(retval == UA_STATUSCODE_GOOD) {
+        while(running) {
+            UA_Server_run_iterate(server, true);
+            /* The trace ends once the machines have connected and subscribed, or failed to */
+            if(trace_enabled() && upstream_started(&upstream))
+                trace_close();
+        }
+        retval = UA_Server_run_shutdown(server);
+        if(snapshot_path)
+            snapshot_save(snapshot_path, &gateway);
+    }
+    trace_close();
+    free_replication(&replication);
+    free_shards(&shards);
+    free_upstream(&upstream);
+    free_on_demand(&on_demand);
     retval |= UA_Server_delete(server);
+    free_session_limits(&session_limits);
+    free_expressions(&expressions);
+    free_alarms(&alarms);
+    free_aggregates(&aggregates);
+    free_gateway(&gateway);
+    shm_table_close(&shm);
 
     /* clean up */
     UA_ByteString_clear(&json_config);
 
+    free_address_space(&address_space);
     free_array_machine_config(&machine_config);
     return retval == UA_STATUSCODE_GOOD ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
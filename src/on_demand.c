@@ -0,0 +1,382 @@
+#include "../include/on_demand.h"
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void _read_done(UA_Client* client, void* userdata, UA_UInt32 request_id, UA_ReadResponse* response);
+static size_t _send(OnDemand* on_demand, UpstreamMachine* upstream_machine, const size_t* items, size_t count);
+static void _flush_callback(UA_Server* server, void* data);
+static void _serve_stale(OnDemand* on_demand, UA_Server* server, const UA_NodeId* node_id, size_t item,
+                         const UA_DataValue* value, UA_DateTime now);
+
+/// @brief Items of a Read request sent to a machine, the userdata of its response
+typedef struct {
+    OnDemand* on_demand;
+    size_t count;
+    size_t items[];
+} OnDemandRequest;
+
+
+/// @brief Attach the ondemand items to the upstream clients of their machines
+/// @param on_demand Pointer to the OnDemand structure to initialize
+/// @param gateway The gateway, its address space gets the OnDemand
+/// @param upstream The upstream clients, may be NULL; their ondemand items are no longer monitored
+/// @note Call before upstream_start so that the subscriptions leave the ondemand items out.
+void init_on_demand(OnDemand* on_demand, Gateway* gateway, Upstream* upstream){
+
+    AddressSpace* address_space;
+
+    if (!on_demand || !gateway) return;
+
+    memset(on_demand, 0, sizeof(OnDemand));
+    on_demand->gateway = gateway;
+    address_space = gateway->address_space;
+
+    for (size_t i = 0; i < address_space->item_count; i++) {
+        AddressSpaceNode node;
+
+        if (address_space_item_at(address_space, i, &node) && address_space_item(address_space, &node)->on_demand)
+            on_demand->item_count++;
+    }
+
+    if (on_demand->item_count == 0) return;
+
+    on_demand->machine_upstream = (UpstreamMachine**)calloc(address_space->count, sizeof(UpstreamMachine*));
+    on_demand->expires_at = (UA_DateTime*)calloc(address_space->item_count, sizeof(UA_DateTime));
+    on_demand->state = (UA_Byte*)calloc(address_space->item_count, sizeof(UA_Byte));
+    on_demand->queued = (size_t*)calloc(on_demand->item_count, sizeof(size_t));
+    if (!on_demand->machine_upstream || !on_demand->expires_at || !on_demand->state || !on_demand->queued) {
+        fprintf(stderr, "Failed to allocate memory for OnDemand\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t m = 0; upstream && m < upstream->count; m++) {
+        upstream->machines[m].on_demand = true;
+        on_demand->machine_upstream[upstream->machines[m].machine] = &upstream->machines[m];
+    }
+
+    address_space->on_demand = on_demand;
+}
+
+/// @brief Add the callback sending the queued refreshes
+/// @param on_demand The ondemand items
+/// @param server Pointer to the UA_Server instance
+/// @return UA_STATUSCODE_GOOD on success, or when there is no ondemand item
+UA_StatusCode on_demand_start(OnDemand* on_demand, UA_Server* server){
+
+    if (!on_demand || !server) return UA_STATUSCODE_BADINTERNALERROR;
+    if (on_demand->item_count == 0) return UA_STATUSCODE_GOOD;
+
+    return UA_Server_addRepeatedCallback(server, _flush_callback, on_demand, ON_DEMAND_INTERVAL,
+                                         &on_demand->callback_id);
+}
+
+/// @brief Value callback of the nodes of the ondemand items, called before each Read
+/// @param server Pointer to the UA_Server instance
+/// @param session_id The session reading the node
+/// @param session_context Context of the session
+/// @param node_id NodeId of the item
+/// @param node_context The AddressSpace of the item, set by the nodestores
+/// @param range Index range of the Read
+/// @param value Current value of the node, served to the client
+/// @note An expired good value is written back into the node as UncertainLastUsableValue and recorded with
+/// gateway_written, the Read serves it with that status.
+void on_demand_on_read(UA_Server* server, const UA_NodeId* session_id, void* session_context,
+                       const UA_NodeId* node_id, void* node_context, const UA_NumericRange* range,
+                       const UA_DataValue* value){
+
+    AddressSpace* address_space = (AddressSpace*)node_context;
+    AddressSpaceNode node;
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    size_t item;
+
+    (void)session_id; (void)session_context; (void)range;
+
+    if (!address_space || !address_space->on_demand) return;
+    if (!address_space_resolve(address_space, node_id, &node) || node.kind != ADDRESS_SPACE_NODE_ITEM) return;
+
+    item = address_space_item_index(address_space, &node);
+    on_demand_touch(address_space->on_demand, item, now);
+    _serve_stale(address_space->on_demand, server, node_id, item, value, now);
+}
+
+/// @brief Mark the node value of an expired item as UncertainLastUsableValue before it is served
+/// @param on_demand The ondemand items
+/// @param server Pointer to the UA_Server instance
+/// @param node_id NodeId of the item
+/// @param item Global index of the item
+/// @param value Current value of the node
+/// @param now Monotonic time of the Read
+/// @note Only a good value is marked, once: the node keeps the mark until the refresh replaces the value.
+/// The stack reads the node again after the value callback, so the Read that found the value expired
+/// already gets the mark.
+static void _serve_stale(OnDemand* on_demand, UA_Server* server, const UA_NodeId* node_id, size_t item,
+                         const UA_DataValue* value, UA_DateTime now){
+
+    UA_DataValue stale;
+    UA_StatusCode retval;
+
+    if (!value || !value->hasValue || now < on_demand->expires_at[item]) return;
+    if (value->hasStatus && !UA_StatusCode_isGood(value->status)) return;
+
+    // The write replaces the node holding the value, the copy outlives it
+    if (UA_DataValue_copy(value, &stale) != UA_STATUSCODE_GOOD) return;
+    stale.hasStatus = true;
+    stale.status = UA_STATUSCODE_UNCERTAINLASTUSABLEVALUE;
+
+    retval = UA_Server_writeDataValue(server, *node_id, stale);
+    if (retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_DEBUG(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Failed to mark ondemand item %zu: %s",
+                     item, UA_StatusCode_name(retval));
+    }
+
+    // The refresh compares with the marked value: the same value read again is written back as good
+    gateway_written(on_demand->gateway, item, &stale);
+    UA_DataValue_clear(&stale);
+}
+
+/// @brief Account a Read of an ondemand item
+/// @param on_demand The ondemand items
+/// @param item Global index of the item
+/// @param now Monotonic time of the Read
+/// @return true if the item was queued for a refresh
+bool on_demand_touch(OnDemand* on_demand, size_t item, UA_DateTime now){
+
+    if (!on_demand->state || item >= on_demand->gateway->address_space->item_count) return false;
+
+    if (on_demand->state[item] != ON_DEMAND_IDLE) {
+        on_demand->merged++;
+        return false;
+    }
+
+    if (now < on_demand->expires_at[item]) {
+        on_demand->hits++;
+        return false;
+    }
+
+    // Only ondemand items reach the callback, the queue cannot hold more than item_count entries
+    if (on_demand->queued_count == on_demand->item_count) return false;
+
+    on_demand->state[item] = ON_DEMAND_QUEUED;
+    on_demand->queued[on_demand->queued_count++] = item;
+    return true;
+}
+
+/// @brief Send one Read request for items of a machine
+/// @param on_demand The ondemand items
+/// @param upstream_machine The machine, with an activated session
+/// @param items Global indexes of the items
+/// @param count Number of items
+/// @return Number of items sent, 0 if the request could not be sent
+static size_t _send(OnDemand* on_demand, UpstreamMachine* upstream_machine, const size_t* items, size_t count){
+
+    AddressSpace* address_space = on_demand->gateway->address_space;
+    UA_ReadValueId* read_ids;
+    OnDemandRequest* request;
+    UA_ReadRequest read_request;
+    UA_StatusCode status;
+    size_t parsed = 0;
+
+    read_ids = (UA_ReadValueId*)calloc(count, sizeof(UA_ReadValueId));
+    request = (OnDemandRequest*)malloc(sizeof(OnDemandRequest) + count * sizeof(size_t));
+    if (!read_ids || !request) {
+        fprintf(stderr, "Failed to allocate memory for the ondemand request\n");
+        exit(EXIT_FAILURE);
+    }
+    request->on_demand = on_demand;
+    request->count = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        AddressSpaceNode node;
+        const Item* item;
+
+        address_space_item_at(address_space, items[i], &node);
+        item = address_space_item(address_space, &node);
+
+        if (!item->nodeId || UA_NodeId_parse(&read_ids[parsed].nodeId, UA_STRING(item->nodeId)) != UA_STATUSCODE_GOOD) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "Invalid NodeId for item %s of %s",
+                           item->name, address_space->machines[node.machine].config->name);
+            // Never read again, the node keeps BadWaitingForInitialData
+            on_demand->state[items[i]] = ON_DEMAND_IDLE;
+            on_demand->expires_at[items[i]] = UA_INT64_MAX;
+            continue;
+        }
+        read_ids[parsed].attributeId = UA_ATTRIBUTEID_VALUE;
+        request->items[request->count++] = items[i];
+        parsed++;
+    }
+
+    status = UA_STATUSCODE_BADNOTHINGTODO;
+    if (parsed > 0) {
+        UA_ReadRequest_init(&read_request);
+        read_request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+        read_request.nodesToRead = read_ids;
+        read_request.nodesToReadSize = parsed;
+        status = UA_Client_sendAsyncReadRequest(upstream_machine->client, &read_request, _read_done, request, NULL);
+    }
+
+    for (size_t i = 0; i < parsed; i++) UA_NodeId_clear(&read_ids[i].nodeId);
+    free(read_ids);
+
+    if (status != UA_STATUSCODE_GOOD) {
+        if (parsed > 0) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "Failed to read the ondemand items of %s: %s",
+                           address_space->machines[upstream_machine->machine].config->name, UA_StatusCode_name(status));
+        }
+        for (size_t i = 0; i < request->count; i++) on_demand->state[request->items[i]] = ON_DEMAND_IDLE;
+        free(request);
+        return 0;
+    }
+
+    for (size_t i = 0; i < request->count; i++) on_demand->state[request->items[i]] = ON_DEMAND_READING;
+    on_demand->requests++;
+    on_demand->refreshes += request->count;
+    return request->count;
+}
+
+/// @brief Send the queued refreshes, one Read request per machine
+/// @param on_demand The ondemand items
+/// @return Number of items sent
+/// @note Items of a machine whose session is not activated stay queued.
+size_t on_demand_flush(OnDemand* on_demand){
+
+    AddressSpace* address_space;
+    size_t* batch;
+    size_t sent = 0;
+    size_t kept = 0;
+
+    if (!on_demand || on_demand->queued_count == 0) return 0;
+
+    address_space = on_demand->gateway->address_space;
+    batch = (size_t*)malloc(on_demand->queued_count * sizeof(size_t));
+    if (!batch) {
+        fprintf(stderr, "Failed to allocate memory for the ondemand request\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The queue is walked once per machine with queued items, the first queued item names the machine
+    while (kept < on_demand->queued_count) {
+        AddressSpaceNode node;
+        UpstreamMachine* upstream_machine;
+        UA_SessionState session = UA_SESSIONSTATE_CLOSED;
+        size_t machine;
+        size_t count = 0;
+        size_t remaining = kept;
+
+        address_space_item_at(address_space, on_demand->queued[kept], &node);
+        machine = node.machine;
+        upstream_machine = on_demand->machine_upstream[machine];
+
+        for (size_t q = kept; q < on_demand->queued_count; q++) {
+            address_space_item_at(address_space, on_demand->queued[q], &node);
+            if (node.machine == machine) batch[count++] = on_demand->queued[q];
+            else on_demand->queued[remaining++] = on_demand->queued[q];
+        }
+
+        if (upstream_machine) UA_Client_getState(upstream_machine->client, NULL, &session, NULL);
+
+        if (session == UA_SESSIONSTATE_ACTIVATED) {
+            // Items of a request that cannot be sent are left expired, the next Read queues them again
+            sent += _send(on_demand, upstream_machine, batch, count);
+        } else if (upstream_machine) {
+            // Kept at the head of the queue for the next flush, the other machines follow
+            memmove(&on_demand->queued[kept + count], &on_demand->queued[kept], (remaining - kept) * sizeof(size_t));
+            memcpy(&on_demand->queued[kept], batch, count * sizeof(size_t));
+            kept += count;
+            remaining += count;
+        } else {
+            // Without a client the items can never be read, their node keeps its value
+            for (size_t i = 0; i < count; i++) on_demand->state[batch[i]] = ON_DEMAND_IDLE;
+        }
+        on_demand->queued_count = remaining;
+    }
+
+    free(batch);
+    return sent;
+}
+
+/// @brief Response of a Read request sent by _send
+/// @param client The upstream client of the machine
+/// @param userdata The OnDemandRequest of the request
+/// @param request_id Id of the request
+/// @param response The results, in the order of the items; the service result is set when the request failed
+static void _read_done(UA_Client* client, void* userdata, UA_UInt32 request_id, UA_ReadResponse* response){
+
+    OnDemandRequest* request = (OnDemandRequest*)userdata;
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+
+    (void)client; (void)request_id;
+
+    for (size_t i = 0; i < request->count; i++) {
+        const UA_DataValue* value = NULL;
+
+        if (response->responseHeader.serviceResult == UA_STATUSCODE_GOOD && i < response->resultsSize)
+            value = &response->results[i];
+
+        on_demand_complete(request->on_demand, request->items[i], value, now);
+    }
+
+    free(request);
+}
+
+/// @brief Store the result of a refresh
+/// @param on_demand The ondemand items
+/// @param item Global index of the item
+/// @param value The value read on the machine, only read; NULL when the request failed
+/// @param now Monotonic time of the response
+/// @note The value is pushed into the gateway through the upstream client of its machine (scaled items
+/// are staged for conversion) and served until now plus the Ttl of the item.
+void on_demand_complete(OnDemand* on_demand, size_t item, const UA_DataValue* value, UA_DateTime now){
+
+    AddressSpace* address_space = on_demand->gateway->address_space;
+    UpstreamMachine* upstream_machine;
+    AddressSpaceNode node;
+    UA_DataValue copy;
+
+    if (!on_demand->state || !address_space_item_at(address_space, item, &node)) return;
+
+    on_demand->state[item] = ON_DEMAND_IDLE;
+
+    if (!value) {
+        on_demand->expires_at[item] = 0;
+        return;
+    }
+
+    on_demand->expires_at[item] = now + (UA_DateTime)address_space_item(address_space, &node)->ttl * UA_DATETIME_MSEC;
+
+    upstream_machine = on_demand->machine_upstream[node.machine];
+    if (upstream_machine) {
+        upstream_push(upstream_machine, item, value);
+        return;
+    }
+
+    if (UA_DataValue_copy(value, &copy) != UA_STATUSCODE_GOOD) return;
+    gateway_push(on_demand->gateway, item, &copy);
+}
+
+/// @brief Repeated callback sending the queued refreshes
+/// @param server Pointer to the UA_Server instance
+/// @param data The OnDemand
+static void _flush_callback(UA_Server* server, void* data){
+
+    (void)server;
+
+    on_demand_flush((OnDemand*)data);
+}
+
+/// @brief Free the memory of the ondemand items
+/// @param on_demand Pointer to the OnDemand structure to free
+/// @note The upstream clients must be freed first, their pending requests complete into the OnDemand.
+void free_on_demand(OnDemand* on_demand){
+
+    if (!on_demand) return;
+
+    if (on_demand->gateway && on_demand->gateway->address_space->on_demand == on_demand) {
+        on_demand->gateway->address_space->on_demand = NULL;
+    }
+
+    free(on_demand->machine_upstream);
+    free(on_demand->expires_at);
+    free(on_demand->state);
+    free(on_demand->queued);
+    memset(on_demand, 0, sizeof(OnDemand));
+}
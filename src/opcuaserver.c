@@ -8,10 +8,13 @@
 UA_ByteString loadFile(const char *const path){
     UA_ByteString fileContents = UA_STRING_NULL;
 
+    trace_begin("loadFile", path);
+
     /* Open the file */
     FILE *fp = fopen(path, "rb");
     if(!fp) {
         errno = 0; /* We read errno also from the tcp layer... */
+        trace_end();
         return fileContents;
     }
 
@@ -29,14 +32,36 @@ UA_ByteString loadFile(const char *const path){
     }
     fclose(fp);
 
+    trace_end();
     return fileContents;    
 }
 
 
 /// @brief Add a machine configuration to the server
 /// @param server Pointer to the UA_Server instance
-/// @param config Pointer to the MachineConfig structure to add
-/// @note This function will create the necessary nodes in the server address space based on the configuration provided.
-void AddMachineConfigToServer(UA_Server *server, ArrayMachineConfig *config){
+/// @param address_space Layout of the machine configurations to add
+/// @return UA_STATUSCODE_GOOD on success
+/// @note This function registers the machine namespaces and links the machines below the Objects folder.
+/// The machine, group and item nodes are created on first access by the gateway nodestore.
+UA_StatusCode AddMachineConfigToServer(UA_Server *server, AddressSpace *address_space){
+
+    UA_StatusCode retval;
+
+    trace_begin("register namespaces", NULL);
+    address_space_register_namespaces(address_space, server);
+    trace_end();
+
+    trace_begin("link machines", NULL);
+    retval = address_space_link_machines(server, address_space);
+    trace_end();
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                     "Failed to link the machines to the Objects folder: %s", UA_StatusCode_name(retval));
+        return retval;
+    }
+
+    UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                "Added %zu machines with %zu items", address_space->count, address_space->item_count);
 
+    return UA_STATUSCODE_GOOD;
 }
\ No newline at end of file
@@ -0,0 +1,314 @@
+#include "../include/pool_allocator.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/// @brief Size class of the allocations served by malloc
+#define POOL_LARGE POOL_CLASS_COUNT
+/// @brief Marker of the block headers, catches pointers that do not come from the pools
+#define POOL_MAGIC 0x504F4F4Cu
+
+typedef struct PoolThread PoolThread;
+
+typedef struct PoolBlock {
+    struct PoolBlock* next;
+} PoolBlock;
+
+/// @brief Header in front of every block, 16 bytes to keep the payload aligned like malloc
+typedef struct {
+    union {
+        PoolThread* owner;  ///< Pooled blocks: thread owning the slab
+        size_t size;        ///< Large blocks: requested size
+    } origin;
+    uint32_t size_class;
+    uint32_t magic;
+} PoolHeader;
+
+typedef struct {
+    PoolBlock* free;
+    _Atomic(PoolBlock*) returned;
+    _Atomic UA_UInt64 allocations;
+    _Atomic UA_UInt64 frees;
+    _Atomic UA_UInt64 remote_frees;
+    _Atomic UA_UInt64 capacity;
+} PoolClass;
+
+struct PoolThread {
+    PoolClass classes[POOL_CLASS_COUNT];
+    PoolThread* next;
+};
+
+static const size_t CLASS_SIZES[POOL_CLASS_COUNT] = {16, 32, 48, 64, 96, 128, 192, 256, 384, 512};
+
+/// @brief Size class per 16-byte step of the requested size
+static const UA_Byte CLASS_BY_STEP[33] = {0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,
+                                          8, 8, 8, 8, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9};
+
+static _Thread_local PoolThread* current_thread = NULL;
+static PoolThread* threads = NULL;
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic UA_UInt64 large_allocations = 0;
+static _Atomic UA_UInt64 large_frees = 0;
+static bool installed = false;
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static inline void _count(_Atomic UA_UInt64* counter);
+static PoolThread* _attach_thread(void);
+static bool _refill(PoolThread* thread, size_t size_class);
+static inline PoolHeader* _header(void* pointer);
+
+
+/// @brief Increment a counter only written by its owner thread
+/// @note A relaxed load and store, the counter stays readable by the statistics without a locked instruction.
+static inline void _count(_Atomic UA_UInt64* counter){
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+/// @brief Create the pools of the calling thread
+/// @return The pools, NULL if the system is out of memory
+/// @note The pools outlive their thread: blocks may still be in use elsewhere, and the statistics keep them.
+static PoolThread* _attach_thread(void){
+
+    PoolThread* thread = (PoolThread*)calloc(1, sizeof(PoolThread));
+
+    if (!thread) return NULL;
+
+    pthread_mutex_lock(&threads_lock);
+    thread->next = threads;
+    threads = thread;
+    pthread_mutex_unlock(&threads_lock);
+
+    current_thread = thread;
+    return thread;
+}
+
+/// @brief Give a size class of the calling thread blocks, returned ones first
+/// @param thread The pools of the calling thread
+/// @param size_class The size class
+/// @return false if the system is out of memory
+static bool _refill(PoolThread* thread, size_t size_class){
+
+    PoolClass* pool = &thread->classes[size_class];
+    size_t stride = sizeof(PoolHeader) + CLASS_SIZES[size_class];
+    size_t count = POOL_SLAB_SIZE / stride;
+    unsigned char* slab;
+
+    pool->free = atomic_exchange_explicit(&pool->returned, NULL, memory_order_acquire);
+    if (pool->free) return true;
+
+    slab = (unsigned char*)malloc(count * stride);
+    if (!slab) return false;
+
+    for (size_t b = count; b-- > 0;) {
+        PoolHeader* header = (PoolHeader*)(slab + b * stride);
+        PoolBlock* block = (PoolBlock*)(header + 1);
+
+        header->origin.owner = thread;
+        header->size_class = (uint32_t)size_class;
+        header->magic = POOL_MAGIC;
+        block->next = pool->free;
+        pool->free = block;
+    }
+
+    atomic_store_explicit(&pool->capacity, atomic_load_explicit(&pool->capacity, memory_order_relaxed) + count,
+                          memory_order_relaxed);
+    return true;
+}
+
+/// @brief Header of a block of the pools
+static inline PoolHeader* _header(void* pointer){
+    return (PoolHeader*)pointer - 1;
+}
+
+/// @brief Allocate a block from the pools of the calling thread
+/// @param size Requested size in bytes
+/// @return The block, NULL if the system is out of memory
+void* pool_malloc(size_t size){
+
+    PoolThread* thread;
+    PoolClass* pool;
+    PoolBlock* block;
+    PoolHeader* header;
+    size_t size_class;
+
+    if (size > CLASS_SIZES[POOL_CLASS_COUNT - 1]) {
+        if (size > SIZE_MAX - sizeof(PoolHeader)) return NULL;
+
+        header = (PoolHeader*)malloc(sizeof(PoolHeader) + size);
+        if (!header) return NULL;
+
+        header->origin.size = size;
+        header->size_class = POOL_LARGE;
+        header->magic = POOL_MAGIC;
+        atomic_fetch_add_explicit(&large_allocations, 1, memory_order_relaxed);
+        return header + 1;
+    }
+
+    thread = current_thread ? current_thread : _attach_thread();
+    if (!thread) return NULL;
+
+    size_class = CLASS_BY_STEP[(size + 15) / 16];
+    pool = &thread->classes[size_class];
+
+    if (!pool->free && !_refill(thread, size_class)) return NULL;
+
+    block = pool->free;
+    pool->free = block->next;
+    _count(&pool->allocations);
+
+    return block;
+}
+
+/// @brief Allocate a zeroed array from the pools
+/// @param count Number of elements
+/// @param size Size of an element
+/// @return The block, NULL if the system is out of memory or the size overflows
+void* pool_calloc(size_t count, size_t size){
+
+    void* pointer;
+
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+
+    pointer = pool_malloc(count * size);
+    if (pointer) memset(pointer, 0, count * size);
+
+    return pointer;
+}
+
+/// @brief Resize a block of the pools
+/// @param pointer Block of the pools or NULL
+/// @param size New size in bytes
+/// @return The resized block, NULL if the system is out of memory, the block is then left untouched
+void* pool_realloc(void* pointer, size_t size){
+
+    PoolHeader* header;
+    size_t old_size;
+    void* resized;
+
+    if (!pointer) return pool_malloc(size);
+    if (size == 0) {
+        pool_free(pointer);
+        return NULL;
+    }
+
+    header = _header(pointer);
+    old_size = header->size_class == POOL_LARGE ? header->origin.size : CLASS_SIZES[header->size_class];
+
+    // A block whose new size still maps to its class stays in place
+    if (header->size_class != POOL_LARGE && size <= old_size &&
+        CLASS_BY_STEP[(size + 15) / 16] == header->size_class) return pointer;
+
+    resized = pool_malloc(size);
+    if (!resized) return NULL;
+
+    memcpy(resized, pointer, old_size < size ? old_size : size);
+    pool_free(pointer);
+
+    return resized;
+}
+
+/// @brief Return a block to the pools, from any thread
+/// @param pointer Block of the pools or NULL
+void pool_free(void* pointer){
+
+    PoolHeader* header;
+    PoolThread* owner;
+    PoolClass* pool;
+    PoolBlock* block = (PoolBlock*)pointer;
+
+    if (!pointer) return;
+
+    header = _header(pointer);
+    if (header->magic != POOL_MAGIC) {
+        fprintf(stderr, "pool_free: %p was not allocated by the pools\n", pointer);
+        abort();
+    }
+
+    if (header->size_class == POOL_LARGE) {
+        atomic_fetch_add_explicit(&large_frees, 1, memory_order_relaxed);
+        free(header);
+        return;
+    }
+
+    owner = header->origin.owner;
+    pool = &owner->classes[header->size_class];
+
+    if (owner == current_thread) {
+        block->next = pool->free;
+        pool->free = block;
+        _count(&pool->frees);
+        return;
+    }
+
+    // Another thread owns the block: push it on the owner's return stack
+    block->next = atomic_load_explicit(&pool->returned, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&pool->returned, &block->next, block,
+                                                  memory_order_release, memory_order_relaxed)) {
+    }
+    atomic_fetch_add_explicit(&pool->remote_frees, 1, memory_order_relaxed);
+}
+
+/// @brief Route the allocations of open62541 to the pools
+/// @return true if installed, false if open62541 was built without UA_ENABLE_MALLOC_SINGLETON
+/// @note Must be called before the first allocation of the stack and never undone: memory obtained from the
+/// pools can only be released by pool_free. Depending on the open62541 build the singletons may be
+/// thread-local, the hooks then apply to the calling thread, which runs the server.
+bool pool_allocator_install(void){
+
+#ifdef UA_ENABLE_MALLOC_SINGLETON
+    UA_mallocSingleton = pool_malloc;
+    UA_freeSingleton = pool_free;
+    UA_callocSingleton = pool_calloc;
+    UA_reallocSingleton = pool_realloc;
+    installed = true;
+#endif
+
+    return installed;
+}
+
+/// @brief Check if the pools serve the allocations of open62541
+/// @return true after a successful pool_allocator_install
+bool pool_allocator_installed(void){
+    return installed;
+}
+
+/// @brief Read the usage of the pools
+/// @param stats Array receiving one entry per size class followed by one entry for the large allocations
+/// @param count Capacity of the array, POOL_CLASS_COUNT + 1 for the complete statistics
+/// @return Number of entries written
+size_t pool_allocator_stats(PoolStats* stats, size_t count){
+
+    size_t written = count < POOL_CLASS_COUNT + 1 ? count : POOL_CLASS_COUNT + 1;
+
+    if (!stats) return 0;
+
+    memset(stats, 0, written * sizeof(PoolStats));
+
+    pthread_mutex_lock(&threads_lock);
+    for (PoolThread* thread = threads; thread; thread = thread->next) {
+        for (size_t c = 0; c < written && c < POOL_CLASS_COUNT; c++) {
+            PoolClass* pool = &thread->classes[c];
+            UA_UInt64 remote = atomic_load_explicit(&pool->remote_frees, memory_order_relaxed);
+
+            stats[c].allocations += atomic_load_explicit(&pool->allocations, memory_order_relaxed);
+            stats[c].frees += atomic_load_explicit(&pool->frees, memory_order_relaxed) + remote;
+            stats[c].remote_frees += remote;
+            stats[c].capacity += atomic_load_explicit(&pool->capacity, memory_order_relaxed);
+        }
+    }
+    pthread_mutex_unlock(&threads_lock);
+
+    for (size_t c = 0; c < written; c++) {
+        if (c == POOL_LARGE) {
+            stats[c].allocations = atomic_load_explicit(&large_allocations, memory_order_relaxed);
+            stats[c].frees = atomic_load_explicit(&large_frees, memory_order_relaxed);
+        } else {
+            stats[c].block_size = CLASS_SIZES[c];
+        }
+        stats[c].in_use = stats[c].allocations >= stats[c].frees ? stats[c].allocations - stats[c].frees : 0;
+    }
+
+    return written;
+}
@@ -0,0 +1,893 @@
+#include "../include/replication.h"
+
+#include <open62541/plugin/log_stdout.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef MSG_NOSIGNAL
+#define REPLICATION_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define REPLICATION_SEND_FLAGS 0
+#endif
+
+/// @brief Initial size of the stream buffers
+#define REPLICATION_BUFFER_MIN (64 * 1024)
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static uint32_t _layout_hash(const AddressSpace* address_space);
+static void _configure_socket(int fd);
+static int _open_socket(const char* address, bool listening, bool* in_progress);
+static void _close_peer(Replication* replication);
+static void _set_service_level(UA_Server* server, UA_Byte level);
+static bool _reserve(Replication* replication, size_t size);
+static bool _queue_frame(Replication* replication, ReplicationFrameType type, size_t item, const void* payload,
+                         size_t length);
+static bool _queue_value(Replication* replication, size_t item, const UA_DataValue* value);
+static void _queue_hello(Replication* replication);
+static void _queue_sync(Replication* replication);
+static bool _flush(Replication* replication);
+static bool _connected(Replication* replication);
+static int _receive(Replication* replication);
+static bool _wins(const Replication* replication, const ReplicationHello* hello);
+static bool _apply(Replication* replication, const ReplicationFrame* frame, const unsigned char* payload);
+static void _listen(Replication* replication);
+static bool _is_probe(const Replication* replication, int fd);
+static void _take_over(Replication* replication, UA_Server* server);
+static void _step_down(Replication* replication, UA_Server* server);
+static void _iterate_primary(Replication* replication, UA_Server* server);
+static void _iterate_standby(Replication* replication, UA_Server* server);
+static void _replication_callback(UA_Server* server, void* data);
+
+
+/// @brief FNV-1a hash of the item paths and sources of a layout
+/// @param address_space Layout of the gateway namespaces
+/// @return The hash, equal on two gateways loading the same machine files
+static uint32_t _layout_hash(const AddressSpace* address_space){
+
+    uint32_t hash = 2166136261u;
+    AddressSpaceNode position;
+    char path[1024];
+
+    for (size_t i = 0; i < address_space->item_count; i++) {
+        size_t length = address_space_item_path(address_space, i, path, sizeof(path));
+
+        address_space_item_at(address_space, i, &position);
+        path[length < sizeof(path) ? length : sizeof(path) - 1] = (char)address_space_item(address_space, &position)->source;
+
+        for (size_t c = 0; c <= length && c < sizeof(path); c++) {
+            hash = (hash ^ (unsigned char)path[c]) * 16777619u;
+        }
+    }
+
+    return hash;
+}
+
+/// @brief Make a socket non-blocking and send small frames without delay
+/// @param fd The socket
+static void _configure_socket(int fd){
+
+    int enable = 1;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    // Both options only apply to some socket families, failures are expected
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+}
+
+/// @brief Open the listening socket of a primary or the connection of a standby
+/// @param address "unix:<path>" or "<host>:<port>", an empty or "*" host listens on every interface
+/// @param listening true to listen, false to connect
+/// @param in_progress Set to true when a connection completes later, may be NULL when listening
+/// @return The non-blocking socket, -1 on failure
+/// @note A Unix socket left by a previous run is replaced.
+static int _open_socket(const char* address, bool listening, bool* in_progress){
+
+    struct addrinfo hints = {0};
+    struct addrinfo* results = NULL;
+    const char* separator;
+    char host[256];
+    int fd = -1;
+
+    if (in_progress) *in_progress = false;
+
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un local = {0};
+        const char* path = address + 5;
+
+        if (strlen(path) == 0 || strlen(path) >= sizeof(local.sun_path)) return -1;
+
+        local.sun_family = AF_UNIX;
+        strcpy(local.sun_path, path);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        _configure_socket(fd);
+
+        if (listening) {
+            unlink(path);
+            if (bind(fd, (struct sockaddr*)&local, sizeof(local)) == 0 && listen(fd, 1) == 0) return fd;
+        } else if (connect(fd, (struct sockaddr*)&local, sizeof(local)) == 0) {
+            return fd;
+        } else if (errno == EINPROGRESS || errno == EAGAIN) {
+            *in_progress = true;
+            return fd;
+        }
+
+        close(fd);
+        return -1;
+    }
+
+    separator = strrchr(address, ':');
+    if (!separator || (size_t)(separator - address) >= sizeof(host)) return -1;
+
+    memcpy(host, address, (size_t)(separator - address));
+    host[separator - address] = '\0';
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    if (getaddrinfo(host[0] && strcmp(host, "*") != 0 ? host : NULL, separator + 1, &hints, &results) != 0) return -1;
+
+    for (struct addrinfo* result = results; result; result = result->ai_next) {
+        int reuse = 1;
+
+        fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+        if (fd < 0) continue;
+        _configure_socket(fd);
+
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            if (bind(fd, result->ai_addr, result->ai_addrlen) == 0 && listen(fd, 1) == 0) break;
+        } else if (connect(fd, result->ai_addr, result->ai_addrlen) == 0) {
+            break;
+        } else if (errno == EINPROGRESS) {
+            *in_progress = true;
+            break;
+        }
+
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(results);
+    return fd;
+}
+
+/// @brief Close the connection to the other gateway and drop the unsent frames
+/// @param replication The replication
+static void _close_peer(Replication* replication){
+
+    if (replication->peer >= 0) close(replication->peer);
+
+    replication->peer = -1;
+    replication->connecting = false;
+    replication->accepted = false;
+    replication->probing = false;
+    replication->resync = false;
+    replication->output_length = 0;
+    replication->output_sent = 0;
+    replication->input_length = 0;
+}
+
+/// @brief Write the ServiceLevel of the server
+/// @param server Pointer to the UA_Server instance
+/// @param level The level, clients prefer the highest
+static void _set_service_level(UA_Server* server, UA_Byte level){
+
+    UA_Variant variant;
+    UA_StatusCode retval;
+
+    UA_Variant_setScalar(&variant, &level, &UA_TYPES[UA_TYPES_BYTE]);
+    retval = UA_Server_writeValue(server, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVICELEVEL), variant);
+    if (retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Failed to set the ServiceLevel: %s",
+                       UA_StatusCode_name(retval));
+    }
+}
+
+/// @brief Make room for a frame in the output buffer
+/// @param replication The replication
+/// @param size Size of the frame
+/// @return false if the unsent stream would exceed REPLICATION_BUFFER_MAX
+static bool _reserve(Replication* replication, size_t size){
+
+    size_t unsent;
+    size_t capacity;
+    unsigned char* output;
+
+    if (replication->output_sent == replication->output_length) {
+        replication->output_sent = replication->output_length = 0;
+    }
+    if (replication->output_capacity - replication->output_length >= size) return true;
+
+    // The sent bytes are dropped before growing
+    unsent = replication->output_length - replication->output_sent;
+    if (unsent > 0) memmove(replication->output, replication->output + replication->output_sent, unsent);
+    replication->output_length = unsent;
+    replication->output_sent = 0;
+    if (replication->output_capacity - unsent >= size) return true;
+
+    if (unsent + size > REPLICATION_BUFFER_MAX) return false;
+
+    capacity = replication->output_capacity > 0 ? replication->output_capacity : REPLICATION_BUFFER_MIN;
+    while (capacity < unsent + size) capacity *= 2;
+
+    output = (unsigned char*)realloc(replication->output, capacity);
+    if (!output) {
+        fprintf(stderr, "Failed to allocate memory for the replication\n");
+        exit(EXIT_FAILURE);
+    }
+    replication->output = output;
+    replication->output_capacity = capacity;
+
+    return true;
+}
+
+/// @brief Append a frame to the output buffer
+/// @param replication The replication
+/// @param type Type of the frame
+/// @param item Global index of the item, 0 for the frames without item
+/// @param payload Payload of the frame, may be NULL if length is 0
+/// @param length Size of the payload
+/// @return false if the output buffer is full
+static bool _queue_frame(Replication* replication, ReplicationFrameType type, size_t item, const void* payload,
+                         size_t length){
+
+    ReplicationFrame frame = {0};
+
+    if (!_reserve(replication, sizeof(frame) + length)) return false;
+
+    frame.type = (uint8_t)type;
+    frame.item = (uint32_t)item;
+    frame.length = (uint32_t)length;
+
+    memcpy(replication->output + replication->output_length, &frame, sizeof(frame));
+    if (length > 0) memcpy(replication->output + replication->output_length + sizeof(frame), payload, length);
+    replication->output_length += sizeof(frame) + length;
+    replication->last_sent = UA_DateTime_nowMonotonic();
+
+    return true;
+}
+
+/// @brief Append the value frame of an item to the output buffer
+/// @param replication The replication
+/// @param item Global index of the item
+/// @param value The value, encoded in place
+/// @return false if the output buffer is full, values that cannot be encoded are skipped
+static bool _queue_value(Replication* replication, size_t item, const UA_DataValue* value){
+
+    ReplicationFrame frame = {0};
+    size_t size = UA_calcSizeBinary(value, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    UA_ByteString encoded;
+
+    if (size == 0 || size > UINT32_MAX) return true;
+    if (!_reserve(replication, sizeof(frame) + size)) return false;
+
+    encoded.data = replication->output + replication->output_length + sizeof(frame);
+    encoded.length = size;
+    if (UA_encodeBinary(value, &UA_TYPES[UA_TYPES_DATAVALUE], &encoded) != UA_STATUSCODE_GOOD) return true;
+
+    frame.type = REPLICATION_FRAME_VALUE;
+    frame.item = (uint32_t)item;
+    frame.length = (uint32_t)encoded.length;
+    memcpy(replication->output + replication->output_length, &frame, sizeof(frame));
+
+    replication->output_length += sizeof(frame) + encoded.length;
+    replication->last_sent = UA_DateTime_nowMonotonic();
+    replication->sent++;
+
+    return true;
+}
+
+/// @brief Queue the hello of this gateway, the first frame sent on a connection
+/// @param replication The replication
+static void _queue_hello(Replication* replication){
+
+    ReplicationHello hello = {0};
+
+    hello.magic = REPLICATION_MAGIC;
+    hello.version = REPLICATION_VERSION;
+    hello.item_count = (uint32_t)replication->gateway->address_space->item_count;
+    hello.layout_hash = replication->layout_hash;
+    hello.role = (uint8_t)replication->role;
+    hello.configured = (uint8_t)replication->configured;
+    hello.epoch = replication->epoch;
+    hello.instance = replication->instance;
+
+    _queue_frame(replication, REPLICATION_FRAME_HELLO, 0, &hello, sizeof(hello));
+}
+
+/// @brief Queue the current value of every upstream item
+/// @param replication The replication of a primary with a connected standby
+/// @note The values come from the cache of the gateway, the nodes are not read.
+static void _queue_sync(Replication* replication){
+
+    Gateway* gateway = replication->gateway;
+    bool complete = true;
+
+    replication->resync = false;
+
+    for (size_t i = 0; complete && i < gateway->address_space->item_count; i++) {
+        UA_DataValue value;
+
+        // Items that never received a value are left waiting on the standby too
+        if (!replication->replicated[i] || !gateway_current(gateway, i, &value)) continue;
+
+        complete = _queue_value(replication, i, &value);
+        UA_DataValue_clear(&value);
+    }
+
+    if (complete) complete = _queue_frame(replication, REPLICATION_FRAME_SYNCED, 0, NULL, 0);
+
+    // The copy starts over once the buffer is drained
+    if (!complete) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "The values do not fit the replication buffer, "
+                       "the standby is resynchronized later");
+        replication->resync = true;
+    }
+}
+
+/// @brief Send the output buffer without blocking
+/// @param replication The replication
+/// @return false if the connection failed
+static bool _flush(Replication* replication){
+
+    while (replication->output_sent < replication->output_length) {
+        ssize_t sent = send(replication->peer, replication->output + replication->output_sent,
+                            replication->output_length - replication->output_sent, REPLICATION_SEND_FLAGS);
+
+        if (sent > 0) {
+            replication->output_sent += (size_t)sent;
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+
+    return true;
+}
+
+/// @brief Complete a pending connection without blocking
+/// @param replication The replication with a peer
+/// @return true once connected, false while connecting or if the connection failed
+static bool _connected(Replication* replication){
+
+    struct pollfd waiting = {replication->peer, POLLOUT, 0};
+    socklen_t length = sizeof(int);
+    int error = 0;
+
+    if (!replication->connecting) return true;
+
+    if (poll(&waiting, 1, 0) > 0) {
+        getsockopt(replication->peer, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error == 0) replication->connecting = false;
+        else _close_peer(replication);
+    }
+
+    return replication->peer >= 0 && !replication->connecting;
+}
+
+/// @brief Receive and apply the frames of the peer without blocking
+/// @param replication The replication of a connected gateway
+/// @return 1 while connected, 0 if the peer closed the connection, -1 on a protocol error
+static int _receive(Replication* replication){
+
+    size_t offset = 0;
+    int state = 1;
+
+    while (state == 1) {
+        ssize_t received;
+
+        if (replication->input_capacity - replication->input_length < REPLICATION_BUFFER_MIN / 4) {
+            size_t capacity = replication->input_capacity > 0 ? replication->input_capacity * 2 : REPLICATION_BUFFER_MIN;
+            unsigned char* input = (unsigned char*)realloc(replication->input, capacity);
+
+            if (!input) {
+                fprintf(stderr, "Failed to allocate memory for the replication\n");
+                exit(EXIT_FAILURE);
+            }
+            replication->input = input;
+            replication->input_capacity = capacity;
+        }
+
+        received = recv(replication->peer, replication->input + replication->input_length,
+                        replication->input_capacity - replication->input_length, 0);
+        if (received > 0) {
+            replication->input_length += (size_t)received;
+            replication->last_received = UA_DateTime_nowMonotonic();
+        } else if (received == 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            state = 0;
+        } else if (errno != EINTR) {
+            break;
+        }
+
+        // Complete frames are applied as they arrive, which bounds the buffer to the largest frame
+        while (replication->input_length - offset >= sizeof(ReplicationFrame)) {
+            ReplicationFrame frame;
+
+            memcpy(&frame, replication->input + offset, sizeof(frame));
+            if (frame.length > REPLICATION_BUFFER_MAX) return -1;
+            if (replication->input_length - offset - sizeof(frame) < frame.length) break;
+
+            if (!_apply(replication, &frame, replication->input + offset + sizeof(frame))) return -1;
+            offset += sizeof(frame) + frame.length;
+        }
+
+        memmove(replication->input, replication->input + offset, replication->input_length - offset);
+        replication->input_length -= offset;
+        offset = 0;
+    }
+
+    return state;
+}
+
+/// @brief Check if this primary stays primary against another one
+/// @param replication The replication of a primary
+/// @param hello The hello of the other primary
+/// @return true if the other primary must step down
+static bool _wins(const Replication* replication, const ReplicationHello* hello){
+
+    if (replication->epoch != hello->epoch) return replication->epoch > hello->epoch;
+    if ((uint8_t)replication->configured != hello->configured) return replication->configured == REPLICATION_PRIMARY;
+
+    return replication->instance > hello->instance;
+}
+
+/// @brief Apply a frame received from the peer
+/// @param replication The replication
+/// @param frame The frame
+/// @param payload The payload of the frame
+/// @return false if the frame is invalid, the layouts differ or the peer is this gateway
+/// @note A primary losing the tie against another primary becomes a standby here, see _step_down().
+static bool _apply(Replication* replication, const ReplicationFrame* frame, const unsigned char* payload){
+
+    AddressSpace* address_space = replication->gateway->address_space;
+    ReplicationHello hello;
+    UA_ByteString encoded;
+    UA_DataValue value;
+
+    if (frame->type == REPLICATION_FRAME_HELLO) {
+        if (frame->length != sizeof(hello)) return false;
+
+        memcpy(&hello, payload, sizeof(hello));
+        if (hello.magic != REPLICATION_MAGIC || hello.version != REPLICATION_VERSION ||
+            hello.item_count != address_space->item_count || hello.layout_hash != replication->layout_hash) {
+            if (replication->role == REPLICATION_PRIMARY) {
+                UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Refusing a gateway serving other machine files "
+                               "on %s", replication->address);
+            } else if (!replication->mismatch) {
+                UA_LOG_ERROR(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "The primary at %s serves other machine files, "
+                             "this standby will not take over", replication->address);
+            }
+            replication->mismatch = replication->role == REPLICATION_STANDBY;
+            return false;
+        }
+        if (hello.instance == replication->instance) return false;
+
+        replication->mismatch = false;
+        replication->accepted = true;
+
+        if (replication->role == REPLICATION_STANDBY) {
+            if (hello.role != REPLICATION_PRIMARY) return false;
+            replication->epoch = hello.epoch;
+            return true;
+        }
+
+        // Two primaries: the loser keeps the connection as the standby of the winner
+        if (hello.role == REPLICATION_PRIMARY && !_wins(replication, &hello)) {
+            replication->role = REPLICATION_STANDBY;
+            replication->epoch = hello.epoch;
+            replication->yield = true;
+            return true;
+        }
+
+        _queue_sync(replication);
+        return true;
+    }
+
+    if (!replication->accepted) return false;
+    if (frame->type == REPLICATION_FRAME_HEARTBEAT) return true;
+
+    // Only a standby receives values
+    if (replication->role == REPLICATION_PRIMARY) return false;
+
+    if (frame->type == REPLICATION_FRAME_SYNCED) {
+        replication->synced = true;
+        UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Standby synchronized with the primary at %s",
+                    replication->address);
+    } else if (frame->type == REPLICATION_FRAME_VALUE) {
+        if (frame->item >= address_space->item_count || !replication->replicated[frame->item]) return false;
+
+        encoded.data = (UA_Byte*)(uintptr_t)payload;
+        encoded.length = frame->length;
+        if (UA_decodeBinary(&encoded, &value, &UA_TYPES[UA_TYPES_DATAVALUE], NULL) != UA_STATUSCODE_GOOD) return false;
+
+        gateway_push(replication->gateway, frame->item, &value);
+        replication->applied++;
+    }
+
+    return true;
+}
+
+/// @brief Listen on the replication address, replacing the listening socket if any
+/// @param replication The replication of a primary
+static void _listen(Replication* replication){
+
+    if (replication->listener >= 0) close(replication->listener);
+
+    replication->listener = _open_socket(replication->address, true, NULL);
+    if (replication->listener < 0) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Cannot listen on %s, no standby can connect",
+                       replication->address);
+    }
+}
+
+/// @brief Check if a connection accepted by a primary is its own probe
+/// @param replication The replication of a probing primary
+/// @param fd The accepted socket
+/// @return true if the remote end of the accepted socket is the local end of the probe
+/// @note Unnamed Unix sockets all compare equal: a standby connecting during a probe is closed and retries.
+static bool _is_probe(const Replication* replication, int fd){
+
+    struct sockaddr_storage local;
+    struct sockaddr_storage remote;
+    socklen_t local_length = sizeof(local);
+    socklen_t remote_length = sizeof(remote);
+
+    memset(&local, 0, sizeof(local));
+    memset(&remote, 0, sizeof(remote));
+
+    if (getsockname(replication->peer, (struct sockaddr*)&local, &local_length) != 0 ||
+        getpeername(fd, (struct sockaddr*)&remote, &remote_length) != 0) return false;
+
+    return local_length == remote_length && memcmp(&local, &remote, local_length) == 0;
+}
+
+/// @brief Turn a standby into the primary
+/// @param replication The replication of a standby
+/// @param server Pointer to the UA_Server instance
+/// @note The upstream subscriptions start publishing, and the replication address is listened on for the next standby.
+static void _take_over(Replication* replication, UA_Server* server){
+
+    UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "The primary at %s is gone, taking over",
+                   replication->address);
+
+    _close_peer(replication);
+    replication->role = REPLICATION_PRIMARY;
+    replication->epoch++;
+    replication->retry_at = UA_DateTime_nowMonotonic() + REPLICATION_PROBE_INTERVAL * UA_DATETIME_MSEC;
+
+    upstream_set_publishing(replication->upstream, true);
+    _set_service_level(server, REPLICATION_SERVICE_LEVEL_PRIMARY);
+
+    _listen(replication);
+}
+
+/// @brief Turn a primary that lost the tie against another primary into its standby
+/// @param replication The replication, already a standby connected to the winner (see _apply())
+/// @param server Pointer to the UA_Server instance
+/// @note The address is left to the winner, which listens on it again.
+static void _step_down(Replication* replication, UA_Server* server){
+
+    UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Another primary of epoch %u serves %s, stepping down",
+                   replication->epoch, replication->address);
+
+    replication->yield = false;
+    replication->probing = false;
+    replication->last_received = UA_DateTime_nowMonotonic();
+
+    if (replication->listener >= 0) close(replication->listener);
+    replication->listener = -1;
+
+    upstream_set_publishing(replication->upstream, false);
+    _set_service_level(server, REPLICATION_SERVICE_LEVEL_STANDBY);
+}
+
+/// @brief Accept a standby and stream the values to it, look for another primary without standby
+/// @param replication The replication of a primary
+/// @param server Pointer to the UA_Server instance
+static void _iterate_primary(Replication* replication, UA_Server* server){
+
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    int state;
+    int fd;
+
+    while (replication->listener >= 0 && (fd = accept(replication->listener, NULL, NULL)) >= 0) {
+        // The address leads back to this gateway: no other primary answers on it
+        if (replication->probing && _is_probe(replication, fd)) {
+            close(fd);
+            _close_peer(replication);
+            continue;
+        }
+
+        // One standby at a time: another one is refused, it retries until the first one is gone
+        if (replication->peer >= 0) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Refusing a second standby on %s",
+                           replication->address);
+            close(fd);
+            continue;
+        }
+
+        _configure_socket(fd);
+        replication->peer = fd;
+        replication->last_received = now;
+        UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Standby connected on %s", replication->address);
+        _queue_hello(replication);
+    }
+
+    // A standby may have taken over while this gateway could not be reached
+    if (replication->peer < 0 && now >= replication->retry_at) {
+        replication->retry_at = now + REPLICATION_PROBE_INTERVAL * UA_DATETIME_MSEC;
+        replication->peer = _open_socket(replication->address, false, &replication->connecting);
+        if (replication->peer >= 0) {
+            replication->probing = true;
+            replication->last_received = now;
+            _queue_hello(replication);
+        }
+    }
+
+    if (replication->peer < 0 || !_connected(replication)) return;
+
+    state = _receive(replication);
+    if (replication->yield) {
+        _step_down(replication, server);
+        return;
+    }
+
+    if (state > 0 && replication->probing && !replication->accepted &&
+        now - replication->last_received >= REPLICATION_TIMEOUT * UA_DATETIME_MSEC) {
+        state = 0;
+    }
+
+    if (state <= 0) {
+        if (!replication->probing) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Standby disconnected from %s", replication->address);
+        }
+        _close_peer(replication);
+        return;
+    }
+
+    // The other primary stepped down to the standby of this one, which takes the address back
+    if (replication->probing && replication->accepted) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Another primary served %s, it stepped down",
+                       replication->address);
+        replication->probing = false;
+        _listen(replication);
+    }
+
+    if (replication->resync && replication->output_sent == replication->output_length) {
+        replication->output_sent = replication->output_length = 0;
+        _queue_sync(replication);
+    }
+
+    if (replication->output_sent == replication->output_length &&
+        now - replication->last_sent >= REPLICATION_HEARTBEAT * UA_DATETIME_MSEC) {
+        _queue_frame(replication, REPLICATION_FRAME_HEARTBEAT, 0, NULL, 0);
+    }
+
+    if (!_flush(replication)) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Standby disconnected from %s", replication->address);
+        _close_peer(replication);
+    }
+}
+
+/// @brief Connect to the primary, apply its frames and take over when it is gone
+/// @param replication The replication of a standby
+/// @param server Pointer to the UA_Server instance
+/// @note A standby that never received a full copy of the values only takes over after REPLICATION_STARTUP_GRACE.
+static void _iterate_standby(Replication* replication, UA_Server* server){
+
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    bool accepted;
+    int state;
+
+    if (replication->peer < 0 && now >= replication->retry_at) {
+        replication->retry_at = now + REPLICATION_RETRY_DELAY * UA_DATETIME_MSEC;
+        replication->peer = _open_socket(replication->address, false, &replication->connecting);
+        if (replication->peer >= 0) _queue_hello(replication);
+    }
+
+    if (replication->peer >= 0 && _connected(replication)) {
+        accepted = replication->accepted;
+        state = _receive(replication);
+        if (state > 0 && !_flush(replication)) state = 0;
+        accepted = accepted || replication->accepted;
+
+        if (state == 0 && accepted && replication->synced) {
+            // The primary closed a stream it had started: it stopped or crashed
+            _take_over(replication, server);
+            return;
+        }
+
+        if (state <= 0) {
+            // Refused before the hello: the primary is alive and serves another standby
+            if (state == 0 && !accepted) replication->last_received = now;
+            _close_peer(replication);
+        }
+    }
+
+    if (!replication->mismatch && now - replication->last_received >= REPLICATION_TIMEOUT * UA_DATETIME_MSEC &&
+        (replication->synced || now - replication->started >= REPLICATION_STARTUP_GRACE * UA_DATETIME_MSEC)) {
+        _take_over(replication, server);
+    }
+}
+
+/// @brief Repeated server callback of the replication
+/// @param server Pointer to the UA_Server instance
+/// @param data The replication
+static void _replication_callback(UA_Server* server, void* data){
+    replication_iterate((Replication*)data, server);
+}
+
+/// @brief Initialize the replication of a gateway
+/// @param replication Pointer to the Replication structure to initialize
+/// @param gateway The gateway, its published values are streamed by a primary and fed by a standby
+/// @param upstream The upstream clients, enabled when a standby takes over, may be NULL
+/// @param address "unix:<path>" or "<host>:<port>", listened on by the primary and connected to by the standby
+/// @param role Role of the gateway at startup
+/// @note Attach the replication to the gateway (gateway->replication) for its values to be streamed.
+void init_replication(Replication* replication, Gateway* gateway, Upstream* upstream, const char* address,
+                      ReplicationRole role){
+
+    AddressSpace* address_space;
+    AddressSpaceNode position;
+
+    if (!replication || !gateway || !address) return;
+
+    memset(replication, 0, sizeof(Replication));
+    replication->gateway = gateway;
+    replication->upstream = upstream;
+    replication->role = role;
+    replication->configured = role;
+    replication->instance = ((uint64_t)getpid() << 32) ^ (uint64_t)UA_DateTime_nowMonotonic() ^ (uintptr_t)replication;
+    replication->listener = -1;
+    replication->peer = -1;
+    address_space = gateway->address_space;
+
+    replication->address = strdup(address);
+    replication->replicated = (bool*)calloc(address_space->item_count + 1, sizeof(bool));
+    if (!replication->address || !replication->replicated) {
+        fprintf(stderr, "Failed to allocate memory for the replication\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < address_space->item_count; i++) {
+        address_space_item_at(address_space, i, &position);
+        replication->replicated[i] = address_space_item(address_space, &position)->source == ITEM_SOURCE_UPSTREAM;
+    }
+    replication->layout_hash = _layout_hash(address_space);
+}
+
+/// @brief Set the redundancy state of the server and add the replication callback
+/// @param replication The replication
+/// @param server Pointer to the UA_Server instance
+/// @return UA_STATUSCODE_GOOD on success, an error if the primary cannot listen on the address
+UA_StatusCode replication_start(Replication* replication, UA_Server* server){
+
+    UA_RedundancySupport support = UA_REDUNDANCYSUPPORT_WARM;
+    UA_Variant variant;
+    struct pollfd waiting;
+    int error = 0;
+    socklen_t length = sizeof(error);
+    int fd;
+
+    if (!replication || !replication->gateway || !server) return UA_STATUSCODE_BADINTERNALERROR;
+
+    UA_Variant_setScalar(&variant, &support, &UA_TYPES[UA_TYPES_REDUNDANCYSUPPORT]);
+    UA_Server_writeValue(server, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERREDUNDANCY_REDUNDANCYSUPPORT), variant);
+    replication->started = UA_DateTime_nowMonotonic();
+
+    // A gateway already answering on the address took over from this one earlier: follow it
+    if (replication->role == REPLICATION_PRIMARY) {
+        fd = _open_socket(replication->address, false, &replication->connecting);
+        if (fd >= 0 && replication->connecting) {
+            waiting.fd = fd;
+            waiting.events = POLLOUT;
+            if (poll(&waiting, 1, REPLICATION_RETRY_DELAY) <= 0 ||
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        replication->connecting = false;
+
+        if (fd >= 0) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "A gateway already serves %s, starting as its standby",
+                           replication->address);
+            replication->role = REPLICATION_STANDBY;
+            replication->peer = fd;
+            _queue_hello(replication);
+            upstream_set_publishing(replication->upstream, false);
+        }
+    }
+
+    if (replication->role == REPLICATION_PRIMARY) {
+        replication->listener = _open_socket(replication->address, true, NULL);
+        if (replication->listener < 0) {
+            UA_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Cannot listen on %s for the standby",
+                         replication->address);
+            return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+        }
+        replication->retry_at = replication->started + REPLICATION_PROBE_INTERVAL * UA_DATETIME_MSEC;
+        _set_service_level(server, REPLICATION_SERVICE_LEVEL_PRIMARY);
+    } else {
+        replication->last_received = replication->started;
+        _set_service_level(server, REPLICATION_SERVICE_LEVEL_STANDBY);
+    }
+
+    return UA_Server_addRepeatedCallback(server, _replication_callback, replication, REPLICATION_INTERVAL,
+                                         &replication->callback_id);
+}
+
+/// @brief Accept, connect, send and receive without blocking
+/// @param replication The replication
+/// @param server Pointer to the UA_Server instance
+/// @note Called by the replication callback, a standby may take over from here.
+void replication_iterate(Replication* replication, UA_Server* server){
+
+    if (!replication || !replication->gateway || !server) return;
+
+    if (replication->role == REPLICATION_PRIMARY) _iterate_primary(replication, server);
+    else _iterate_standby(replication, server);
+}
+
+/// @brief Stream a value published by the gateway
+/// @param replication The replication
+/// @param item Global index of the item
+/// @param value The value
+/// @note Only a primary with a connected standby streams, and only the values of upstream items:
+/// the standby computes aggregates and expressions itself.
+void replication_publish(Replication* replication, size_t item, const UA_DataValue* value){
+
+    if (!replication || replication->role != REPLICATION_PRIMARY || replication->peer < 0 || !replication->accepted ||
+        replication->resync) return;
+    if (item >= replication->gateway->address_space->item_count || !replication->replicated[item]) return;
+
+    // A standby too slow to follow is resynchronized from the current values once it caught up
+    if (!_queue_value(replication, item, value)) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "The standby on %s falls behind, it will be resynchronized",
+                       replication->address);
+        replication->resync = true;
+    }
+}
+
+/// @brief Check if the gateway is a standby
+/// @param replication The replication or NULL
+/// @return true until the standby takes over
+bool replication_standby(const Replication* replication){
+    return replication && replication->role == REPLICATION_STANDBY;
+}
+
+/// @brief Close the sockets and free the memory of the replication
+/// @param replication Pointer to the Replication structure to free
+/// @note The server must be stopped first, the replication callback uses the replication.
+void free_replication(Replication* replication){
+
+    if (!replication || !replication->gateway) return;
+
+    _close_peer(replication);
+    if (replication->listener >= 0) {
+        close(replication->listener);
+        if (replication->address && strncmp(replication->address, "unix:", 5) == 0) unlink(replication->address + 5);
+    }
+
+    free(replication->address);
+    free(replication->replicated);
+    free(replication->output);
+    free(replication->input);
+    memset(replication, 0, sizeof(Replication));
+}
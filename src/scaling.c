@@ -0,0 +1,361 @@
+#include "../include/scaling.h"
+
+#include <float.h>
+#include <math.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define SCALING_X86 1
+#endif
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static bool _is_numeric(const UA_DataType* type);
+static void _reserve(ScalingBatch* batch, size_t capacity);
+static void _convert_scalar(ScalingBatch* batch, size_t first, size_t count);
+#ifdef SCALING_X86
+static size_t _convert_sse2(ScalingBatch* batch, size_t count);
+static size_t _convert_avx(ScalingBatch* batch, size_t count);
+#endif
+static void _store(UA_DataValue* value, double converted, const UA_DataType* type);
+
+
+/// @brief Range of the numeric types, indexed by type kind
+static const struct {
+    double low;
+    double high;
+} TYPE_RANGES[] = {
+    [UA_DATATYPEKIND_BOOLEAN] = {-INFINITY, INFINITY},
+    [UA_DATATYPEKIND_SBYTE] = {-128.0, 127.0},
+    [UA_DATATYPEKIND_BYTE] = {0.0, 255.0},
+    [UA_DATATYPEKIND_INT16] = {-32768.0, 32767.0},
+    [UA_DATATYPEKIND_UINT16] = {0.0, 65535.0},
+    [UA_DATATYPEKIND_INT32] = {-2147483648.0, 2147483647.0},
+    [UA_DATATYPEKIND_UINT32] = {0.0, 4294967295.0},
+    // The largest doubles below 2^63 and 2^64, llround overflows on the bounds themselves
+    [UA_DATATYPEKIND_INT64] = {-9223372036854775808.0, 9223372036854774784.0},
+    [UA_DATATYPEKIND_UINT64] = {0.0, 18446744073709549568.0},
+    [UA_DATATYPEKIND_FLOAT] = {-3.4028234663852886e38, 3.4028234663852886e38},
+    [UA_DATATYPEKIND_DOUBLE] = {-INFINITY, INFINITY}
+};
+
+/// @brief Check if a type can hold a converted value
+static bool _is_numeric(const UA_DataType* type){
+    return type->typeKind <= UA_DATATYPEKIND_DOUBLE;
+}
+
+/// @brief Grow the columns of a batch
+/// @param batch The batch
+/// @param capacity New number of rows
+static void _reserve(ScalingBatch* batch, size_t capacity){
+
+    batch->targets = (size_t*)realloc(batch->targets, capacity * sizeof(size_t));
+    batch->values = (UA_DataValue*)realloc(batch->values, capacity * sizeof(UA_DataValue));
+    batch->raw = (double*)realloc(batch->raw, capacity * sizeof(double));
+    batch->scale = (double*)realloc(batch->scale, capacity * sizeof(double));
+    batch->offset = (double*)realloc(batch->offset, capacity * sizeof(double));
+    batch->low = (double*)realloc(batch->low, capacity * sizeof(double));
+    batch->high = (double*)realloc(batch->high, capacity * sizeof(double));
+    batch->converted = (double*)realloc(batch->converted, capacity * sizeof(double));
+    batch->flags = (uint8_t*)realloc(batch->flags, capacity * sizeof(uint8_t));
+
+    if (!batch->targets || !batch->values || !batch->raw || !batch->scale || !batch->offset ||
+        !batch->low || !batch->high || !batch->converted || !batch->flags) {
+        fprintf(stderr, "Failed to allocate memory for the scaling batch\n");
+        exit(EXIT_FAILURE);
+    }
+
+    batch->capacity = capacity;
+}
+
+/// @brief Convert rows one at a time
+/// @param batch The batch
+/// @param first First row to convert
+/// @param count End of the rows to convert
+static void _convert_scalar(ScalingBatch* batch, size_t first, size_t count){
+
+    for (size_t i = first; i < count; i++) {
+        double value = batch->raw[i] * batch->scale[i] + batch->offset[i];
+        uint8_t flags = 0;
+
+        if (!isfinite(value)) {
+            flags = SCALING_INVALID;
+        } else if (value < batch->low[i]) {
+            value = batch->low[i];
+            flags = SCALING_EXCEEDED;
+        } else if (value > batch->high[i]) {
+            value = batch->high[i];
+            flags = SCALING_EXCEEDED;
+        }
+
+        batch->converted[i] = value;
+        batch->flags[i] = flags;
+    }
+}
+
+#ifdef SCALING_X86
+/// @brief Convert rows two at a time
+/// @return Number of rows converted, the remaining ones are left to the scalar code
+static size_t _convert_sse2(ScalingBatch* batch, size_t count){
+
+    size_t i = 0;
+
+    for (; i + 2 <= count; i += 2) {
+        __m128d low = _mm_loadu_pd(batch->low + i);
+        __m128d high = _mm_loadu_pd(batch->high + i);
+        __m128d value = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(batch->raw + i), _mm_loadu_pd(batch->scale + i)),
+                                   _mm_loadu_pd(batch->offset + i));
+        int exceeded = _mm_movemask_pd(_mm_or_pd(_mm_cmplt_pd(value, low), _mm_cmpgt_pd(value, high)));
+        // |value| not below DBL_MAX: NaN or infinity
+        int invalid = _mm_movemask_pd(_mm_cmpnle_pd(_mm_andnot_pd(_mm_set1_pd(-0.0), value), _mm_set1_pd(DBL_MAX)));
+
+        // An invalid value is flagged, whatever the clamp makes of it
+        _mm_storeu_pd(batch->converted + i, _mm_min_pd(_mm_max_pd(value, low), high));
+        for (int k = 0; k < 2; k++) {
+            batch->flags[i + k] = (invalid >> k & 1) ? SCALING_INVALID : (exceeded >> k & 1) ? SCALING_EXCEEDED : 0;
+        }
+    }
+
+    return i;
+}
+
+/// @brief Convert rows four at a time
+/// @return Number of rows converted, the remaining ones are left to the scalar code
+__attribute__((target("avx")))
+static size_t _convert_avx(ScalingBatch* batch, size_t count){
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m256d low = _mm256_loadu_pd(batch->low + i);
+        __m256d high = _mm256_loadu_pd(batch->high + i);
+        __m256d value = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(batch->raw + i), _mm256_loadu_pd(batch->scale + i)),
+                                      _mm256_loadu_pd(batch->offset + i));
+        int exceeded = _mm256_movemask_pd(_mm256_or_pd(_mm256_cmp_pd(value, low, _CMP_LT_OQ),
+                                                       _mm256_cmp_pd(value, high, _CMP_GT_OQ)));
+        int invalid = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), value),
+                                                       _mm256_set1_pd(DBL_MAX), _CMP_NLE_UQ));
+
+        _mm256_storeu_pd(batch->converted + i, _mm256_min_pd(_mm256_max_pd(value, low), high));
+        for (int k = 0; k < 4; k++) {
+            batch->flags[i + k] = (invalid >> k & 1) ? SCALING_INVALID : (exceeded >> k & 1) ? SCALING_EXCEEDED : 0;
+        }
+    }
+
+    return i;
+}
+#endif
+
+/// @brief Convert, clamp and check columns of raw values
+/// @param batch The batch, its raw, scale, offset, low and high columns are read
+/// @param count Number of rows to convert
+/// @note Fills the converted and flags columns. Exposed for the tests, the flush calls it.
+void scaling_convert(ScalingBatch* batch, size_t count){
+
+    size_t done = 0;
+
+    if (!batch || count > batch->capacity) return;
+
+#ifdef SCALING_X86
+    done = __builtin_cpu_supports("avx") ? _convert_avx(batch, count) : _convert_sse2(batch, count);
+#endif
+    _convert_scalar(batch, done, count);
+}
+
+/// @brief Set the converted value of a staged value
+/// @param value The staged value, without variant
+/// @param converted The converted value, within the range of the type
+/// @param type Target type of the item
+static void _store(UA_DataValue* value, double converted, const UA_DataType* type){
+
+    union {
+        UA_Boolean boolean;
+        UA_SByte sbyte;
+        UA_Byte byte;
+        UA_Int16 int16;
+        UA_UInt16 uint16;
+        UA_Int32 int32;
+        UA_UInt32 uint32;
+        UA_Int64 int64;
+        UA_UInt64 uint64;
+        UA_Float float_value;
+        UA_Double double_value;
+    } scalar;
+
+    switch (type->typeKind) {
+        case UA_DATATYPEKIND_BOOLEAN: scalar.boolean = converted != 0.0; break;
+        case UA_DATATYPEKIND_SBYTE:   scalar.sbyte = (UA_SByte)llround(converted); break;
+        case UA_DATATYPEKIND_BYTE:    scalar.byte = (UA_Byte)llround(converted); break;
+        case UA_DATATYPEKIND_INT16:   scalar.int16 = (UA_Int16)llround(converted); break;
+        case UA_DATATYPEKIND_UINT16:  scalar.uint16 = (UA_UInt16)llround(converted); break;
+        case UA_DATATYPEKIND_INT32:   scalar.int32 = (UA_Int32)llround(converted); break;
+        case UA_DATATYPEKIND_UINT32:  scalar.uint32 = (UA_UInt32)llround(converted); break;
+        case UA_DATATYPEKIND_INT64:   scalar.int64 = (UA_Int64)llround(converted); break;
+        case UA_DATATYPEKIND_UINT64:  scalar.uint64 = (UA_UInt64)nearbyint(converted); break;
+        case UA_DATATYPEKIND_FLOAT:   scalar.float_value = (UA_Float)converted; break;
+        default:                      scalar.double_value = converted; break;
+    }
+
+    value->hasValue = UA_Variant_setScalarCopy(&value->value, &scalar, type) == UA_STATUSCODE_GOOD;
+}
+
+/// @brief Prepare the conversion of the scaled items of a machine
+/// @param batch Pointer to the ScalingBatch structure to initialize
+/// @param gateway Gateway receiving the converted values, must outlive the batch
+/// @param machine Index of the machine in the address space
+/// @return false if the machine has no scaled item, the batch is then empty and stages nothing
+/// @note The range of an item is narrowed to the range of its target type, a target type that
+/// cannot hold a number is replaced by System.Double.
+bool init_scaling_batch(ScalingBatch* batch, Gateway* gateway, size_t machine){
+
+    AddressSpaceMachine* address_space_machine;
+    ArrayGroup* groups;
+    bool scaled = false;
+
+    if (!batch) return false;
+    memset(batch, 0, sizeof(ScalingBatch));
+    if (!gateway || !gateway->address_space || machine >= gateway->address_space->count) return false;
+
+    address_space_machine = &gateway->address_space->machines[machine];
+    groups = &address_space_machine->config->groups;
+
+    for (size_t g = 0; g < groups->count && !scaled; g++) {
+        for (size_t i = 0; i < groups->groups[g].items.count && !scaled; i++) {
+            scaled = groups->groups[g].items.items[i].scaled;
+        }
+    }
+    if (!scaled) return false;
+
+    batch->gateway = gateway;
+    batch->first_item = address_space_machine->first_item;
+    batch->item_count = address_space_machine->item_count;
+    batch->items = (const Item**)calloc(batch->item_count, sizeof(Item*));
+    batch->types = (const UA_DataType**)calloc(batch->item_count, sizeof(UA_DataType*));
+    if (!batch->items || !batch->types) {
+        fprintf(stderr, "Failed to allocate memory for the scaling batch\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t g = 0; g < groups->count; g++) {
+        for (size_t i = 0; i < groups->groups[g].items.count; i++) {
+            const Item* item = &groups->groups[g].items.items[i];
+            size_t local = address_space_machine->group_first_item[g] + i;
+            const UA_DataType* type;
+
+            if (!item->scaled) continue;
+
+            type = address_space_data_type(item->type);
+            if (!_is_numeric(type)) {
+                fprintf(stderr, "Target type %s of item %s is not numeric, System.Double is published\n",
+                        item->type ? item->type : "", item->name ? item->name : "");
+                type = &UA_TYPES[UA_TYPES_DOUBLE];
+            }
+
+            batch->items[local] = item;
+            batch->types[local] = type;
+        }
+    }
+
+    _reserve(batch, SCALING_INITIAL_CAPACITY);
+
+    return true;
+}
+
+/// @brief Stage a value received for an item
+/// @param batch The batch of the machine of the item
+/// @param item Global index of the item
+/// @param value The raw value, only read: its variant is converted at the next flush
+/// @return false if the item is not scaled, the value must then be pushed as is
+bool scaling_batch_add(ScalingBatch* batch, size_t item, const UA_DataValue* value){
+
+    size_t local;
+    size_t row;
+    const Item* config;
+    const UA_DataType* type;
+    double raw;
+
+    if (!batch || !batch->items || !value || item < batch->first_item) return false;
+
+    local = item - batch->first_item;
+    if (local >= batch->item_count || !batch->items[local]) return false;
+
+    config = batch->items[local];
+    type = batch->types[local];
+
+    if (batch->count == batch->capacity) _reserve(batch, batch->capacity * 2);
+    row = batch->count++;
+
+    // Status and timestamps are kept, the variant is rebuilt from the converted value
+    batch->values[row] = *value;
+    UA_Variant_init(&batch->values[row].value);
+    batch->values[row].hasValue = false;
+
+    // Bad values are forwarded as they are, other values without a number are invalid
+    if (!gateway_value_to_double(value, &raw)) raw = NAN;
+
+    batch->targets[row] = item;
+    batch->raw[row] = raw;
+    batch->scale[row] = config->scale;
+    batch->offset[row] = config->offset;
+    batch->low[row] = fmax(config->min, TYPE_RANGES[type->typeKind].low);
+    batch->high[row] = fmin(config->max, TYPE_RANGES[type->typeKind].high);
+
+    return true;
+}
+
+/// @brief Convert the staged values and push them into the gateway queues
+/// @param batch The batch
+/// @return Number of values pushed
+size_t scaling_batch_flush(ScalingBatch* batch){
+
+    size_t count;
+
+    if (!batch || batch->count == 0) return 0;
+
+    count = batch->count;
+    batch->count = 0;
+    scaling_convert(batch, count);
+
+    for (size_t i = 0; i < count; i++) {
+        UA_DataValue* value = &batch->values[i];
+        bool bad = value->hasStatus && UA_StatusCode_isBad(value->status);
+
+        if (bad) {
+            // The machine reported the failure, it is forwarded without value
+        } else if (batch->flags[i] & SCALING_INVALID) {
+            value->hasStatus = true;
+            value->status = UA_STATUSCODE_BADOUTOFRANGE;
+        } else {
+            _store(value, batch->converted[i], batch->types[batch->targets[i] - batch->first_item]);
+            if ((batch->flags[i] & SCALING_EXCEEDED) && (!value->hasStatus || UA_StatusCode_isGood(value->status))) {
+                value->hasStatus = true;
+                value->status = UA_STATUSCODE_UNCERTAINENGINEERINGUNITSEXCEEDED;
+            }
+        }
+
+        gateway_push(batch->gateway, batch->targets[i], value);
+    }
+
+    return count;
+}
+
+/// @brief Free the memory of a batch
+/// @param batch Pointer to the ScalingBatch structure to free
+/// @note Staged values not yet flushed are dropped, they hold no memory of their own.
+void free_scaling_batch(ScalingBatch* batch){
+
+    if (!batch) return;
+
+    free(batch->items);
+    free(batch->types);
+    free(batch->targets);
+    free(batch->values);
+    free(batch->raw);
+    free(batch->scale);
+    free(batch->offset);
+    free(batch->low);
+    free(batch->high);
+    free(batch->converted);
+    free(batch->flags);
+    memset(batch, 0, sizeof(ScalingBatch));
+}
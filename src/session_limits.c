@@ -0,0 +1,581 @@
+#include "../include/session_limits.h"
+
+#include <open62541/plugin/log_stdout.h>
+
+#include <math.h>
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static bool _enabled(const SessionLimitsConfig* config);
+static UA_Double _share(const SessionLimits* limits, size_t active);
+static size_t _slot(const SessionLimits* limits, const UA_NodeId* session_id, UA_UInt32 hash);
+static void _index_add(SessionLimits* limits, size_t position);
+static void _index_remove(SessionLimits* limits, size_t slot);
+static SessionBudget* _find(SessionLimits* limits, const UA_NodeId* session_id);
+static size_t _value_bytes(const SessionLimits* limits, const UA_NodeId* node_id);
+static void _log_session(const char* message, const UA_NodeId* session_id);
+static void _round_callback(UA_Server* server, void* data);
+static void _wrap_managers(SessionLimits* limits, UA_EventLoop* event_loop);
+static UA_StatusCode _open_connection(UA_ConnectionManager* cm, const UA_KeyValueMap* params, void* application,
+                                      void* context, UA_ConnectionManager_connectionCallback callback);
+static void _network_callback(UA_ConnectionManager* cm, uintptr_t connection_id, void* application,
+                              void** connection_context, UA_ConnectionState state, const UA_KeyValueMap* params,
+                              UA_ByteString msg);
+static bool _charged(const SessionLimits* limits);
+static void _clear(UA_AccessControl* ac);
+static UA_StatusCode _activate_session(UA_Server* server, UA_AccessControl* ac,
+                                       const UA_EndpointDescription* endpoint_description,
+                                       const UA_ByteString* secure_channel_remote_certificate,
+                                       const UA_NodeId* session_id, const UA_ExtensionObject* user_identity_token,
+                                       void** session_context);
+static void _close_session(UA_Server* server, UA_AccessControl* ac, const UA_NodeId* session_id,
+                           void* session_context);
+static UA_Byte _get_user_access_level(UA_Server* server, UA_AccessControl* ac, const UA_NodeId* session_id,
+                                      void* session_context, const UA_NodeId* node_id, void* node_context);
+static UA_Boolean _allow_browse_node(UA_Server* server, UA_AccessControl* ac, const UA_NodeId* session_id,
+                                     void* session_context, const UA_NodeId* node_id, void* node_context);
+static UA_Boolean _get_user_executable_on_object(UA_Server* server, UA_AccessControl* ac,
+                                                 const UA_NodeId* session_id, void* session_context,
+                                                 const UA_NodeId* method_id, void* method_context,
+                                                 const UA_NodeId* object_id, void* object_context);
+
+/// @brief Limits whose connection managers are wrapped, the managers call back without context of their own
+static SessionLimits* wrapping_limits = NULL;
+
+
+/// @brief Whether a limit is set
+static bool _enabled(const SessionLimitsConfig* config){
+    return config->operations_per_second > 0 || config->server_operations_per_second > 0 ||
+           config->bytes_per_second > 0;
+}
+
+/// @brief Operations per second of each session
+/// @param active Number of sessions sharing the server limit
+/// @return INFINITY when the operations are not limited
+static UA_Double _share(const SessionLimits* limits, size_t active){
+
+    UA_Double share = INFINITY;
+    UA_Double fair;
+
+    if (limits->config.operations_per_second > 0) {
+        share = limits->config.operations_per_second;
+    }
+    if (limits->config.server_operations_per_second > 0) {
+        fair = (UA_Double)limits->config.server_operations_per_second / (UA_Double)(active > 0 ? active : 1);
+        if (fair < share) {
+            share = fair;
+        }
+    }
+
+    return share;
+}
+
+/// @brief Find the slot of a session in the index
+/// @return Slot holding the session, or the empty slot ending its probe sequence
+static size_t _slot(const SessionLimits* limits, const UA_NodeId* session_id, UA_UInt32 hash){
+
+    size_t mask = limits->index_capacity - 1;
+    size_t slot = hash & mask;
+    const SessionBudget* budget;
+
+    while (limits->index[slot] != 0) {
+        budget = &limits->sessions[limits->index[slot] - 1];
+        if (budget->hash == hash && UA_NodeId_equal(&budget->session_id, session_id)) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/// @brief Add a session to the index, growing it to keep it at most half full
+/// @param position Position of the session in the budgets
+static void _index_add(SessionLimits* limits, size_t position){
+
+    size_t* index;
+    size_t capacity;
+
+    if ((limits->count + 1) * 2 > limits->index_capacity) {
+        capacity = limits->index_capacity ? limits->index_capacity * 2 : 16;
+        index = (size_t*)calloc(capacity, sizeof(size_t));
+        if (!index) {
+            fprintf(stderr, "Memory allocation failed for the session index\n");
+            exit(EXIT_FAILURE);
+        }
+        free(limits->index);
+        limits->index = index;
+        limits->index_capacity = capacity;
+        for (size_t i = 0; i < limits->count; i++) {
+            if (i != position) {
+                index[_slot(limits, &limits->sessions[i].session_id, limits->sessions[i].hash)] = i + 1;
+            }
+        }
+    }
+
+    limits->index[_slot(limits, &limits->sessions[position].session_id, limits->sessions[position].hash)] =
+        position + 1;
+}
+
+/// @brief Empty a slot of the index, moving back the sessions probed past it
+static void _index_remove(SessionLimits* limits, size_t slot){
+
+    size_t mask = limits->index_capacity - 1;
+    size_t next = slot;
+    size_t home;
+
+    for (;;) {
+        next = (next + 1) & mask;
+        if (limits->index[next] == 0) {
+            break;
+        }
+        // A session whose home lies cyclically in (slot, next] is still reachable from it
+        home = limits->sessions[limits->index[next] - 1].hash & mask;
+        if (slot <= next ? (slot < home && home <= next) : (slot < home || home <= next)) {
+            continue;
+        }
+        limits->index[slot] = limits->index[next];
+        slot = next;
+    }
+    limits->index[slot] = 0;
+}
+
+/// @brief Find the budget of a session
+/// @return NULL for the sessions that were not activated through the access control (the admin session)
+static SessionBudget* _find(SessionLimits* limits, const UA_NodeId* session_id){
+
+    size_t slot;
+
+    if (limits->count == 0) {
+        return NULL;
+    }
+
+    slot = _slot(limits, session_id, UA_NodeId_hash(session_id));
+    if (limits->index[slot] == 0) {
+        return NULL;
+    }
+
+    return &limits->sessions[limits->index[slot] - 1];
+}
+
+/// @brief Size of the cached encoding of the value of a gateway item
+/// @return 0 for the other nodes
+static size_t _value_bytes(const SessionLimits* limits, const UA_NodeId* node_id){
+
+    AddressSpaceNode node;
+
+    if (!limits->gateway || !limits->gateway->encoded || limits->config.bytes_per_second == 0) {
+        return 0;
+    }
+    if (!address_space_resolve(limits->gateway->address_space, node_id, &node) ||
+        node.kind != ADDRESS_SPACE_NODE_ITEM) {
+        return 0;
+    }
+
+    return limits->gateway->encoded[address_space_item_index(limits->gateway->address_space, &node)].length;
+}
+
+/// @brief Log a message about a session
+static void _log_session(const char* message, const UA_NodeId* session_id){
+
+    UA_String printed = UA_STRING_NULL;
+
+    UA_NodeId_print(session_id, &printed);
+    UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_SESSION, "Session %.*s %s",
+                (int)printed.length, (const char*)printed.data, message);
+    UA_String_clear(&printed);
+}
+
+/// @brief Wrap the access control of a server configuration with the session budgets
+/// @param limits Pointer to the SessionLimits structure to initialize
+/// @param server_config Server configuration, loaded but not yet used to create the server
+/// @param config The limits
+/// @param gateway The gateway, gives the size of the item values, may be NULL
+/// @note Nothing is wrapped when no limit is set. The limits must outlive the server.
+void session_limits_install(SessionLimits* limits, UA_ServerConfig* server_config, const SessionLimitsConfig* config,
+                            Gateway* gateway){
+
+    UA_AccessControl* ac = &server_config->accessControl;
+
+    memset(limits, 0, sizeof(SessionLimits));
+    limits->config = *config;
+    limits->gateway = gateway;
+    limits->share = _share(limits, 1);
+
+    if (!_enabled(config)) {
+        return;
+    }
+
+    // The wrapped plugin keeps its own context, the server sees a copy calling through the limits
+    limits->wrapped = *ac;
+    ac->context = limits;
+    ac->clear = _clear;
+    if (ac->activateSession) {
+        ac->activateSession = _activate_session;
+    }
+    if (ac->closeSession) {
+        ac->closeSession = _close_session;
+    }
+    if (ac->getUserAccessLevel) {
+        ac->getUserAccessLevel = _get_user_access_level;
+    }
+    if (ac->allowBrowseNode) {
+        ac->allowBrowseNode = _allow_browse_node;
+    }
+    if (ac->getUserExecutableOnObject) {
+        ac->getUserExecutableOnObject = _get_user_executable_on_object;
+    }
+
+    UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                "Session limits: %u operations/s per session, %u operations/s per server, %u bytes/s per session",
+                config->operations_per_second, config->server_operations_per_second, config->bytes_per_second);
+}
+
+/// @brief Refill the budgets, called every SESSION_LIMITS_ROUND
+static void _round_callback(UA_Server* server, void* data){
+    (void)server;
+    session_limits_round((SessionLimits*)data);
+}
+
+/// @brief Wrap the connection opening of the connection managers of an event loop
+/// @note The connections opened afterwards, the listening ones of the server, call back through the limits.
+static void _wrap_managers(SessionLimits* limits, UA_EventLoop* event_loop){
+
+    UA_ConnectionManager* cm;
+
+    for (UA_EventSource* es = event_loop->eventSources; es; es = es->next) {
+        if (es->eventSourceType != UA_EVENTSOURCETYPE_CONNECTIONMANAGER ||
+            limits->manager_count == SESSION_LIMITS_MAX_MANAGERS) {
+            continue;
+        }
+        cm = (UA_ConnectionManager*)es;
+        limits->managers[limits->manager_count].manager = cm;
+        limits->managers[limits->manager_count].open_connection = cm->openConnection;
+        limits->manager_count++;
+        cm->openConnection = _open_connection;
+    }
+
+    wrapping_limits = limits;
+    limits->services_only = limits->manager_count > 0;
+}
+
+/// @brief Add the callback refilling the budgets and watch the client messages
+/// @param limits The installed limits
+/// @param server Pointer to the UA_Server instance, not yet started
+/// @return UA_STATUSCODE_GOOD on success, or when no limit is set
+/// @note The connection managers of the event loop are wrapped before the server opens its connections.
+/// Without connection manager to wrap, every operation is charged, the samples of the monitored items included.
+UA_StatusCode session_limits_start(SessionLimits* limits, UA_Server* server){
+
+    UA_ServerConfig* server_config = UA_Server_getConfig(server);
+
+    if (!_enabled(&limits->config)) {
+        return UA_STATUSCODE_GOOD;
+    }
+
+    if (server_config->eventLoop) {
+        _wrap_managers(limits, server_config->eventLoop);
+    }
+    if (!limits->services_only) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                       "Session limits: no connection manager, the samples of the monitored items are charged");
+    }
+
+    return UA_Server_addRepeatedCallback(server, _round_callback, limits, SESSION_LIMITS_ROUND, &limits->callback_id);
+}
+
+/// @brief Open a connection of a wrapped connection manager
+/// @note The messages of the connections opened for the server reach it through _network_callback. The
+/// connections opened with another callback (reverse connect) are left as they are.
+static UA_StatusCode _open_connection(UA_ConnectionManager* cm, const UA_KeyValueMap* params, void* application,
+                                      void* context, UA_ConnectionManager_connectionCallback callback){
+
+    SessionLimits* limits = wrapping_limits;
+    size_t i = 0;
+
+    while (limits->managers[i].manager != cm) {
+        i++;
+    }
+
+    if (!limits->network_callback) {
+        limits->network_callback = callback;
+        limits->network_application = application;
+    }
+    if (callback != limits->network_callback || application != limits->network_application) {
+        return limits->managers[i].open_connection(cm, params, application, context, callback);
+    }
+
+    return limits->managers[i].open_connection(cm, params, limits, context, _network_callback);
+}
+
+/// @brief Process a message of a client connection, its operations are charged to their sessions
+static void _network_callback(UA_ConnectionManager* cm, uintptr_t connection_id, void* application,
+                              void** connection_context, UA_ConnectionState state, const UA_KeyValueMap* params,
+                              UA_ByteString msg){
+
+    SessionLimits* limits = (SessionLimits*)application;
+
+    limits->in_service = true;
+    limits->network_callback(cm, connection_id, limits->network_application, connection_context, state, params,
+                             msg);
+    limits->in_service = false;
+}
+
+/// @brief Whether the operation being checked is charged
+/// @return false for the operations run from the timers of the server, the samples of the monitored items
+static bool _charged(const SessionLimits* limits){
+    return !limits->services_only || limits->in_service;
+}
+
+/// @brief Give a budget to a new session
+/// @param limits The limits
+/// @param session_id The session
+/// @note Called when a session is activated, the session starts with a full bucket.
+void session_limits_open(SessionLimits* limits, const UA_NodeId* session_id){
+
+    SessionBudget* budget;
+    SessionBudget* sessions;
+    size_t capacity;
+
+    // A session activated again (new user, new channel) keeps its budget
+    if (_find(limits, session_id)) {
+        return;
+    }
+
+    if (limits->count == limits->capacity) {
+        capacity = limits->capacity ? limits->capacity * 2 : 8;
+        sessions = realloc(limits->sessions, capacity * sizeof(SessionBudget));
+        if (!sessions) {
+            fprintf(stderr, "Memory allocation failed for the session budgets\n");
+            exit(EXIT_FAILURE);
+        }
+        limits->sessions = sessions;
+        limits->capacity = capacity;
+    }
+
+    budget = &limits->sessions[limits->count];
+    memset(budget, 0, sizeof(SessionBudget));
+    UA_NodeId_copy(session_id, &budget->session_id);
+    budget->hash = UA_NodeId_hash(session_id);
+    budget->operations = isinf(limits->share) ? 0.0 : limits->share;
+    budget->bytes = limits->config.bytes_per_second;
+    _index_add(limits, limits->count);
+    limits->count++;
+}
+
+/// @brief Forget a closed session
+/// @param limits The limits
+/// @param session_id The session
+void session_limits_close(SessionLimits* limits, const UA_NodeId* session_id){
+
+    SessionBudget* budget = _find(limits, session_id);
+    size_t position;
+    size_t last;
+
+    if (!budget) {
+        return;
+    }
+
+    if (budget->refused > 0) {
+        UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_SESSION,
+                    "Session closed after %llu operations refused by its budget", (unsigned long long)budget->refused);
+    }
+
+    // The last session takes the place of the closed one
+    position = (size_t)(budget - limits->sessions);
+    last = limits->count - 1;
+    _index_remove(limits, _slot(limits, session_id, budget->hash));
+    UA_NodeId_clear(&budget->session_id);
+    if (position != last) {
+        limits->index[_slot(limits, &limits->sessions[last].session_id, limits->sessions[last].hash)] = position + 1;
+        *budget = limits->sessions[last];
+    }
+    limits->count--;
+}
+
+/// @brief Charge an operation to a session
+/// @param limits The limits
+/// @param session_id The session
+/// @param bytes Size of the value of the operation
+/// @return false if the session is past its budget, the operation must then be refused
+bool session_limits_charge(SessionLimits* limits, const UA_NodeId* session_id, size_t bytes){
+
+    SessionBudget* budget = _find(limits, session_id);
+
+    if (!budget) {
+        return true;
+    }
+
+    budget->used++;
+
+    // The bucket may go negative: the last operation before a refill runs whole
+    if ((!isinf(limits->share) && budget->operations <= 0.0) ||
+        (limits->config.bytes_per_second > 0 && budget->bytes <= 0.0)) {
+        budget->refused++;
+        budget->refused_in_round = true;
+        limits->refused++;
+        return false;
+    }
+
+    if (!isinf(limits->share)) {
+        budget->operations -= 1.0;
+    }
+    if (limits->config.bytes_per_second > 0) {
+        budget->bytes -= (UA_Double)(bytes + SESSION_LIMITS_OPERATION_BYTES);
+    }
+
+    return true;
+}
+
+/// @brief Refill the bucket of every session
+/// @param limits The limits
+/// @note Called every SESSION_LIMITS_ROUND by the limits callback.
+void session_limits_round(SessionLimits* limits){
+
+    size_t active = 0;
+    UA_Double round = SESSION_LIMITS_ROUND / 1000.0;
+    SessionBudget* budget;
+
+    // The server limit is shared by the sessions that used the server in the last round
+    for (size_t i = 0; i < limits->count; i++) {
+        if (limits->sessions[i].used > 0) {
+            active++;
+        }
+    }
+    limits->share = _share(limits, active);
+
+    for (size_t i = 0; i < limits->count; i++) {
+        budget = &limits->sessions[i];
+
+        if (!isinf(limits->share)) {
+            budget->operations += limits->share * round;
+            if (budget->operations > limits->share) {
+                budget->operations = limits->share;
+            }
+        }
+        if (limits->config.bytes_per_second > 0) {
+            budget->bytes += limits->config.bytes_per_second * round;
+            if (budget->bytes > limits->config.bytes_per_second) {
+                budget->bytes = limits->config.bytes_per_second;
+            }
+        }
+
+        if (budget->refused_in_round && !budget->throttled) {
+            _log_session("throttled by its budget", &budget->session_id);
+        } else if (!budget->refused_in_round && budget->throttled) {
+            _log_session("no longer throttled", &budget->session_id);
+        }
+        budget->throttled = budget->refused_in_round;
+        budget->refused_in_round = false;
+        budget->used = 0;
+    }
+}
+
+/// @brief Clear the wrapped access control, called by the server
+static void _clear(UA_AccessControl* ac){
+
+    SessionLimits* limits = (SessionLimits*)ac->context;
+
+    // The user token policies of ac are those of the wrapped copy
+    if (limits->wrapped.clear) {
+        limits->wrapped.clear(&limits->wrapped);
+    }
+    memset(ac, 0, sizeof(UA_AccessControl));
+}
+
+/// @brief Activate a session through the wrapped access control, then give it a budget
+static UA_StatusCode _activate_session(UA_Server* server, UA_AccessControl* ac,
+                                       const UA_EndpointDescription* endpoint_description,
+                                       const UA_ByteString* secure_channel_remote_certificate,
+                                       const UA_NodeId* session_id, const UA_ExtensionObject* user_identity_token,
+                                       void** session_context){
+
+    SessionLimits* limits = (SessionLimits*)ac->context;
+    UA_StatusCode retval = limits->wrapped.activateSession(server, &limits->wrapped, endpoint_description,
+                                                           secure_channel_remote_certificate, session_id,
+                                                           user_identity_token, session_context);
+
+    if (retval == UA_STATUSCODE_GOOD) {
+        session_limits_open(limits, session_id);
+    }
+
+    return retval;
+}
+
+/// @brief Close a session through the wrapped access control, then forget its budget
+static void _close_session(UA_Server* server, UA_AccessControl* ac, const UA_NodeId* session_id,
+                           void* session_context){
+
+    SessionLimits* limits = (SessionLimits*)ac->context;
+
+    limits->wrapped.closeSession(server, &limits->wrapped, session_id, session_context);
+    session_limits_close(limits, session_id);
+}
+
+/// @brief Access level of a session to a variable, 0 for a read or write past its budget
+static UA_Byte _get_user_access_level(UA_Server* server, UA_AccessControl* ac, const UA_NodeId* session_id,
+                                      void* session_context, const UA_NodeId* node_id, void* node_context){
+
+    SessionLimits* limits = (SessionLimits*)ac->context;
+    UA_Byte level = limits->wrapped.getUserAccessLevel(server, &limits->wrapped, session_id, session_context,
+                                                       node_id, node_context);
+
+    if (level == 0 || !_charged(limits)) {
+        return level;
+    }
+    if (!session_limits_charge(limits, session_id, _value_bytes(limits, node_id))) {
+        return 0;
+    }
+
+    return level;
+}
+
+/// @brief Whether a browsed node is returned to a session, false past its budget
+static UA_Boolean _allow_browse_node(UA_Server* server, UA_AccessControl* ac, const UA_NodeId* session_id,
+                                     void* session_context, const UA_NodeId* node_id, void* node_context){
+
+    SessionLimits* limits = (SessionLimits*)ac->context;
+
+    if (!limits->wrapped.allowBrowseNode(server, &limits->wrapped, session_id, session_context, node_id,
+                                         node_context)) {
+        return false;
+    }
+
+    return !_charged(limits) || session_limits_charge(limits, session_id, 0);
+}
+
+/// @brief Whether a session may call a method, false past its budget
+static UA_Boolean _get_user_executable_on_object(UA_Server* server, UA_AccessControl* ac,
+                                                 const UA_NodeId* session_id, void* session_context,
+                                                 const UA_NodeId* method_id, void* method_context,
+                                                 const UA_NodeId* object_id, void* object_context){
+
+    SessionLimits* limits = (SessionLimits*)ac->context;
+
+    if (!limits->wrapped.getUserExecutableOnObject(server, &limits->wrapped, session_id, session_context, method_id,
+                                                   method_context, object_id, object_context)) {
+        return false;
+    }
+
+    return !_charged(limits) || session_limits_charge(limits, session_id, 0);
+}
+
+/// @brief Free the memory of the limits
+/// @param limits Pointer to the SessionLimits structure to free
+/// @note The server must be deleted first, its access control and its connection managers call the limits.
+void free_session_limits(SessionLimits* limits){
+
+    for (size_t i = 0; i < limits->count; i++) {
+        UA_NodeId_clear(&limits->sessions[i].session_id);
+    }
+    free(limits->sessions);
+    free(limits->index);
+    limits->sessions = NULL;
+    limits->index = NULL;
+    limits->count = 0;
+    limits->capacity = 0;
+    limits->index_capacity = 0;
+    if (wrapping_limits == limits) {
+        wrapping_limits = NULL;
+    }
+}
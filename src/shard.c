@@ -0,0 +1,492 @@
+#include "../include/shard.h"
+#include "../include/upstream.h"
+
+#include <open62541/plugin/log_stdout.h>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void _stop_worker(int sig);
+static void _close_inherited(void);
+static void _sync_worker(Shards* shards, size_t shard, Gateway* gateway);
+static void _run_worker(Shards* shards, size_t shard);
+static void _spawn(Shards* shards, size_t shard);
+static void _lost(Shards* shards, size_t shard);
+static void _read_callback(UA_Server* server, void* data);
+
+/// @brief Set by the signals stopping a worker
+static volatile sig_atomic_t worker_stopping = 0;
+
+
+/// @brief Signal handler of a worker
+static void _stop_worker(int sig){
+    (void)sig;
+    worker_stopping = 1;
+}
+
+/// @brief Close every descriptor inherited from the front except the standard streams
+/// @note The front forks its workers again while it serves: without this a worker would hold its listening
+/// socket, its client sockets and its replication link open, and the rings are mappings without descriptor.
+static void _close_inherited(void){
+
+    long max = sysconf(_SC_OPEN_MAX);
+
+#if defined(__linux__) && defined(SYS_close_range)
+    if (syscall(SYS_close_range, 3U, ~0U, 0U) == 0) return;
+#endif
+
+    if (max < 0 || max > 65536) max = 65536;
+    for (int fd = 3; fd < max; fd++) close(fd);
+}
+
+/// @brief Take the blocked machines from the front and give it the values dropped on the full ring
+/// @param shards The shards, the shared mapping is the same in both processes
+/// @param shard Index of the worker
+/// @param gateway The gateway of the worker
+static void _sync_worker(Shards* shards, size_t shard, Gateway* gateway){
+
+    AddressSpace* address_space = gateway->address_space;
+
+    for (size_t m = 0; m < address_space->count; m++) {
+        size_t groups = address_space->machines[m].config->groups.count;
+
+        if (shards->machine_shard[m] != shard) continue;
+
+        gateway->machine_blocked[m] = atomic_load_explicit(&shards->blocked[m], memory_order_relaxed);
+        for (size_t g = gateway->first_group[m]; g < gateway->first_group[m] + groups; g++) {
+            if (gateway->group_overflows[g] == 0) continue;
+
+            atomic_fetch_add_explicit(&shards->overflows[g], gateway->group_overflows[g], memory_order_relaxed);
+            gateway->group_overflows[g] = 0;
+        }
+    }
+}
+
+/// @brief Body of a worker process, never returns
+/// @param shards The shards, as copied by fork
+/// @param shard Index of the worker
+/// @note The worker starts from a copy of the front gateway whose values go to its ring. It exits when
+/// it is stopped or when the front is gone.
+static void _run_worker(Shards* shards, size_t shard){
+
+    AddressSpace* address_space = shards->gateway->address_space;
+    ShardRing* ring = shards->workers[shard].ring;
+    Gateway gateway = *shards->gateway;
+    Upstream upstream;
+    bool* selected;
+
+    signal(SIGINT, _stop_worker);
+    signal(SIGTERM, _stop_worker);
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+    if (getppid() != shards->front) _exit(EXIT_SUCCESS);
+
+    // Aggregates, expressions, replication and the shared-memory table stay in the front
+    gateway.shm = NULL;
+    gateway.aggregates = NULL;
+    gateway.expressions = NULL;
+    gateway.replication = NULL;
+    gateway.shard = ring;
+    gateway.machine_blocked = (size_t*)calloc(address_space->count, sizeof(size_t));
+    gateway.group_overflows = (UA_UInt64*)calloc(shards->gateway->first_group[address_space->count], sizeof(UA_UInt64));
+    selected = (bool*)calloc(address_space->count, sizeof(bool));
+    if (!gateway.machine_blocked || !gateway.group_overflows || !selected) {
+        fprintf(stderr, "Failed to allocate memory for the shard worker\n");
+        _exit(EXIT_FAILURE);
+    }
+
+    for (size_t m = 0; m < address_space->count; m++) {
+        selected[m] = shards->machine_shard[m] == shard;
+    }
+    init_upstream_machines(&upstream, &gateway, selected);
+    free(selected);
+
+    UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Shard %zu (pid %d) serves %zu machines",
+                shard, (int)getpid(), upstream.count);
+    upstream_start(&upstream, NULL);
+
+    while (!worker_stopping && getppid() == shards->front) {
+        // Backpressure: a blocked machine pauses its subscription, and all of them wait while the front catches up
+        _sync_worker(shards, shard, &gateway);
+        if (shard_ring_free(ring) >= ring->size / 2) upstream_iterate(&upstream);
+        usleep((useconds_t)(UPSTREAM_ITERATE_INTERVAL * 1000));
+    }
+
+    free_upstream(&upstream);
+    _sync_worker(shards, shard, &gateway);
+    free(gateway.machine_blocked);
+    free(gateway.group_overflows);
+    _exit(EXIT_SUCCESS);
+}
+
+/// @brief Fork a worker
+/// @param shards The shards
+/// @param shard Index of the worker
+/// @note A failed fork is retried after SHARD_RESTART_DELAY.
+static void _spawn(Shards* shards, size_t shard){
+
+    ShardWorker* worker = &shards->workers[shard];
+    pid_t pid;
+
+    // Buffered output would be written twice
+    fflush(NULL);
+
+    pid = fork();
+    if (pid == 0) {
+        _close_inherited();
+        _run_worker(shards, shard);
+    }
+
+    if (pid < 0) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Failed to fork shard %zu", shard);
+        worker->restart_at = UA_DateTime_nowMonotonic() + SHARD_RESTART_DELAY * UA_DATETIME_MSEC;
+        return;
+    }
+
+    worker->pid = pid;
+}
+
+/// @brief Mark the upstream items of the machines of a worker that exited
+/// @param shards The shards
+/// @param shard Index of the worker
+static void _lost(Shards* shards, size_t shard){
+
+    AddressSpace* address_space = shards->gateway->address_space;
+    UA_DataValue value;
+
+    for (size_t m = 0; m < address_space->count; m++) {
+        AddressSpaceMachine* machine = &address_space->machines[m];
+        ArrayGroup* groups = &machine->config->groups;
+
+        if (shards->machine_shard[m] != shard) continue;
+
+        for (size_t g = 0; g < groups->count; g++) {
+            for (size_t i = 0; i < groups->groups[g].items.count; i++) {
+                if (groups->groups[g].items.items[i].source != ITEM_SOURCE_UPSTREAM) continue;
+
+                UA_DataValue_init(&value);
+                value.hasStatus = true;
+                value.status = UA_STATUSCODE_BADNOCOMMUNICATION;
+                value.sourceTimestamp = UA_DateTime_now();
+                value.hasSourceTimestamp = true;
+                gateway_push(shards->gateway, machine->first_item + machine->group_first_item[g] + i, &value);
+            }
+        }
+    }
+}
+
+/// @brief Repeated front callback reading the rings and restarting the workers
+/// @param server Pointer to the UA_Server instance
+/// @param data The shards
+static void _read_callback(UA_Server* server, void* data){
+
+    Shards* shards = (Shards*)data;
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    int status;
+
+    (void)server;
+
+    shards->received += shard_exchange(shards);
+
+    for (size_t w = 0; w < shards->count; w++) {
+        ShardWorker* worker = &shards->workers[w];
+
+        if (worker->pid > 0 && waitpid(worker->pid, &status, WNOHANG) == worker->pid) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND,
+                           "Shard %zu exited (%s %d, %llu values dropped), restarting it in %d ms", w,
+                           WIFSIGNALED(status) ? "signal" : "status",
+                           WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status),
+                           (unsigned long long)atomic_load_explicit(&worker->ring->dropped, memory_order_relaxed),
+                           SHARD_RESTART_DELAY);
+
+            // The last values of the worker come before the loss of its machines
+            shards->received += shard_ring_read(worker->ring, shards->gateway);
+            _lost(shards, w);
+            worker->pid = -1;
+            worker->restart_at = now + SHARD_RESTART_DELAY * UA_DATETIME_MSEC;
+        } else if (worker->pid < 0 && now >= worker->restart_at) {
+            worker->restarts++;
+            _spawn(shards, w);
+        }
+    }
+}
+
+/// @brief Spread the machines over the workers and map their rings
+/// @param shards Pointer to the Shards structure to initialize
+/// @param gateway The gateway of the front, the workers start from a copy of it
+/// @param count Number of workers, at most SHARD_MAX
+/// @note The machines with an URL are assigned from the largest to the smallest to the worker with
+/// the fewest items so far. No process is forked before shard_start.
+void init_shards(Shards* shards, Gateway* gateway, size_t count){
+
+    AddressSpace* address_space;
+    size_t loads[SHARD_MAX] = {0};
+
+    if (!shards) return;
+
+    memset(shards, 0, sizeof(Shards));
+    if (!gateway || count == 0) return;
+    if (count > SHARD_MAX) count = SHARD_MAX;
+
+    address_space = gateway->address_space;
+    shards->gateway = gateway;
+    shards->count = count;
+    shards->front = getpid();
+    shards->workers = (ShardWorker*)calloc(count, sizeof(ShardWorker));
+    shards->machine_shard = (size_t*)malloc((address_space->count + 1) * sizeof(size_t));
+    if (!shards->workers || !shards->machine_shard) {
+        fprintf(stderr, "Failed to allocate memory for the shards\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Machines without an URL belong to no worker
+    for (size_t m = 0; m < address_space->count; m++) {
+        shards->machine_shard[m] = address_space->machines[m].config->url ? SIZE_MAX - 1 : SIZE_MAX;
+    }
+
+    for (;;) {
+        size_t largest = SIZE_MAX;
+        size_t lightest = 0;
+
+        for (size_t m = 0; m < address_space->count; m++) {
+            if (shards->machine_shard[m] != SIZE_MAX - 1) continue;
+            if (largest == SIZE_MAX || address_space->machines[m].item_count > address_space->machines[largest].item_count) {
+                largest = m;
+            }
+        }
+        if (largest == SIZE_MAX) break;
+
+        for (size_t w = 1; w < count; w++) {
+            if (loads[w] < loads[lightest]) lightest = w;
+        }
+
+        shards->machine_shard[largest] = lightest;
+        loads[lightest] += address_space->machines[largest].item_count;
+    }
+
+    // Shared with the workers, zeroed like the rings
+    shards->shared_size = gateway->first_group[address_space->count] * sizeof(uint64_t) +
+                          (address_space->count + 1) * sizeof(uint32_t);
+    shards->overflows = (_Atomic uint64_t*)mmap(NULL, shards->shared_size, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shards->overflows == MAP_FAILED) {
+        fprintf(stderr, "Failed to map the state shared with the shards\n");
+        exit(EXIT_FAILURE);
+    }
+    shards->blocked = (_Atomic uint32_t*)(shards->overflows + gateway->first_group[address_space->count]);
+
+    for (size_t w = 0; w < count; w++) {
+        shards->workers[w].pid = -1;
+        shards->workers[w].ring = shard_ring_create(SHARD_RING_SIZE);
+        if (!shards->workers[w].ring) {
+            fprintf(stderr, "Failed to map the ring of shard %zu\n", w);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/// @brief Fork the workers and add the callback reading their rings
+/// @param shards The shards
+/// @param server Pointer to the UA_Server instance of the front
+/// @return UA_STATUSCODE_GOOD on success
+/// @note Call in place of upstream_start, before UA_Server_run_startup.
+UA_StatusCode shard_start(Shards* shards, UA_Server* server){
+
+    if (!shards || !server || shards->count == 0) return UA_STATUSCODE_BADINTERNALERROR;
+
+    for (size_t w = 0; w < shards->count; w++) {
+        _spawn(shards, w);
+    }
+
+    return UA_Server_addRepeatedCallback(server, _read_callback, shards, SHARD_INTERVAL, &shards->callback_id);
+}
+
+/// @brief Read the rings of the workers and share the state of their machines with them
+/// @param shards The shards
+/// @return Number of values read
+/// @note Called by the front callback. Every ring is drained, a blocked machine does not hold back the other
+/// machines of its worker: its flag tells the worker to pause its subscription. The values the workers
+/// dropped on a full ring are added to the overflows of their Groups.
+size_t shard_exchange(Shards* shards){
+
+    Gateway* gateway;
+    size_t read = 0;
+
+    if (!shards || shards->count == 0) return 0;
+
+    gateway = shards->gateway;
+    for (size_t w = 0; w < shards->count; w++) {
+        read += shard_ring_read(shards->workers[w].ring, gateway);
+    }
+
+    for (size_t m = 0; m < gateway->address_space->count; m++) {
+        atomic_store_explicit(&shards->blocked[m], gateway_machine_blocked(gateway, m), memory_order_relaxed);
+    }
+    for (size_t g = 0; g < gateway->first_group[gateway->address_space->count]; g++) {
+        gateway->group_overflows[g] += atomic_exchange_explicit(&shards->overflows[g], 0, memory_order_relaxed);
+    }
+
+    return read;
+}
+
+/// @brief Map a shared ring
+/// @param size Size of the data of the ring, a power of two
+/// @return The ring, NULL on failure
+ShardRing* shard_ring_create(size_t size){
+
+    ShardRing* ring;
+
+    if (size < 2 * sizeof(ShardRecord) || (size & (size - 1)) != 0) return NULL;
+
+    // Anonymous shared mappings are zeroed and survive fork in both processes
+    ring = (ShardRing*)mmap(NULL, sizeof(ShardRing) + size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) return NULL;
+
+    ring->size = size;
+
+    return ring;
+}
+
+/// @brief Write a value into a ring
+/// @param ring The ring
+/// @param item Global index of the item
+/// @param value The value, only read
+/// @return false if the value cannot be encoded or the ring is full, the value is then dropped
+bool shard_ring_write(ShardRing* ring, size_t item, const UA_DataValue* value){
+
+    ShardRecord record;
+    UA_ByteString encoded;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t offset;
+    uint64_t space;
+    uint64_t length;
+    size_t size;
+
+    if (!ring || !value || item >= SHARD_RECORD_WRAP) return false;
+
+    size = UA_calcSizeBinary(value, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    length = (sizeof(ShardRecord) + size + 7) & ~(uint64_t)7;
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    offset = head & (ring->size - 1);
+    space = ring->size - offset;
+
+    if (size == 0 || length > ring->size / 2 || head + length + (space < length ? space : 0) - tail > ring->size) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    if (space < length) {
+        record.item = SHARD_RECORD_WRAP;
+        record.length = 0;
+        memcpy(ring->data + offset, &record, sizeof(record));
+        head += space;
+        offset = 0;
+    }
+
+    record.item = (uint32_t)item;
+    record.length = (uint32_t)size;
+    memcpy(ring->data + offset, &record, sizeof(record));
+
+    encoded.data = ring->data + offset + sizeof(record);
+    encoded.length = size;
+    if (UA_encodeBinary(value, &UA_TYPES[UA_TYPES_DATAVALUE], &encoded) != UA_STATUSCODE_GOOD) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    atomic_store_explicit(&ring->head, head + length, memory_order_release);
+
+    return true;
+}
+
+/// @brief Push the values of a ring into a gateway
+/// @param ring The ring
+/// @param gateway The gateway receiving the values
+/// @return Number of values read
+size_t shard_ring_read(ShardRing* ring, Gateway* gateway){
+
+    uint64_t tail;
+    uint64_t head;
+    size_t read = 0;
+
+    if (!ring || !gateway) return 0;
+
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    while (tail < head) {
+        uint64_t offset = tail & (ring->size - 1);
+        ShardRecord record;
+        UA_ByteString encoded;
+        UA_DataValue value;
+
+        memcpy(&record, ring->data + offset, sizeof(record));
+        if (record.item == SHARD_RECORD_WRAP) {
+            tail += ring->size - offset;
+            continue;
+        }
+
+        encoded.data = ring->data + offset + sizeof(record);
+        encoded.length = record.length;
+        if (UA_decodeBinary(&encoded, &value, &UA_TYPES[UA_TYPES_DATAVALUE], NULL) == UA_STATUSCODE_GOOD) {
+            gateway_push(gateway, record.item, &value);
+            read++;
+        }
+
+        tail += (sizeof(record) + record.length + 7) & ~(uint64_t)7;
+    }
+
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+    return read;
+}
+
+/// @brief Number of bytes that can be written into a ring
+/// @param ring The ring
+/// @return Free bytes, a record may still not fit when the end of the ring is too short
+size_t shard_ring_free(const ShardRing* ring){
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    return (size_t)(ring->size - (head - tail));
+}
+
+/// @brief Unmap a ring
+/// @param ring The ring or NULL
+void shard_ring_destroy(ShardRing* ring){
+    if (ring) munmap(ring, sizeof(ShardRing) + ring->size);
+}
+
+/// @brief Stop the workers and free the memory of the shards
+/// @param shards Pointer to the Shards structure to free
+/// @note The server must be stopped first, the front callback uses the shards.
+void free_shards(Shards* shards){
+
+    if (!shards) return;
+
+    for (size_t w = 0; w < shards->count; w++) {
+        if (shards->workers[w].pid > 0) kill(shards->workers[w].pid, SIGTERM);
+    }
+    for (size_t w = 0; w < shards->count; w++) {
+        if (shards->workers[w].pid > 0) waitpid(shards->workers[w].pid, NULL, 0);
+        shard_ring_destroy(shards->workers[w].ring);
+    }
+
+    if (shards->overflows) munmap((void*)shards->overflows, shards->shared_size);
+    free(shards->workers);
+    free(shards->machine_shard);
+    memset(shards, 0, sizeof(Shards));
+}
@@ -0,0 +1,184 @@
+#include "../include/shm_reader.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// @brief Number of attempts before a slot that keeps changing is reported as unreadable
+#define SHM_READER_RETRIES 64
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static int _compare_name(const ShmReader* reader, const ShmTableEntry* entry, const char* path, size_t length);
+
+
+/// @brief Compare the name of a directory entry with a path
+/// @return <0, 0 or >0 like strcmp
+static int _compare_name(const ShmReader* reader, const ShmTableEntry* entry, const char* path, size_t length){
+    size_t shortest = entry->name_length < length ? entry->name_length : length;
+    int order = memcmp(reader->names + entry->name_offset, path, shortest);
+
+    if (order != 0) return order;
+    if (entry->name_length == length) return 0;
+
+    return entry->name_length < length ? -1 : 1;
+}
+
+/// @brief Map the table published by the gateway
+/// @param reader Pointer to the ShmReader structure to initialize
+/// @param name Name of the segment as given to the gateway (e.g. "/opcuaserver")
+/// @return true on success, false if the segment does not exist or is not a value table
+bool shm_reader_open(ShmReader* reader, const char* name){
+
+    struct stat info;
+    const ShmTableHeader* header;
+    int fd;
+
+    if (!reader || !name) return false;
+
+    memset(reader, 0, sizeof(ShmReader));
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ShmTableHeader)) {
+        close(fd);
+        return false;
+    }
+
+    reader->size = (size_t)info.st_size;
+    reader->base = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (reader->base == MAP_FAILED) {
+        memset(reader, 0, sizeof(ShmReader));
+        return false;
+    }
+
+    header = (const ShmTableHeader*)reader->base;
+    if (header->magic != SHM_TABLE_MAGIC || header->version != SHM_TABLE_VERSION || header->size > reader->size) {
+        shm_reader_close(reader);
+        return false;
+    }
+
+    reader->header = header;
+    reader->directory = (const ShmTableEntry*)((const char*)reader->base + header->directory_offset);
+    reader->names = (const char*)reader->base + header->names_offset;
+    reader->slots = (const ShmTableSlot*)((const char*)reader->base + header->slots_offset);
+
+    return true;
+}
+
+/// @brief Find the slot of an item
+/// @param reader The reader
+/// @param path Item path "<machine>/<group>/<item>"
+/// @param slot Output receiving the slot index
+/// @return true if the item exists, false otherwise
+bool shm_reader_find(const ShmReader* reader, const char* path, size_t* slot){
+
+    size_t low = 0;
+    size_t high;
+    size_t length;
+
+    if (!reader || !reader->header || !path || !slot) return false;
+
+    length = strlen(path);
+    high = (size_t)reader->header->slot_count;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        int order = _compare_name(reader, &reader->directory[middle], path, length);
+
+        if (order == 0) {
+            *slot = (size_t)reader->directory[middle].slot;
+            return true;
+        }
+
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return false;
+}
+
+/// @brief Read a consistent copy of a slot
+/// @param reader The reader
+/// @param slot Index of the slot
+/// @param value Output receiving the copy
+/// @return true on success, false if the slot is out of range or kept changing during the copy
+bool shm_reader_read(const ShmReader* reader, size_t slot, ShmTableSlot* value){
+
+    const ShmTableSlot* source;
+
+    if (!reader || !reader->header || !value || slot >= reader->header->slot_count) return false;
+
+    source = &reader->slots[slot];
+
+    for (int attempt = 0; attempt < SHM_READER_RETRIES; attempt++) {
+        uint32_t before = __atomic_load_n(&source->sequence, __ATOMIC_ACQUIRE);
+
+        // The writer is in the middle of an update
+        if (before & 1u) continue;
+
+        memcpy(value, source, sizeof(ShmTableSlot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&source->sequence, __ATOMIC_RELAXED) == before) {
+            value->sequence = before;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// @brief Get the number of items of the table
+/// @param reader The reader
+/// @return Number of slots and directory entries
+size_t shm_reader_count(const ShmReader* reader){
+    return reader && reader->header ? (size_t)reader->header->slot_count : 0;
+}
+
+/// @brief Get the name of a directory entry
+/// @param reader The reader
+/// @param entry Index of the entry, in name order
+/// @param length Output receiving the length of the name, the name is not zero terminated
+/// @param slot Output receiving the slot of the entry
+/// @return Pointer to the name in the segment
+const char* shm_reader_entry(const ShmReader* reader, size_t entry, size_t* length, size_t* slot){
+
+    const ShmTableEntry* directory_entry;
+
+    if (!reader || !reader->header || entry >= reader->header->slot_count) return NULL;
+
+    directory_entry = &reader->directory[entry];
+    if (length) *length = directory_entry->name_length;
+    if (slot) *slot = (size_t)directory_entry->slot;
+
+    return reader->names + directory_entry->name_offset;
+}
+
+/// @brief Check if the gateway abandoned the table
+/// @param reader The reader
+/// @return true once the gateway stopped, the reader should reopen the segment
+bool shm_reader_stale(const ShmReader* reader){
+    return !reader || !reader->header || __atomic_load_n(&reader->header->open, __ATOMIC_ACQUIRE) == 0;
+}
+
+/// @brief Unmap the table
+/// @param reader Pointer to the ShmReader structure to close
+void shm_reader_close(ShmReader* reader){
+
+    if (!reader) return;
+
+    if (reader->base && reader->base != MAP_FAILED) {
+        munmap(reader->base, reader->size);
+    }
+
+    memset(reader, 0, sizeof(ShmReader));
+}
@@ -0,0 +1,235 @@
+#include "../include/shm_table.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+    char* name;
+    size_t slot;
+} ShmTableName;
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static int _compare_names(const void* a, const void* b);
+static ShmTableName* _collect_names(const AddressSpace* address_space, size_t* names_size);
+static void _set_value(ShmTableSlot* slot, const UA_Variant* value);
+
+
+/// @brief qsort comparison of two item names
+static int _compare_names(const void* a, const void* b){
+    return strcmp(((const ShmTableName*)a)->name, ((const ShmTableName*)b)->name);
+}
+
+/// @brief Build the sorted names of every item of the layout
+/// @param address_space Layout of the gateway namespaces
+/// @param names_size Output receiving the total length of the names
+/// @return Array of item_count names, sorted, freed by the caller
+static ShmTableName* _collect_names(const AddressSpace* address_space, size_t* names_size){
+
+    ShmTableName* names = (ShmTableName*)calloc(address_space->item_count + 1, sizeof(ShmTableName));
+    char buffer[1024];
+
+    if (!names) {
+        fprintf(stderr, "Failed to allocate memory for ShmTable\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *names_size = 0;
+    for (size_t i = 0; i < address_space->item_count; i++) {
+        address_space_item_path(address_space, i, buffer, sizeof(buffer));
+
+        names[i].name = strdup(buffer);
+        names[i].slot = i;
+        *names_size += strlen(buffer);
+    }
+
+    qsort(names, address_space->item_count, sizeof(ShmTableName), _compare_names);
+
+    return names;
+}
+
+/// @brief Convert a scalar value of a built-in type into the slot representation
+/// @param slot The slot, being written
+/// @param value The value
+static void _set_value(ShmTableSlot* slot, const UA_Variant* value){
+
+    const UA_DataType* type = value->type;
+    const void* data = value->data;
+
+    slot->type = SHM_VALUE_EMPTY;
+    slot->length = 0;
+    slot->value.u = 0;
+
+    if (!UA_Variant_isScalar(value) || !data) return;
+
+    if (type == &UA_TYPES[UA_TYPES_BOOLEAN]) {
+        slot->type = SHM_VALUE_BOOLEAN;
+        slot->value.i = *(const UA_Boolean*)data ? 1 : 0;
+    } else if (type == &UA_TYPES[UA_TYPES_SBYTE]) {
+        slot->type = SHM_VALUE_INT;
+        slot->value.i = *(const UA_SByte*)data;
+    } else if (type == &UA_TYPES[UA_TYPES_INT16]) {
+        slot->type = SHM_VALUE_INT;
+        slot->value.i = *(const UA_Int16*)data;
+    } else if (type == &UA_TYPES[UA_TYPES_INT32]) {
+        slot->type = SHM_VALUE_INT;
+        slot->value.i = *(const UA_Int32*)data;
+    } else if (type == &UA_TYPES[UA_TYPES_INT64]) {
+        slot->type = SHM_VALUE_INT;
+        slot->value.i = *(const UA_Int64*)data;
+    } else if (type == &UA_TYPES[UA_TYPES_BYTE]) {
+        slot->type = SHM_VALUE_UINT;
+        slot->value.u = *(const UA_Byte*)data;
+    } else if (type == &UA_TYPES[UA_TYPES_UINT16]) {
+        slot->type = SHM_VALUE_UINT;
+        slot->value.u = *(const UA_UInt16*)data;
+    } else if (type == &UA_TYPES[UA_TYPES_UINT32]) {
+        slot->type = SHM_VALUE_UINT;
+        slot->value.u = *(const UA_UInt32*)data;
+    } else if (type == &UA_TYPES[UA_TYPES_UINT64]) {
+        slot->type = SHM_VALUE_UINT;
+        slot->value.u = *(const UA_UInt64*)data;
+    } else if (type == &UA_TYPES[UA_TYPES_FLOAT]) {
+        slot->type = SHM_VALUE_DOUBLE;
+        slot->value.d = *(const UA_Float*)data;
+    } else if (type == &UA_TYPES[UA_TYPES_DOUBLE]) {
+        slot->type = SHM_VALUE_DOUBLE;
+        slot->value.d = *(const UA_Double*)data;
+    } else if (type == &UA_TYPES[UA_TYPES_DATETIME]) {
+        slot->type = SHM_VALUE_DATETIME;
+        slot->value.i = *(const UA_DateTime*)data;
+    } else if (type == &UA_TYPES[UA_TYPES_STRING]) {
+        const UA_String* text = (const UA_String*)data;
+
+        slot->type = SHM_VALUE_STRING;
+        slot->length = (uint32_t)(text->length < SHM_TABLE_TEXT_SIZE ? text->length : SHM_TABLE_TEXT_SIZE);
+        if (slot->length > 0) memcpy(slot->text, text->data, slot->length);
+    }
+}
+
+/// @brief Create the segment and write the directory of the layout
+/// @param table Pointer to the ShmTable structure to initialize
+/// @param name Name of the POSIX shared-memory segment (e.g. "/opcuaserver")
+/// @param address_space Layout of the gateway namespaces
+/// @return true on success, false otherwise
+/// @note A segment left by a previous run with the same name is replaced.
+bool shm_table_open(ShmTable* table, const char* name, const AddressSpace* address_space){
+
+    ShmTableName* names;
+    ShmTableHeader header = {0};
+    ShmTableEntry* directory;
+    size_t names_size;
+    size_t offset = 0;
+    size_t count;
+    char* base;
+    int fd;
+
+    if (!table || !name || !address_space) return false;
+
+    memset(table, 0, sizeof(ShmTable));
+    count = address_space->item_count;
+    names = _collect_names(address_space, &names_size);
+
+    header.magic = SHM_TABLE_MAGIC;
+    header.version = SHM_TABLE_VERSION;
+    header.slot_count = count;
+    header.directory_offset = sizeof(ShmTableHeader);
+    header.names_offset = header.directory_offset + count * sizeof(ShmTableEntry);
+    header.slots_offset = (header.names_offset + names_size + 63) & ~(uint64_t)63;
+    header.size = header.slots_offset + count * sizeof(ShmTableSlot);
+
+    // Readers of a previous run keep their mapping, new readers get the new segment
+    shm_unlink(name);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)header.size) != 0) {
+        fprintf(stderr, "Failed to create the shared-memory segment %s: %s\n", name, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(name);
+        }
+        for (size_t i = 0; i < count; i++) free(names[i].name);
+        free(names);
+        return false;
+    }
+
+    base = (char*)mmap(NULL, header.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Failed to map the shared-memory segment %s: %s\n", name, strerror(errno));
+        shm_unlink(name);
+        for (size_t i = 0; i < count; i++) free(names[i].name);
+        free(names);
+        return false;
+    }
+
+    directory = (ShmTableEntry*)(base + header.directory_offset);
+    for (size_t i = 0; i < count; i++) {
+        size_t length = strlen(names[i].name);
+
+        directory[i].name_offset = (uint32_t)offset;
+        directory[i].name_length = (uint32_t)length;
+        directory[i].slot = names[i].slot;
+        memcpy(base + header.names_offset + offset, names[i].name, length);
+        offset += length;
+        free(names[i].name);
+    }
+    free(names);
+
+    table->name = strdup(name);
+    table->base = base;
+    table->size = header.size;
+    table->header = (ShmTableHeader*)base;
+    table->slots = (ShmTableSlot*)(base + header.slots_offset);
+
+    for (size_t i = 0; i < count; i++) {
+        table->slots[i].status = UA_STATUSCODE_BADWAITINGFORINITIALDATA;
+    }
+
+    // The header is written last, readers check the magic before anything else
+    header.open = 1;
+    memcpy(table->header, &header, sizeof(ShmTableHeader));
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    return true;
+}
+
+/// @brief Copy a value into the slot of an item
+/// @param table The table
+/// @param slot Global index of the item
+/// @param value The value, only scalars of the built-in types are kept
+void shm_table_write(ShmTable* table, size_t slot, const UA_DataValue* value){
+
+    ShmTableSlot* target;
+    uint32_t sequence;
+
+    if (!table || !table->header || !value || slot >= table->header->slot_count) return;
+
+    target = &table->slots[slot];
+    sequence = target->sequence;
+
+    __atomic_store_n(&target->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    target->status = value->hasStatus ? value->status : UA_STATUSCODE_GOOD;
+    target->source_timestamp = value->hasSourceTimestamp ? value->sourceTimestamp : 0;
+    target->server_timestamp = value->hasServerTimestamp ? value->serverTimestamp : 0;
+    _set_value(target, &value->value);
+
+    __atomic_store_n(&target->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/// @brief Mark the table abandoned, unmap and remove the segment
+/// @param table Pointer to the ShmTable structure to close
+/// @note Readers keep their mapping until they close it.
+void shm_table_close(ShmTable* table){
+
+    if (!table || !table->base) return;
+
+    __atomic_store_n(&table->header->open, 0, __ATOMIC_RELEASE);
+    munmap(table->base, table->size);
+    shm_unlink(table->name);
+    free(table->name);
+    memset(table, 0, sizeof(ShmTable));
+}
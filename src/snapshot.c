@@ -0,0 +1,258 @@
+#include "../include/snapshot.h"
+
+#include <open62541/plugin/log_stdout.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// @brief Maximum length of an item path in a snapshot
+#define SNAPSHOT_MAX_PATH 1024
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static bool _write_record(FILE* file, const char* item_path, const UA_DataValue* value, UA_ByteString* buffer);
+
+
+/// @brief Append the record of an item to a snapshot
+/// @param file The snapshot being written
+/// @param item_path Path of the item
+/// @param value The value of the item
+/// @param buffer Encoding buffer reused across records, grown as needed
+/// @return false if the value cannot be encoded or written
+static bool _write_record(FILE* file, const char* item_path, const UA_DataValue* value, UA_ByteString* buffer){
+
+    SnapshotRecord record = {0};
+    size_t size = UA_calcSizeBinary(value, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    UA_ByteString encoded;
+
+    if (size == 0 || size > UINT32_MAX) return false;
+
+    if (buffer->length < size) {
+        UA_ByteString_clear(buffer);
+        if (UA_ByteString_allocBuffer(buffer, size) != UA_STATUSCODE_GOOD) return false;
+    }
+
+    encoded.data = buffer->data;
+    encoded.length = size;
+    if (UA_encodeBinary(value, &UA_TYPES[UA_TYPES_DATAVALUE], &encoded) != UA_STATUSCODE_GOOD) return false;
+
+    record.path_length = (uint16_t)strlen(item_path);
+    record.value_length = (uint32_t)encoded.length;
+
+    return fwrite(&record, sizeof(record), 1, file) == 1 &&
+           fwrite(item_path, 1, record.path_length, file) == record.path_length &&
+           fwrite(encoded.data, 1, encoded.length, file) == encoded.length;
+}
+
+/// @brief Write the values of the items to a snapshot file
+/// @param path Path of the snapshot, replaced atomically
+/// @param address_space Layout of the gateway namespaces
+/// @param values Value of every item, indexed by global item index, values without hasValue are skipped
+/// @return Number of values written, 0 with a message on failure
+size_t snapshot_write(const char* path, const AddressSpace* address_space, const UA_DataValue* values){
+
+    SnapshotHeader header = {0};
+    UA_ByteString buffer = UA_BYTESTRING_NULL;
+    char item_path[SNAPSHOT_MAX_PATH];
+    char temporary[4096];
+    bool ok = true;
+    FILE* file;
+
+    if (!path || !address_space || !values) return 0;
+
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    file = fopen(temporary, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to create the snapshot %s\n", temporary);
+        return 0;
+    }
+
+    // The header is rewritten with the final count once the records are written
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.written = UA_DateTime_now();
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (size_t i = 0; ok && i < address_space->item_count; i++) {
+        size_t length;
+
+        if (!values[i].hasValue) continue;
+
+        length = address_space_item_path(address_space, i, item_path, sizeof(item_path));
+        if (length == 0 || length >= sizeof(item_path) || length > UINT16_MAX) continue;
+
+        if (_write_record(file, item_path, &values[i], &buffer)) {
+            header.count++;
+        } else {
+            ok = !ferror(file);
+        }
+    }
+    UA_ByteString_clear(&buffer);
+
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || rename(temporary, path) != 0) {
+        fprintf(stderr, "Failed to write the snapshot %s\n", path);
+        remove(temporary);
+        return 0;
+    }
+
+    return header.count;
+}
+
+/// @brief Read the values of a snapshot file for the items of a layout
+/// @param path Path of the snapshot
+/// @param address_space Layout of the gateway namespaces
+/// @param values Array of item_count values receiving the values found, others are left untouched
+/// @param written Receives the UA_DateTime at which the snapshot was written, may be NULL
+/// @return Number of values read, 0 if the file is missing or invalid
+/// @note Good values are returned with the status UncertainLastUsableValue.
+size_t snapshot_read(const char* path, const AddressSpace* address_space, UA_DataValue* values, UA_DateTime* written){
+
+    const SnapshotHeader* header;
+    const unsigned char* cursor;
+    const unsigned char* end;
+    struct stat status;
+    size_t read = 0;
+    void* base;
+    int fd;
+
+    if (!path || !address_space || !values) return 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    base = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return 0;
+
+    header = (const SnapshotHeader*)base;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 || header->version != SNAPSHOT_VERSION) {
+        fprintf(stderr, "Ignoring %s: not a snapshot of this version\n", path);
+        munmap(base, (size_t)status.st_size);
+        return 0;
+    }
+
+    if (written) *written = header->written;
+    cursor = (const unsigned char*)base + sizeof(SnapshotHeader);
+    end = (const unsigned char*)base + status.st_size;
+
+    for (uint32_t r = 0; r < header->count; r++) {
+        SnapshotRecord record;
+        AddressSpaceNode position;
+        bool found;
+        UA_ByteString encoded;
+        UA_DataValue value;
+        size_t index;
+
+        if ((size_t)(end - cursor) < sizeof(record)) break;
+        memcpy(&record, cursor, sizeof(record));
+        cursor += sizeof(record);
+        if ((size_t)(end - cursor) < (size_t)record.path_length + record.value_length) break;
+
+        // Paths are looked up in place in the mapping, only item paths belong to the snapshot
+        found = address_space_find_path(address_space, (const char*)cursor, record.path_length, &position) &&
+                position.kind == ADDRESS_SPACE_NODE_ITEM;
+        cursor += record.path_length;
+
+        encoded.data = (UA_Byte*)(uintptr_t)cursor;
+        encoded.length = record.value_length;
+        cursor += record.value_length;
+
+        if (!found || UA_decodeBinary(&encoded, &value, &UA_TYPES[UA_TYPES_DATAVALUE], NULL) != UA_STATUSCODE_GOOD) continue;
+
+        if (!value.hasStatus || UA_StatusCode_isGood(value.status)) {
+            value.hasStatus = true;
+            value.status = UA_STATUSCODE_UNCERTAINLASTUSABLEVALUE;
+        }
+
+        index = address_space_item_index(address_space, &position);
+        UA_DataValue_clear(&values[index]);
+        values[index] = value;
+        read++;
+    }
+
+    munmap(base, (size_t)status.st_size);
+
+    return read;
+}
+
+/// @brief Save the current value of every gateway item
+/// @param path Path of the snapshot
+/// @param gateway The gateway, its cache of published values is saved
+/// @return Number of values saved
+/// @note Items that never received a value are not saved. The nodes are not read from the server.
+size_t snapshot_save(const char* path, const Gateway* gateway){
+
+    const AddressSpace* address_space;
+    UA_DataValue* values;
+    size_t saved;
+
+    if (!path || !gateway) return 0;
+
+    address_space = gateway->address_space;
+    values = (UA_DataValue*)calloc(address_space->item_count + 1, sizeof(UA_DataValue));
+    if (!values) {
+        fprintf(stderr, "Failed to allocate memory for the snapshot\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < address_space->item_count; i++) gateway_current(gateway, i, &values[i]);
+
+    saved = snapshot_write(path, address_space, values);
+    UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Saved %zu of %zu item values to %s",
+                saved, address_space->item_count, path);
+
+    for (size_t i = 0; i < address_space->item_count; i++) UA_DataValue_clear(&values[i]);
+    free(values);
+
+    return saved;
+}
+
+/// @brief Restore the values of a snapshot into the gateway items
+/// @param path Path of the snapshot
+/// @param gateway The gateway, its nodes and shared-memory table receive the values
+/// @param server Pointer to the UA_Server instance, the machine namespaces must be registered
+/// @return Number of values restored
+/// @note Call before the upstream machines connect: fresh values simply replace the restored ones.
+size_t snapshot_restore(const char* path, Gateway* gateway, UA_Server* server){
+
+    AddressSpace* address_space;
+    UA_DataValue* values;
+    UA_DateTime written = 0;
+    size_t restored = 0;
+
+    if (!path || !gateway || !server) return 0;
+
+    address_space = gateway->address_space;
+    values = (UA_DataValue*)calloc(address_space->item_count + 1, sizeof(UA_DataValue));
+    if (!values) {
+        fprintf(stderr, "Failed to allocate memory for the snapshot\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (snapshot_read(path, address_space, values, &written) > 0) {
+        for (size_t i = 0; i < address_space->item_count; i++) {
+            if (values[i].hasValue && gateway_preload(gateway, i, &values[i])) restored++;
+            UA_DataValue_clear(&values[i]);
+        }
+
+        // The values go through the publish path of the gateway, before the server listens
+        gateway_publish(gateway, server, restored);
+    }
+    free(values);
+
+    UA_LOG_INFO(UA_Log_Stdout, UA_LOGCATEGORY_USERLAND, "Restored %zu of %zu item values from %s, saved %lld s ago",
+                restored, address_space->item_count, path,
+                (long long)(written ? (UA_DateTime_now() - written) / UA_DATETIME_SEC : 0));
+
+    return restored;
+}
@@ -0,0 +1,218 @@
+#include "../include/trace.h"
+
+#include <json.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    char* name;
+    char* detail;
+    uint64_t start;
+    uint64_t duration;
+    bool detached;       ///< Started by trace_start, on its own row
+    bool running;        ///< Detached and not finished yet
+} TraceSpan;
+
+typedef struct {
+    char* path;
+    size_t count;
+    size_t capacity;
+    TraceSpan* spans;
+    size_t depth;
+    size_t open[TRACE_MAX_DEPTH];
+    size_t skipped;
+} Trace;
+
+static Trace trace = {0};
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static uint64_t _now(void);
+static TraceSpan* _add_span(const char* name, const char* detail);
+static void _free_trace(void);
+
+
+/// @brief Current time of the monotonic clock
+/// @return Time in microseconds, as expected by the Chrome trace format
+static uint64_t _now(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+/// @brief Free the recorded spans and stop recording
+static void _free_trace(void){
+    for (size_t i = 0; i < trace.count; i++) {
+        free(trace.spans[i].name);
+        free(trace.spans[i].detail);
+    }
+
+    free(trace.spans);
+    free(trace.path);
+    memset(&trace, 0, sizeof(Trace));
+}
+
+/// @brief Start recording spans
+/// @param path Path of the trace file written by `trace_close`
+/// @note Calling it again while a trace is open has no effect.
+void trace_open(const char* path){
+    if (!path || trace.path) return;
+
+    trace.path = strdup(path);
+}
+
+/// @brief Check if spans are being recorded
+/// @return true between `trace_open` and `trace_close`
+bool trace_enabled(void){
+    return trace.path != NULL;
+}
+
+/// @brief Record a new span starting now
+/// @param name Name of the span, copied
+/// @param detail Optional detail, copied, may be NULL
+/// @return The span, at index trace.count - 1
+static TraceSpan* _add_span(const char* name, const char* detail){
+
+    TraceSpan* span;
+
+    if (trace.count == trace.capacity) {
+        trace.capacity = trace.capacity < 64 ? 64 : trace.capacity * 2;
+        trace.spans = (TraceSpan*)realloc(trace.spans, sizeof(TraceSpan) * trace.capacity);
+        if (!trace.spans) {
+            fprintf(stderr, "Failed to allocate memory for TraceSpan\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    span = &trace.spans[trace.count++];
+    span->name = strdup(name);
+    span->detail = detail ? strdup(detail) : NULL;
+    span->duration = 0;
+    span->detached = false;
+    span->running = false;
+    span->start = _now();
+
+    return span;
+}
+
+/// @brief Begin a span
+/// @param name Name of the span, copied
+/// @param detail Optional detail shown in the span arguments (a file path for instance), copied, may be NULL
+void trace_begin(const char* name, const char* detail){
+
+    if (!trace.path || !name) return;
+
+    // Keep begin and end balanced even when the span cannot be recorded
+    if (trace.depth + trace.skipped >= TRACE_MAX_DEPTH) {
+        trace.skipped++;
+        return;
+    }
+
+    _add_span(name, detail);
+    trace.open[trace.depth++] = trace.count - 1;
+}
+
+/// @brief End the innermost open span
+void trace_end(void){
+
+    TraceSpan* span;
+
+    if (!trace.path) return;
+
+    if (trace.skipped > 0) {
+        trace.skipped--;
+        return;
+    }
+
+    if (trace.depth == 0) return;
+
+    span = &trace.spans[trace.open[--trace.depth]];
+    span->duration = _now() - span->start;
+}
+
+/// @brief Start a span that does not nest, ended by `trace_finish` in any order
+/// @param name Name of the span, copied
+/// @param detail Optional detail shown in the span arguments, copied, may be NULL
+/// @return The span, TRACE_NO_SPAN when no trace is open
+size_t trace_start(const char* name, const char* detail){
+
+    TraceSpan* span;
+
+    if (!trace.path || !name) return TRACE_NO_SPAN;
+
+    span = _add_span(name, detail);
+    span->detached = true;
+    span->running = true;
+
+    return trace.count - 1;
+}
+
+/// @brief End a span started by `trace_start`
+/// @param span The span, TRACE_NO_SPAN or a span already ended are ignored
+void trace_finish(size_t span){
+
+    if (!trace.path || span >= trace.count || !trace.spans[span].running) return;
+
+    trace.spans[span].running = false;
+    trace.spans[span].duration = _now() - trace.spans[span].start;
+}
+
+/// @brief End the remaining spans, write the trace file and stop recording
+/// @return true if the trace file was written or no trace was open, false otherwise
+bool trace_close(void){
+
+    struct json_object* root;
+    struct json_object* events;
+    struct json_object* event;
+    struct json_object* args;
+    uint64_t origin;
+    bool written;
+    int pid = (int)getpid();
+
+    if (!trace.path) return true;
+
+    trace.skipped = 0;
+    while (trace.depth > 0) trace_end();
+    for (size_t i = 0; i < trace.count; i++) trace_finish(i);
+
+    // Timestamps are shown relative to the first span
+    origin = trace.count > 0 ? trace.spans[0].start : 0;
+
+    root = json_object_new_object();
+    events = json_object_new_array();
+
+    for (size_t i = 0; i < trace.count; i++) {
+        TraceSpan* span = &trace.spans[i];
+
+        event = json_object_new_object();
+        json_object_object_add(event, "name", json_object_new_string(span->name));
+        json_object_object_add(event, "cat", json_object_new_string("startup"));
+        json_object_object_add(event, "ph", json_object_new_string("X"));
+        json_object_object_add(event, "ts", json_object_new_int64((int64_t)(span->start - origin)));
+        json_object_object_add(event, "dur", json_object_new_int64((int64_t)span->duration));
+        json_object_object_add(event, "pid", json_object_new_int(pid));
+        // A detached span overlaps others without nesting, its own row keeps the viewer from mixing them
+        json_object_object_add(event, "tid", json_object_new_int(span->detached ? pid + 1 + (int)i : pid));
+
+        if (span->detail) {
+            args = json_object_new_object();
+            json_object_object_add(args, "detail", json_object_new_string(span->detail));
+            json_object_object_add(event, "args", args);
+        }
+
+        json_object_array_add(events, event);
+    }
+
+    json_object_object_add(root, "traceEvents", events);
+    json_object_object_add(root, "displayTimeUnit", json_object_new_string("ms"));
+
+    written = json_object_to_file_ext(trace.path, root, JSON_C_TO_STRING_PLAIN) == 0;
+    if (!written) fprintf(stderr, "Failed to write the trace file %s\n", trace.path);
+
+    json_object_put(root);
+    _free_trace();
+
+    return written;
+}
@@ -0,0 +1,565 @@
+#include "../include/upstream.h"
+#include "../include/trace.h"
+
+#include <open62541/client_config_default.h>
+#include <open62541/client_subscriptions.h>
+#include <open62541/plugin/log_stdout.h>
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void _data_change(UA_Client* client, UA_UInt32 subscription_id, void* subscription_context,
+                         UA_UInt32 monitored_item_id, void* monitored_item_context, UA_DataValue* value);
+static bool _monitored(const UpstreamMachine* upstream_machine, const Item* item);
+static void _prepare(UpstreamMachine* upstream_machine);
+static void _subscribe(UpstreamMachine* upstream_machine);
+static void _subscription_created(UA_Client* client, void* userdata, UA_UInt32 request_id, void* response);
+static void _items_created(UA_Client* client, void* userdata, UA_UInt32 request_id, void* response);
+static void _subscribe_done(UpstreamMachine* upstream_machine);
+static void _unsubscribe(UpstreamMachine* upstream_machine);
+static void _connect(UpstreamMachine* upstream_machine);
+static void _connected(UpstreamMachine* upstream_machine, bool activated);
+static void _set_publishing(UpstreamMachine* upstream_machine);
+static void _iterate_callback(UA_Server* server, void* data);
+
+
+/// @brief Data change callback of the monitored items
+/// @note The monitored item context is the global index of the item. Values of scaled items are
+/// staged and pushed when the iteration of the client ends.
+static void _data_change(UA_Client* client, UA_UInt32 subscription_id, void* subscription_context,
+                         UA_UInt32 monitored_item_id, void* monitored_item_context, UA_DataValue* value){
+
+    (void)client; (void)subscription_id; (void)monitored_item_id;
+
+    upstream_push((UpstreamMachine*)subscription_context, (size_t)(uintptr_t)monitored_item_context, value);
+}
+
+/// @brief Push a value received from a machine into the gateway
+/// @param upstream_machine The machine
+/// @param item Global index of the item
+/// @param value The value, only read
+/// @note Values of scaled items are staged and pushed when the iteration of the client ends.
+void upstream_push(UpstreamMachine* upstream_machine, size_t item, const UA_DataValue* value){
+
+    UA_DataValue copy;
+
+    if (scaling_batch_add(&upstream_machine->scaling, item, value)) return;
+
+    if (UA_DataValue_copy(value, &copy) != UA_STATUSCODE_GOOD) return;
+
+    gateway_push(upstream_machine->gateway, item, &copy);
+}
+
+/// @brief Whether an item gets a monitored item on its machine
+/// @param upstream_machine The machine
+/// @param item The item
+/// @return false for the items computed by the gateway and the ondemand items read by on_demand.h
+static bool _monitored(const UpstreamMachine* upstream_machine, const Item* item){
+    return item->source == ITEM_SOURCE_UPSTREAM && !(item->on_demand && upstream_machine->on_demand);
+}
+
+/// @brief Parse the NodeIds of the monitored items of a machine, once
+/// @param upstream_machine The machine
+/// @note Items whose NodeId cannot be parsed are skipped with a warning, and a Group left without items
+/// gets no subscription, with a warning too.
+static void _prepare(UpstreamMachine* upstream_machine){
+
+    AddressSpaceMachine* machine = &upstream_machine->gateway->address_space->machines[upstream_machine->machine];
+    ArrayGroup* groups = &machine->config->groups;
+
+    if (groups->count == 0) return;
+
+    upstream_machine->groups = (UpstreamGroup*)calloc(groups->count, sizeof(UpstreamGroup));
+    upstream_machine->subscriptions = (UA_UInt32*)calloc(groups->count, sizeof(UA_UInt32));
+    if (!upstream_machine->groups || !upstream_machine->subscriptions) {
+        fprintf(stderr, "Failed to allocate memory for the subscriptions\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t g = 0; g < groups->count; g++) {
+        ArrayItem* items = &groups->groups[g].items;
+        UpstreamGroup* group = &upstream_machine->groups[upstream_machine->group_count];
+        UA_Double interval = (UA_Double)groups->groups[g].target_latency / 2;
+        size_t monitored = 0;
+
+        // A group of ondemand items costs no subscription on the machine
+        for (size_t i = 0; i < items->count; i++) {
+            if (_monitored(upstream_machine, &items->items[i])) monitored++;
+        }
+        if (monitored == 0) continue;
+
+        group->upstream_machine = upstream_machine;
+        group->group = g;
+        group->create = (UA_MonitoredItemCreateRequest*)calloc(monitored, sizeof(UA_MonitoredItemCreateRequest));
+        group->items = (size_t*)calloc(monitored, sizeof(size_t));
+        if (!group->create || !group->items) {
+            fprintf(stderr, "Failed to allocate memory for the monitored items\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0; i < items->count; i++) {
+            UA_NodeId node_id;
+
+            // Items computed by the gateway have no upstream NodeId, ondemand items are read when needed
+            if (!_monitored(upstream_machine, &items->items[i])) continue;
+
+            if (!items->items[i].nodeId ||
+                UA_NodeId_parse(&node_id, UA_STRING(items->items[i].nodeId)) != UA_STATUSCODE_GOOD) {
+                UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "Invalid NodeId for item %s of %s",
+                               items->items[i].name, machine->config->name);
+                continue;
+            }
+
+            group->create[group->count] = UA_MonitoredItemCreateRequest_default(node_id);
+            if (interval > 0 && interval < group->create[group->count].requestedParameters.samplingInterval) {
+                group->create[group->count].requestedParameters.samplingInterval = interval;
+            }
+            group->items[group->count] = machine->first_item + machine->group_first_item[g] + i;
+            group->count++;
+        }
+
+        if (group->count == 0) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "Group %s of %s has no valid NodeId, not subscribed",
+                           groups->groups[g].name, machine->config->name);
+            free(group->create);
+            free(group->items);
+            memset(group, 0, sizeof(UpstreamGroup));
+            continue;
+        }
+
+        upstream_machine->group_count++;
+    }
+}
+
+/// @brief Request one subscription per Group of a connected machine
+/// @param upstream_machine The machine
+/// @note The requests are asynchronous: the monitored items of a Group are requested once its subscription
+/// is created, and _subscribe_done ends the setup when the last response is in. The subscription of a
+/// Group carries the priority of its class, and its publishing and sampling intervals are shortened to half
+/// the target latency of the Group when the defaults of open62541 would not meet it. A machine that does
+/// not publish, or is paused, gets its subscriptions with publishing disabled.
+static void _subscribe(UpstreamMachine* upstream_machine){
+
+    static const UA_Byte priorities[PRIORITY_CLASS_COUNT] = {200, 100, 0};
+
+    AddressSpaceMachine* machine = &upstream_machine->gateway->address_space->machines[upstream_machine->machine];
+    ArrayGroup* groups = &machine->config->groups;
+
+    upstream_machine->subscribe_span = trace_start("upstream subscribe", machine->config->name);
+    upstream_machine->subscribing = true;
+    upstream_machine->failed = false;
+    upstream_machine->subscription_count = 0;
+    upstream_machine->pending = 0;
+
+    for (size_t g = 0; g < upstream_machine->group_count; g++) {
+        UpstreamGroup* group = &upstream_machine->groups[g];
+        const Group* config = &groups->groups[group->group];
+        UA_CreateSubscriptionRequest request = UA_CreateSubscriptionRequest_default();
+        UA_Double interval = (UA_Double)config->target_latency / 2;
+        UA_StatusCode retval;
+
+        request.priority = priorities[config->priority];
+        request.publishingEnabled = upstream_machine->publishing && !upstream_machine->paused;
+        if (interval > 0 && interval < request.requestedPublishingInterval) {
+            request.requestedPublishingInterval = interval;
+        }
+
+        retval = UA_Client_Subscriptions_create_async(upstream_machine->client, request, upstream_machine, NULL, NULL,
+                                                      _subscription_created, group, NULL);
+        if (retval != UA_STATUSCODE_GOOD) {
+            UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "Failed to subscribe to group %s of %s: %s",
+                           config->name, machine->config->name, UA_StatusCode_name(retval));
+            upstream_machine->failed = true;
+            break;
+        }
+        upstream_machine->pending++;
+    }
+
+    // Nothing in flight: the setup ends now
+    if (upstream_machine->pending == 0) {
+        upstream_machine->pending = 1;
+        _subscribe_done(upstream_machine);
+    }
+}
+
+/// @brief Response of the creation of the subscription of a Group, requests its monitored items
+/// @param client The client of the machine
+/// @param userdata The UpstreamGroup
+/// @param request_id Id of the request
+/// @param response The UA_CreateSubscriptionResponse
+static void _subscription_created(UA_Client* client, void* userdata, UA_UInt32 request_id, void* response){
+
+    UpstreamGroup* group = (UpstreamGroup*)userdata;
+    UpstreamMachine* upstream_machine = group->upstream_machine;
+    AddressSpaceMachine* machine = &upstream_machine->gateway->address_space->machines[upstream_machine->machine];
+    const char* name = machine->config->groups.groups[group->group].name;
+    UA_CreateSubscriptionResponse* subscription = (UA_CreateSubscriptionResponse*)response;
+    UA_CreateMonitoredItemsRequest request;
+    UA_Client_DataChangeNotificationCallback* callbacks;
+    void** contexts;
+    UA_StatusCode retval = subscription->responseHeader.serviceResult;
+
+    (void)request_id;
+
+    if (!upstream_machine->subscribing) return;
+
+    if (retval == UA_STATUSCODE_GOOD) {
+        upstream_machine->subscriptions[upstream_machine->subscription_count++] = subscription->subscriptionId;
+
+        callbacks = (UA_Client_DataChangeNotificationCallback*)calloc(group->count,
+                                                                      sizeof(UA_Client_DataChangeNotificationCallback));
+        contexts = (void**)calloc(group->count, sizeof(void*));
+        if (!callbacks || !contexts) {
+            fprintf(stderr, "Failed to allocate memory for the monitored items\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < group->count; i++) {
+            callbacks[i] = _data_change;
+            contexts[i] = (void*)(uintptr_t)group->items[i];
+        }
+
+        memset(&request, 0, sizeof(UA_CreateMonitoredItemsRequest));
+        request.subscriptionId = subscription->subscriptionId;
+        request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+        request.itemsToCreate = group->create;
+        request.itemsToCreateSize = group->count;
+
+        // The request, the contexts and the callbacks are copied by the client
+        retval = UA_Client_MonitoredItems_createDataChanges_async(client, request, contexts, callbacks, NULL,
+                                                                  _items_created, group, NULL);
+        free(callbacks);
+        free(contexts);
+        if (retval == UA_STATUSCODE_GOOD) return;
+    }
+
+    UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "Failed to subscribe to group %s of %s: %s",
+                   name, machine->config->name, UA_StatusCode_name(retval));
+    upstream_machine->failed = true;
+    _subscribe_done(upstream_machine);
+}
+
+/// @brief Response of the creation of the monitored items of a Group
+/// @param client The client of the machine
+/// @param userdata The UpstreamGroup
+/// @param request_id Id of the request
+/// @param response The UA_CreateMonitoredItemsResponse
+/// @note An item rejected by the machine is logged and its node gets the status of the rejection.
+static void _items_created(UA_Client* client, void* userdata, UA_UInt32 request_id, void* response){
+
+    UpstreamGroup* group = (UpstreamGroup*)userdata;
+    UpstreamMachine* upstream_machine = group->upstream_machine;
+    AddressSpaceMachine* machine = &upstream_machine->gateway->address_space->machines[upstream_machine->machine];
+    const Group* config = &machine->config->groups.groups[group->group];
+    UA_CreateMonitoredItemsResponse* items = (UA_CreateMonitoredItemsResponse*)response;
+    UA_StatusCode retval = items->responseHeader.serviceResult;
+
+    (void)client; (void)request_id;
+
+    if (!upstream_machine->subscribing) return;
+
+    if (retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "Failed to monitor group %s of %s: %s",
+                       config->name, machine->config->name, UA_StatusCode_name(retval));
+        upstream_machine->failed = true;
+        _subscribe_done(upstream_machine);
+        return;
+    }
+
+    for (size_t i = 0; i < items->resultsSize && i < group->count; i++) {
+        UA_StatusCode status = items->results[i].statusCode;
+        size_t local = group->items[i] - machine->first_item - machine->group_first_item[group->group];
+        UA_DataValue value;
+
+        if (status == UA_STATUSCODE_GOOD) continue;
+
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "Item %s of %s rejected by the machine: %s",
+                       config->items.items[local].name, machine->config->name, UA_StatusCode_name(status));
+        UA_DataValue_init(&value);
+        value.hasStatus = true;
+        value.status = UA_StatusCode_isBad(status) ? status : UA_STATUSCODE_BADINTERNALERROR;
+        value.hasSourceTimestamp = true;
+        value.sourceTimestamp = UA_DateTime_now();
+        upstream_push(upstream_machine, group->items[i], &value);
+    }
+
+    _subscribe_done(upstream_machine);
+}
+
+/// @brief Count a finished Group of the subscription setup, and end the setup after the last one
+/// @param upstream_machine The machine
+/// @note If a subscription or its monitored items could not be created, the subscriptions created so far
+/// are deleted and the machine is subscribed again after UPSTREAM_RECONNECT_DELAY.
+static void _subscribe_done(UpstreamMachine* upstream_machine){
+
+    if (upstream_machine->pending == 0 || --upstream_machine->pending > 0) return;
+
+    upstream_machine->subscribing = false;
+    if (upstream_machine->failed) {
+        _unsubscribe(upstream_machine);
+        upstream_machine->subscribe_at = UA_DateTime_nowMonotonic() + UPSTREAM_RECONNECT_DELAY * UA_DATETIME_MSEC;
+    } else {
+        upstream_machine->subscribed = true;
+    }
+
+    trace_finish(upstream_machine->subscribe_span);
+    upstream_machine->subscribe_span = TRACE_NO_SPAN;
+    upstream_machine->started = true;
+}
+
+/// @brief Delete the subscriptions created for a machine in its current session
+/// @param upstream_machine The machine
+/// @note The request is asynchronous and its response ignored, a subscription left on the machine expires
+/// with its lifetime.
+static void _unsubscribe(UpstreamMachine* upstream_machine){
+
+    UA_DeleteSubscriptionsRequest request;
+
+    if (upstream_machine->subscription_count == 0) return;
+
+    UA_DeleteSubscriptionsRequest_init(&request);
+    request.subscriptionIds = upstream_machine->subscriptions;
+    request.subscriptionIdsSize = upstream_machine->subscription_count;
+    UA_Client_Subscriptions_delete_async(upstream_machine->client, request, NULL, NULL, NULL);
+    upstream_machine->subscription_count = 0;
+}
+
+/// @brief Start connecting a machine
+/// @param upstream_machine The machine
+/// @note The "upstream connect" span lasts until the session is activated or the connection fails.
+static void _connect(UpstreamMachine* upstream_machine){
+
+    MachineConfig* config = upstream_machine->gateway->address_space->machines[upstream_machine->machine].config;
+    UA_StatusCode retval;
+
+    trace_finish(upstream_machine->connect_span);
+    upstream_machine->connect_span = trace_start("upstream connect", config->url);
+    upstream_machine->connecting = true;
+
+    upstream_machine->subscribed = false;
+    upstream_machine->subscribing = false;
+    upstream_machine->pending = 0;
+    upstream_machine->subscription_count = 0;
+    upstream_machine->subscribe_at = 0;
+    upstream_machine->retry_at = UA_DateTime_nowMonotonic() + UPSTREAM_RECONNECT_DELAY * UA_DATETIME_MSEC;
+
+    retval = UA_Client_connectAsync(upstream_machine->client, config->url);
+    if (retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "Failed to connect to %s: %s",
+                       config->url, UA_StatusCode_name(retval));
+        _connected(upstream_machine, false);
+    }
+}
+
+/// @brief End the connection attempt of a machine
+/// @param upstream_machine The machine, connecting
+/// @param activated true when the session is activated, false when the connection failed
+/// @note A failed attempt ends the startup of the machine, which is retried after UPSTREAM_RECONNECT_DELAY.
+static void _connected(UpstreamMachine* upstream_machine, bool activated){
+
+    upstream_machine->connecting = false;
+    trace_finish(upstream_machine->connect_span);
+    upstream_machine->connect_span = TRACE_NO_SPAN;
+    if (!activated) upstream_machine->started = true;
+}
+
+/// @brief Apply the publishing mode of a machine to its subscriptions
+/// @param upstream_machine The machine, subscribed
+/// @note Publishing is enabled only for a publishing machine that is not paused.
+static void _set_publishing(UpstreamMachine* upstream_machine){
+
+    MachineConfig* config = upstream_machine->gateway->address_space->machines[upstream_machine->machine].config;
+    UA_SetPublishingModeRequest request;
+    UA_SetPublishingModeResponse response;
+
+    if (upstream_machine->subscription_count == 0) return;
+
+    UA_SetPublishingModeRequest_init(&request);
+    request.publishingEnabled = upstream_machine->publishing && !upstream_machine->paused;
+    request.subscriptionIds = upstream_machine->subscriptions;
+    request.subscriptionIdsSize = upstream_machine->subscription_count;
+
+    response = UA_Client_Subscriptions_setPublishingMode(upstream_machine->client, request);
+    if (response.responseHeader.serviceResult != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(UA_Log_Stdout, UA_LOGCATEGORY_CLIENT, "Failed to %s the publishing of %s: %s",
+                       request.publishingEnabled ? "enable" : "disable", config->name,
+                       UA_StatusCode_name(response.responseHeader.serviceResult));
+    }
+    UA_SetPublishingModeResponse_clear(&response);
+}
+
+/// @brief Repeated server callback iterating the upstream clients
+/// @param server Pointer to the UA_Server instance
+/// @param data The upstream clients
+static void _iterate_callback(UA_Server* server, void* data){
+    (void)server;
+    upstream_iterate((Upstream*)data);
+}
+
+/// @brief Read the notifications of the machines and keep their sessions and subscriptions up
+/// @param upstream The upstream clients
+/// @note Called by the upstream callback, or by the loop of a shard worker that has no server.
+void upstream_iterate(Upstream* upstream){
+
+    UA_SecureChannelState channel_state;
+    UA_SessionState session_state;
+    UA_StatusCode connect_status;
+    UA_DateTime now;
+    bool paused;
+
+    if (!upstream) return;
+
+    for (size_t i = 0; i < upstream->count; i++) {
+        UpstreamMachine* upstream_machine = &upstream->machines[i];
+
+        // Backpressure: a blocked machine stops publishing until its queues drain, its session stays up
+        paused = gateway_machine_blocked(upstream->gateway, upstream_machine->machine);
+        if (paused != upstream_machine->paused) {
+            upstream_machine->paused = paused;
+            if (upstream_machine->subscribed && upstream_machine->publishing) _set_publishing(upstream_machine);
+        }
+
+        UA_Client_run_iterate(upstream_machine->client, 0);
+        scaling_batch_flush(&upstream_machine->scaling);
+        UA_Client_getState(upstream_machine->client, &channel_state, &session_state, &connect_status);
+        now = UA_DateTime_nowMonotonic();
+
+        if (session_state == UA_SESSIONSTATE_ACTIVATED) {
+            if (upstream_machine->connecting) _connected(upstream_machine, true);
+            if (!upstream_machine->subscribed && !upstream_machine->subscribing &&
+                now >= upstream_machine->subscribe_at) {
+                _subscribe(upstream_machine);
+            }
+        } else if (channel_state == UA_SECURECHANNELSTATE_CLOSED) {
+            if (upstream_machine->connecting) _connected(upstream_machine, false);
+            if (now >= upstream_machine->retry_at) _connect(upstream_machine);
+        }
+    }
+}
+
+/// @brief Create one client per machine with an URL
+/// @param upstream Pointer to the Upstream structure to initialize
+/// @param gateway Gateway receiving the values, must outlive the upstream clients
+void init_upstream(Upstream* upstream, Gateway* gateway){
+    init_upstream_machines(upstream, gateway, NULL);
+}
+
+/// @brief Create one client per selected machine with an URL
+/// @param upstream Pointer to the Upstream structure to initialize
+/// @param gateway Gateway receiving the values, must outlive the upstream clients
+/// @param selected Machines to connect, indexed by machine, NULL for every machine
+void init_upstream_machines(Upstream* upstream, Gateway* gateway, const bool* selected){
+
+    AddressSpace* address_space;
+
+    if (!upstream || !gateway) return;
+
+    memset(upstream, 0, sizeof(Upstream));
+    upstream->gateway = gateway;
+    address_space = gateway->address_space;
+
+    if (address_space->count == 0) return;
+
+    upstream->machines = (UpstreamMachine*)calloc(address_space->count, sizeof(UpstreamMachine));
+    if (!upstream->machines) {
+        fprintf(stderr, "Failed to allocate memory for Upstream\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t m = 0; m < address_space->count; m++) {
+        UpstreamMachine* upstream_machine = &upstream->machines[upstream->count];
+
+        if (!address_space->machines[m].config->url || (selected && !selected[m])) continue;
+
+        upstream_machine->client = UA_Client_new();
+        if (!upstream_machine->client) {
+            fprintf(stderr, "Failed to create the client of %s\n", address_space->machines[m].config->name);
+            exit(EXIT_FAILURE);
+        }
+
+        upstream_machine->gateway = gateway;
+        upstream_machine->machine = m;
+        upstream_machine->publishing = true;
+        upstream_machine->connect_span = TRACE_NO_SPAN;
+        upstream_machine->subscribe_span = TRACE_NO_SPAN;
+        init_scaling_batch(&upstream_machine->scaling, gateway, m);
+        upstream->count++;
+    }
+}
+
+/// @brief Connect the machines and add the upstream callback to the server
+/// @param upstream The upstream clients
+/// @param server Pointer to the UA_Server instance, NULL when the caller iterates the clients with upstream_iterate
+/// @return UA_STATUSCODE_GOOD on success
+/// @note Connections are asynchronous, a machine that cannot be reached is retried every UPSTREAM_RECONNECT_DELAY.
+UA_StatusCode upstream_start(Upstream* upstream, UA_Server* server){
+
+    if (!upstream) return UA_STATUSCODE_BADINTERNALERROR;
+
+    upstream->startup_deadline = UA_DateTime_nowMonotonic() + UPSTREAM_STARTUP_TIMEOUT * UA_DATETIME_MSEC;
+    for (size_t i = 0; i < upstream->count; i++) {
+        if (!upstream->machines[i].groups) _prepare(&upstream->machines[i]);
+        _connect(&upstream->machines[i]);
+    }
+
+    if (!server) return UA_STATUSCODE_GOOD;
+
+    return UA_Server_addRepeatedCallback(server, _iterate_callback, upstream, UPSTREAM_ITERATE_INTERVAL,
+                                         &upstream->callback_id);
+}
+
+/// @brief Check if the machines are past their startup
+/// @param upstream The upstream clients
+/// @return true once every machine has connected and subscribed, or failed to, since upstream_start, or once
+/// UPSTREAM_STARTUP_TIMEOUT has passed
+/// @note The startup trace is closed then, so that it covers the connections and subscriptions of the machines.
+bool upstream_started(const Upstream* upstream){
+
+    if (!upstream || UA_DateTime_nowMonotonic() >= upstream->startup_deadline) return true;
+
+    for (size_t i = 0; i < upstream->count; i++) {
+        if (!upstream->machines[i].started) return false;
+    }
+    return true;
+}
+
+/// @brief Enable or disable the publishing of the upstream subscriptions
+/// @param upstream The upstream clients
+/// @param publishing false to keep the subscriptions without notifications, true to resume them
+/// @note Applies to the subscriptions already created and to the ones created later.
+void upstream_set_publishing(Upstream* upstream, bool publishing){
+
+    if (!upstream) return;
+
+    for (size_t i = 0; i < upstream->count; i++) {
+        UpstreamMachine* upstream_machine = &upstream->machines[i];
+
+        if (upstream_machine->publishing == publishing) continue;
+
+        upstream_machine->publishing = publishing;
+        if (upstream_machine->subscribed && !upstream_machine->paused) _set_publishing(upstream_machine);
+    }
+}
+
+/// @brief Disconnect and free the upstream clients
+/// @param upstream Pointer to the Upstream structure to free
+void free_upstream(Upstream* upstream){
+
+    if (!upstream) return;
+
+    for (size_t i = 0; i < upstream->count; i++) {
+        UA_Client_disconnect(upstream->machines[i].client);
+        UA_Client_delete(upstream->machines[i].client);
+        free(upstream->machines[i].subscriptions);
+        for (size_t g = 0; g < upstream->machines[i].group_count; g++) {
+            UpstreamGroup* group = &upstream->machines[i].groups[g];
+
+            for (size_t j = 0; j < group->count; j++) UA_MonitoredItemCreateRequest_clear(&group->create[j]);
+            free(group->create);
+            free(group->items);
+        }
+        free(upstream->machines[i].groups);
+        free_scaling_batch(&upstream->machines[i].scaling);
+    }
+
+    free(upstream->machines);
+    memset(upstream, 0, sizeof(Upstream));
+}
@@ -0,0 +1,171 @@
+#include "../include/tests/address_space_test.h"
+#include "../include/tests/machine_config_test.h"
+
+#include <open62541/server_config_default.h>
+
+/// @brief Test initialization of the address space layout.
+/// @param None
+/// @return None
+/// @details This function tests the layout computed from the machine configurations of the fixtures.
+/// It checks that every machine is described and that items are counted across all groups and machines.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the address space test suite.
+/// @see init_address_space(), free_address_space()
+void test_init_address_space(void){
+    AddressSpace address_space;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+
+    TEST_ASSERT_EQUAL_INT(3, address_space.count);
+    TEST_ASSERT_EQUAL_INT(9, address_space.item_count);
+    TEST_ASSERT_EQUAL_INT(0, address_space.machines[0].first_item);
+    TEST_ASSERT_EQUAL_INT(3, address_space.machines[1].first_item);
+    TEST_ASSERT_EQUAL_INT(2, address_space.machines[0].group_first_item[1]);
+
+    free_address_space(&address_space);
+    TEST_ASSERT_NULL(address_space.machines);
+}
+
+/// @brief Test resolving NodeIds of the gateway namespaces.
+/// @param None
+/// @return None
+/// @details This function tests that machine, group and item NodeIds resolve to the right position.
+/// It checks that NodeIds outside the layout are rejected and that resolved positions convert back to the same NodeId.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the address space test suite.
+/// @see address_space_register_namespaces(), address_space_resolve(), address_space_node_id()
+void test_address_space_resolve(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    AddressSpaceNode node;
+    UA_NodeId node_id;
+    UA_UInt16 ns;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    address_space_register_namespaces(&address_space, server);
+
+    ns = address_space.machines[1].namespace_index;
+    TEST_ASSERT_NOT_EQUAL(0, ns);
+
+    node_id = UA_NODEID_NUMERIC(ns, ADDRESS_SPACE_MACHINE_ID);
+    TEST_ASSERT_TRUE(address_space_resolve(&address_space, &node_id, &node));
+    TEST_ASSERT_EQUAL_INT(ADDRESS_SPACE_NODE_MACHINE, node.kind);
+    TEST_ASSERT_EQUAL_INT(1, node.machine);
+
+    node_id = UA_NODEID_NUMERIC(ns, ADDRESS_SPACE_FIRST_GROUP_ID + 1);
+    TEST_ASSERT_TRUE(address_space_resolve(&address_space, &node_id, &node));
+    TEST_ASSERT_EQUAL_INT(ADDRESS_SPACE_NODE_GROUP, node.kind);
+    TEST_ASSERT_EQUAL_INT(1, node.group);
+
+    // Groups FLAGS (2 items) and DATA (1 item): the last item belongs to DATA
+    node_id = UA_NODEID_NUMERIC(ns, ADDRESS_SPACE_FIRST_GROUP_ID + 2 + 2);
+    TEST_ASSERT_TRUE(address_space_resolve(&address_space, &node_id, &node));
+    TEST_ASSERT_EQUAL_INT(ADDRESS_SPACE_NODE_ITEM, node.kind);
+    TEST_ASSERT_EQUAL_INT(1, node.group);
+    TEST_ASSERT_EQUAL_INT(2, node.item);
+    TEST_ASSERT_EQUAL_STRING("NB_POLES", address_space_item(&address_space, &node)->name);
+
+    node_id = address_space_node_id(&address_space, &node);
+    TEST_ASSERT_EQUAL_INT(ns, node_id.namespaceIndex);
+    TEST_ASSERT_EQUAL_INT(ADDRESS_SPACE_FIRST_GROUP_ID + 2 + 2, node_id.identifier.numeric);
+
+    node_id = UA_NODEID_NUMERIC(ns, ADDRESS_SPACE_FIRST_GROUP_ID + 2 + 3);
+    TEST_ASSERT_FALSE(address_space_resolve(&address_space, &node_id, &node));
+
+    node_id = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    TEST_ASSERT_FALSE(address_space_resolve(&address_space, &node_id, &node));
+
+    node_id = UA_NODEID_STRING(ns, "PC");
+    TEST_ASSERT_FALSE(address_space_resolve(&address_space, &node_id, &node));
+
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
+
+/// @brief Test the global item index of the layout.
+/// @param None
+/// @return None
+/// @details This function tests that every global item index maps to an item and back to the same index.
+/// It checks that indexes past the last item are rejected.
+/// @note This function is part of the address space test suite.
+/// @see address_space_item_at(), address_space_item_index()
+void test_address_space_item_index(void){
+    AddressSpace address_space;
+    AddressSpaceNode node;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+
+    for (size_t i = 0; i < address_space.item_count; i++) {
+        TEST_ASSERT_TRUE(address_space_item_at(&address_space, i, &node));
+        TEST_ASSERT_EQUAL_INT(i / 3, node.machine);
+        TEST_ASSERT_EQUAL_INT(i, address_space_item_index(&address_space, &node));
+    }
+
+    TEST_ASSERT_FALSE(address_space_item_at(&address_space, address_space.item_count, &node));
+
+    free_address_space(&address_space);
+}
+
+/// @brief Test finding nodes from their paths.
+/// @param None
+/// @return None
+/// @details This function tests that machine, group and item paths resolve through the path index of the layout.
+/// It checks that the path of every item resolves back to the same item and that paths are compared on their length, not a terminator.
+/// It also ensures that unknown paths are rejected and that the memory is freed correctly after the test.
+/// @note This function is part of the address space test suite.
+/// @see address_space_find_path(), address_space_item_path()
+void test_address_space_find_path(void){
+    AddressSpace address_space;
+    AddressSpaceNode node;
+    const char* path = "Machine2/DATA/NB_POLES";
+    char buffer[ADDRESS_SPACE_MAX_PATH];
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+
+    TEST_ASSERT_TRUE(address_space_find_path(&address_space, path, strlen(path), &node));
+    TEST_ASSERT_EQUAL_INT(ADDRESS_SPACE_NODE_ITEM, node.kind);
+    TEST_ASSERT_EQUAL_STRING("Machine2", address_space.machines[node.machine].config->name);
+    TEST_ASSERT_EQUAL_INT(1, node.group);
+    TEST_ASSERT_EQUAL_INT(2, node.item);
+
+    // Prefixes of the path are the group and the machine
+    TEST_ASSERT_TRUE(address_space_find_path(&address_space, path, strlen("Machine2/DATA"), &node));
+    TEST_ASSERT_EQUAL_INT(ADDRESS_SPACE_NODE_GROUP, node.kind);
+    TEST_ASSERT_EQUAL_INT(1, node.group);
+    TEST_ASSERT_TRUE(address_space_find_path(&address_space, path, strlen("Machine2"), &node));
+    TEST_ASSERT_EQUAL_INT(ADDRESS_SPACE_NODE_MACHINE, node.kind);
+    TEST_ASSERT_EQUAL_STRING("Machine2", address_space.machines[node.machine].config->name);
+
+    TEST_ASSERT_FALSE(address_space_find_path(&address_space, path, strlen("Machine2/DATA/NB"), &node));
+    TEST_ASSERT_FALSE(address_space_find_path(&address_space, "Machine4/DATA/NB_POLES", strlen("Machine4/DATA/NB_POLES"), &node));
+    TEST_ASSERT_FALSE(address_space_find_path(&address_space, "", 0, &node));
+
+    for (size_t i = 0; i < address_space.item_count; i++) {
+        size_t length = address_space_item_path(&address_space, i, buffer, sizeof(buffer));
+
+        TEST_ASSERT_TRUE(address_space_find_path(&address_space, buffer, length, &node));
+        TEST_ASSERT_EQUAL_INT(ADDRESS_SPACE_NODE_ITEM, node.kind);
+        TEST_ASSERT_EQUAL_INT(i, address_space_item_index(&address_space, &node));
+    }
+
+    free_address_space(&address_space);
+    TEST_ASSERT_NULL(address_space.paths);
+}
+
+/// @brief Test the mapping of item types to OPC UA data types.
+/// @param None
+/// @return None
+/// @details This function tests that the type names of the machine files map to the matching data types.
+/// It checks that unknown or missing type names fall back to the Variant type.
+/// @note This function is part of the address space test suite.
+/// @see address_space_data_type()
+void test_address_space_data_type(void){
+    TEST_ASSERT_EQUAL_PTR(&UA_TYPES[UA_TYPES_INT16], address_space_data_type("System.Int16"));
+    TEST_ASSERT_EQUAL_PTR(&UA_TYPES[UA_TYPES_DOUBLE], address_space_data_type("System.Double"));
+    TEST_ASSERT_EQUAL_PTR(&UA_TYPES[UA_TYPES_VARIANT], address_space_data_type("System.Decimal"));
+    TEST_ASSERT_EQUAL_PTR(&UA_TYPES[UA_TYPES_VARIANT], address_space_data_type(NULL));
+}
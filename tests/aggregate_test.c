@@ -0,0 +1,188 @@
+#include "../include/tests/aggregate_test.h"
+#include "../include/tests/machine_config_test.h"
+
+#include <math.h>
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static UA_Double _pop_number(Gateway* gateway, size_t item, const UA_DataType* type, UA_StatusCode* status);
+
+
+/// @brief Pop the oldest value queued for an aggregate item
+/// @param gateway The gateway
+/// @param item Global index of the aggregate item
+/// @param type Expected data type, Double or UInt32
+/// @param status Status of the value
+/// @return The value, NAN if the queue is empty or the type differs
+static UA_Double _pop_number(Gateway* gateway, size_t item, const UA_DataType* type, UA_StatusCode* status){
+
+    UA_DataValue value;
+    UA_Double result = NAN;
+
+    if (!item_queue_pop(&gateway->queues[item], &value)) return NAN;
+
+    if (UA_Variant_hasScalarType(&value.value, type)) {
+        result = type == &UA_TYPES[UA_TYPES_UINT32] ? *(UA_UInt32*)value.value.data : *(UA_Double*)value.value.data;
+    }
+    *status = value.status;
+    UA_DataValue_clear(&value);
+
+    return result;
+}
+
+/// @brief Test the aggregate items added by the machine configuration.
+/// @param None
+/// @return None
+/// @details This function tests that a group with aggregate windows gets one item per numeric item, window and statistic.
+/// It checks the names, types and positions of the aggregate items and that string items are not aggregated.
+/// @note This function is part of the aggregate test suite.
+/// @see load_machine_config()
+void test_aggregate_items(void){
+    Group* group;
+
+    load_machine_config("tests/fixtures/aggregates", &machine_config);
+    TEST_ASSERT_EQUAL_INT(1, machine_config.count);
+
+    group = &machine_config.configs[0].groups.groups[0];
+    TEST_ASSERT_EQUAL_INT(2, group->window_count);
+    TEST_ASSERT_EQUAL_INT(1000, group->windows[0]);
+    TEST_ASSERT_EQUAL_INT(60000, group->windows[1]);
+
+    // NB_POLES and REFERENCE, then 2 windows x 5 statistics for NB_POLES only
+    TEST_ASSERT_EQUAL_INT(12, group->items.count);
+    TEST_ASSERT_EQUAL_INT(ITEM_SOURCE_UPSTREAM, group->items.items[1].source);
+    TEST_ASSERT_EQUAL_STRING("NB_POLES.1s.Min", group->items.items[2].name);
+    TEST_ASSERT_EQUAL_STRING("System.Double", group->items.items[2].type);
+    TEST_ASSERT_EQUAL_STRING("NB_POLES.1s.Count", group->items.items[5].name);
+    TEST_ASSERT_EQUAL_STRING("System.UInt32", group->items.items[5].type);
+    TEST_ASSERT_EQUAL_STRING("NB_POLES.1min.StdDev", group->items.items[11].name);
+    TEST_ASSERT_EQUAL_INT(ITEM_SOURCE_AGGREGATE, group->items.items[11].source);
+    TEST_ASSERT_EQUAL_INT(0, group->items.items[11].source_item);
+    TEST_ASSERT_EQUAL_INT(1, group->items.items[11].window);
+    TEST_ASSERT_EQUAL_INT(AGGREGATE_STDDEV, group->items.items[11].stat);
+    TEST_ASSERT_NULL(group->items.items[11].nodeId);
+}
+
+/// @brief Test the sliding windows of the aggregates.
+/// @param None
+/// @return None
+/// @details This function tests that Min, Max, Mean, Count and StdDev are published for each window of an item.
+/// It checks that values leaving the shortest window are expired while the longest window keeps them.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the aggregate test suite.
+/// @see init_aggregates(), aggregates_update(), aggregates_publish(), free_aggregates()
+void test_aggregate_windows(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    Aggregates aggregates;
+    UA_DataValue value;
+    UA_StatusCode status;
+    UA_DateTime now = UA_DATETIME_SEC;
+    size_t source;
+    size_t second;
+    size_t minute;
+
+    load_machine_config("tests/fixtures/aggregates", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    init_aggregates(&aggregates, &gateway);
+
+    TEST_ASSERT_EQUAL_INT(1, aggregates.count);
+    TEST_ASSERT_EQUAL_PTR(&aggregates, gateway.aggregates);
+
+    source = address_space.machines[0].first_item;
+    second = source + 2;
+    minute = second + AGGREGATE_STAT_COUNT;
+
+    for (UA_Int32 i = 1; i <= 3; i++) {
+        UA_DataValue_init(&value);
+        UA_Variant_setScalarCopy(&value.value, &i, &UA_TYPES[UA_TYPES_INT32]);
+        value.hasValue = true;
+        aggregates_update(&aggregates, source, &value, now);
+        UA_DataValue_clear(&value);
+    }
+
+    // Values of other items and non-numeric values are ignored
+    UA_DataValue_init(&value);
+    aggregates_update(&aggregates, source, &value, now);
+    aggregates_update(&aggregates, source + 1, &value, now);
+
+    TEST_ASSERT_EQUAL_INT(2, aggregates_publish(&aggregates, now));
+    TEST_ASSERT_EQUAL_INT(0, aggregates_publish(&aggregates, now));
+
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, _pop_number(&gateway, second + AGGREGATE_MIN, &UA_TYPES[UA_TYPES_DOUBLE], &status));
+    TEST_ASSERT_EQUAL_DOUBLE(3.0, _pop_number(&gateway, second + AGGREGATE_MAX, &UA_TYPES[UA_TYPES_DOUBLE], &status));
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, _pop_number(&gateway, second + AGGREGATE_MEAN, &UA_TYPES[UA_TYPES_DOUBLE], &status));
+    TEST_ASSERT_EQUAL_DOUBLE(3.0, _pop_number(&gateway, second + AGGREGATE_COUNT, &UA_TYPES[UA_TYPES_UINT32], &status));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, sqrt(2.0 / 3.0), _pop_number(&gateway, second + AGGREGATE_STDDEV, &UA_TYPES[UA_TYPES_DOUBLE], &status));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, status);
+
+    // Two seconds later the 1s window is empty, the 1min window still holds the values
+    now += 2 * UA_DATETIME_SEC;
+    TEST_ASSERT_EQUAL_INT(1, aggregates_publish(&aggregates, now));
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, _pop_number(&gateway, second + AGGREGATE_COUNT, &UA_TYPES[UA_TYPES_UINT32], &status));
+    _pop_number(&gateway, second + AGGREGATE_MEAN, &UA_TYPES[UA_TYPES_DOUBLE], &status);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADNODATA, status);
+    TEST_ASSERT_EQUAL_INT(1, gateway.queues[minute + AGGREGATE_COUNT].count);
+    TEST_ASSERT_EQUAL_DOUBLE(3.0, _pop_number(&gateway, minute + AGGREGATE_COUNT, &UA_TYPES[UA_TYPES_UINT32], &status));
+
+    free_aggregates(&aggregates);
+    TEST_ASSERT_NULL(gateway.aggregates);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
+
+/// @brief Test the statistics of values with a large offset.
+/// @param None
+/// @return None
+/// @details This function tests that Mean and StdDev stay exact for values around 1e9 spread over several buckets.
+/// It checks that the statistics are still exact once a bucket with an outlier has left the window.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the aggregate test suite.
+/// @see aggregates_update(), aggregates_publish()
+void test_aggregate_large_offset(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    Aggregates aggregates;
+    UA_DataValue value;
+    UA_StatusCode status;
+    UA_DateTime start = UA_DATETIME_SEC;
+    UA_Double number;
+    size_t source;
+    size_t minute;
+
+    load_machine_config("tests/fixtures/aggregates", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    init_aggregates(&aggregates, &gateway);
+
+    source = address_space.machines[0].first_item;
+    minute = source + 2 + AGGREGATE_STAT_COUNT;
+
+    // An outlier, then 1e9 + 1, 2 and 3 in three later buckets of the 1min window
+    for (UA_Int32 i = 0; i <= 3; i++) {
+        number = i == 0 ? 1e9 + 1000.0 : 1e9 + i;
+        UA_DataValue_init(&value);
+        UA_Variant_setScalarCopy(&value.value, &number, &UA_TYPES[UA_TYPES_DOUBLE]);
+        value.hasValue = true;
+        aggregates_update(&aggregates, source, &value, start + (i == 0 ? 0 : (29 + i) * UA_DATETIME_SEC));
+        UA_DataValue_clear(&value);
+    }
+
+    aggregates_publish(&aggregates, start + 33 * UA_DATETIME_SEC);
+    TEST_ASSERT_EQUAL_DOUBLE(4.0, _pop_number(&gateway, minute + AGGREGATE_COUNT, &UA_TYPES[UA_TYPES_UINT32], &status));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 1e9 + 251.5, _pop_number(&gateway, minute + AGGREGATE_MEAN, &UA_TYPES[UA_TYPES_DOUBLE], &status));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, sqrt(186751.25), _pop_number(&gateway, minute + AGGREGATE_STDDEV, &UA_TYPES[UA_TYPES_DOUBLE], &status));
+
+    // The outlier leaves the window, the other values stay
+    aggregates_publish(&aggregates, start + 60 * UA_DATETIME_SEC + UA_DATETIME_SEC / 2);
+    TEST_ASSERT_EQUAL_DOUBLE(3.0, _pop_number(&gateway, minute + AGGREGATE_COUNT, &UA_TYPES[UA_TYPES_UINT32], &status));
+    TEST_ASSERT_EQUAL_DOUBLE(1e9 + 1.0, _pop_number(&gateway, minute + AGGREGATE_MIN, &UA_TYPES[UA_TYPES_DOUBLE], &status));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 1e9 + 2.0, _pop_number(&gateway, minute + AGGREGATE_MEAN, &UA_TYPES[UA_TYPES_DOUBLE], &status));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, sqrt(2.0 / 3.0), _pop_number(&gateway, minute + AGGREGATE_STDDEV, &UA_TYPES[UA_TYPES_DOUBLE], &status));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, status);
+
+    free_aggregates(&aggregates);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
@@ -0,0 +1,252 @@
+#include "../include/tests/alarms_test.h"
+#include "../include/tests/machine_config_test.h"
+
+#include <math.h>
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static size_t _stage(Alarms* alarms, size_t item, double number, UA_StatusCode status);
+
+
+/// @brief Stage a Double value and flush the update set
+/// @return The result of alarms_flush
+static size_t _stage(Alarms* alarms, size_t item, double number, UA_StatusCode status){
+
+    UA_DataValue value;
+
+    UA_DataValue_init(&value);
+    UA_Variant_setScalar(&value.value, &number, &UA_TYPES[UA_TYPES_DOUBLE]);
+    value.hasValue = true;
+    value.status = status;
+    value.hasStatus = status != UA_STATUSCODE_GOOD;
+
+    alarms_stage(alarms, item, &value);
+    return alarms_flush(alarms);
+}
+
+/// @brief Test the loading of the limits and the creation of the alarms.
+/// @param None
+/// @return None
+/// @details This function tests that the Limits of a Group apply to its items without limits of their own
+/// and not to its aggregates, that the limits not set are NAN and that only the items with limits get an alarm.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the alarms test suite.
+/// @see load_machine_config(), init_alarms(), free_alarms()
+void test_alarms_items(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    Alarms alarms;
+    ArrayItem* items;
+
+    load_machine_config("tests/fixtures/alarms", &machine_config);
+    items = &machine_config.configs[0].groups.groups[0].items;
+
+    TEST_ASSERT_TRUE(items->items[0].limits.enabled);
+    TEST_ASSERT_EQUAL_DOUBLE(95.0, items->items[0].limits.high_high);
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, items->items[0].limits.low_low);
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, items->items[0].limits.hysteresis);
+    TEST_ASSERT_EQUAL_DOUBLE(6.0, items->items[1].limits.high);
+    TEST_ASSERT_TRUE(isnan(items->items[1].limits.high_high));
+    TEST_ASSERT_TRUE(isnan(items->items[1].limits.low));
+    TEST_ASSERT_EQUAL_DOUBLE(0.5, items->items[1].limits.hysteresis);
+    TEST_ASSERT_TRUE(items->items[2].limits.enabled);
+    TEST_ASSERT_EQUAL_INT(ITEM_SOURCE_AGGREGATE, items->items[3].source);
+    TEST_ASSERT_FALSE(items->items[3].limits.enabled);
+    TEST_ASSERT_FALSE(machine_config.configs[0].groups.groups[1].items.items[0].limits.enabled);
+
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    init_alarms(&alarms, &gateway);
+
+    TEST_ASSERT_EQUAL_INT(3, alarms.count);
+    TEST_ASSERT_EQUAL_PTR(&alarms, gateway.alarms);
+    TEST_ASSERT_EQUAL_INT(1, alarms.by_item[1]);
+    TEST_ASSERT_EQUAL_UINT64(ALARM_NONE, alarms.by_item[3]);
+    TEST_ASSERT_EQUAL_UINT64(ALARM_NONE, alarms.by_item[address_space.item_count - 1]);
+
+    free_alarms(&alarms);
+    TEST_ASSERT_NULL(gateway.alarms);
+    TEST_ASSERT_NULL(alarms.by_item);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
+
+/// @brief Test the state transitions of the alarms.
+/// @param None
+/// @return None
+/// @details This function tests that a value reaching a limit enters its state, that it leaves it only once it
+/// is back inside the limit by more than the Hysteresis, and that a value staying in its state is no transition.
+/// It checks that an item staged twice in the same update set keeps both transitions and that strings leave
+/// the state unchanged.
+/// @note This function is part of the alarms test suite.
+/// @see alarms_stage(), alarms_flush()
+void test_alarms_transitions(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    Alarms alarms;
+    UA_DataValue value;
+    UA_String text = UA_STRING("high");
+    double numbers[] = {3.0, 50.0};
+    size_t temperature;
+
+    load_machine_config("tests/fixtures/alarms", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    init_alarms(&alarms, &gateway);
+    temperature = address_space.machines[0].first_item;
+
+    TEST_ASSERT_EQUAL_INT(0, _stage(&alarms, temperature, 50.0, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_INT(1, _stage(&alarms, temperature, 80.0, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_DOUBLE(ALARM_HIGH, alarms.level[0]);
+
+    // Within the hysteresis of High, then out of it
+    TEST_ASSERT_EQUAL_INT(0, _stage(&alarms, temperature, 78.5, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_INT(1, _stage(&alarms, temperature, 78.0, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_DOUBLE(ALARM_NORMAL, alarms.level[0]);
+
+    TEST_ASSERT_EQUAL_INT(1, _stage(&alarms, temperature, 96.0, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_DOUBLE(ALARM_HIGH_HIGH, alarms.level[0]);
+    TEST_ASSERT_EQUAL_INT(0, _stage(&alarms, temperature, 94.0, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_INT(1, _stage(&alarms, temperature, 92.0, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_DOUBLE(ALARM_HIGH, alarms.level[0]);
+
+    // Values without a number are not evaluated
+    UA_DataValue_init(&value);
+    UA_Variant_setScalar(&value.value, &text, &UA_TYPES[UA_TYPES_STRING]);
+    value.hasValue = true;
+    alarms_stage(&alarms, temperature + 2, &value);
+    TEST_ASSERT_EQUAL_INT(0, alarms.staged);
+
+    // Two values of the same item in one update set: LowLow, then back to Normal
+    for (size_t i = 0; i < 2; i++) {
+        UA_Variant_setScalar(&value.value, &numbers[i], &UA_TYPES[UA_TYPES_DOUBLE]);
+        alarms_stage(&alarms, temperature, &value);
+    }
+    TEST_ASSERT_EQUAL_DOUBLE(ALARM_LOW_LOW, alarms.level[0]);
+    TEST_ASSERT_EQUAL_INT(1, alarms_flush(&alarms));
+    TEST_ASSERT_EQUAL_DOUBLE(ALARM_NORMAL, alarms.level[0]);
+
+    // Only High is set on PRESSURE
+    TEST_ASSERT_EQUAL_INT(0, _stage(&alarms, temperature + 1, -100.0, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_INT(1, _stage(&alarms, temperature + 1, 1e9, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_DOUBLE(ALARM_HIGH, alarms.level[1]);
+    TEST_ASSERT_EQUAL_UINT64(7, alarms.events);
+
+    free_alarms(&alarms);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
+
+/// @brief Test the quality transitions of the alarms.
+/// @param None
+/// @return None
+/// @details This function tests that a bad value fires one quality transition that clears the state of the
+/// alarm instead of leaving it latched, and that further bad values fire nothing.
+/// It checks that the next value with a number fires its state with a Good quality, even when it is Normal,
+/// and that alarms_start creates one condition per alarm when open62541 has alarms and conditions.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the alarms test suite.
+/// @see alarms_start(), alarms_stage(), alarms_flush()
+void test_alarms_quality(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    Alarms alarms;
+    UA_Server* server = UA_Server_new();
+    size_t temperature;
+
+    load_machine_config("tests/fixtures/alarms", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    init_alarms(&alarms, &gateway);
+    temperature = address_space.machines[0].first_item;
+
+    TEST_ASSERT_EQUAL_INT(UA_STATUSCODE_GOOD, alarms_start(&alarms, server));
+#ifdef UA_ENABLE_SUBSCRIPTIONS_ALARMS_CONDITIONS
+    for (size_t i = 0; i < alarms.count; i++) {
+        TEST_ASSERT_FALSE(UA_NodeId_isNull(&alarms.conditions[i]));
+    }
+#endif
+
+    TEST_ASSERT_EQUAL_INT(1, _stage(&alarms, temperature, 80.0, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_DOUBLE(ALARM_HIGH, alarms.level[0]);
+
+    // The machine went Bad: the state is unknown, once
+    TEST_ASSERT_EQUAL_INT(0, _stage(&alarms, temperature, 0.0, UA_STATUSCODE_BADCOMMUNICATIONERROR));
+    TEST_ASSERT_EQUAL_DOUBLE(ALARM_NORMAL, alarms.level[0]);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADCOMMUNICATIONERROR, alarms.quality[0]);
+    TEST_ASSERT_EQUAL_UINT64(2, alarms.events);
+    TEST_ASSERT_EQUAL_INT(0, _stage(&alarms, temperature, 0.0, UA_STATUSCODE_BADCOMMUNICATIONERROR));
+    TEST_ASSERT_EQUAL_UINT64(2, alarms.events);
+
+    // Back with a Normal value, then Bad again and back High
+    TEST_ASSERT_EQUAL_INT(1, _stage(&alarms, temperature, 50.0, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, alarms.quality[0]);
+    TEST_ASSERT_EQUAL_INT(0, _stage(&alarms, temperature, 50.0, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_INT(0, _stage(&alarms, temperature, 0.0, UA_STATUSCODE_BADNOCOMMUNICATION));
+    TEST_ASSERT_EQUAL_INT(1, _stage(&alarms, temperature, 85.0, UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_DOUBLE(ALARM_HIGH, alarms.level[0]);
+    TEST_ASSERT_EQUAL_UINT64(5, alarms.events);
+
+    free_alarms(&alarms);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
+
+/// @brief Test the evaluation kernel.
+/// @param None
+/// @return None
+/// @details This function tests that the vectorized evaluation gives the levels of the scalar rules for every
+/// batch length up to 13 rows, so that each remainder of the vector widths is covered.
+/// It checks values on the limits, within the hysteresis and limits that are not set.
+/// @note This function is part of the alarms test suite.
+/// @see alarms_evaluate()
+void test_alarms_evaluate(void){
+    Alarms alarms = {0};
+    const double values[13] = {50.0, 80.0, 79.0, 77.0, 95.0, 93.5, 92.0, 10.0, 11.0, 12.5, 5.0, 6.0, -1e9};
+    const double currents[13] = {0.0, 0.0, 1.0, 1.0, 1.0, 2.0, 2.0, 0.0, -1.0, -1.0, -1.0, -2.0, 2.0};
+    double value[13], high_high[13], high[13], low[13], low_low[13], hysteresis[13], current[13], next[13];
+
+    alarms.count = 13;
+    alarms.value = value;
+    alarms.high_high = high_high;
+    alarms.high = high;
+    alarms.low = low;
+    alarms.low_low = low_low;
+    alarms.hysteresis = hysteresis;
+    alarms.current = current;
+    alarms.next = next;
+
+    for (size_t count = 0; count <= 13; count++) {
+        for (size_t i = 0; i < count; i++) {
+            value[i] = values[i];
+            current[i] = currents[i];
+            high_high[i] = i % 4 == 3 ? NAN : 95.0;
+            high[i] = i % 5 == 4 ? NAN : 80.0;
+            low[i] = 10.0;
+            low_low[i] = i % 3 == 2 ? NAN : 5.0;
+            hysteresis[i] = 2.0;
+            next[i] = 42.0;
+        }
+
+        alarms_evaluate(&alarms, count);
+
+        for (size_t i = 0; i < count; i++) {
+            double v = value[i];
+            double c = current[i];
+            bool is_high_high = v >= high_high[i] || (c >= 2.0 && v > high_high[i] - hysteresis[i]);
+            bool is_high = v >= high[i] || (c >= 1.0 && v > high[i] - hysteresis[i]);
+            bool is_low_low = v <= low_low[i] || (c <= -2.0 && v < low_low[i] + hysteresis[i]);
+            bool is_low = v <= low[i] || (c <= -1.0 && v < low[i] + hysteresis[i]);
+            double expected = is_high_high ? 2.0 : is_high ? 1.0 : is_low_low ? -2.0 : is_low ? -1.0 : 0.0;
+
+            TEST_ASSERT_EQUAL_DOUBLE(expected, next[i]);
+        }
+    }
+
+    // Row 1 reaches High, row 2 stays in it, row 3 leaves it, row 6 falls back from HighHigh to High
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, next[1]);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, next[2]);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, next[3]);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, next[6]);
+}
@@ -0,0 +1,103 @@
+#include "../include/tests/compiled_machines_test.h"
+#include "../include/tests/machine_config_test.h"
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static char* _write(const ArrayMachineConfig* config, const char* source);
+
+
+/// @brief Write machine configurations into a string
+/// @return The generated text to free, NULL if writing failed
+static char* _write(const ArrayMachineConfig* config, const char* source){
+
+    char* text = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&text, &length);
+    bool written;
+
+    if (!out)
+        return NULL;
+    written = write_compiled_machine_config(config, source, out);
+    fclose(out);
+    if (!written) {
+        free(text);
+        return NULL;
+    }
+
+    return text;
+}
+
+/// @brief Test the generation of the compiled machine tables.
+/// @param None
+/// @return None
+/// @details This function tests that loaded machine configurations are written as C tables holding every
+/// setting of the machines, groups and items: queue, priority, aggregate windows, scaling and its infinite
+/// default range. It checks that the strings are escaped and that a group without items gets no table.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the compiled machines test suite.
+/// @see write_compiled_machine_config()
+void test_compiled_machines_write(void){
+    Group group = {0};
+    MachineConfig machine = {0};
+    ArrayMachineConfig config = {1, 1, &machine, false};
+    char* text;
+
+    load_machine_config("tests/fixtures/scaling", &machine_config);
+    text = _write(&machine_config, "tests/fixtures/scaling");
+    TEST_ASSERT_NOT_NULL(text);
+
+    TEST_ASSERT_NOT_NULL(strstr(text, "#define COMPILED_MACHINE_COUNT 1\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "#define COMPILED_MACHINES_SOURCE \"tests/fixtures/scaling\"\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "{.name = \"TEMPERATURE\", .nodeId = \"ns=5;i=1000\", .type = \"System.Double\""));
+    TEST_ASSERT_NOT_NULL(strstr(text, ".scaled = true, .scale = 0.10000000000000001, .offset = -40, .min = -40, .max = 150,\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text, ".on_demand = false, .ttl = 1000},\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text, ".scaled = false, .scale = 1, .offset = 0, .min = -INFINITY, .max = INFINITY,\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text, ".items = {4, 4, ITEMS_0_0}"));
+    TEST_ASSERT_NOT_NULL(strstr(text, ".queue_size = 32, .queue_overflow = QUEUE_OVERFLOW_DROP_OLDEST"));
+    TEST_ASSERT_NOT_NULL(strstr(text, ".url = \"opc.tcp://server-opcua-test:4840\""));
+    TEST_ASSERT_NOT_NULL(strstr(text, ".groups = {1, 1, GROUPS_0}}"));
+    free(text);
+    free_array_machine_config(&machine_config);
+
+    load_machine_config("tests/fixtures/aggregates", &machine_config);
+    text = _write(&machine_config, "tests/fixtures/aggregates");
+    TEST_ASSERT_NOT_NULL(text);
+    TEST_ASSERT_NOT_NULL(strstr(text, ".window_count = 2, .windows = {1000, 60000}}"));
+    TEST_ASSERT_NOT_NULL(strstr(text, ".source = ITEM_SOURCE_AGGREGATE"));
+    free(text);
+
+    // Quotes, backslashes, line breaks and UTF-8 cannot end the literals
+    machine.name = "Press \"A\"\\\n\xc3\xa9";
+    machine.groups = (ArrayGroup){1, 1, &group};
+    group.name = "EMPTY";
+    text = _write(&config, NULL);
+    TEST_ASSERT_NOT_NULL(text);
+    TEST_ASSERT_NOT_NULL(strstr(text, "{.name = \"Press \\\"A\\\"\\\\\\012\\303\\251\", .url = NULL"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "{.name = \"EMPTY\", .items = {0, 0, NULL}"));
+    TEST_ASSERT_NULL(strstr(text, "ITEMS_0_0"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "#define COMPILED_MACHINES_SOURCE NULL\n"));
+    free(text);
+}
+
+/// @brief Test the loading of the compiled machines.
+/// @param None
+/// @return None
+/// @details This function tests that a server built without compiled machines loads none, and that freeing a
+/// compiled array only resets it, the static tables are not freed.
+/// @note This function is part of the compiled machines test suite.
+/// @see load_compiled_machine_config(), compiled_machines_source(), free_array_machine_config()
+void test_compiled_machines_load(void){
+    static MachineConfig table[1] = {{.name = "Machine1"}};
+    ArrayMachineConfig config = {1, 1, table, true};
+
+    TEST_ASSERT_FALSE(load_compiled_machine_config(&machine_config));
+    TEST_ASSERT_EQUAL_INT(0, machine_config.count);
+    TEST_ASSERT_NULL(machine_config.configs);
+    TEST_ASSERT_NULL(compiled_machines_source());
+
+    free_array_machine_config(&config);
+    TEST_ASSERT_EQUAL_INT(0, config.count);
+    TEST_ASSERT_NULL(config.configs);
+    TEST_ASSERT_FALSE(config.compiled);
+    TEST_ASSERT_EQUAL_STRING("Machine1", table[0].name);
+}
@@ -0,0 +1,233 @@
+#include "../include/tests/discovery_test.h"
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void _reference(UA_ReferenceDescription* reference, UA_UInt16 ns, UA_UInt32 id, UA_NodeClass node_class,
+                       char* name, bool property);
+static void _browsed(Discovery* discovery, size_t object, UA_StatusCode status, UA_ReferenceDescription* references,
+                     size_t count, char* continuation);
+static void _sent(Discovery* discovery);
+static const char* _field(struct json_object* object, const char* key);
+
+
+/// @brief Fill a reference found by a browse, the strings are not copied
+static void _reference(UA_ReferenceDescription* reference, UA_UInt16 ns, UA_UInt32 id, UA_NodeClass node_class,
+                       char* name, bool property){
+
+    memset(reference, 0, sizeof(UA_ReferenceDescription));
+    reference->nodeId.nodeId = UA_NODEID_NUMERIC(ns, id);
+    reference->referenceTypeId = UA_NODEID_NUMERIC(0, property ? UA_NS0ID_HASPROPERTY : UA_NS0ID_HASCOMPONENT);
+    reference->nodeClass = node_class;
+    reference->browseName.name = UA_STRING(name);
+}
+
+/// @brief Feed the result of the browse of an object
+static void _browsed(Discovery* discovery, size_t object, UA_StatusCode status, UA_ReferenceDescription* references,
+                     size_t count, char* continuation){
+
+    UA_BrowseResult result;
+
+    memset(&result, 0, sizeof(UA_BrowseResult));
+    result.statusCode = status;
+    result.references = references;
+    result.referencesSize = count;
+    if (continuation) result.continuationPoint = UA_BYTESTRING(continuation);
+
+    discovery_browsed(discovery, &object, 1, UA_STATUSCODE_GOOD, &result, 1);
+}
+
+/// @brief Mark everything queued as sent, like the requests of discovery_run do
+static void _sent(Discovery* discovery){
+
+    for (size_t c = 0; c < discovery->continuation_count; c++) UA_ByteString_clear(&discovery->continuations[c].point);
+    discovery->continuation_count = 0;
+    discovery->browse_retry_count = 0;
+    discovery->read_retry_count = 0;
+    discovery->browsed = discovery->object_count;
+    discovery->typed = discovery->variable_count;
+}
+
+/// @brief String field of a json object, NULL if missing
+static const char* _field(struct json_object* object, const char* key){
+
+    struct json_object* value;
+
+    return json_object_object_get_ex(object, key, &value) ? json_object_get_string(value) : NULL;
+}
+
+/// @brief Test the collection of browse and read results.
+/// @param None
+/// @return None
+/// @details This function tests that the objects and variables of a browse result are collected once, through
+/// their first reference and across continuation points, and that namespace 0 and properties are skipped.
+/// It checks that the Subscriptions hold one Group per object with variables, with the types read.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the discovery test suite.
+/// @see discovery_browsed(), discovery_typed(), discovery_subscriptions()
+void test_discovery_collect(void){
+    Discovery discovery;
+    UA_NodeId root = UA_NODEID_NUMERIC(1, 1);
+    UA_ReferenceDescription references[4];
+    UA_DataValue types[3];
+    UA_NodeId type_ids[2] = {UA_NODEID_NUMERIC(0, UA_NS0ID_DOUBLE), UA_NODEID_NUMERIC(0, UA_NS0ID_FLOAT)};
+    size_t variables[3] = {0, 1, 2};
+    struct json_object* subscriptions;
+    struct json_object* group;
+    struct json_object* items;
+
+    init_discovery(&discovery, NULL, &root, "Line", 8, 8, 1);
+    _sent(&discovery);
+
+    _reference(&references[0], 1, 10, UA_NODECLASS_OBJECT, "Cell", false);
+    _reference(&references[1], 1, 20, UA_NODECLASS_VARIABLE, "Speed", false);
+    _reference(&references[2], 0, 2253, UA_NODECLASS_OBJECT, "Server", false);
+    _reference(&references[3], 1, 21, UA_NODECLASS_VARIABLE, "EngineeringUnits", true);
+    _browsed(&discovery, 0, UA_STATUSCODE_GOOD, references, 4, "next");
+    TEST_ASSERT_EQUAL_size_t(2, discovery.object_count);
+    TEST_ASSERT_EQUAL_size_t(1, discovery.variable_count);
+    TEST_ASSERT_EQUAL_size_t(1, discovery.continuation_count);
+
+    // Nothing is built before the continuation point and the new nodes are sent
+    TEST_ASSERT_NULL(discovery_subscriptions(&discovery));
+    _sent(&discovery);
+
+    // The rest of the references of the root, Speed is found twice
+    _reference(&references[0], 1, 20, UA_NODECLASS_VARIABLE, "Speed", false);
+    _reference(&references[1], 1, 30, UA_NODECLASS_VARIABLE, "Temperature", false);
+    _browsed(&discovery, 0, UA_STATUSCODE_GOOD, references, 2, NULL);
+    _reference(&references[0], 1, 40, UA_NODECLASS_VARIABLE, "Level", false);
+    _browsed(&discovery, 1, UA_STATUSCODE_GOOD, references, 1, NULL);
+    TEST_ASSERT_EQUAL_size_t(3, discovery.variable_count);
+    _sent(&discovery);
+
+    // Level has no DataType the gateway knows
+    for (size_t v = 0; v < 3; v++) UA_DataValue_init(&types[v]);
+    for (size_t v = 0; v < 2; v++) {
+        UA_Variant_setScalar(&types[v].value, &type_ids[v], &UA_TYPES[UA_TYPES_NODEID]);
+        types[v].hasValue = true;
+    }
+    discovery_typed(&discovery, variables, 3, UA_STATUSCODE_GOOD, types, 3);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, discovery.status);
+
+    subscriptions = discovery_subscriptions(&discovery);
+    TEST_ASSERT_NOT_NULL(subscriptions);
+    TEST_ASSERT_EQUAL_size_t(2, json_object_array_length(subscriptions));
+
+    group = json_object_array_get_idx(subscriptions, 0);
+    TEST_ASSERT_EQUAL_STRING("Line", _field(group, "Name"));
+    json_object_object_get_ex(group, "Items", &items);
+    TEST_ASSERT_EQUAL_size_t(2, json_object_array_length(items));
+    TEST_ASSERT_EQUAL_STRING("Speed", _field(json_object_array_get_idx(items, 0), "Name"));
+    TEST_ASSERT_EQUAL_STRING("System.Double", _field(json_object_array_get_idx(items, 0), "Type"));
+    TEST_ASSERT_EQUAL_STRING("System.Single", _field(json_object_array_get_idx(items, 1), "Type"));
+
+    group = json_object_array_get_idx(subscriptions, 1);
+    TEST_ASSERT_EQUAL_STRING("Cell", _field(group, "Name"));
+    json_object_object_get_ex(group, "Items", &items);
+    TEST_ASSERT_EQUAL_size_t(1, json_object_array_length(items));
+    TEST_ASSERT_NULL(_field(json_object_array_get_idx(items, 0), "Type"));
+
+    json_object_put(subscriptions);
+    free_discovery(&discovery);
+}
+
+/// @brief Test sending nodes again after a transient status.
+/// @param None
+/// @return None
+/// @details This function tests that an object answered with BadNoContinuationPoints is queued to be browsed
+/// again with smaller batches, and that a variable answered with BadTooManyOperations is queued to be read again.
+/// It checks that a node still failing after DISCOVER_MAX_ATTEMPTS sends aborts the discovery, which then
+/// builds no Subscriptions.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the discovery test suite.
+/// @see discovery_browsed(), discovery_typed(), discovery_subscriptions()
+void test_discovery_retry(void){
+    Discovery discovery;
+    UA_NodeId root = UA_NODEID_NUMERIC(1, 1);
+    UA_ReferenceDescription reference;
+    UA_DataValue type;
+    size_t objects[1] = {0};
+    size_t variables[1] = {0};
+
+    init_discovery(&discovery, NULL, &root, "Line", 8, 8, 1);
+    _sent(&discovery);
+
+    _browsed(&discovery, 0, UA_STATUSCODE_BADNOCONTINUATIONPOINTS, NULL, 0, NULL);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, discovery.status);
+    TEST_ASSERT_EQUAL_size_t(1, discovery.browse_retry_count);
+    TEST_ASSERT_EQUAL_size_t(0, discovery.browse_retries[0]);
+    TEST_ASSERT_EQUAL_size_t(4, discovery.browse_batch);
+    TEST_ASSERT_NULL(discovery_subscriptions(&discovery));
+    _sent(&discovery);
+
+    _reference(&reference, 1, 20, UA_NODECLASS_VARIABLE, "Speed", false);
+    _browsed(&discovery, 0, UA_STATUSCODE_GOOD, &reference, 1, NULL);
+    _sent(&discovery);
+
+    UA_DataValue_init(&type);
+    type.hasStatus = true;
+    type.status = UA_STATUSCODE_BADTOOMANYOPERATIONS;
+    discovery_typed(&discovery, variables, 1, UA_STATUSCODE_GOOD, &type, 1);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, discovery.status);
+    TEST_ASSERT_EQUAL_size_t(1, discovery.read_retry_count);
+    TEST_ASSERT_EQUAL_size_t(4, discovery.read_batch);
+    _sent(&discovery);
+
+    // The root already failed once, a service failure counts for every node of the request
+    for (size_t attempt = 2; attempt < DISCOVER_MAX_ATTEMPTS; attempt++) {
+        discovery_browsed(&discovery, objects, 1, UA_STATUSCODE_BADTIMEOUT, NULL, 0);
+        TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, discovery.status);
+        TEST_ASSERT_EQUAL_size_t(1, discovery.browse_retry_count);
+        _sent(&discovery);
+    }
+    discovery_browsed(&discovery, objects, 1, UA_STATUSCODE_BADTIMEOUT, NULL, 0);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADTIMEOUT, discovery.status);
+    TEST_ASSERT_EQUAL_size_t(0, discovery.browse_retry_count);
+    TEST_ASSERT_NULL(discovery_subscriptions(&discovery));
+
+    free_discovery(&discovery);
+}
+
+/// @brief Test aborting a discovery on a bad status.
+/// @param None
+/// @return None
+/// @details This function tests that a node answered with a status that does not clear on its own, or a response
+/// with fewer results than nodes, aborts the discovery with that status.
+/// It checks that the results received after the abort are ignored and that no Subscriptions are built, so a
+/// machine file is never written from a partial discovery.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the discovery test suite.
+/// @see discovery_browsed(), discovery_subscriptions()
+void test_discovery_abort(void){
+    Discovery discovery;
+    UA_NodeId root = UA_NODEID_NUMERIC(1, 1);
+    UA_ReferenceDescription reference;
+    UA_BrowseResult result;
+    size_t objects[2] = {0, 1};
+
+    init_discovery(&discovery, NULL, &root, "Line", 8, 8, 1);
+    _sent(&discovery);
+
+    _browsed(&discovery, 0, UA_STATUSCODE_BADNODEIDUNKNOWN, NULL, 0, NULL);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADNODEIDUNKNOWN, discovery.status);
+    TEST_ASSERT_EQUAL_size_t(0, discovery.browse_retry_count);
+
+    _reference(&reference, 1, 20, UA_NODECLASS_VARIABLE, "Speed", false);
+    _browsed(&discovery, 0, UA_STATUSCODE_GOOD, &reference, 1, NULL);
+    TEST_ASSERT_EQUAL_size_t(0, discovery.variable_count);
+    TEST_ASSERT_NULL(discovery_subscriptions(&discovery));
+    free_discovery(&discovery);
+
+    // Two objects browsed, one result
+    init_discovery(&discovery, NULL, &root, "Line", 8, 8, 1);
+    _reference(&reference, 1, 10, UA_NODECLASS_OBJECT, "Cell", false);
+    _browsed(&discovery, 0, UA_STATUSCODE_GOOD, &reference, 1, NULL);
+    _sent(&discovery);
+
+    memset(&result, 0, sizeof(UA_BrowseResult));
+    discovery_browsed(&discovery, objects, 2, UA_STATUSCODE_GOOD, &result, 1);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADUNEXPECTEDERROR, discovery.status);
+    TEST_ASSERT_NULL(discovery_subscriptions(&discovery));
+
+    free_discovery(&discovery);
+}
@@ -0,0 +1,209 @@
+#include "../include/tests/expression_test.h"
+#include "../include/tests/machine_config_test.h"
+
+#include <math.h>
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static UA_Double _evaluate(const char* text, const AddressSpace* address_space, const UA_Double* values);
+static void _push_double(Gateway* gateway, size_t item, UA_Double number);
+
+
+/// @brief Compile and run an expression of the DATA group
+/// @return The result, NAN if the expression does not compile
+static UA_Double _evaluate(const char* text, const AddressSpace* address_space, const UA_Double* values){
+
+    AddressSpaceNode position = {ADDRESS_SPACE_NODE_ITEM, 0, 1, 2};
+    Expression expression = {0};
+    UA_Double result;
+    char error[256];
+
+    if (!expression_compile(&expression, text, address_space, &position, error, sizeof(error))) return NAN;
+
+    result = expression_evaluate(&expression, values);
+    free_expression(&expression);
+
+    return result;
+}
+
+/// @brief Push a Double value received from upstream
+static void _push_double(Gateway* gateway, size_t item, UA_Double number){
+
+    UA_DataValue value;
+
+    UA_DataValue_init(&value);
+    UA_Variant_setScalarCopy(&value.value, &number, &UA_TYPES[UA_TYPES_DOUBLE]);
+    value.hasValue = true;
+    gateway_push(gateway, item, &value);
+}
+
+/// @brief Test the compilation and evaluation of expressions.
+/// @param None
+/// @return None
+/// @details This function tests operator precedence, functions, the conditional operator and item references
+/// relative to the group, the machine or across machines.
+/// It checks that syntax errors and unknown items are reported.
+/// @note This function is part of the expression test suite.
+/// @see expression_compile(), expression_evaluate(), free_expression()
+void test_expression_compile(void){
+    AddressSpace address_space;
+    AddressSpaceNode position = {ADDRESS_SPACE_NODE_ITEM, 0, 1, 2};
+    Expression expression = {0};
+    UA_Double values[8] = {1.0, 230.0, 5.0};
+    char error[256];
+
+    load_machine_config("tests/fixtures/expressions", &machine_config);
+    init_address_space(&address_space, &machine_config);
+
+    TEST_ASSERT_EQUAL_DOUBLE(7.0, _evaluate("1 + 2 * 3", &address_space, values));
+    TEST_ASSERT_EQUAL_DOUBLE(9.0, _evaluate("(1 + 2) * 3", &address_space, values));
+    TEST_ASSERT_EQUAL_DOUBLE(-5.0, _evaluate("-2 - 3", &address_space, values));
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, _evaluate("10 % 4 == 2 || false", &address_space, values));
+    TEST_ASSERT_EQUAL_DOUBLE(1150.0, _evaluate("{VOLTAGE} * {DATA/CURRENT}", &address_space, values));
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, _evaluate("!{Machine1/FLAGS/PC}", &address_space, values));
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, _evaluate("{CURRENT} > 2 ? min({CURRENT}, 10) : max(1, 0)", &address_space, values));
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, _evaluate("round(sqrt(abs(-4.2)))", &address_space, values));
+
+    TEST_ASSERT_FALSE(expression_compile(&expression, "{MISSING} + 1", &address_space, &position, error, sizeof(error)));
+    TEST_ASSERT_EQUAL_STRING("Unknown item {MISSING} at offset 1", error);
+    TEST_ASSERT_NULL(expression.code);
+    TEST_ASSERT_FALSE(expression_compile(&expression, "1 +", &address_space, &position, error, sizeof(error)));
+    TEST_ASSERT_FALSE(expression_compile(&expression, "(1", &address_space, &position, error, sizeof(error)));
+    TEST_ASSERT_FALSE(expression_compile(&expression, "1 2", &address_space, &position, error, sizeof(error)));
+    TEST_ASSERT_FALSE(expression_compile(&expression, "log(1)", &address_space, &position, error, sizeof(error)));
+    TEST_ASSERT_FALSE(expression_compile(&expression, "min(1)", &address_space, &position, error, sizeof(error)));
+
+    free_address_space(&address_space);
+}
+
+/// @brief Test the incremental evaluation of derived items.
+/// @param None
+/// @return None
+/// @details This function tests that a change re-evaluates the dependent expressions only and that results are
+/// published when they change, waiting for every referenced item first.
+/// It checks that constant expressions are published at startup and that cycles and invalid expressions are published Bad.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the expression test suite.
+/// @see init_expressions(), expressions_update(), free_expressions()
+void test_expressions_update(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    Expressions expressions;
+    UA_DataValue value;
+    size_t pc, voltage, current, power, overload, poles;
+
+    load_machine_config("tests/fixtures/expressions", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    init_expressions(&expressions, &gateway);
+
+    pc = address_space.machines[0].first_item;
+    voltage = pc + address_space.machines[0].group_first_item[1];
+    current = voltage + 1;
+    power = voltage + 2;
+    overload = voltage + 3;
+    poles = voltage + 4;
+
+    // LOOP references itself and UNKNOWN a missing item, neither is evaluated but both are published Bad once
+    TEST_ASSERT_EQUAL_INT(5, expressions.count);
+    TEST_ASSERT_NOT_NULL(expressions.expressions[0].code);
+    TEST_ASSERT_NULL(expressions.expressions[3].code);
+    TEST_ASSERT_NULL(expressions.expressions[4].code);
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[poles + 1], &value));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADCONFIGURATIONERROR, value.status);
+    UA_DataValue_clear(&value);
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[poles + 2], &value));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADCONFIGURATIONERROR, value.status);
+    UA_DataValue_clear(&value);
+
+    // Constant expressions are published at startup, converted to the item type
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[poles], &value));
+    TEST_ASSERT_TRUE(UA_Variant_hasScalarType(&value.value, &UA_TYPES[UA_TYPES_INT32]));
+    TEST_ASSERT_EQUAL_INT(6, *(UA_Int32*)value.value.data);
+    UA_DataValue_clear(&value);
+
+    // POWER waits for CURRENT, OVERLOAD waits for POWER and PC
+    _push_double(&gateway, voltage, 230.0);
+    TEST_ASSERT_EQUAL_INT(1, gateway.queues[power].count);
+    TEST_ASSERT_EQUAL_INT(1, gateway.queues[overload].count);
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[power], &value));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADWAITINGFORINITIALDATA, value.status);
+    UA_DataValue_clear(&value);
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[overload], &value));
+    UA_DataValue_clear(&value);
+
+    _push_double(&gateway, current, 5.0);
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[power], &value));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, value.status);
+    TEST_ASSERT_EQUAL_DOUBLE(1150.0, *(UA_Double*)value.value.data);
+    UA_DataValue_clear(&value);
+    TEST_ASSERT_EQUAL_INT(0, gateway.queues[overload].count);
+
+    _push_double(&gateway, pc, 0.0);
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[overload], &value));
+    TEST_ASSERT_TRUE(UA_Variant_hasScalarType(&value.value, &UA_TYPES[UA_TYPES_BOOLEAN]));
+    TEST_ASSERT_TRUE(*(UA_Boolean*)value.value.data);
+    UA_DataValue_clear(&value);
+
+    // An unchanged result is not published again
+    _push_double(&gateway, current, 5.0);
+    TEST_ASSERT_EQUAL_INT(0, gateway.queues[power].count);
+    TEST_ASSERT_EQUAL_INT(0, gateway.queues[poles].count);
+
+    free_expressions(&expressions);
+    TEST_ASSERT_NULL(gateway.expressions);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
+
+/// @brief Test the expressions taking part in a reference cycle.
+/// @param None
+/// @return None
+/// @details This function tests that only the members of a cycle are dropped, while the expressions reaching the
+/// cycle keep their program and are published with BadConfigurationError.
+/// It checks that the expressions outside the cycle are still evaluated.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the expression test suite.
+/// @see init_expressions(), expressions_update(), free_expressions()
+void test_expressions_cycles(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    Expressions expressions;
+    UA_DataValue value;
+    size_t speed;
+
+    load_machine_config("tests/fixtures/cycles", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    init_expressions(&expressions, &gateway);
+
+    speed = address_space.machines[0].first_item;
+
+    // B and C reference each other, A reaches the cycle and D reaches A
+    TEST_ASSERT_EQUAL_INT(5, expressions.count);
+    TEST_ASSERT_NOT_NULL(expressions.expressions[0].code);
+    TEST_ASSERT_NULL(expressions.expressions[1].code);
+    TEST_ASSERT_NULL(expressions.expressions[2].code);
+    TEST_ASSERT_NOT_NULL(expressions.expressions[3].code);
+    TEST_ASSERT_NOT_NULL(expressions.expressions[4].code);
+    for (size_t e = 0; e < 4; e++) {
+        TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADCONFIGURATIONERROR, expressions.expressions[e].error);
+        TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[speed + 1 + e], &value));
+        TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADCONFIGURATIONERROR, value.status);
+        UA_DataValue_clear(&value);
+    }
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, expressions.expressions[4].error);
+    TEST_ASSERT_EQUAL_INT(0, gateway.queues[speed + 5].count);
+
+    // A change of SPEED evaluates E, D stays Bad and is not published again
+    _push_double(&gateway, speed, 10.0);
+    TEST_ASSERT_EQUAL_INT(0, gateway.queues[speed + 4].count);
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[speed + 5], &value));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, value.status);
+    TEST_ASSERT_EQUAL_DOUBLE(20.0, *(UA_Double*)value.value.data);
+    UA_DataValue_clear(&value);
+
+    free_expressions(&expressions);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
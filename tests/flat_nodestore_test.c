@@ -0,0 +1,197 @@
+#include "../include/tests/flat_nodestore_test.h"
+#include "../include/tests/machine_config_test.h"
+
+#include <open62541/plugin/nodestore_default.h>
+
+#include <math.h>
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void _install(UA_ServerConfig* config, AddressSpace* address_space, UA_Server* server);
+static UA_NodeId _node_id(const AddressSpace* address_space, AddressSpaceNodeKind kind, size_t group, size_t item);
+static void _set_double(UA_DataValue* value, UA_Double number);
+static UA_Double _get_double(const UA_Node* node);
+
+
+/// @brief Install the flat nodestore over a hash map nodestore for the layout of the filled fixtures
+static void _install(UA_ServerConfig* config, AddressSpace* address_space, UA_Server* server){
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(address_space, &machine_config);
+    address_space_register_namespaces(address_space, server);
+
+    memset(config, 0, sizeof(UA_ServerConfig));
+    TEST_ASSERT_EQUAL_INT(UA_STATUSCODE_GOOD, UA_Nodestore_HashMap(&config->nodestore));
+    TEST_ASSERT_EQUAL_INT(UA_STATUSCODE_GOOD, flat_nodestore_install(config, address_space));
+}
+
+/// @brief NodeId of a node of the second machine (groups FLAGS and DATA)
+static UA_NodeId _node_id(const AddressSpace* address_space, AddressSpaceNodeKind kind, size_t group, size_t item){
+
+    AddressSpaceNode position = {.kind = kind, .machine = 1, .group = group, .item = item};
+
+    return address_space_node_id(address_space, &position);
+}
+
+/// @brief Replace a value with a Double
+static void _set_double(UA_DataValue* value, UA_Double number){
+
+    UA_DataValue_clear(value);
+    UA_Variant_setScalarCopy(&value->value, &number, &UA_TYPES[UA_TYPES_DOUBLE]);
+    value->hasValue = true;
+}
+
+/// @brief Double value of an item view, NAN without a Double
+static UA_Double _get_double(const UA_Node* node){
+
+    const UA_Variant* value = &node->variableNode.value.data.value.value;
+
+    if (!UA_Variant_hasScalarType(value, &UA_TYPES[UA_TYPES_DOUBLE])) return NAN;
+
+    return *(const UA_Double*)value->data;
+}
+
+/// @brief Test releasing a view after its slot was replaced.
+/// @param None
+/// @return None
+/// @details This function tests that a view owns a copy of the item value: replacing the slot while the view is out
+/// leaves the view readable with the value it was assembled with.
+/// It checks that releasing the unwritten view afterwards keeps the replaced value in the slot.
+/// It also ensures that the nodestore and the memory are freed correctly after the test.
+/// @note This function is part of the flat nodestore test suite.
+/// @see flat_nodestore_install()
+void test_flat_nodestore_replace(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    UA_ServerConfig config;
+    UA_Nodestore* store = &config.nodestore;
+    UA_ReferenceTypeSet references = UA_REFERENCETYPESET_NONE;
+    UA_NodeId node_id;
+    const UA_Node* view = NULL;
+    const UA_Node* other;
+    UA_Node* copy;
+
+    _install(&config, &address_space, server);
+    node_id = _node_id(&address_space, ADDRESS_SPACE_NODE_ITEM, 1, 2);
+
+    // Replace the slot before the view is assembled, then twice while it is out: the value the view was
+    // assembled with is freed by the first of these replaces
+    for (int i = 0; i <= 2; i++) {
+        if (i == 1) {
+            view = store->getNode(store->context, &node_id, 0, references, UA_BROWSEDIRECTION_BOTH);
+            TEST_ASSERT_NOT_NULL(view);
+            TEST_ASSERT_EQUAL_INT(UA_NODECLASS_VARIABLE, view->head.nodeClass);
+        }
+
+        TEST_ASSERT_EQUAL_INT(UA_STATUSCODE_GOOD, store->getNodeCopy(store->context, &node_id, &copy));
+        _set_double(&copy->variableNode.value.data.value, 1.5 * i);
+        TEST_ASSERT_EQUAL_INT(UA_STATUSCODE_GOOD, store->replaceNode(store->context, copy));
+    }
+
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, _get_double(view));
+    store->releaseNode(store->context, view);
+
+    other = store->getNode(store->context, &node_id, 0, references, UA_BROWSEDIRECTION_BOTH);
+    TEST_ASSERT_EQUAL_DOUBLE(3.0, _get_double(other));
+    store->releaseNode(store->context, other);
+
+    store->clear(store->context);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
+
+/// @brief Test writing a value in place on a view.
+/// @param None
+/// @return None
+/// @details This function tests that a value written on a view, as the server does when it edits a node, moves into
+/// the slot when the view is released.
+/// It checks that releasing an older view of the same item afterwards does not undo the write.
+/// It also ensures that the nodestore and the memory are freed correctly after the test.
+/// @note This function is part of the flat nodestore test suite.
+/// @see flat_nodestore_install()
+void test_flat_nodestore_write(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    UA_ServerConfig config;
+    UA_Nodestore* store = &config.nodestore;
+    UA_ReferenceTypeSet references = UA_REFERENCETYPESET_NONE;
+    UA_NodeId node_id;
+    const UA_Node* older;
+    const UA_Node* view;
+    UA_Node* edited;
+
+    _install(&config, &address_space, server);
+    node_id = _node_id(&address_space, ADDRESS_SPACE_NODE_ITEM, 0, 0);
+
+    older = store->getNode(store->context, &node_id, 0, references, UA_BROWSEDIRECTION_BOTH);
+    view = store->getNode(store->context, &node_id, 0, references, UA_BROWSEDIRECTION_BOTH);
+    TEST_ASSERT_NOT_NULL(older);
+    TEST_ASSERT_NOT_NULL(view);
+
+    // The server edits the node it got in place and releases it
+    edited = (UA_Node*)(uintptr_t)view;
+    _set_double(&edited->variableNode.value.data.value, 42.0);
+    store->releaseNode(store->context, view);
+
+    TEST_ASSERT_TRUE(isnan(_get_double(older)));
+    store->releaseNode(store->context, older);
+
+    view = store->getNode(store->context, &node_id, 0, references, UA_BROWSEDIRECTION_BOTH);
+    TEST_ASSERT_EQUAL_DOUBLE(42.0, _get_double(view));
+    store->releaseNode(store->context, view);
+
+    store->clear(store->context);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
+
+/// @brief Test the fixed structure of the gateway namespaces.
+/// @param None
+/// @return None
+/// @details This function tests that group views carry a HasComponent reference per item of the group.
+/// It checks that replacing a group, removing an item and inserting a node with a gateway NodeId are rejected.
+/// It also ensures that the nodestore and the memory are freed correctly after the test.
+/// @note This function is part of the flat nodestore test suite.
+/// @see flat_nodestore_install()
+void test_flat_nodestore_structure(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    UA_ServerConfig config;
+    UA_Nodestore* store = &config.nodestore;
+    UA_ReferenceTypeSet references = UA_REFERENCETYPESET_ALL;
+    UA_NodeId group_id;
+    UA_NodeId item_id;
+    const UA_Node* view;
+    UA_Node* node;
+    size_t components = 0;
+
+    _install(&config, &address_space, server);
+    group_id = _node_id(&address_space, ADDRESS_SPACE_NODE_GROUP, 0, 0);
+    item_id = _node_id(&address_space, ADDRESS_SPACE_NODE_ITEM, 0, 1);
+
+    // Group FLAGS holds PC and PLC
+    view = store->getNode(store->context, &group_id, 0, references, UA_BROWSEDIRECTION_FORWARD);
+    TEST_ASSERT_NOT_NULL(view);
+    TEST_ASSERT_EQUAL_INT(UA_NODECLASS_OBJECT, view->head.nodeClass);
+    for (size_t k = 0; k < view->head.referencesSize; k++) {
+        if (view->head.references[k].referenceTypeIndex == UA_REFERENCETYPEINDEX_HASCOMPONENT &&
+            !view->head.references[k].isInverse) {
+            components += view->head.references[k].targetsSize;
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(2, components);
+    store->releaseNode(store->context, view);
+
+    TEST_ASSERT_EQUAL_INT(UA_STATUSCODE_GOOD, store->getNodeCopy(store->context, &group_id, &node));
+    TEST_ASSERT_EQUAL_INT(UA_STATUSCODE_BADNOTSUPPORTED, store->replaceNode(store->context, node));
+    TEST_ASSERT_EQUAL_INT(UA_STATUSCODE_BADNOTSUPPORTED, store->removeNode(store->context, &item_id));
+
+    node = store->newNode(store->context, UA_NODECLASS_VARIABLE);
+    TEST_ASSERT_NOT_NULL(node);
+    UA_NodeId_copy(&item_id, &node->head.nodeId);
+    TEST_ASSERT_EQUAL_INT(UA_STATUSCODE_BADNODEIDEXISTS, store->insertNode(store->context, node, NULL));
+
+    store->clear(store->context);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
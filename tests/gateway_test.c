@@ -0,0 +1,191 @@
+#include "../include/tests/gateway_test.h"
+#include "../include/tests/machine_config_test.h"
+
+#include <open62541/server_config_default.h>
+
+/// @brief Test the queues of the gateway.
+/// @param None
+/// @return None
+/// @details This function tests that pushed values are published one per item and per turn within the budget.
+/// It checks that a full Block queue pauses its machine until a value is published and that overflows are counted per Group.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the gateway test suite.
+/// @see init_gateway(), gateway_push(), gateway_publish(), gateway_machine_blocked(), free_gateway()
+void test_gateway_queues(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    Gateway gateway;
+    UA_DataValue value;
+    size_t flags;
+    size_t data;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+
+    // FLAGS keeps the default queue, DATA is a Block queue of 4 values
+    flags = address_space.machines[0].first_item;
+    data = flags + address_space.machines[0].group_first_item[1];
+
+    UA_DataValue_init(&value);
+    TEST_ASSERT_TRUE(gateway_push(&gateway, flags, &value));
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(gateway_push(&gateway, data, &value));
+    }
+    TEST_ASSERT_TRUE(gateway_machine_blocked(&gateway, 0));
+    TEST_ASSERT_FALSE(gateway_machine_blocked(&gateway, 1));
+
+    TEST_ASSERT_FALSE(gateway_push(&gateway, data, &value));
+    TEST_ASSERT_EQUAL_INT(1, gateway.group_overflows[gateway.first_group[0] + 1]);
+    TEST_ASSERT_EQUAL_INT(0, gateway.group_overflows[gateway.first_group[0]]);
+    TEST_ASSERT_FALSE(gateway_push(&gateway, address_space.item_count, &value));
+
+    // One value per item and per turn: FLAGS first, then DATA
+    TEST_ASSERT_EQUAL_INT(2, gateway_publish(&gateway, server, 2));
+    TEST_ASSERT_EQUAL_INT(0, gateway.queues[flags].count);
+    TEST_ASSERT_EQUAL_INT(3, gateway.queues[data].count);
+    TEST_ASSERT_FALSE(gateway_machine_blocked(&gateway, 0));
+
+    TEST_ASSERT_EQUAL_INT(3, gateway_publish(&gateway, server, GATEWAY_PUBLISH_BUDGET));
+    TEST_ASSERT_EQUAL_INT(0, gateway_publish(&gateway, server, GATEWAY_PUBLISH_BUDGET));
+
+    free_gateway(&gateway);
+    TEST_ASSERT_NULL(gateway.queues);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
+
+/// @brief Test the cached encoding of the published values.
+/// @param None
+/// @return None
+/// @details This function tests that a scalar value with the same value and status as the last published value of its item
+/// is counted as unchanged instead of being written, even when its server or source timestamp differs.
+/// It checks that a new value or another item are published normally, that the cache follows them and their timestamps,
+/// and that a value written into the node by another writer than the gateway replaces the cached encoding.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the gateway test suite.
+/// @see gateway_push(), gateway_publish(), gateway_written(), free_gateway()
+void test_gateway_unchanged_values(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    Gateway gateway;
+    UA_DataValue value;
+    UA_Int32 values[] = {7, 7, 7, 8, 8};
+    UA_DateTime stamps[] = {1, 1, 1, 1, 2};
+    size_t flags;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    flags = address_space.machines[0].first_item;
+
+    // Resent, resent with another server timestamp, changed value, resent with another source timestamp
+    for (size_t i = 0; i < 5; i++) {
+        UA_DataValue_init(&value);
+        UA_Variant_setScalarCopy(&value.value, &values[i], &UA_TYPES[UA_TYPES_INT32]);
+        value.hasValue = true;
+        value.hasSourceTimestamp = true;
+        value.sourceTimestamp = stamps[i];
+        value.hasServerTimestamp = true;
+        value.serverTimestamp = i == 2 ? 100 : 10;
+        TEST_ASSERT_TRUE(gateway_push(&gateway, flags, &value));
+        TEST_ASSERT_EQUAL_INT(1, gateway_publish(&gateway, server, GATEWAY_PUBLISH_BUDGET));
+    }
+    TEST_ASSERT_EQUAL_UINT64(3, gateway.unchanged);
+    TEST_ASSERT_TRUE(gateway.encoded[flags].length > 0);
+
+    // The cache keeps the latest source timestamp of the unchanged value
+    TEST_ASSERT_TRUE(gateway_current(&gateway, flags, &value));
+    TEST_ASSERT_EQUAL_INT(8, *(UA_Int32*)value.value.data);
+    TEST_ASSERT_EQUAL_INT64(stamps[4], value.sourceTimestamp);
+    UA_DataValue_clear(&value);
+
+    // Another writer replaced the node value: the last upstream value is published again
+    UA_DataValue_init(&value);
+    UA_Variant_setScalarCopy(&value.value, &values[0], &UA_TYPES[UA_TYPES_INT32]);
+    value.hasValue = true;
+    gateway_written(&gateway, flags, &value);
+    UA_DataValue_clear(&value);
+    UA_Variant_setScalarCopy(&value.value, &values[4], &UA_TYPES[UA_TYPES_INT32]);
+    value.hasValue = true;
+    value.hasSourceTimestamp = true;
+    value.sourceTimestamp = stamps[4];
+    TEST_ASSERT_TRUE(gateway_push(&gateway, flags, &value));
+    TEST_ASSERT_EQUAL_INT(1, gateway_publish(&gateway, server, GATEWAY_PUBLISH_BUDGET));
+    TEST_ASSERT_EQUAL_UINT64(3, gateway.unchanged);
+
+    // Empty values are not cached and always published
+    UA_DataValue_init(&value);
+    TEST_ASSERT_TRUE(gateway_push(&gateway, flags, &value));
+    TEST_ASSERT_TRUE(gateway_push(&gateway, flags + 1, &value));
+    TEST_ASSERT_EQUAL_INT(2, gateway_publish(&gateway, server, GATEWAY_PUBLISH_BUDGET));
+    TEST_ASSERT_EQUAL_UINT64(3, gateway.unchanged);
+    TEST_ASSERT_EQUAL_size_t(0, gateway.encoded[flags].length);
+
+    free_gateway(&gateway);
+    TEST_ASSERT_NULL(gateway.encoded);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
+
+/// @brief Test the priority classes of the gateway.
+/// @param None
+/// @return None
+/// @details This function tests that values of a High Group are published before the values of a Low Group queued earlier,
+/// and that a burst on a High item leaves the Low items one value per scheduler round instead of starving them.
+/// It checks the number of values published per class and that their latencies are measured.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the gateway test suite.
+/// @see gateway_push(), gateway_publish(), free_gateway()
+void test_gateway_priorities(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    Gateway gateway;
+    UA_DataValue value;
+    size_t pc;
+    size_t plc;
+    size_t data;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+
+    // FLAGS is High, DATA is Low
+    pc = address_space.machines[0].first_item;
+    plc = pc + 1;
+    data = pc + address_space.machines[0].group_first_item[1];
+    TEST_ASSERT_EQUAL_INT(PRIORITY_HIGH, gateway.item_class[pc]);
+    TEST_ASSERT_EQUAL_INT(PRIORITY_LOW, gateway.item_class[data]);
+
+    // Flags received after the data are published first
+    UA_DataValue_init(&value);
+    for (int i = 0; i < 3; i++) gateway_push(&gateway, data, &value);
+    gateway_push(&gateway, pc, &value);
+    gateway_push(&gateway, plc, &value);
+
+    TEST_ASSERT_EQUAL_INT(2, gateway_publish(&gateway, server, 2));
+    TEST_ASSERT_EQUAL_INT(0, gateway.queues[pc].count);
+    TEST_ASSERT_EQUAL_INT(0, gateway.queues[plc].count);
+    TEST_ASSERT_EQUAL_INT(3, gateway.queues[data].count);
+
+    // A burst of flags: 8 flags and 1 data value per round
+    for (int i = 0; i < 12; i++) gateway_push(&gateway, pc, &value);
+    TEST_ASSERT_EQUAL_INT(10, gateway_publish(&gateway, server, 10));
+    TEST_ASSERT_EQUAL_INT(3, gateway.queues[pc].count);
+    TEST_ASSERT_EQUAL_INT(2, gateway.queues[data].count);
+
+    TEST_ASSERT_EQUAL_INT(5, gateway_publish(&gateway, server, GATEWAY_PUBLISH_BUDGET));
+    TEST_ASSERT_EQUAL_UINT64(14, gateway.classes[PRIORITY_HIGH].published);
+    TEST_ASSERT_EQUAL_UINT64(0, gateway.classes[PRIORITY_NORMAL].published);
+    TEST_ASSERT_EQUAL_UINT64(3, gateway.classes[PRIORITY_LOW].published);
+    TEST_ASSERT_TRUE(gateway.classes[PRIORITY_LOW].max_latency >= gateway.classes[PRIORITY_LOW].recent_latency);
+    TEST_ASSERT_TRUE(gateway.classes[PRIORITY_LOW].recent_latency >= 0);
+
+    // The values were published well within the 1 s target of the Low class
+    TEST_ASSERT_EQUAL_UINT64(0, gateway.classes[PRIORITY_LOW].late);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, gateway.classes[PRIORITY_LOW].recent_late);
+
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
@@ -0,0 +1,134 @@
+#include "../include/tests/item_queue_test.h"
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void _push_int(ItemQueue* queue, UA_Int32 number, bool lossless);
+static void _pop_int(ItemQueue* queue, UA_Int32 number);
+
+
+/// @brief Push an Int32 value and check the result of the push
+static void _push_int(ItemQueue* queue, UA_Int32 number, bool lossless){
+    UA_DataValue value;
+
+    UA_DataValue_init(&value);
+    UA_Variant_setScalarCopy(&value.value, &number, &UA_TYPES[UA_TYPES_INT32]);
+    value.hasValue = true;
+
+    TEST_ASSERT_EQUAL(lossless, item_queue_push(queue, &value));
+    TEST_ASSERT_FALSE(value.hasValue);
+}
+
+/// @brief Pop a value and check that it is the expected Int32
+static void _pop_int(ItemQueue* queue, UA_Int32 number){
+    UA_DataValue value;
+
+    TEST_ASSERT_TRUE(item_queue_pop(queue, &value));
+    TEST_ASSERT_EQUAL_INT(number, *(UA_Int32*)value.value.data);
+    UA_DataValue_clear(&value);
+}
+
+/// @brief Test pushing and popping values in order.
+/// @param None
+/// @return None
+/// @details This function tests that values are popped in the order they were pushed and that an empty queue pops nothing.
+/// It checks that the reception time of the oldest value is kept with it.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the item queue test suite.
+/// @see init_item_queue(), item_queue_push(), item_queue_pop(), free_item_queue()
+void test_item_queue_fifo(void){
+    ItemQueue queue;
+    UA_DataValue value;
+
+    init_item_queue(&queue, 3, QUEUE_OVERFLOW_DROP_OLDEST);
+    TEST_ASSERT_NULL(queue.values);
+    TEST_ASSERT_FALSE(item_queue_pop(&queue, &value));
+
+    _push_int(&queue, 1, true);
+    _push_int(&queue, 2, true);
+    _pop_int(&queue, 1);
+    _push_int(&queue, 3, true);
+    _push_int(&queue, 4, true);
+    TEST_ASSERT_TRUE(item_queue_full(&queue));
+    TEST_ASSERT_TRUE(item_queue_oldest(&queue) > 0);
+    TEST_ASSERT_TRUE(item_queue_oldest(&queue) <= queue.received[(queue.head + 2) % queue.capacity]);
+
+    _pop_int(&queue, 2);
+    _pop_int(&queue, 3);
+    _pop_int(&queue, 4);
+    TEST_ASSERT_FALSE(item_queue_pop(&queue, &value));
+    TEST_ASSERT_EQUAL_INT(0, item_queue_oldest(&queue));
+    TEST_ASSERT_EQUAL_INT(0, queue.overflows);
+
+    _push_int(&queue, 5, true);
+    free_item_queue(&queue);
+    TEST_ASSERT_NULL(queue.values);
+    TEST_ASSERT_EQUAL_INT(0, queue.count);
+}
+
+/// @brief Test the DropOldest overflow policy.
+/// @param None
+/// @return None
+/// @details This function tests that a push on a full queue drops the oldest value and counts the overflow.
+/// @note This function is part of the item queue test suite.
+/// @see item_queue_push()
+void test_item_queue_drop_oldest(void){
+    ItemQueue queue;
+
+    init_item_queue(&queue, 2, QUEUE_OVERFLOW_DROP_OLDEST);
+    _push_int(&queue, 1, true);
+    _push_int(&queue, 2, true);
+    _push_int(&queue, 3, false);
+
+    TEST_ASSERT_EQUAL_INT(1, queue.overflows);
+    _pop_int(&queue, 2);
+    _pop_int(&queue, 3);
+
+    free_item_queue(&queue);
+}
+
+/// @brief Test the KeepLatest overflow policy.
+/// @param None
+/// @return None
+/// @details This function tests that a push on a full queue leaves only the new value and counts the overflow.
+/// @note This function is part of the item queue test suite.
+/// @see item_queue_push()
+void test_item_queue_keep_latest(void){
+    ItemQueue queue;
+    UA_DataValue value;
+
+    init_item_queue(&queue, 2, QUEUE_OVERFLOW_KEEP_LATEST);
+    _push_int(&queue, 1, true);
+    _push_int(&queue, 2, true);
+    _push_int(&queue, 3, false);
+
+    TEST_ASSERT_EQUAL_INT(1, queue.overflows);
+    TEST_ASSERT_EQUAL_INT(1, queue.count);
+    _pop_int(&queue, 3);
+    TEST_ASSERT_FALSE(item_queue_pop(&queue, &value));
+
+    free_item_queue(&queue);
+}
+
+/// @brief Test the Block overflow policy.
+/// @param None
+/// @return None
+/// @details This function tests that a full Block queue reports itself full and that a push past the bound replaces the newest value.
+/// @note This function is part of the item queue test suite.
+/// @see item_queue_push(), item_queue_full()
+void test_item_queue_block(void){
+    ItemQueue queue;
+
+    init_item_queue(&queue, 2, QUEUE_OVERFLOW_BLOCK);
+    _push_int(&queue, 1, true);
+    TEST_ASSERT_FALSE(item_queue_full(&queue));
+    _push_int(&queue, 2, true);
+    TEST_ASSERT_TRUE(item_queue_full(&queue));
+    _push_int(&queue, 3, false);
+
+    TEST_ASSERT_EQUAL_INT(1, queue.overflows);
+    _pop_int(&queue, 1);
+    TEST_ASSERT_FALSE(item_queue_full(&queue));
+    _pop_int(&queue, 3);
+
+    free_item_queue(&queue);
+}
@@ -35,6 +35,44 @@ void test_load_machine_config(void){
     TEST_ASSERT_EQUAL_INT(3, machine_config.count);
 }
 
+/// @brief Test the fields of a loaded machine configuration.
+/// @param None
+/// @return None
+/// @details This function tests that machine, group and item fields are read from the machine files.
+/// It checks that the PascalCase keys and the "Subscriptions" array of the machine files are understood.
+/// It checks that the queue and priority settings of a group are read, whatever their case, and default when absent.
+/// It also verifies that the memory is freed correctly after the test.
+/// @note This function is part of the machine config test suite.
+/// @see load_machine_config(), free_array_machine_config()
+void test_load_machine_config_fields(void){
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+
+    TEST_ASSERT_EQUAL_INT(3, machine_config.count);
+    TEST_ASSERT_NOT_NULL(machine_config.configs[0].name);
+    TEST_ASSERT_EQUAL_STRING("opc.tcp://server-opcua-test:4840", machine_config.configs[0].url);
+    TEST_ASSERT_EQUAL_INT(2, machine_config.configs[0].groups.count);
+    TEST_ASSERT_EQUAL_STRING("FLAGS", machine_config.configs[0].groups.groups[0].name);
+    TEST_ASSERT_EQUAL_INT(2, machine_config.configs[0].groups.groups[0].items.count);
+    TEST_ASSERT_EQUAL_STRING("PC", machine_config.configs[0].groups.groups[0].items.items[0].name);
+    TEST_ASSERT_EQUAL_STRING("System.Int16", machine_config.configs[0].groups.groups[0].items.items[0].type);
+    TEST_ASSERT_EQUAL_INT(DEFAULT_QUEUE_SIZE, machine_config.configs[0].groups.groups[0].queue_size);
+    TEST_ASSERT_EQUAL_INT(QUEUE_OVERFLOW_DROP_OLDEST, machine_config.configs[0].groups.groups[0].queue_overflow);
+    TEST_ASSERT_EQUAL_INT(4, machine_config.configs[0].groups.groups[1].queue_size);
+    TEST_ASSERT_EQUAL_INT(QUEUE_OVERFLOW_BLOCK, machine_config.configs[0].groups.groups[1].queue_overflow);
+    TEST_ASSERT_EQUAL_INT(PRIORITY_HIGH, machine_config.configs[0].groups.groups[0].priority);
+    TEST_ASSERT_EQUAL_INT(50, machine_config.configs[0].groups.groups[0].target_latency);
+    TEST_ASSERT_EQUAL_INT(PRIORITY_LOW, machine_config.configs[0].groups.groups[1].priority);
+    TEST_ASSERT_EQUAL_INT(DEFAULT_TARGET_LATENCY_LOW, machine_config.configs[0].groups.groups[1].target_latency);
+
+    // Machine3 spells the same settings in lower case
+    for (size_t c = 0; c < machine_config.count; c++) {
+        TEST_ASSERT_EQUAL_INT(PRIORITY_HIGH, machine_config.configs[c].groups.groups[0].priority);
+        TEST_ASSERT_EQUAL_INT(PRIORITY_LOW, machine_config.configs[c].groups.groups[1].priority);
+        TEST_ASSERT_EQUAL_INT(QUEUE_OVERFLOW_BLOCK, machine_config.configs[c].groups.groups[1].queue_overflow);
+    }
+}
+
 /// @brief Test loading machine configuration from a non-existent file.
 /// @param None
 /// @return None
@@ -1,6 +1,24 @@
 #include "../include/tests/common_test.h"
 #include "../include/tests/stack_test.h"
 #include "../include/tests/machine_config_test.h"
+#include "../include/tests/compiled_machines_test.h"
+#include "../include/tests/discovery_test.h"
+#include "../include/tests/address_space_test.h"
+#include "../include/tests/flat_nodestore_test.h"
+#include "../include/tests/trace_test.h"
+#include "../include/tests/item_queue_test.h"
+#include "../include/tests/gateway_test.h"
+#include "../include/tests/aggregate_test.h"
+#include "../include/tests/expression_test.h"
+#include "../include/tests/scaling_test.h"
+#include "../include/tests/on_demand_test.h"
+#include "../include/tests/alarms_test.h"
+#include "../include/tests/shm_table_test.h"
+#include "../include/tests/pool_allocator_test.h"
+#include "../include/tests/snapshot_test.h"
+#include "../include/tests/replication_test.h"
+#include "../include/tests/shard_test.h"
+#include "../include/tests/session_limits_test.h"
 
 void setUp(void) {
     // Code exécuté avant chaque test
@@ -25,8 +43,96 @@ int main(void) {
     RUN_TEST(test_init_array_machine_config);
     RUN_TEST(test_load_machine_config_without_file);  
     RUN_TEST(test_load_machine_config);
+    RUN_TEST(test_load_machine_config_fields);
     RUN_TEST(test_free_machine_config);
     RUN_TEST(test_free_machine_config_empty);
+
+    // Compiled machines tests
+    RUN_TEST(test_compiled_machines_write);
+    RUN_TEST(test_compiled_machines_load);
+
+    // Discovery tests
+    RUN_TEST(test_discovery_collect);
+    RUN_TEST(test_discovery_retry);
+    RUN_TEST(test_discovery_abort);
+
+    // Address space tests
+    RUN_TEST(test_init_address_space);
+    RUN_TEST(test_address_space_resolve);
+    RUN_TEST(test_address_space_item_index);
+    RUN_TEST(test_address_space_find_path);
+    RUN_TEST(test_address_space_data_type);
+
+    // Flat nodestore tests
+    RUN_TEST(test_flat_nodestore_replace);
+    RUN_TEST(test_flat_nodestore_write);
+    RUN_TEST(test_flat_nodestore_structure);
+
+    // Trace tests
+    RUN_TEST(test_trace_disabled);
+    RUN_TEST(test_trace_nested_spans);
+    RUN_TEST(test_trace_detached_spans);
+
+    // Item queue tests
+    RUN_TEST(test_item_queue_fifo);
+    RUN_TEST(test_item_queue_drop_oldest);
+    RUN_TEST(test_item_queue_keep_latest);
+    RUN_TEST(test_item_queue_block);
+
+    // Gateway tests
+    RUN_TEST(test_gateway_queues);
+    RUN_TEST(test_gateway_unchanged_values);
+    RUN_TEST(test_gateway_priorities);
+
+    // Aggregate tests
+    RUN_TEST(test_aggregate_items);
+    RUN_TEST(test_aggregate_windows);
+    RUN_TEST(test_aggregate_large_offset);
+
+    // Expression tests
+    RUN_TEST(test_expression_compile);
+    RUN_TEST(test_expressions_update);
+    RUN_TEST(test_expressions_cycles);
+
+    // Scaling tests
+    RUN_TEST(test_scaling_items);
+    RUN_TEST(test_scaling_convert);
+
+    // On-demand tests
+    RUN_TEST(test_on_demand_items);
+    RUN_TEST(test_on_demand_single_flight);
+    RUN_TEST(test_on_demand_stale);
+
+    // Alarms tests
+    RUN_TEST(test_alarms_items);
+    RUN_TEST(test_alarms_transitions);
+    RUN_TEST(test_alarms_quality);
+    RUN_TEST(test_alarms_evaluate);
+
+    // Shared-memory table tests
+    RUN_TEST(test_shm_table_read_write);
+
+    // Snapshot tests
+    RUN_TEST(test_snapshot_round_trip);
+    RUN_TEST(test_snapshot_gateway);
+
+    // Replication tests
+    RUN_TEST(test_replication_stream);
+    RUN_TEST(test_replication_fencing);
+
+    // Shard tests
+    RUN_TEST(test_shard_ring);
+    RUN_TEST(test_shard_assignment);
+    RUN_TEST(test_shard_backpressure);
+
+    // Session limits tests
+    RUN_TEST(test_session_limits_sessions);
+    RUN_TEST(test_session_limits_services);
+    RUN_TEST(test_session_limits_fair_share);
+
+    // Pool allocator tests
+    RUN_TEST(test_pool_allocator_classes);
+    RUN_TEST(test_pool_allocator_remote_free);
   
 
     //stack tests
@@ -0,0 +1,181 @@
+#include "../include/tests/on_demand_test.h"
+#include "../include/tests/machine_config_test.h"
+
+
+/// @brief Test the loading of the acquisition mode of the items.
+/// @param None
+/// @return None
+/// @details This function tests that Mode and Ttl are loaded in any case, that the Ttl defaults to
+/// DEFAULT_ON_DEMAND_TTL and that items computed by the gateway are never read on demand.
+/// It also ensures that the OnDemand counts the ondemand items and attaches itself to the address space.
+/// @note This function is part of the on-demand test suite.
+/// @see load_machine_config(), init_on_demand(), free_on_demand()
+void test_on_demand_items(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    OnDemand on_demand;
+    Group* groups;
+
+    load_machine_config("tests/fixtures/ondemand", &machine_config);
+    groups = machine_config.configs[0].groups.groups;
+
+    TEST_ASSERT_TRUE(groups[0].items.items[0].on_demand);
+    TEST_ASSERT_EQUAL_INT(30000, groups[0].items.items[0].ttl);
+    TEST_ASSERT_TRUE(groups[0].items.items[1].on_demand);
+    TEST_ASSERT_EQUAL_INT(DEFAULT_ON_DEMAND_TTL, groups[0].items.items[1].ttl);
+    TEST_ASSERT_FALSE(groups[1].items.items[0].on_demand);
+    TEST_ASSERT_FALSE(groups[1].items.items[1].on_demand);
+    TEST_ASSERT_EQUAL_INT(ITEM_SOURCE_EXPRESSION, groups[1].items.items[1].source);
+
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    init_on_demand(&on_demand, &gateway, NULL);
+
+    TEST_ASSERT_EQUAL_INT(2, on_demand.item_count);
+    TEST_ASSERT_EQUAL_PTR(&on_demand, address_space.on_demand);
+    TEST_ASSERT_NULL(on_demand.machine_upstream[0]);
+
+    free_on_demand(&on_demand);
+    TEST_ASSERT_NULL(address_space.on_demand);
+    TEST_ASSERT_NULL(on_demand.state);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
+
+/// @brief Test the read-through cache of the ondemand items.
+/// @param None
+/// @return None
+/// @details This function tests that the first Read of an item queues it once, that the Reads that follow
+/// are merged into the pending refresh, that a refresh pushes its value into the gateway and serves it
+/// until its Ttl has passed, and that a failed refresh leaves the item expired.
+/// It checks that items of a machine without client are dropped from the queue.
+/// @note This function is part of the on-demand test suite.
+/// @see on_demand_touch(), on_demand_flush(), on_demand_complete()
+void test_on_demand_single_flight(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    OnDemand on_demand;
+    UA_DataValue value;
+    UA_UInt32 parts = 1234;
+    UA_DateTime now = UA_DATETIME_SEC;
+    size_t item;
+
+    load_machine_config("tests/fixtures/ondemand", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    init_on_demand(&on_demand, &gateway, NULL);
+    item = address_space.machines[0].first_item;
+
+    // Many sessions reading an expired item cost one refresh
+    TEST_ASSERT_TRUE(on_demand_touch(&on_demand, item, now));
+    for (size_t i = 0; i < 5; i++) TEST_ASSERT_FALSE(on_demand_touch(&on_demand, item, now));
+    TEST_ASSERT_TRUE(on_demand_touch(&on_demand, item + 1, now));
+    TEST_ASSERT_EQUAL_INT(5, on_demand.merged);
+    TEST_ASSERT_EQUAL_INT(2, on_demand.queued_count);
+    TEST_ASSERT_EQUAL_INT(ON_DEMAND_QUEUED, on_demand.state[item]);
+
+    // Without a client the machine cannot be read, the items go back to idle
+    TEST_ASSERT_EQUAL_INT(0, on_demand_flush(&on_demand));
+    TEST_ASSERT_EQUAL_INT(0, on_demand.queued_count);
+    TEST_ASSERT_EQUAL_INT(ON_DEMAND_IDLE, on_demand.state[item]);
+    TEST_ASSERT_EQUAL_INT(0, on_demand.requests);
+
+    // A refresh is pushed into the gateway and served for the Ttl of its item
+    UA_DataValue_init(&value);
+    UA_Variant_setScalar(&value.value, &parts, &UA_TYPES[UA_TYPES_UINT32]);
+    value.hasValue = true;
+    on_demand.state[item] = ON_DEMAND_READING;
+    TEST_ASSERT_FALSE(on_demand_touch(&on_demand, item, now));
+    on_demand_complete(&on_demand, item, &value, now);
+    TEST_ASSERT_EQUAL_INT(ON_DEMAND_IDLE, on_demand.state[item]);
+    TEST_ASSERT_EQUAL_INT(1, gateway.queues[item].count);
+
+    TEST_ASSERT_FALSE(on_demand_touch(&on_demand, item, now + 29 * UA_DATETIME_SEC));
+    TEST_ASSERT_EQUAL_INT(1, on_demand.hits);
+    TEST_ASSERT_TRUE(on_demand_touch(&on_demand, item, now + 30 * UA_DATETIME_SEC));
+
+    // A failed refresh pushes nothing, the previous value stays expired and the next Read queues the item again
+    on_demand.queued_count = 0;
+    on_demand.state[item] = ON_DEMAND_READING;
+    on_demand_complete(&on_demand, item, NULL, now);
+    TEST_ASSERT_EQUAL_INT(1, gateway.queues[item].count);
+    TEST_ASSERT_TRUE(on_demand_touch(&on_demand, item, now));
+
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[item], &value));
+    TEST_ASSERT_EQUAL_UINT32(1234, *(UA_UInt32*)value.value.data);
+    UA_DataValue_clear(&value);
+
+    free_on_demand(&on_demand);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
+
+/// @brief Test serving an expired value as the last usable one.
+/// @param None
+/// @return None
+/// @details This function tests that a Read finding the value of an item past its Ttl queues the item and
+/// writes the value back as UncertainLastUsableValue, recorded as the current value of the item, while a
+/// Read within the Ttl leaves the value good.
+/// It checks that a value that is not good, such as BadWaitingForInitialData before the first refresh, is
+/// not marked.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the on-demand test suite.
+/// @see on_demand_on_read(), gateway_current()
+void test_on_demand_stale(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    Gateway gateway;
+    OnDemand on_demand;
+    AddressSpaceNode node;
+    UA_NodeId node_id;
+    UA_DataValue value;
+    UA_DataValue current;
+    UA_UInt32 parts = 1234;
+    size_t item;
+
+    load_machine_config("tests/fixtures/ondemand", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    address_space_register_namespaces(&address_space, server);
+    init_gateway(&gateway, &address_space);
+    init_on_demand(&on_demand, &gateway, NULL);
+    item = address_space.machines[0].first_item;
+    address_space_item_at(&address_space, item, &node);
+    node_id = address_space_node_id(&address_space, &node);
+
+    UA_DataValue_init(&value);
+    UA_Variant_setScalar(&value.value, &parts, &UA_TYPES[UA_TYPES_UINT32]);
+    value.hasValue = true;
+    on_demand_complete(&on_demand, item, &value, UA_DateTime_nowMonotonic());
+    TEST_ASSERT_EQUAL_INT(1, gateway_publish(&gateway, server, GATEWAY_PUBLISH_BUDGET));
+
+    // Within the Ttl the value is served as is
+    on_demand_on_read(server, NULL, NULL, &node_id, &address_space, NULL, &value);
+    TEST_ASSERT_EQUAL_INT(0, on_demand.queued_count);
+    TEST_ASSERT_TRUE(gateway_current(&gateway, item, &current));
+    TEST_ASSERT_FALSE(current.hasStatus && current.status != UA_STATUSCODE_GOOD);
+    UA_DataValue_clear(&current);
+
+    // Past the Ttl the item is refreshed and its value served as the last usable one
+    on_demand.expires_at[item] = 0;
+    on_demand_on_read(server, NULL, NULL, &node_id, &address_space, NULL, &value);
+    TEST_ASSERT_EQUAL_INT(1, on_demand.queued_count);
+    TEST_ASSERT_TRUE(gateway_current(&gateway, item, &current));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_UNCERTAINLASTUSABLEVALUE, current.status);
+    TEST_ASSERT_EQUAL_UINT32(1234, *(UA_UInt32*)current.value.data);
+    UA_DataValue_clear(&current);
+
+    // No value yet: nothing to mark
+    address_space_item_at(&address_space, item + 1, &node);
+    node_id = address_space_node_id(&address_space, &node);
+    UA_DataValue_init(&value);
+    value.hasStatus = true;
+    value.status = UA_STATUSCODE_BADWAITINGFORINITIALDATA;
+    on_demand_on_read(server, NULL, NULL, &node_id, &address_space, NULL, &value);
+    TEST_ASSERT_EQUAL_INT(2, on_demand.queued_count);
+    TEST_ASSERT_FALSE(gateway_current(&gateway, item + 1, &current));
+
+    free_on_demand(&on_demand);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
@@ -0,0 +1,139 @@
+#include "../include/tests/pool_allocator_test.h"
+
+#include <pthread.h>
+
+/// @brief Number of blocks freed by the worker thread
+#define REMOTE_BLOCKS 64
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static void* _free_blocks(void* data);
+
+
+/// @brief Worker thread freeing the blocks of another thread
+/// @param data Array of REMOTE_BLOCKS blocks
+/// @return NULL
+static void* _free_blocks(void* data){
+
+    void** blocks = (void**)data;
+
+    for (size_t b = 0; b < REMOTE_BLOCKS; b++) pool_free(blocks[b]);
+
+    return NULL;
+}
+
+/// @brief Test the size classes of the pool allocator.
+/// @param None
+/// @return None
+/// @details This function tests that a freed block is handed out again for the next request of the same class,
+/// that the counters of the class follow the allocations, and that large requests are served by malloc.
+/// It also checks that calloc zeroes its block and that realloc keeps the block within its class and moves it,
+/// contents included, when it grows beyond.
+/// @note This function is part of the pool allocator test suite.
+/// @see pool_malloc(), pool_calloc(), pool_realloc(), pool_free(), pool_allocator_stats()
+void test_pool_allocator_classes(void){
+
+    PoolStats before[POOL_CLASS_COUNT + 1];
+    PoolStats after[POOL_CLASS_COUNT + 1];
+    unsigned char* block;
+    unsigned char* other;
+    unsigned char* large;
+
+    TEST_ASSERT_EQUAL_size_t(POOL_CLASS_COUNT + 1, pool_allocator_stats(before, POOL_CLASS_COUNT + 1));
+    TEST_ASSERT_EQUAL_size_t(16, before[0].block_size);
+    TEST_ASSERT_EQUAL_size_t(512, before[POOL_CLASS_COUNT - 1].block_size);
+    TEST_ASSERT_EQUAL_size_t(0, before[POOL_CLASS_COUNT].block_size);
+
+    // A freed block is the next one handed out for its class
+    block = pool_malloc(40);
+    TEST_ASSERT_NOT_NULL(block);
+    pool_free(block);
+    other = pool_malloc(33);
+    TEST_ASSERT_EQUAL_PTR(block, other);
+
+    pool_allocator_stats(after, POOL_CLASS_COUNT + 1);
+    TEST_ASSERT_EQUAL_UINT64(before[2].allocations + 2, after[2].allocations);
+    TEST_ASSERT_EQUAL_UINT64(before[2].frees + 1, after[2].frees);
+    TEST_ASSERT_EQUAL_UINT64(1, after[2].in_use - before[2].in_use);
+    TEST_ASSERT_TRUE(after[2].capacity >= after[2].in_use);
+
+    // Realloc stays in place within the class and moves the contents beyond
+    memset(other, 0xAB, 48);
+    block = pool_realloc(other, 48);
+    TEST_ASSERT_EQUAL_PTR(other, block);
+    block = pool_realloc(block, 200);
+    TEST_ASSERT_NOT_NULL(block);
+    TEST_ASSERT_NOT_EQUAL(other, block);
+    for (size_t i = 0; i < 48; i++) TEST_ASSERT_EQUAL_UINT8(0xAB, block[i]);
+    pool_free(block);
+
+    // Calloc zeroes a recycled block
+    block = pool_malloc(64);
+    memset(block, 0xFF, 64);
+    pool_free(block);
+    block = pool_calloc(4, 16);
+    for (size_t i = 0; i < 64; i++) TEST_ASSERT_EQUAL_UINT8(0, block[i]);
+    pool_free(block);
+    TEST_ASSERT_NULL(pool_calloc(SIZE_MAX / 2, 4));
+
+    // Large requests go to malloc and keep their size through realloc
+    large = pool_malloc(4096);
+    TEST_ASSERT_NOT_NULL(large);
+    memset(large, 0x5A, 4096);
+    large = pool_realloc(large, 8192);
+    TEST_ASSERT_EQUAL_UINT8(0x5A, large[4095]);
+    pool_allocator_stats(after, POOL_CLASS_COUNT + 1);
+    TEST_ASSERT_EQUAL_UINT64(1, after[POOL_CLASS_COUNT].in_use - before[POOL_CLASS_COUNT].in_use);
+    pool_free(large);
+    pool_free(NULL);
+
+    pool_allocator_stats(after, POOL_CLASS_COUNT + 1);
+    for (size_t c = 0; c <= POOL_CLASS_COUNT; c++) TEST_ASSERT_EQUAL_UINT64(before[c].in_use, after[c].in_use);
+}
+
+/// @brief Test the blocks freed by another thread than their owner.
+/// @param None
+/// @return None
+/// @details This function tests that blocks allocated by the test thread and freed by a worker thread are counted
+/// as remote frees, and that the owner takes them back from its return stack once its free list runs empty.
+/// @note This function is part of the pool allocator test suite.
+/// @see pool_malloc(), pool_free(), pool_allocator_stats()
+void test_pool_allocator_remote_free(void){
+
+    PoolStats before[POOL_CLASS_COUNT + 1];
+    PoolStats after[POOL_CLASS_COUNT + 1];
+    void* blocks[REMOTE_BLOCKS];
+    pthread_t worker;
+    void** drained;
+    size_t free_count;
+    size_t reused = 0;
+
+    pool_allocator_stats(before, POOL_CLASS_COUNT + 1);
+
+    for (size_t b = 0; b < REMOTE_BLOCKS; b++) blocks[b] = pool_malloc(300);
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&worker, NULL, _free_blocks, blocks));
+    TEST_ASSERT_EQUAL_INT(0, pthread_join(worker, NULL));
+
+    pool_allocator_stats(after, POOL_CLASS_COUNT + 1);
+    TEST_ASSERT_EQUAL_UINT64(before[8].remote_frees + REMOTE_BLOCKS, after[8].remote_frees);
+    TEST_ASSERT_EQUAL_UINT64(before[8].in_use, after[8].in_use);
+
+    // Draining the local list brings the returned blocks back before any new slab
+    free_count = (size_t)(after[8].capacity - after[8].in_use);
+    drained = (void**)malloc(free_count * sizeof(void*));
+    TEST_ASSERT_NOT_NULL(drained);
+    for (size_t b = 0; b < free_count; b++) {
+        drained[b] = pool_malloc(300);
+        for (size_t r = 0; r < REMOTE_BLOCKS; r++) {
+            if (blocks[r] == drained[b]) reused++;
+        }
+    }
+    TEST_ASSERT_EQUAL_size_t(REMOTE_BLOCKS, reused);
+
+    pool_allocator_stats(before, POOL_CLASS_COUNT + 1);
+    TEST_ASSERT_EQUAL_UINT64(after[8].capacity, before[8].capacity);
+
+    for (size_t b = 0; b < free_count; b++) pool_free(drained[b]);
+    free(drained);
+}
@@ -0,0 +1,157 @@
+#include "../include/tests/replication_test.h"
+#include "../include/tests/machine_config_test.h"
+
+#define REPLICATION_TEST_ADDRESS "unix:replication_test.sock"
+
+/// @brief Test streaming the values of a primary gateway to a standby.
+/// @param None
+/// @return None
+/// @details This function tests that a standby connected over a Unix socket exchanges hellos with the primary, receives
+/// the copy of the current values and then every value the primary publishes for an upstream item, queued into its own gateway.
+/// It checks that the standby does not stream the values it applies and that it takes over, listening on the
+/// replication address, as soon as the primary closes the connection.
+/// It also ensures that the sockets, the server and the memory are freed correctly after the test.
+/// @note This function is part of the replication test suite.
+/// @see init_replication(), replication_start(), replication_iterate(), replication_publish(), free_replication()
+void test_replication_stream(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    Gateway primary_gateway;
+    Gateway standby_gateway;
+    Replication primary;
+    Replication standby;
+    UA_DataValue value;
+    UA_Int16 alarm = 3;
+    size_t item;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&primary_gateway, &address_space);
+    init_gateway(&standby_gateway, &address_space);
+
+    init_replication(&primary, &primary_gateway, NULL, REPLICATION_TEST_ADDRESS, REPLICATION_PRIMARY);
+    init_replication(&standby, &standby_gateway, NULL, REPLICATION_TEST_ADDRESS, REPLICATION_STANDBY);
+    primary_gateway.replication = &primary;
+    standby_gateway.replication = &standby;
+    TEST_ASSERT_EQUAL_UINT32(primary.layout_hash, standby.layout_hash);
+    TEST_ASSERT_FALSE(replication_standby(&primary));
+    TEST_ASSERT_TRUE(replication_standby(&standby));
+
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, replication_start(&primary, server));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, replication_start(&standby, server));
+
+    // Connect, accept and send the hello
+    replication_iterate(&standby, server);
+    TEST_ASSERT_TRUE(standby.peer >= 0);
+    replication_iterate(&primary, server);
+    TEST_ASSERT_TRUE(primary.peer >= 0);
+    replication_iterate(&standby, server);
+    TEST_ASSERT_TRUE(standby.accepted);
+    TEST_ASSERT_TRUE(standby.synced);
+    TEST_ASSERT_FALSE(standby.mismatch);
+
+    // A value published by the primary is queued by the standby
+    item = address_space.machines[0].first_item;
+    UA_DataValue_init(&value);
+    UA_Variant_setScalarCopy(&value.value, &alarm, &UA_TYPES[UA_TYPES_INT16]);
+    value.hasValue = true;
+    TEST_ASSERT_TRUE(gateway_push(&primary_gateway, item, &value));
+    TEST_ASSERT_EQUAL_INT(1, gateway_publish(&primary_gateway, server, GATEWAY_PUBLISH_BUDGET));
+    TEST_ASSERT_EQUAL_INT(1, primary.sent);
+
+    replication_iterate(&primary, server);
+    replication_iterate(&standby, server);
+    TEST_ASSERT_EQUAL_INT(1, standby.applied);
+    TEST_ASSERT_EQUAL_INT(1, standby_gateway.queues[item].count);
+
+    // The standby publishes the same value without streaming it
+    TEST_ASSERT_EQUAL_INT(1, gateway_publish(&standby_gateway, server, GATEWAY_PUBLISH_BUDGET));
+    TEST_ASSERT_EQUAL_INT(0, standby.sent);
+    TEST_ASSERT_EQUAL_INT(primary_gateway.encoded[item].length, standby_gateway.encoded[item].length);
+    TEST_ASSERT_EQUAL_MEMORY(primary_gateway.encoded[item].data, standby_gateway.encoded[item].data,
+                             standby_gateway.encoded[item].length);
+
+    // The primary stops: the standby takes over and listens for the next standby
+    free_replication(&primary);
+    replication_iterate(&standby, server);
+    TEST_ASSERT_FALSE(replication_standby(&standby));
+    TEST_ASSERT_TRUE(standby.listener >= 0);
+    TEST_ASSERT_EQUAL_INT(-1, standby.peer);
+
+    free_replication(&standby);
+    TEST_ASSERT_NULL(standby.address);
+    free_gateway(&standby_gateway);
+    free_gateway(&primary_gateway);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
+
+/// @brief Test that two gateways of a pair never stay primary together.
+/// @param None
+/// @return None
+/// @details This function tests that a standby which never reached a primary ignores the silence until the startup grace
+/// period is over, then takes over with a new epoch.
+/// It checks that a primary cut from its address by this takeover finds the new primary on its next probe, steps down to
+/// its standby (lower epoch) and receives the copy of the values, and that a primary started while the address answers
+/// starts as a standby.
+/// It also ensures that the sockets, the server and the memory are freed correctly after the test.
+/// @note This function is part of the replication test suite.
+/// @see replication_start(), replication_iterate(), replication_standby(), free_replication()
+void test_replication_fencing(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    Gateway gateway;
+    Replication primary;
+    Replication standby;
+    Replication late;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+
+    init_replication(&primary, &gateway, NULL, REPLICATION_TEST_ADDRESS, REPLICATION_PRIMARY);
+    init_replication(&standby, &gateway, NULL, REPLICATION_TEST_ADDRESS, REPLICATION_STANDBY);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, replication_start(&primary, server));
+
+    // The primary cannot be reached: its socket is gone
+    TEST_ASSERT_EQUAL_INT(0, remove(REPLICATION_TEST_ADDRESS + 5));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, replication_start(&standby, server));
+
+    // Silent, but never synchronized and within the startup grace period
+    standby.last_received -= (REPLICATION_TIMEOUT + 1) * UA_DATETIME_MSEC;
+    replication_iterate(&standby, server);
+    TEST_ASSERT_TRUE(replication_standby(&standby));
+
+    standby.started -= REPLICATION_STARTUP_GRACE * UA_DATETIME_MSEC;
+    replication_iterate(&standby, server);
+    TEST_ASSERT_FALSE(replication_standby(&standby));
+    TEST_ASSERT_EQUAL_UINT32(1, standby.epoch);
+    TEST_ASSERT_FALSE(replication_standby(&primary));
+
+    // The next probe of the former primary reaches the new one, the former primary steps down
+    primary.retry_at = 0;
+    for (int round = 0; round < 3; round++) {
+        replication_iterate(&primary, server);
+        replication_iterate(&standby, server);
+    }
+    TEST_ASSERT_TRUE(replication_standby(&primary));
+    TEST_ASSERT_TRUE(primary.synced);
+    TEST_ASSERT_EQUAL_UINT32(1, primary.epoch);
+    TEST_ASSERT_EQUAL_INT(-1, primary.listener);
+    TEST_ASSERT_FALSE(replication_standby(&standby));
+    TEST_ASSERT_TRUE(standby.listener >= 0);
+    TEST_ASSERT_FALSE(standby.probing);
+
+    // A primary started while the address answers follows it
+    init_replication(&late, &gateway, NULL, REPLICATION_TEST_ADDRESS, REPLICATION_PRIMARY);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, replication_start(&late, server));
+    TEST_ASSERT_TRUE(replication_standby(&late));
+    TEST_ASSERT_EQUAL_INT(-1, late.listener);
+
+    free_replication(&late);
+    free_replication(&primary);
+    free_replication(&standby);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
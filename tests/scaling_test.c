@@ -0,0 +1,177 @@
+#include "../include/tests/scaling_test.h"
+#include "../include/tests/machine_config_test.h"
+
+#include <math.h>
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static bool _add_raw(ScalingBatch* batch, size_t item, const void* raw, const UA_DataType* type, UA_StatusCode status);
+
+
+/// @brief Stage a raw scalar value
+/// @return The result of scaling_batch_add
+static bool _add_raw(ScalingBatch* batch, size_t item, const void* raw, const UA_DataType* type, UA_StatusCode status){
+
+    UA_DataValue value;
+    bool staged;
+
+    UA_DataValue_init(&value);
+    UA_Variant_setScalarCopy(&value.value, raw, type);
+    value.hasValue = true;
+    value.status = status;
+    value.hasStatus = status != UA_STATUSCODE_GOOD;
+    value.sourceTimestamp = 42;
+    value.hasSourceTimestamp = true;
+
+    staged = scaling_batch_add(batch, item, &value);
+    UA_DataValue_clear(&value);
+
+    return staged;
+}
+
+/// @brief Test the engineering-unit conversion of the scaled items.
+/// @param None
+/// @return None
+/// @details This function tests that Scale, Offset, Min, Max and TargetType are loaded and that staged raw values
+/// are pushed converted into the target type of their item, clamped to its range and to the range of the type.
+/// It checks that clamped values are uncertain, that values without a number are BadOutOfRange, that bad values
+/// keep their status and that unscaled items are not staged.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the scaling test suite.
+/// @see init_scaling_batch(), scaling_batch_add(), scaling_batch_flush(), free_scaling_batch()
+void test_scaling_items(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    ScalingBatch batch;
+    UA_DataValue value;
+    UA_String text = UA_STRING("20.5");
+    UA_Int16 temperatures[] = {0, 1000, 2000};
+    UA_UInt16 pressure = 12345;
+    UA_Int32 level = 200;
+    Item* items;
+    size_t temperature;
+
+    load_machine_config("tests/fixtures/scaling", &machine_config);
+    items = machine_config.configs[0].groups.groups[0].items.items;
+
+    TEST_ASSERT_TRUE(items[0].scaled);
+    TEST_ASSERT_EQUAL_DOUBLE(0.1, items[0].scale);
+    TEST_ASSERT_EQUAL_DOUBLE(-40.0, items[0].offset);
+    TEST_ASSERT_EQUAL_DOUBLE(150.0, items[0].max);
+    TEST_ASSERT_EQUAL_STRING("System.Double", items[0].type);
+    TEST_ASSERT_EQUAL_STRING("System.Single", items[1].type);
+    TEST_ASSERT_FALSE(items[3].scaled);
+    TEST_ASSERT_EQUAL_STRING("System.Int16", items[3].type);
+
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    TEST_ASSERT_TRUE(init_scaling_batch(&batch, &gateway, 0));
+    temperature = address_space.machines[0].first_item;
+
+    for (size_t i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(_add_raw(&batch, temperature, &temperatures[i], &UA_TYPES[UA_TYPES_INT16], UA_STATUSCODE_GOOD));
+    }
+    TEST_ASSERT_TRUE(_add_raw(&batch, temperature, &text, &UA_TYPES[UA_TYPES_STRING], UA_STATUSCODE_GOOD));
+    TEST_ASSERT_TRUE(_add_raw(&batch, temperature, &temperatures[0], &UA_TYPES[UA_TYPES_INT16],
+                              UA_STATUSCODE_BADCOMMUNICATIONERROR));
+    TEST_ASSERT_TRUE(_add_raw(&batch, temperature + 1, &pressure, &UA_TYPES[UA_TYPES_UINT16], UA_STATUSCODE_GOOD));
+    TEST_ASSERT_TRUE(_add_raw(&batch, temperature + 2, &level, &UA_TYPES[UA_TYPES_INT32], UA_STATUSCODE_GOOD));
+    TEST_ASSERT_FALSE(_add_raw(&batch, temperature + 3, &temperatures[0], &UA_TYPES[UA_TYPES_INT16], UA_STATUSCODE_GOOD));
+    TEST_ASSERT_EQUAL_INT(0, gateway.queues[temperature].count);
+
+    TEST_ASSERT_EQUAL_INT(7, scaling_batch_flush(&batch));
+    TEST_ASSERT_EQUAL_INT(0, scaling_batch_flush(&batch));
+    TEST_ASSERT_EQUAL_INT(5, gateway.queues[temperature].count);
+
+    // 0 * 0.1 - 40, 1000 * 0.1 - 40, then 160 clamped to the Max of the item
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[temperature], &value));
+    TEST_ASSERT_TRUE(UA_Variant_hasScalarType(&value.value, &UA_TYPES[UA_TYPES_DOUBLE]));
+    TEST_ASSERT_EQUAL_DOUBLE(-40.0, *(UA_Double*)value.value.data);
+    TEST_ASSERT_FALSE(value.hasStatus);
+    TEST_ASSERT_EQUAL_INT(42, value.sourceTimestamp);
+    UA_DataValue_clear(&value);
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[temperature], &value));
+    TEST_ASSERT_EQUAL_DOUBLE(60.0, *(UA_Double*)value.value.data);
+    UA_DataValue_clear(&value);
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[temperature], &value));
+    TEST_ASSERT_EQUAL_DOUBLE(150.0, *(UA_Double*)value.value.data);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_UNCERTAINENGINEERINGUNITSEXCEEDED, value.status);
+    UA_DataValue_clear(&value);
+
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[temperature], &value));
+    TEST_ASSERT_FALSE(value.hasValue);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADOUTOFRANGE, value.status);
+    UA_DataValue_clear(&value);
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[temperature], &value));
+    TEST_ASSERT_FALSE(value.hasValue);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADCOMMUNICATIONERROR, value.status);
+    UA_DataValue_clear(&value);
+
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[temperature + 1], &value));
+    TEST_ASSERT_TRUE(UA_Variant_hasScalarType(&value.value, &UA_TYPES[UA_TYPES_FLOAT]));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-4, 123.45, *(UA_Float*)value.value.data);
+    UA_DataValue_clear(&value);
+
+    // 400 does not fit in a Byte
+    TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[temperature + 2], &value));
+    TEST_ASSERT_TRUE(UA_Variant_hasScalarType(&value.value, &UA_TYPES[UA_TYPES_BYTE]));
+    TEST_ASSERT_EQUAL_UINT8(255, *(UA_Byte*)value.value.data);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_UNCERTAINENGINEERINGUNITSEXCEEDED, value.status);
+    UA_DataValue_clear(&value);
+
+    free_scaling_batch(&batch);
+    TEST_ASSERT_NULL(batch.items);
+    TEST_ASSERT_FALSE(scaling_batch_add(&batch, temperature, &value));
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
+
+/// @brief Test the conversion kernel.
+/// @param None
+/// @return None
+/// @details This function tests that the vectorized conversion gives the results and the flags of the scalar
+/// formula for every batch length up to 13 rows, so that each remainder of the vector widths is covered.
+/// It checks clamped, NaN and infinite values.
+/// @note This function is part of the scaling test suite.
+/// @see scaling_convert()
+void test_scaling_convert(void){
+    ScalingBatch batch;
+    AddressSpace address_space;
+    Gateway gateway;
+    const double raw[13] = {0.0, 12.0, -7.5, 1e6, -1e6, NAN, 3.0, INFINITY, 250.0, -250.0, 1e308, 42.0, 0.5};
+
+    load_machine_config("tests/fixtures/scaling", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    TEST_ASSERT_TRUE(init_scaling_batch(&batch, &gateway, 0));
+
+    for (size_t count = 0; count <= 13; count++) {
+        for (size_t i = 0; i < count; i++) {
+            batch.raw[i] = raw[i];
+            batch.scale[i] = i % 3 == 0 ? 10.0 : 0.25;
+            batch.offset[i] = i % 2 == 0 ? -5.0 : 1.0;
+            batch.low[i] = i % 4 == 0 ? -INFINITY : -100.0;
+            batch.high[i] = i % 5 == 0 ? INFINITY : 100.0;
+        }
+
+        scaling_convert(&batch, count);
+
+        for (size_t i = 0; i < count; i++) {
+            double expected = raw[i] * batch.scale[i] + batch.offset[i];
+
+            if (!isfinite(expected)) {
+                TEST_ASSERT_EQUAL_INT(SCALING_INVALID, batch.flags[i]);
+            } else if (expected < batch.low[i] || expected > batch.high[i]) {
+                TEST_ASSERT_EQUAL_INT(SCALING_EXCEEDED, batch.flags[i]);
+                TEST_ASSERT_EQUAL_DOUBLE(expected < batch.low[i] ? batch.low[i] : batch.high[i], batch.converted[i]);
+            } else {
+                TEST_ASSERT_EQUAL_INT(0, batch.flags[i]);
+                TEST_ASSERT_EQUAL_DOUBLE(expected, batch.converted[i]);
+            }
+        }
+    }
+
+    free_scaling_batch(&batch);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
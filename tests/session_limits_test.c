@@ -0,0 +1,210 @@
+#include "../include/tests/session_limits_test.h"
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static size_t _charge_all(SessionLimits* limits, const UA_NodeId* session_id, size_t bytes);
+static UA_Byte _grant(UA_Server* server, UA_AccessControl* ac, const UA_NodeId* session_id, void* session_context,
+                      const UA_NodeId* node_id, void* node_context);
+
+
+/// @brief Charge operations to a session until one is refused
+/// @return Number of operations that ran
+static size_t _charge_all(SessionLimits* limits, const UA_NodeId* session_id, size_t bytes){
+
+    size_t count = 0;
+
+    while (count < 100000 && session_limits_charge(limits, session_id, bytes))
+        count++;
+
+    return count;
+}
+
+/// @brief Access control of the server config granting every access
+static UA_Byte _grant(UA_Server* server, UA_AccessControl* ac, const UA_NodeId* session_id, void* session_context,
+                      const UA_NodeId* node_id, void* node_context){
+    (void)server;
+    (void)ac;
+    (void)session_id;
+    (void)session_context;
+    (void)node_id;
+    (void)node_context;
+    return 0xFF;
+}
+
+/// @brief Test the index of the sessions.
+/// @param None
+/// @return None
+/// @details This function tests that many sessions opened and closed in any order keep their own budget: each
+/// session left open is refused after its own operations, and the closed ones are no longer charged.
+/// It checks that a session opened twice keeps one budget and that a closed session opened again gets a new one.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the session limits test suite.
+/// @see session_limits_open(), session_limits_close(), session_limits_charge(), free_session_limits()
+void test_session_limits_sessions(void){
+    UA_ServerConfig server_config;
+    SessionLimits limits;
+    SessionLimitsConfig config = {3, 0, 0};
+    UA_NodeId session;
+
+    memset(&server_config, 0, sizeof(UA_ServerConfig));
+    session_limits_install(&limits, &server_config, &config, NULL);
+
+    for (UA_UInt32 i = 0; i < 100; i++) {
+        session = UA_NODEID_NUMERIC(1, i * 7919);
+        session_limits_open(&limits, &session);
+    }
+    session = UA_NODEID_NUMERIC(1, 7919);
+    session_limits_open(&limits, &session);
+    TEST_ASSERT_EQUAL_INT(100, limits.count);
+
+    // Close every third session, the last ones moving into their places
+    for (UA_UInt32 i = 0; i < 100; i += 3) {
+        session = UA_NODEID_NUMERIC(1, i * 7919);
+        session_limits_close(&limits, &session);
+    }
+    TEST_ASSERT_EQUAL_INT(66, limits.count);
+
+    for (UA_UInt32 i = 0; i < 100; i++) {
+        session = UA_NODEID_NUMERIC(1, i * 7919);
+        TEST_ASSERT_EQUAL_INT(i % 3 == 0 ? 100000 : 3, _charge_all(&limits, &session, 0));
+    }
+
+    // A reopened session gets a new budget
+    session = UA_NODEID_NUMERIC(1, 0);
+    session_limits_open(&limits, &session);
+    TEST_ASSERT_EQUAL_INT(3, _charge_all(&limits, &session, 0));
+
+    free_session_limits(&limits);
+    TEST_ASSERT_NULL(limits.index);
+}
+
+/// @brief Test charging the operations of the services only.
+/// @param None
+/// @return None
+/// @details This function tests that the access control wrapped by the limits charges the reads of a session
+/// while a client message is processed, and refuses them past its budget with an access level of 0.
+/// It checks that the reads made outside of a client message, the samples of the monitored items, are granted
+/// without being charged, and that every read is charged when the client messages are not seen.
+/// @note This function is part of the session limits test suite.
+/// @see session_limits_install(), session_limits_open(), free_session_limits()
+void test_session_limits_services(void){
+    UA_ServerConfig server_config;
+    SessionLimits limits;
+    SessionLimitsConfig config = {2, 0, 0};
+    UA_NodeId session = UA_NODEID_NUMERIC(1, 1);
+    UA_NodeId node = UA_NODEID_NUMERIC(2, 1);
+    UA_AccessControl* ac = &server_config.accessControl;
+
+    memset(&server_config, 0, sizeof(UA_ServerConfig));
+    ac->getUserAccessLevel = _grant;
+    session_limits_install(&limits, &server_config, &config, NULL);
+    session_limits_open(&limits, &session);
+    limits.services_only = true;
+
+    // Sampling
+    for (size_t i = 0; i < 10; i++)
+        TEST_ASSERT_EQUAL_UINT8(0xFF, ac->getUserAccessLevel(NULL, ac, &session, NULL, &node, NULL));
+
+    // Read requests
+    limits.in_service = true;
+    TEST_ASSERT_EQUAL_UINT8(0xFF, ac->getUserAccessLevel(NULL, ac, &session, NULL, &node, NULL));
+    TEST_ASSERT_EQUAL_UINT8(0xFF, ac->getUserAccessLevel(NULL, ac, &session, NULL, &node, NULL));
+    TEST_ASSERT_EQUAL_UINT8(0, ac->getUserAccessLevel(NULL, ac, &session, NULL, &node, NULL));
+    TEST_ASSERT_EQUAL_INT(1, limits.refused);
+
+    // The samples still run while the session is throttled
+    limits.in_service = false;
+    TEST_ASSERT_EQUAL_UINT8(0xFF, ac->getUserAccessLevel(NULL, ac, &session, NULL, &node, NULL));
+
+    // Without the client messages, everything is charged
+    limits.services_only = false;
+    TEST_ASSERT_EQUAL_UINT8(0, ac->getUserAccessLevel(NULL, ac, &session, NULL, &node, NULL));
+    TEST_ASSERT_EQUAL_INT(2, limits.refused);
+
+    free_session_limits(&limits);
+}
+
+/// @brief Test the fair share of the budgets between the sessions.
+/// @param None
+/// @return None
+/// @details This function tests that a session reading in a loop is refused past its budget while the other
+/// sessions keep theirs, that the server limit is shared between the sessions active in the last round, and that
+/// the byte budget refuses the operations of a session reading large values.
+/// It checks that the sessions not activated through the limits are never refused.
+/// It also ensures that the memory is freed correctly after the test.
+/// @note This function is part of the session limits test suite.
+/// @see session_limits_install(), session_limits_open(), session_limits_charge(), session_limits_round(),
+/// session_limits_close(), free_session_limits()
+void test_session_limits_fair_share(void){
+    UA_ServerConfig server_config;
+    SessionLimits limits;
+    SessionLimitsConfig config = {1000, 300, 0};
+    UA_NodeId greedy = UA_NODEID_NUMERIC(1, 1);
+    UA_NodeId polite = UA_NODEID_NUMERIC(1, 2);
+    UA_NodeId idle = UA_NODEID_NUMERIC(1, 3);
+    UA_NodeId admin = UA_NODEID_NUMERIC(0, 1);
+
+    memset(&server_config, 0, sizeof(UA_ServerConfig));
+    session_limits_install(&limits, &server_config, &config, NULL);
+    TEST_ASSERT_EQUAL_PTR(&limits, server_config.accessControl.context);
+
+    session_limits_open(&limits, &greedy);
+    session_limits_open(&limits, &polite);
+    session_limits_open(&limits, &idle);
+    session_limits_open(&limits, &greedy);
+    TEST_ASSERT_EQUAL_INT(3, limits.count);
+
+    // A new session starts with one second of the server limit
+    TEST_ASSERT_EQUAL_INT(300, _charge_all(&limits, &greedy, 0));
+    TEST_ASSERT_TRUE(session_limits_charge(&limits, &polite, 0));
+    TEST_ASSERT_TRUE(session_limits_charge(&limits, &polite, 0));
+    TEST_ASSERT_TRUE(session_limits_charge(&limits, &admin, 0));
+
+    // Two sessions were active: each gets 150 operations/s, 15 per round
+    session_limits_round(&limits);
+    TEST_ASSERT_EQUAL_DOUBLE(150.0, limits.share);
+    TEST_ASSERT_TRUE(limits.sessions[0].throttled);
+    TEST_ASSERT_FALSE(limits.sessions[1].throttled);
+    TEST_ASSERT_EQUAL_INT(15, _charge_all(&limits, &greedy, 0));
+    TEST_ASSERT_EQUAL_INT(150, _charge_all(&limits, &polite, 0));
+    TEST_ASSERT_EQUAL_INT(2, limits.sessions[0].refused);
+
+    // The greedy session alone gets the per-session limit, capped at one second of budget
+    session_limits_round(&limits);
+    TEST_ASSERT_EQUAL_DOUBLE(150.0, limits.share);
+    session_limits_round(&limits);
+    TEST_ASSERT_EQUAL_DOUBLE(300.0, limits.share);
+    for (size_t i = 0; i < 20; i++)
+        session_limits_round(&limits);
+    TEST_ASSERT_EQUAL_INT(300, _charge_all(&limits, &idle, 0));
+    TEST_ASSERT_FALSE(limits.sessions[0].throttled);
+
+    session_limits_close(&limits, &greedy);
+    TEST_ASSERT_EQUAL_INT(2, limits.count);
+    TEST_ASSERT_TRUE(session_limits_charge(&limits, &greedy, 0));
+    free_session_limits(&limits);
+    TEST_ASSERT_NULL(limits.sessions);
+
+    // Bytes only: 468 bytes of value and 32 of operation, two operations per second
+    config = (SessionLimitsConfig){0, 0, 1000};
+    memset(&server_config, 0, sizeof(UA_ServerConfig));
+    session_limits_install(&limits, &server_config, &config, NULL);
+    session_limits_open(&limits, &greedy);
+    TEST_ASSERT_EQUAL_INT(2, _charge_all(&limits, &greedy, 468));
+    // The last operation of a quantum runs whole, the next quanta pay it back
+    session_limits_round(&limits);
+    TEST_ASSERT_EQUAL_INT(1, _charge_all(&limits, &greedy, 468));
+    for (size_t i = 0; i < 4; i++)
+        session_limits_round(&limits);
+    TEST_ASSERT_EQUAL_INT(0, _charge_all(&limits, &greedy, 468));
+    session_limits_round(&limits);
+    TEST_ASSERT_EQUAL_INT(1, _charge_all(&limits, &greedy, 468));
+    free_session_limits(&limits);
+
+    // No limit: the access control is left untouched
+    config = (SessionLimitsConfig){0, 0, 0};
+    memset(&server_config, 0, sizeof(UA_ServerConfig));
+    session_limits_install(&limits, &server_config, &config, NULL);
+    TEST_ASSERT_NULL(server_config.accessControl.context);
+    free_session_limits(&limits);
+}
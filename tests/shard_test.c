@@ -0,0 +1,198 @@
+#include "../include/tests/shard_test.h"
+#include "../include/tests/machine_config_test.h"
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static bool _write_int(ShardRing* ring, size_t item, UA_Int32 number);
+
+
+/// @brief Write an Int32 value into a ring
+/// @return The result of shard_ring_write
+static bool _write_int(ShardRing* ring, size_t item, UA_Int32 number){
+
+    UA_DataValue value;
+    bool written;
+
+    UA_DataValue_init(&value);
+    UA_Variant_setScalarCopy(&value.value, &number, &UA_TYPES[UA_TYPES_INT32]);
+    value.hasValue = true;
+    written = shard_ring_write(ring, item, &value);
+    UA_DataValue_clear(&value);
+
+    return written;
+}
+
+/// @brief Test the ring between a shard worker and the front.
+/// @param None
+/// @return None
+/// @details This function tests that values written into a ring are pushed in order into the gateway queues of
+/// their items, including when the records wrap around the end of the ring.
+/// It checks that a value written into a full ring is dropped and counted, and that a gateway attached to a ring
+/// writes its values into it instead of its queues and counts the values the full ring drops as Group overflows.
+/// It also ensures that the ring and the memory are freed correctly after the test.
+/// @note This function is part of the shard test suite.
+/// @see shard_ring_create(), shard_ring_write(), shard_ring_read(), shard_ring_free(), shard_ring_destroy()
+void test_shard_ring(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    Gateway worker;
+    ShardRing* ring;
+    UA_DataValue value;
+    size_t flags;
+    UA_Int32 written = 0;
+
+    TEST_ASSERT_NULL(shard_ring_create(1000));
+    ring = shard_ring_create(512);
+    TEST_ASSERT_NOT_NULL(ring);
+    TEST_ASSERT_EQUAL_INT(512, shard_ring_free(ring));
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    flags = address_space.machines[0].first_item;
+
+    // The two FLAGS items keep the default queue of 16 values
+    for (UA_Int32 i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(_write_int(ring, flags + (size_t)(i % 2), written++));
+    }
+    TEST_ASSERT_TRUE(shard_ring_free(ring) < 512);
+    TEST_ASSERT_EQUAL_INT(10, shard_ring_read(ring, &gateway));
+    TEST_ASSERT_EQUAL_INT(512, shard_ring_free(ring));
+    for (UA_Int32 i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[flags + (size_t)(i % 2)], &value));
+        TEST_ASSERT_EQUAL_INT(i, *(UA_Int32*)value.value.data);
+        UA_DataValue_clear(&value);
+    }
+
+    // Fill the ring past its end
+    while (_write_int(ring, flags + (size_t)(written % 2), written)) written++;
+    TEST_ASSERT_TRUE(written > 20);
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&ring->dropped));
+    TEST_ASSERT_EQUAL_INT(written - 10, shard_ring_read(ring, &gateway));
+    for (UA_Int32 i = 10; i < written; i++) {
+        TEST_ASSERT_TRUE(item_queue_pop(&gateway.queues[flags + (size_t)(i % 2)], &value));
+        TEST_ASSERT_EQUAL_INT(i, *(UA_Int32*)value.value.data);
+        UA_DataValue_clear(&value);
+    }
+    TEST_ASSERT_EQUAL_INT(0, shard_ring_read(ring, &gateway));
+
+    // A worker gateway writes into its ring
+    worker = gateway;
+    worker.shard = ring;
+    UA_DataValue_init(&value);
+    TEST_ASSERT_TRUE(gateway_push(&worker, flags, &value));
+    TEST_ASSERT_EQUAL_INT(0, gateway.queues[flags].count);
+    TEST_ASSERT_EQUAL_INT(1, shard_ring_read(ring, &gateway));
+    TEST_ASSERT_EQUAL_INT(1, gateway.queues[flags].count);
+
+    // A value the full ring drops is an overflow of its Group
+    while (_write_int(ring, flags, written)) written++;
+    UA_DataValue_init(&value);
+    UA_Variant_setScalarCopy(&value.value, &written, &UA_TYPES[UA_TYPES_INT32]);
+    value.hasValue = true;
+    TEST_ASSERT_FALSE(gateway_push(&worker, flags, &value));
+    TEST_ASSERT_EQUAL_INT(1, gateway.group_overflows[gateway.first_group[0]]);
+
+    shard_ring_destroy(ring);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
+
+/// @brief Test the assignment of the machines to the workers.
+/// @param None
+/// @return None
+/// @details This function tests that the machines are spread over the workers by number of items and that each
+/// worker gets a ring without being forked.
+/// It also ensures that the rings and the memory are freed correctly after the test.
+/// @note This function is part of the shard test suite.
+/// @see init_shards(), free_shards()
+void test_shard_assignment(void){
+    AddressSpace address_space;
+    Gateway gateway;
+    Shards shards;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+
+    // Three machines of the same size: the first and the last share a worker
+    init_shards(&shards, &gateway, 2);
+    TEST_ASSERT_EQUAL_INT(2, shards.count);
+    TEST_ASSERT_EQUAL_INT(0, shards.machine_shard[0]);
+    TEST_ASSERT_EQUAL_INT(1, shards.machine_shard[1]);
+    TEST_ASSERT_EQUAL_INT(0, shards.machine_shard[2]);
+    for (size_t w = 0; w < shards.count; w++) {
+        TEST_ASSERT_EQUAL_INT(-1, shards.workers[w].pid);
+        TEST_ASSERT_NOT_NULL(shards.workers[w].ring);
+    }
+    free_shards(&shards);
+    TEST_ASSERT_NULL(shards.workers);
+
+    // More workers than machines: one machine each, the last worker idles
+    init_shards(&shards, &gateway, 4);
+    for (size_t m = 0; m < address_space.count; m++) {
+        TEST_ASSERT_EQUAL_INT(m, shards.machine_shard[m]);
+    }
+    free_shards(&shards);
+
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+}
+
+/// @brief Test the backpressure of the machines of a worker.
+/// @param None
+/// @return None
+/// @details This function tests that the front drains the ring of a worker while one of its machines is blocked,
+/// so the values of the other machines of the worker keep flowing, and that the blocked machine is flagged in the
+/// state shared with the worker until its queue drains.
+/// It checks that the values a worker dropped on its full ring are added to the overflows of their Groups.
+/// It also ensures that the rings and the memory are freed correctly after the test.
+/// @note This function is part of the shard test suite.
+/// @see shard_exchange(), init_shards(), free_shards()
+void test_shard_backpressure(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    Gateway gateway;
+    Shards shards;
+    ShardRing* ring;
+    size_t data;
+    size_t other;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+
+    // Machines 0 and 2 share worker 0, DATA of machine 0 is a Block queue of 4 values
+    init_shards(&shards, &gateway, 2);
+    ring = shards.workers[0].ring;
+    data = address_space.machines[0].first_item + address_space.machines[0].group_first_item[1];
+    other = address_space.machines[2].first_item;
+
+    for (UA_Int32 i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(_write_int(ring, data, i));
+    }
+    TEST_ASSERT_TRUE(_write_int(ring, other, 0));
+    TEST_ASSERT_EQUAL_INT(6, shard_exchange(&shards));
+    TEST_ASSERT_EQUAL_INT(1, gateway.queues[other].count);
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&shards.blocked[0]));
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&shards.blocked[2]));
+    TEST_ASSERT_EQUAL_INT(1, gateway.group_overflows[gateway.first_group[0] + 1]);
+
+    // The worker dropped two values of machine 2 on its full ring
+    atomic_fetch_add(&shards.overflows[gateway.first_group[2]], 2);
+    TEST_ASSERT_TRUE(_write_int(ring, other, 1));
+    TEST_ASSERT_EQUAL_INT(1, shard_exchange(&shards));
+    TEST_ASSERT_EQUAL_INT(2, gateway.group_overflows[gateway.first_group[2]]);
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&shards.overflows[gateway.first_group[2]]));
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&shards.blocked[0]));
+
+    // Publishing a value of DATA unblocks machine 0
+    TEST_ASSERT_TRUE(gateway_publish(&gateway, server, GATEWAY_PUBLISH_BUDGET) > 0);
+    TEST_ASSERT_EQUAL_INT(0, shard_exchange(&shards));
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&shards.blocked[0]));
+
+    free_shards(&shards);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
@@ -0,0 +1,62 @@
+#include "../include/tests/shm_table_test.h"
+#include "../include/tests/machine_config_test.h"
+
+#include <unistd.h>
+
+/// @brief Test reading values written in the shared-memory table.
+/// @param None
+/// @return None
+/// @details This function tests that the reader finds every item of the fixtures by name and reads the values written by the gateway.
+/// It checks that items without a value report BadWaitingForInitialData and that unknown names are not found.
+/// It also checks that the reader sees the table abandoned once the gateway closes it.
+/// @note This function is part of the shared-memory table test suite.
+/// @see shm_table_open(), shm_table_write(), shm_reader_open(), shm_reader_find(), shm_reader_read()
+void test_shm_table_read_write(void){
+    AddressSpace address_space;
+    ShmTable table;
+    ShmReader reader;
+    ShmTableSlot slot;
+    UA_DataValue value;
+    UA_Int32 poles = 12;
+    char name[64];
+    char path[256];
+    size_t index;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+
+    snprintf(name, sizeof(name), "/opcuaserver_test_%d", (int)getpid());
+    TEST_ASSERT_TRUE(shm_table_open(&table, name, &address_space));
+    TEST_ASSERT_TRUE(shm_reader_open(&reader, name));
+    TEST_ASSERT_EQUAL_INT(address_space.item_count, shm_reader_count(&reader));
+    TEST_ASSERT_FALSE(shm_reader_stale(&reader));
+
+    // NB_POLES is the first item of the DATA group
+    snprintf(path, sizeof(path), "%s/DATA/NB_POLES", machine_config.configs[0].name);
+    TEST_ASSERT_TRUE(shm_reader_find(&reader, path, &index));
+    TEST_ASSERT_EQUAL_INT(address_space.machines[0].first_item + address_space.machines[0].group_first_item[1], index);
+    TEST_ASSERT_FALSE(shm_reader_find(&reader, "Unknown/DATA/NB_POLES", &index));
+
+    TEST_ASSERT_TRUE(shm_reader_read(&reader, index, &slot));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADWAITINGFORINITIALDATA, slot.status);
+    TEST_ASSERT_EQUAL_INT(SHM_VALUE_EMPTY, slot.type);
+
+    UA_DataValue_init(&value);
+    UA_Variant_setScalar(&value.value, &poles, &UA_TYPES[UA_TYPES_INT32]);
+    value.hasValue = true;
+    shm_table_write(&table, index, &value);
+
+    TEST_ASSERT_TRUE(shm_reader_read(&reader, index, &slot));
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_GOOD, slot.status);
+    TEST_ASSERT_EQUAL_INT(SHM_VALUE_INT, slot.type);
+    TEST_ASSERT_EQUAL_INT(12, slot.value.i);
+    TEST_ASSERT_EQUAL_INT(2, slot.sequence);
+    TEST_ASSERT_FALSE(shm_reader_read(&reader, address_space.item_count, &slot));
+
+    shm_table_close(&table);
+    TEST_ASSERT_TRUE(shm_reader_stale(&reader));
+    shm_reader_close(&reader);
+    TEST_ASSERT_FALSE(shm_reader_open(&reader, name));
+
+    free_address_space(&address_space);
+}
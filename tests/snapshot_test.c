@@ -0,0 +1,150 @@
+#include "../include/tests/snapshot_test.h"
+#include "../include/tests/machine_config_test.h"
+
+#include <unistd.h>
+
+#define SNAPSHOT_TEST_FILE "snapshot_test.bin"
+
+// Private functions (static)
+// In the case where we cannot manage functions in order in the file
+static size_t _find_item(const AddressSpace* address_space, const char* path);
+static void _set_int16(UA_DataValue* value, UA_Int16 number, UA_DateTime source_timestamp);
+
+
+/// @brief Find the global index of an item from its path
+/// @return The index, item_count if the path is unknown
+static size_t _find_item(const AddressSpace* address_space, const char* path){
+
+    char buffer[256];
+
+    for (size_t i = 0; i < address_space->item_count; i++) {
+        address_space_item_path(address_space, i, buffer, sizeof(buffer));
+        if (strcmp(buffer, path) == 0) return i;
+    }
+
+    return address_space->item_count;
+}
+
+/// @brief Set a good Int16 value with a source timestamp
+static void _set_int16(UA_DataValue* value, UA_Int16 number, UA_DateTime source_timestamp){
+
+    UA_DataValue_init(value);
+    UA_Variant_setScalarCopy(&value->value, &number, &UA_TYPES[UA_TYPES_INT16]);
+    value->hasValue = true;
+    value->hasSourceTimestamp = true;
+    value->sourceTimestamp = source_timestamp;
+}
+
+/// @brief Test writing and reading a snapshot of item values.
+/// @param None
+/// @return None
+/// @details This function tests that the values of a layout are read back by item path into another layout
+/// where items were added, removed and reordered.
+/// It checks that values, source timestamps and bad statuses are kept, that good values come back as
+/// UncertainLastUsableValue, that items without value in the snapshot are left untouched and that the
+/// time of the snapshot is returned.
+/// It also checks that missing or foreign files are ignored and that the memory is freed correctly after the test.
+/// @note This function is part of the snapshot test suite.
+/// @see snapshot_write(), snapshot_read()
+void test_snapshot_round_trip(void){
+    ArrayMachineConfig moved_config = {0};
+    AddressSpace address_space;
+    AddressSpace moved;
+    UA_DataValue* values;
+    UA_DataValue* restored;
+    UA_DateTime written = 0;
+    size_t pc;
+    size_t plc;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    load_machine_config("tests/fixtures/snapshot", &moved_config);
+    init_address_space(&address_space, &machine_config);
+    init_address_space(&moved, &moved_config);
+
+    values = (UA_DataValue*)calloc(address_space.item_count, sizeof(UA_DataValue));
+    restored = (UA_DataValue*)calloc(moved.item_count, sizeof(UA_DataValue));
+    TEST_ASSERT_NOT_NULL(values);
+    TEST_ASSERT_NOT_NULL(restored);
+
+    // PC is good, PLC lost its connection, NB_POLES is gone from the new layout
+    _set_int16(&values[_find_item(&address_space, "Machine1/FLAGS/PC")], 1, 1000);
+    _set_int16(&values[_find_item(&address_space, "Machine1/FLAGS/PLC")], 2, 2000);
+    values[_find_item(&address_space, "Machine1/FLAGS/PLC")].hasStatus = true;
+    values[_find_item(&address_space, "Machine1/FLAGS/PLC")].status = UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    _set_int16(&values[_find_item(&address_space, "Machine1/DATA/NB_POLES")], 3, 3000);
+
+    TEST_ASSERT_EQUAL_size_t(3, snapshot_write(SNAPSHOT_TEST_FILE, &address_space, values));
+    TEST_ASSERT_EQUAL_size_t(2, snapshot_read(SNAPSHOT_TEST_FILE, &moved, restored, &written));
+    TEST_ASSERT_TRUE(written > 0);
+
+    pc = _find_item(&moved, "Machine1/FLAGS/PC");
+    plc = _find_item(&moved, "Machine1/FLAGS/PLC");
+    TEST_ASSERT_TRUE(UA_Variant_hasScalarType(&restored[pc].value, &UA_TYPES[UA_TYPES_INT16]));
+    TEST_ASSERT_EQUAL_INT(1, *(UA_Int16*)restored[pc].value.data);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_UNCERTAINLASTUSABLEVALUE, restored[pc].status);
+    TEST_ASSERT_EQUAL_INT64(1000, restored[pc].sourceTimestamp);
+    TEST_ASSERT_EQUAL_INT(2, *(UA_Int16*)restored[plc].value.data);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_BADCOMMUNICATIONERROR, restored[plc].status);
+    TEST_ASSERT_FALSE(restored[_find_item(&moved, "Machine1/FLAGS/ALARM")].hasValue);
+
+    // Missing and foreign files are ignored
+    TEST_ASSERT_EQUAL_size_t(0, snapshot_read("missing_snapshot.bin", &moved, restored, NULL));
+    TEST_ASSERT_EQUAL_size_t(0, snapshot_read("tests/fixtures/snapshot/Machine/Machine.json", &moved, restored, NULL));
+
+    for (size_t i = 0; i < address_space.item_count; i++) UA_DataValue_clear(&values[i]);
+    for (size_t i = 0; i < moved.item_count; i++) UA_DataValue_clear(&restored[i]);
+    free(values);
+    free(restored);
+    remove(SNAPSHOT_TEST_FILE);
+    TEST_ASSERT_NOT_EQUAL(0, access(SNAPSHOT_TEST_FILE, F_OK));
+
+    free_address_space(&address_space);
+    free_address_space(&moved);
+    free_array_machine_config(&moved_config);
+}
+
+/// @brief Test saving the gateway values and restoring them into another gateway.
+/// @param None
+/// @return None
+/// @details This function tests that the values published by a gateway are saved from its cache of published values,
+/// without reading the nodes, and that items which never received a value are not saved.
+/// It checks that the restored values are published by the other gateway as UncertainLastUsableValue and become
+/// its current values.
+/// It also ensures that the server and the memory are freed correctly after the test.
+/// @note This function is part of the snapshot test suite.
+/// @see snapshot_save(), snapshot_restore(), gateway_preload(), gateway_current()
+void test_snapshot_gateway(void){
+    UA_Server* server = UA_Server_new();
+    AddressSpace address_space;
+    Gateway gateway;
+    Gateway restored;
+    UA_DataValue value;
+    size_t pc;
+
+    load_machine_config("tests/fixtures/filled", &machine_config);
+    init_address_space(&address_space, &machine_config);
+    init_gateway(&gateway, &address_space);
+    pc = _find_item(&address_space, "Machine1/FLAGS/PC");
+
+    _set_int16(&value, 5, 4000);
+    TEST_ASSERT_TRUE(gateway_push(&gateway, pc, &value));
+    TEST_ASSERT_EQUAL_INT(1, gateway_publish(&gateway, server, GATEWAY_PUBLISH_BUDGET));
+    TEST_ASSERT_EQUAL_size_t(1, snapshot_save(SNAPSHOT_TEST_FILE, &gateway));
+
+    init_gateway(&restored, &address_space);
+    TEST_ASSERT_EQUAL_size_t(1, snapshot_restore(SNAPSHOT_TEST_FILE, &restored, server));
+    TEST_ASSERT_EQUAL_INT(0, restored.queues[pc].count);
+
+    TEST_ASSERT_TRUE(gateway_current(&restored, pc, &value));
+    TEST_ASSERT_EQUAL_INT(5, *(UA_Int16*)value.value.data);
+    TEST_ASSERT_EQUAL_UINT32(UA_STATUSCODE_UNCERTAINLASTUSABLEVALUE, value.status);
+    TEST_ASSERT_EQUAL_INT64(4000, value.sourceTimestamp);
+    UA_DataValue_clear(&value);
+    TEST_ASSERT_FALSE(gateway_current(&restored, pc + 1, &value));
+
+    remove(SNAPSHOT_TEST_FILE);
+    free_gateway(&restored);
+    free_gateway(&gateway);
+    free_address_space(&address_space);
+    UA_Server_delete(server);
+}
@@ -0,0 +1,131 @@
+#include "../include/tests/trace_test.h"
+
+#include <json.h>
+#include <unistd.h>
+
+#define TRACE_TEST_FILE "trace_test.json"
+
+/// @brief Test that spans are ignored when no trace is open.
+/// @param None
+/// @return None
+/// @details This function tests that begin and end calls without an open trace do nothing and write no file.
+/// @note This function is part of the trace test suite.
+/// @see trace_begin(), trace_end(), trace_enabled()
+void test_trace_disabled(void){
+    TEST_ASSERT_FALSE(trace_enabled());
+
+    trace_begin("ignored", NULL);
+    trace_end();
+
+    TEST_ASSERT_TRUE(trace_close());
+    TEST_ASSERT_NOT_EQUAL(0, access(TRACE_TEST_FILE, F_OK));
+}
+
+/// @brief Test the Chrome trace file of nested spans.
+/// @param None
+/// @return None
+/// @details This function tests that nested spans are written as complete events in the order they began.
+/// It checks that inner spans lie within their parent span and that details are written as arguments.
+/// It also checks that spans still open are ended when the trace is closed.
+/// @note This function is part of the trace test suite.
+/// @see trace_open(), trace_begin(), trace_end(), trace_close()
+void test_trace_nested_spans(void){
+    struct json_object* root;
+    struct json_object* events;
+    struct json_object* outer;
+    struct json_object* inner;
+    struct json_object* value;
+    int64_t outer_ts, outer_dur, inner_ts, inner_dur;
+
+    trace_open(TRACE_TEST_FILE);
+    TEST_ASSERT_TRUE(trace_enabled());
+
+    trace_begin("outer", NULL);
+    trace_begin("inner", "tests/fixtures/filled");
+    trace_end();
+    TEST_ASSERT_TRUE(trace_close());
+    TEST_ASSERT_FALSE(trace_enabled());
+
+    root = json_object_from_file(TRACE_TEST_FILE);
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_TRUE(json_object_object_get_ex(root, "traceEvents", &events));
+    TEST_ASSERT_EQUAL_INT(2, json_object_array_length(events));
+
+    outer = json_object_array_get_idx(events, 0);
+    inner = json_object_array_get_idx(events, 1);
+
+    json_object_object_get_ex(outer, "name", &value);
+    TEST_ASSERT_EQUAL_STRING("outer", json_object_get_string(value));
+    json_object_object_get_ex(outer, "ph", &value);
+    TEST_ASSERT_EQUAL_STRING("X", json_object_get_string(value));
+    TEST_ASSERT_FALSE(json_object_object_get_ex(outer, "args", &value));
+
+    json_object_object_get_ex(inner, "args", &value);
+    json_object_object_get_ex(value, "detail", &value);
+    TEST_ASSERT_EQUAL_STRING("tests/fixtures/filled", json_object_get_string(value));
+
+    json_object_object_get_ex(outer, "ts", &value);
+    outer_ts = json_object_get_int64(value);
+    json_object_object_get_ex(outer, "dur", &value);
+    outer_dur = json_object_get_int64(value);
+    json_object_object_get_ex(inner, "ts", &value);
+    inner_ts = json_object_get_int64(value);
+    json_object_object_get_ex(inner, "dur", &value);
+    inner_dur = json_object_get_int64(value);
+
+    TEST_ASSERT_EQUAL_INT64(0, outer_ts);
+    TEST_ASSERT_TRUE(inner_ts >= outer_ts);
+    TEST_ASSERT_TRUE(inner_ts + inner_dur <= outer_ts + outer_dur);
+
+    json_object_put(root);
+    remove(TRACE_TEST_FILE);
+}
+
+/// @brief Test the Chrome trace file of detached spans.
+/// @param None
+/// @return None
+/// @details This function tests that spans started with trace_start end in any order, each on its own row,
+/// and that a span still running when the trace is closed is ended then.
+/// It also checks that trace_start returns TRACE_NO_SPAN without an open trace.
+/// @note This function is part of the trace test suite.
+/// @see trace_start(), trace_finish(), trace_close()
+void test_trace_detached_spans(void){
+    struct json_object* root;
+    struct json_object* events;
+    struct json_object* value;
+    int64_t tids[3];
+    size_t first;
+    size_t second;
+
+    TEST_ASSERT_EQUAL_UINT64(TRACE_NO_SPAN, trace_start("ignored", NULL));
+    trace_finish(TRACE_NO_SPAN);
+
+    trace_open(TRACE_TEST_FILE);
+    trace_begin("startup", NULL);
+    first = trace_start("connect", "opc.tcp://first:4840");
+    second = trace_start("connect", "opc.tcp://second:4840");
+    trace_end();
+    trace_finish(first);
+    trace_finish(first);
+    TEST_ASSERT_NOT_EQUAL(first, second);
+    TEST_ASSERT_TRUE(trace_close());
+    trace_finish(second);
+
+    root = json_object_from_file(TRACE_TEST_FILE);
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_TRUE(json_object_object_get_ex(root, "traceEvents", &events));
+    TEST_ASSERT_EQUAL_INT(3, json_object_array_length(events));
+
+    for (size_t i = 0; i < 3; i++) {
+        json_object_object_get_ex(json_object_array_get_idx(events, i), "tid", &value);
+        tids[i] = json_object_get_int64(value);
+        json_object_object_get_ex(json_object_array_get_idx(events, i), "dur", &value);
+        TEST_ASSERT_TRUE(json_object_get_int64(value) >= 0);
+    }
+    TEST_ASSERT_NOT_EQUAL(tids[0], tids[1]);
+    TEST_ASSERT_NOT_EQUAL(tids[1], tids[2]);
+    TEST_ASSERT_NOT_EQUAL(tids[0], tids[2]);
+
+    json_object_put(root);
+    remove(TRACE_TEST_FILE);
+}
@@ -0,0 +1,61 @@
+#include "../include/compiled_machines.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/// @brief Build-time compiler of the machine files
+/// @details Loads a machine folder with the parser of the server and writes it as the static C tables
+/// included by src/compiled_machines.c (see compiled_machines.h). The makefile runs it when MACHINES is set:
+///
+///     make MACHINES=/path/to/machines
+///
+/// The output is written to a temporary file and renamed, so an interrupted run never leaves a partial
+/// table behind for the next build.
+
+int main(int argc, char *argv[]) {
+
+    ArrayMachineConfig machine_config = {0};
+    char temporary[PATH_MAX];
+    size_t items = 0;
+    FILE* out;
+    bool written;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <machine-folder> <output.inc>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    load_machine_config(argv[1], &machine_config);
+    if (machine_config.count == 0) {
+        fprintf(stderr, "No machine file found in %s\n", argv[1]);
+        free_array_machine_config(&machine_config);
+        return EXIT_FAILURE;
+    }
+
+    snprintf(temporary, sizeof(temporary), "%s.tmp", argv[2]);
+    out = fopen(temporary, "w");
+    if (!out) {
+        perror(temporary);
+        free_array_machine_config(&machine_config);
+        return EXIT_FAILURE;
+    }
+
+    written = write_compiled_machine_config(&machine_config, argv[1], out);
+    written = fclose(out) == 0 && written;
+    if (!written || rename(temporary, argv[2]) != 0) {
+        perror(argv[2]);
+        remove(temporary);
+        free_array_machine_config(&machine_config);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t m = 0; m < machine_config.count; m++) {
+        for (size_t g = 0; g < machine_config.configs[m].groups.count; g++)
+            items += machine_config.configs[m].groups.groups[g].items.count;
+    }
+    printf("Compiled %zu machines with %zu items from %s into %s\n", machine_config.count, items, argv[1], argv[2]);
+
+    free_array_machine_config(&machine_config);
+    return EXIT_SUCCESS;
+}
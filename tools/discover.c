@@ -0,0 +1,590 @@
+#include "../include/discovery.h"
+
+#include <open62541/client_config_default.h>
+#include <open62541/client_highlevel.h>
+#include <open62541/plugin/log_stdout.h>
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/// @brief Machine file generator browsing an upstream OPC UA server
+/// @details Browses the subtree of a machine breadth first and writes the `Subscriptions` of its
+/// machine file: one Group per object holding variables, named after its browse path below the root,
+/// one Item per variable with its NodeId and the type read from its DataType attribute.
+/// Each Browse, BrowseNext and Read request carries a batch of nodes (up to the operation limits of
+/// the server) and several requests are kept in flight on the session, so a PLC with tens of thousands
+/// of tags is discovered in a few hundred round trips instead of one per node (see discovery.h).
+/// Nodes answered with a transient status are sent again; a discovery aborted by any other bad status
+/// leaves the machine file and the cache untouched, and both are replaced atomically.
+/// An existing machine file is refreshed rather than replaced: the settings of its Groups (Queue,
+/// Priority, Aggregates...) and of its Items (a renamed item, a forced Type) are kept, as are the
+/// expression items and the Groups without upstream items.
+/// The result of a browse is cached next to the machine file with a key made of the namespace array
+/// and the model versions published in Server/Namespaces; a later run against an unchanged model
+/// skips the browse entirely.
+
+/// @brief Nodes per Browse and Read request when the server does not limit them lower
+#define DISCOVER_DEFAULT_BATCH 1000
+/// @brief Requests in flight on the session
+#define DISCOVER_DEFAULT_PIPELINE 8
+
+typedef struct {
+    const char* url;
+    const char* output;
+    const char* cache;
+    const char* name;
+    const char* namespace;
+    const char* root;
+    size_t batch;
+    size_t pipeline;
+    bool refresh;
+} DiscoverOptions;
+
+static volatile sig_atomic_t running = true;
+
+static void stop_handler(int sig){
+    (void)sig;
+    running = false;
+}
+
+/// @brief FNV-1a hash of bytes, chained from a previous hash
+static UA_UInt64 hash_bytes(UA_UInt64 hash, const void* data, size_t length){
+
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+/// @brief Copy a UA_String into a terminated string
+static char* string_dup(const UA_String* string){
+
+    char* copy = (char*)malloc(string->length + 1);
+
+    if (!copy) {
+        fprintf(stderr, "Failed to allocate memory for a name\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (string->length > 0) memcpy(copy, string->data, string->length);
+    copy[string->length] = '\0';
+
+    return copy;
+}
+
+/// @brief Nodes per request, the requested batch or the operation limit of the server
+static size_t operation_limit(UA_Client* client, UA_UInt32 limit_id, size_t requested){
+
+    UA_Variant value;
+    UA_UInt32 limit = 0;
+
+    if (requested > 0) return requested;
+
+    UA_Variant_init(&value);
+    if (UA_Client_readValueAttribute(client, UA_NODEID_NUMERIC(0, limit_id), &value) == UA_STATUSCODE_GOOD &&
+        UA_Variant_hasScalarType(&value, &UA_TYPES[UA_TYPES_UINT32])) {
+        limit = *(UA_UInt32*)value.data;
+    }
+    UA_Variant_clear(&value);
+
+    // 0 means no limit
+    return limit > 0 && limit < DISCOVER_DEFAULT_BATCH ? limit : DISCOVER_DEFAULT_BATCH;
+}
+
+/// @brief Key of the cache: the browse target, the namespace array and the model versions of the server
+/// @details The NodeIds written in the machine file carry namespace indexes, so any change of the namespace
+/// array invalidates them. Servers publishing NamespaceVersion or NamespacePublicationDate in
+/// Server/Namespaces change the key with their model; others need --refresh after a model change.
+static UA_UInt64 model_key(UA_Client* client, const DiscoverOptions* options){
+
+    UA_UInt64 key = hash_bytes(14695981039346656037ull, options->url, strlen(options->url));
+    UA_BrowseRequest browse;
+    UA_BrowseResponse namespaces;
+    UA_BrowseResponse properties;
+    UA_ReadRequest read;
+    UA_ReadResponse versions;
+    UA_Variant array;
+
+    key = hash_bytes(key, options->root, strlen(options->root) + 1);
+
+    UA_Variant_init(&array);
+    if (UA_Client_readValueAttribute(client, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_NAMESPACEARRAY), &array) ==
+            UA_STATUSCODE_GOOD && UA_Variant_hasArrayType(&array, &UA_TYPES[UA_TYPES_STRING])) {
+        for (size_t i = 0; i < array.arrayLength; i++) {
+            const UA_String* uri = &((const UA_String*)array.data)[i];
+
+            key = hash_bytes(key, uri->data, uri->length);
+            key = hash_bytes(key, "", 1);
+        }
+    }
+    UA_Variant_clear(&array);
+
+    // Server/Namespaces holds one object per namespace, with the version properties
+    UA_BrowseRequest_init(&browse);
+    browse.nodesToBrowse = UA_BrowseDescription_new();
+    browse.nodesToBrowseSize = 1;
+    browse.nodesToBrowse[0].nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_NAMESPACES);
+    browse.nodesToBrowse[0].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+    browse.nodesToBrowse[0].browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    browse.nodesToBrowse[0].nodeClassMask = UA_NODECLASS_OBJECT;
+    namespaces = UA_Client_Service_browse(client, browse);
+    UA_BrowseRequest_clear(&browse);
+
+    UA_BrowseResponse_init(&properties);
+    if (namespaces.responseHeader.serviceResult == UA_STATUSCODE_GOOD && namespaces.resultsSize == 1 &&
+        namespaces.results[0].referencesSize > 0) {
+        const UA_BrowseResult* result = &namespaces.results[0];
+
+        UA_BrowseRequest_init(&browse);
+        browse.nodesToBrowse = (UA_BrowseDescription*)UA_Array_new(result->referencesSize, &UA_TYPES[UA_TYPES_BROWSEDESCRIPTION]);
+        browse.nodesToBrowseSize = browse.nodesToBrowse ? result->referencesSize : 0;
+        for (size_t i = 0; i < browse.nodesToBrowseSize; i++) {
+            UA_NodeId_copy(&result->references[i].nodeId.nodeId, &browse.nodesToBrowse[i].nodeId);
+            browse.nodesToBrowse[i].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
+            browse.nodesToBrowse[i].browseDirection = UA_BROWSEDIRECTION_FORWARD;
+            browse.nodesToBrowse[i].resultMask = UA_BROWSERESULTMASK_BROWSENAME;
+        }
+        properties = UA_Client_Service_browse(client, browse);
+        UA_BrowseRequest_clear(&browse);
+    }
+    UA_BrowseResponse_clear(&namespaces);
+
+    UA_ReadRequest_init(&read);
+    for (size_t i = 0; i < properties.resultsSize; i++) {
+        for (size_t r = 0; r < properties.results[i].referencesSize; r++) {
+            const UA_ReferenceDescription* reference = &properties.results[i].references[r];
+            const UA_String version = UA_STRING("NamespaceVersion");
+            const UA_String date = UA_STRING("NamespacePublicationDate");
+            UA_ReadValueId id;
+
+            if (!UA_String_equal(&reference->browseName.name, &version) && !UA_String_equal(&reference->browseName.name, &date)) {
+                continue;
+            }
+
+            UA_ReadValueId_init(&id);
+            id.nodeId = reference->nodeId.nodeId;
+            id.attributeId = UA_ATTRIBUTEID_VALUE;
+            UA_Array_appendCopy((void**)&read.nodesToRead, &read.nodesToReadSize, &id, &UA_TYPES[UA_TYPES_READVALUEID]);
+        }
+    }
+    UA_BrowseResponse_clear(&properties);
+
+    if (read.nodesToReadSize > 0) {
+        versions = UA_Client_Service_read(client, read);
+        for (size_t i = 0; i < versions.resultsSize; i++) {
+            UA_ByteString encoded = UA_BYTESTRING_NULL;
+
+            if (!versions.results[i].hasValue) continue;
+            if (UA_encodeBinary(&versions.results[i].value, &UA_TYPES[UA_TYPES_VARIANT], &encoded) == UA_STATUSCODE_GOOD) {
+                key = hash_bytes(key, encoded.data, encoded.length);
+            }
+            UA_ByteString_clear(&encoded);
+        }
+        UA_ReadResponse_clear(&versions);
+    }
+    UA_ReadRequest_clear(&read);
+
+    return key;
+}
+
+/// @brief Get a field of a machine file, written in PascalCase or camelCase like the gateway accepts
+static struct json_object* field(struct json_object* object, const char* key){
+
+    struct json_object* value = NULL;
+    char camel[64];
+
+    if (!object || !json_object_is_type(object, json_type_object)) return NULL;
+    if (json_object_object_get_ex(object, key, &value)) return value;
+
+    snprintf(camel, sizeof(camel), "%s", key);
+    camel[0] = (char)(camel[0] - 'A' + 'a');
+    return json_object_object_get_ex(object, camel, &value) ? value : NULL;
+}
+
+/// @brief Copy the fields of an object except the listed ones, the values are shared
+static void copy_fields(struct json_object* into, struct json_object* from, const char* const* skipped, size_t skipped_count){
+
+    json_object_object_foreach(from, key, value) {
+        bool skip = false;
+
+        for (size_t s = 0; s < skipped_count && !skip; s++) {
+            skip = strcasecmp(key, skipped[s]) == 0;
+        }
+        if (!skip) json_object_object_add(into, key, json_object_get(value));
+    }
+}
+
+/// @brief Refresh the Groups of an existing machine file with the discovered ones
+/// @details Discovered Groups keep the settings of the existing Group of the same name, discovered Items
+/// keep the existing Item with the same NodeId and expression Items are appended. Existing Groups without
+/// upstream items are kept, the others are dropped: their nodes are gone from the server.
+static struct json_object* merge_subscriptions(struct json_object* existing, struct json_object* discovered, size_t* dropped){
+
+    static const char* const GROUP_FIELDS[] = {"Name", "Items"};
+    struct json_object* merged = json_object_new_array();
+    struct json_object* by_name = json_object_new_object();
+    struct json_object* used = json_object_new_object();
+    size_t existing_count = existing ? json_object_array_length(existing) : 0;
+
+    *dropped = 0;
+
+    for (size_t g = 0; g < existing_count; g++) {
+        struct json_object* group = json_object_array_get_idx(existing, g);
+        struct json_object* name = field(group, "Name");
+
+        if (name && !json_object_object_get_ex(by_name, json_object_get_string(name), NULL)) {
+            json_object_object_add(by_name, json_object_get_string(name), json_object_get(group));
+        }
+    }
+
+    for (size_t g = 0; g < json_object_array_length(discovered); g++) {
+        struct json_object* found = json_object_array_get_idx(discovered, g);
+        const char* name = json_object_get_string(field(found, "Name"));
+        struct json_object* found_items = field(found, "Items");
+        struct json_object* group = json_object_new_object();
+        struct json_object* items = json_object_new_array();
+        struct json_object* old_group = NULL;
+        struct json_object* old_items;
+        struct json_object* by_node = json_object_new_object();
+
+        json_object_object_add(group, "Name", json_object_new_string(name));
+        if (json_object_object_get_ex(by_name, name, &old_group)) {
+            copy_fields(group, old_group, GROUP_FIELDS, 2);
+            json_object_object_add(used, name, NULL);
+        }
+
+        old_items = field(old_group, "Items");
+        for (size_t i = 0; old_items && i < json_object_array_length(old_items); i++) {
+            struct json_object* item = json_object_array_get_idx(old_items, i);
+            struct json_object* node_id = field(item, "NodeId");
+
+            if (node_id) json_object_object_add(by_node, json_object_get_string(node_id), json_object_get(item));
+        }
+
+        // Renamed items and forced types survive the refresh
+        for (size_t i = 0; i < json_object_array_length(found_items); i++) {
+            struct json_object* item = json_object_array_get_idx(found_items, i);
+            struct json_object* old_item = NULL;
+
+            json_object_object_get_ex(by_node, json_object_get_string(field(item, "NodeId")), &old_item);
+            json_object_array_add(items, json_object_get(old_item ? old_item : item));
+        }
+
+        for (size_t i = 0; old_items && i < json_object_array_length(old_items); i++) {
+            struct json_object* item = json_object_array_get_idx(old_items, i);
+
+            if (!field(item, "NodeId")) json_object_array_add(items, json_object_get(item));
+        }
+
+        json_object_object_add(group, "Items", items);
+        json_object_array_add(merged, group);
+        json_object_put(by_node);
+    }
+
+    for (size_t g = 0; g < existing_count; g++) {
+        struct json_object* group = json_object_array_get_idx(existing, g);
+        struct json_object* name = field(group, "Name");
+        struct json_object* items = field(group, "Items");
+        bool upstream = false;
+
+        if (name && json_object_object_get_ex(used, json_object_get_string(name), NULL)) continue;
+
+        for (size_t i = 0; items && i < json_object_array_length(items) && !upstream; i++) {
+            upstream = field(json_object_array_get_idx(items, i), "NodeId") != NULL;
+        }
+
+        if (upstream) {
+            (*dropped)++;
+        } else {
+            json_object_array_add(merged, json_object_get(group));
+        }
+    }
+
+    json_object_put(by_name);
+    json_object_put(used);
+
+    return merged;
+}
+
+/// @brief Build the machine file from an existing one (or none) and the discovered Groups
+static struct json_object* build_machine(struct json_object* existing, struct json_object* discovered,
+                                         const DiscoverOptions* options, const char* root_name, size_t* dropped){
+
+    static const char* const MACHINE_FIELDS[] = {"Name", "Url", "Namespace", "Subscriptions", "Groups"};
+    struct json_object* machine = json_object_new_object();
+    struct json_object* old_subscriptions = field(existing, "Subscriptions");
+    const char* name = options->name;
+    const char* namespace = options->namespace;
+
+    if (!old_subscriptions) old_subscriptions = field(existing, "Groups");
+    if (!name && field(existing, "Name")) name = json_object_get_string(field(existing, "Name"));
+    if (!name) name = root_name;
+    if (!namespace && field(existing, "Namespace")) namespace = json_object_get_string(field(existing, "Namespace"));
+    if (!namespace) namespace = name;
+
+    json_object_object_add(machine, "Name", json_object_new_string(name));
+    json_object_object_add(machine, "Url", json_object_new_string(options->url));
+    json_object_object_add(machine, "Namespace", json_object_new_string(namespace));
+    if (existing) copy_fields(machine, existing, MACHINE_FIELDS, 5);
+    json_object_object_add(machine, "Subscriptions", merge_subscriptions(old_subscriptions, discovered, dropped));
+
+    return machine;
+}
+
+/// @brief Load the Groups of the cache if its key matches
+static struct json_object* load_cache(const char* path, const char* key, char** root_name){
+
+    struct json_object* cache;
+    struct json_object* value;
+    struct json_object* subscriptions = NULL;
+
+    if (!path) return NULL;
+
+    cache = json_object_from_file(path);
+    if (!cache) return NULL;
+
+    if (json_object_object_get_ex(cache, "Key", &value) && strcmp(json_object_get_string(value), key) == 0 &&
+        json_object_object_get_ex(cache, "Subscriptions", &subscriptions)) {
+        json_object_get(subscriptions);
+        *root_name = json_object_object_get_ex(cache, "Root", &value) ? strdup(json_object_get_string(value)) : NULL;
+    } else {
+        subscriptions = NULL;
+    }
+
+    json_object_put(cache);
+    return subscriptions;
+}
+
+/// @brief Write a json file through a temporary file renamed over it, a reader never sees a partial file
+/// @return false if the file was not written, it is then left as it was
+static bool write_file(const char* path, struct json_object* object, int flags){
+
+    size_t length = strlen(path) + sizeof(".tmp");
+    char* temporary = (char*)malloc(length);
+    bool written;
+
+    if (!temporary) {
+        fprintf(stderr, "Failed to allocate memory for the path of %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(temporary, length, "%s.tmp", path);
+
+    written = json_object_to_file_ext(temporary, object, flags) == 0 && rename(temporary, path) == 0;
+    if (!written) remove(temporary);
+
+    free(temporary);
+    return written;
+}
+
+static void save_cache(const char* path, const char* key, const char* root_name, struct json_object* subscriptions){
+
+    struct json_object* cache;
+
+    if (!path) return;
+
+    cache = json_object_new_object();
+    json_object_object_add(cache, "Key", json_object_new_string(key));
+    json_object_object_add(cache, "Root", json_object_new_string(root_name));
+    json_object_object_add(cache, "Subscriptions", json_object_get(subscriptions));
+
+    if (!write_file(path, cache, JSON_C_TO_STRING_PLAIN)) {
+        fprintf(stderr, "Failed to write the cache %s\n", path);
+    }
+
+    json_object_put(cache);
+}
+
+/// @brief Browse the subtree of the root and read the types of its variables
+/// @return The discovered Groups, NULL if the discovery was aborted or interrupted before it was complete
+static struct json_object* discover(UA_Client* client, const DiscoverOptions* options, const UA_NodeId* root,
+                                    const char* root_name){
+
+    Discovery discovery;
+    struct json_object* subscriptions = NULL;
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    UA_StatusCode retval;
+    UA_Double seconds;
+
+    init_discovery(&discovery, client, root, root_name,
+                   operation_limit(client, UA_NS0ID_SERVER_SERVERCAPABILITIES_OPERATIONLIMITS_MAXNODESPERBROWSE,
+                                   options->batch),
+                   operation_limit(client, UA_NS0ID_SERVER_SERVERCAPABILITIES_OPERATIONLIMITS_MAXNODESPERREAD,
+                                   options->batch),
+                   options->pipeline);
+    retval = discovery_run(&discovery, &running);
+
+    seconds = (UA_Double)(UA_DateTime_nowMonotonic() - start) / UA_DATETIME_SEC;
+
+    if (!running) {
+        fprintf(stderr, "Interrupted\n");
+    } else if (retval != UA_STATUSCODE_GOOD) {
+        fprintf(stderr, "Browse of %s failed: %s, nothing written\n", options->url, UA_StatusCode_name(retval));
+    } else {
+        printf("discover: %zu objects, %zu variables in %zu requests, %zu nodes sent again (%.2f s)\n",
+               discovery.object_count, discovery.variable_count, discovery.requests, discovery.retries, seconds);
+        subscriptions = discovery_subscriptions(&discovery);
+    }
+
+    free_discovery(&discovery);
+    return subscriptions;
+}
+
+static void usage(const char* program){
+    fprintf(stderr,
+            "Usage: %s [options] <opc.tcp://machine:4840>\n"
+            "  --output <file>       machine file to write or refresh (default: standard output)\n"
+            "  --root <nodeid>       node whose subtree is browsed (default i=85, the Objects folder)\n"
+            "  --name <name>         machine name (default: kept from the machine file, or the root browse name)\n"
+            "  --namespace <uri>     namespace of the machine (default: kept from the machine file, or the name)\n"
+            "  --batch <n>           nodes per Browse and Read request (default: server limits, at most %d)\n"
+            "  --pipeline <n>        requests in flight (default %d)\n"
+            "  --cache <file>        browse cache (default <output>.cache)\n"
+            "  --refresh             browse even if the model of the server is unchanged\n"
+            "  --help                show this help\n",
+            program, DISCOVER_DEFAULT_BATCH, DISCOVER_DEFAULT_PIPELINE);
+}
+
+int main(int argc, char *argv[]) {
+
+    DiscoverOptions options = {NULL, NULL, NULL, NULL, NULL, "i=85", 0, DISCOVER_DEFAULT_PIPELINE, false};
+    struct json_object* subscriptions;
+    struct json_object* existing = NULL;
+    struct json_object* machine;
+    UA_NodeId root = UA_NODEID_NULL;
+    UA_QualifiedName browse_name;
+    UA_Client* client;
+    char* root_name = NULL;
+    char* cache_path = NULL;
+    char key[17];
+    size_t dropped = 0;
+    int status = EXIT_SUCCESS;
+    int option;
+
+    static struct option long_options[] = {
+        {"output", required_argument, NULL, 'o'},
+        {"root", required_argument, NULL, 'r'},
+        {"name", required_argument, NULL, 'n'},
+        {"namespace", required_argument, NULL, 'N'},
+        {"batch", required_argument, NULL, 'b'},
+        {"pipeline", required_argument, NULL, 'p'},
+        {"cache", required_argument, NULL, 'c'},
+        {"refresh", no_argument, NULL, 'R'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'o': options.output = optarg; break;
+            case 'r': options.root = optarg; break;
+            case 'n': options.name = optarg; break;
+            case 'N': options.namespace = optarg; break;
+            case 'b': options.batch = strtoul(optarg, NULL, 10); break;
+            case 'p': options.pipeline = strtoul(optarg, NULL, 10); break;
+            case 'c': options.cache = optarg; break;
+            case 'R': options.refresh = true; break;
+            case 'h':
+                usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind < argc) options.url = argv[optind];
+    if (options.pipeline == 0) options.pipeline = 1;
+
+    if (!options.url || UA_NodeId_parse(&root, UA_STRING((char*)options.root)) != UA_STATUSCODE_GOOD) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // The cache is not a .json file, the gateway would load it as a machine
+    if (!options.cache && options.output) {
+        size_t length = strlen(options.output) + sizeof(".cache");
+
+        cache_path = (char*)malloc(length);
+        if (!cache_path) {
+            fprintf(stderr, "Failed to allocate memory for the cache path\n");
+            exit(EXIT_FAILURE);
+        }
+        snprintf(cache_path, length, "%s.cache", options.output);
+        options.cache = cache_path;
+    }
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    client = UA_Client_new();
+    if (client) {
+        UA_ClientConfig* config = UA_Client_getConfig(client);
+
+        config->logging = UA_Log_Stdout_new(UA_LOGLEVEL_WARNING);
+        UA_ClientConfig_setDefault(config);
+    }
+    if (!client || UA_Client_connect(client, options.url) != UA_STATUSCODE_GOOD) {
+        fprintf(stderr, "Cannot connect to %s\n", options.url);
+        UA_Client_delete(client);
+        UA_NodeId_clear(&root);
+        free(cache_path);
+        return EXIT_FAILURE;
+    }
+
+    snprintf(key, sizeof(key), "%016" PRIx64, (uint64_t)model_key(client, &options));
+
+    subscriptions = options.refresh ? NULL : load_cache(options.cache, key, &root_name);
+    if (subscriptions) {
+        printf("discover: model of %s unchanged, %zu groups taken from %s\n", options.url,
+               json_object_array_length(subscriptions), options.cache);
+    } else {
+        UA_QualifiedName_init(&browse_name);
+        UA_Client_readBrowseNameAttribute(client, root, &browse_name);
+        root_name = browse_name.name.length > 0 ? string_dup(&browse_name.name) : strdup(options.root);
+        UA_QualifiedName_clear(&browse_name);
+
+        subscriptions = discover(client, &options, &root, root_name);
+        if (subscriptions) save_cache(options.cache, key, root_name, subscriptions);
+    }
+
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+    UA_NodeId_clear(&root);
+
+    if (!subscriptions) {
+        free(root_name);
+        free(cache_path);
+        return EXIT_FAILURE;
+    }
+
+    if (options.output) existing = json_object_from_file(options.output);
+    machine = build_machine(existing, subscriptions, &options, root_name ? root_name : options.root, &dropped);
+    if (dropped > 0) printf("discover: %zu groups without their nodes on the server were dropped\n", dropped);
+
+    if (!options.output) {
+        puts(json_object_to_json_string_ext(machine, JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_SPACED | JSON_C_TO_STRING_NOSLASHESCAPE));
+    } else if (!write_file(options.output, machine, JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_SPACED | JSON_C_TO_STRING_NOSLASHESCAPE)) {
+        fprintf(stderr, "Failed to write %s\n", options.output);
+        status = EXIT_FAILURE;
+    } else {
+        printf("discover: wrote %s\n", options.output);
+    }
+
+    json_object_put(machine);
+    json_object_put(existing);
+    json_object_put(subscriptions);
+    free(root_name);
+    free(cache_path);
+
+    return status;
+}
@@ -0,0 +1,721 @@
+#include <open62541/client.h>
+#include <open62541/client_config_default.h>
+#include <open62541/client_highlevel.h>
+#include <open62541/client_subscriptions.h>
+#include <open62541/plugin/log_stdout.h>
+
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/// @brief Load generator and publish-latency benchmark for the gateway
+/// @details Opens many client sessions against the server, each with its own subscriptions and
+/// monitored items on the gateway variables, and measures for every notification the delay between
+/// its timestamp and its reception. After the warm-up it reports the latency distribution, the
+/// notification throughput, the fairness between sessions, the session setup time and the CPU used
+/// on the client side. The variables are discovered by browsing the server once; sessions monitor
+/// them round-robin, so several sessions may watch the same variable as HMIs do.
+/// Run the generator on the gateway host (or with synchronized clocks), latencies compare the
+/// server-side timestamps with the local clock.
+
+/// @brief Sub-buckets per power of two of the latency histogram, about 6% resolution
+#define LOADGEN_SUB_BUCKETS 16
+/// @brief Number of latency buckets, up to 2^36 microseconds
+#define LOADGEN_BUCKETS (LOADGEN_SUB_BUCKETS + 32 * LOADGEN_SUB_BUCKETS)
+/// @brief Monitored items created per CreateMonitoredItems request
+#define LOADGEN_ITEMS_PER_CALL 1000
+/// @brief Pause between two rounds over the sessions of a worker, in microseconds
+#define LOADGEN_IDLE_SLEEP 100
+
+typedef struct {
+    UA_UInt64 counts[LOADGEN_BUCKETS];
+    UA_UInt64 total;
+    UA_Int64 max;
+    UA_Double sum;
+} LatencyHistogram;
+
+typedef struct {
+    const char* url;
+    size_t sessions;
+    size_t subscriptions;
+    size_t items;
+    UA_Double sampling;
+    UA_Double publishing;
+    UA_UInt32 queue_size;
+    UA_Double duration;
+    UA_Double warmup;
+    size_t threads;
+    const char* policy;
+    UA_MessageSecurityMode mode;
+    const char* certificate;
+    const char* key;
+    const char* application_uri;
+    bool server_timestamp;
+    const char* csv;
+} LoadOptions;
+
+typedef struct {
+    UA_Client* client;
+    size_t index;
+    bool connected;
+    bool server_timestamp;
+    size_t item_count;
+    UA_Double connect_ms;
+    UA_UInt64 notifications;
+    UA_UInt64 bad_values;
+    LatencyHistogram latency;
+} LoadSession;
+
+typedef struct {
+    pthread_t thread;
+    const LoadOptions* options;
+    const UA_NodeId* nodes;
+    size_t node_count;
+    LoadSession* sessions;
+    size_t session_count;
+} LoadWorker;
+
+static const struct {
+    const char* name;
+    const char* uri;
+} POLICIES[] = {
+    {"None", "http://opcfoundation.org/UA/SecurityPolicy#None"},
+    {"Basic128Rsa15", "http://opcfoundation.org/UA/SecurityPolicy#Basic128Rsa15"},
+    {"Basic256", "http://opcfoundation.org/UA/SecurityPolicy#Basic256"},
+    {"Basic256Sha256", "http://opcfoundation.org/UA/SecurityPolicy#Basic256Sha256"},
+    {"Aes128_Sha256_RsaOaep", "http://opcfoundation.org/UA/SecurityPolicy#Aes128_Sha256_RsaOaep"},
+    {"Aes256_Sha256_RsaPss", "http://opcfoundation.org/UA/SecurityPolicy#Aes256_Sha256_RsaPss"}
+};
+
+static volatile sig_atomic_t running = true;
+
+// Start gate: the workers open their sessions, then wait until the measurement window is set
+static pthread_mutex_t gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static size_t workers_ready = 0;
+static bool gate_open = false;
+static UA_DateTime measure_start;
+static UA_DateTime measure_end;
+
+static void stop_handler(int sig){
+    (void)sig;
+    running = false;
+}
+
+/// @brief Histogram bucket of a latency in microseconds
+static size_t histogram_bucket(UA_Int64 us){
+
+    int exponent = 0;
+
+    if (us < LOADGEN_SUB_BUCKETS) return (size_t)(us < 0 ? 0 : us);
+
+    while ((us >> exponent) >= 2 * LOADGEN_SUB_BUCKETS) exponent++;
+    if (exponent >= 32) return LOADGEN_BUCKETS - 1;
+
+    return LOADGEN_SUB_BUCKETS + (size_t)exponent * LOADGEN_SUB_BUCKETS + (size_t)((us >> exponent) - LOADGEN_SUB_BUCKETS);
+}
+
+/// @brief Lower bound in microseconds of a histogram bucket
+static UA_Int64 histogram_lower_bound(size_t bucket){
+
+    size_t exponent;
+
+    if (bucket < LOADGEN_SUB_BUCKETS) return (UA_Int64)bucket;
+
+    exponent = (bucket - LOADGEN_SUB_BUCKETS) / LOADGEN_SUB_BUCKETS;
+    return (UA_Int64)(LOADGEN_SUB_BUCKETS + (bucket - LOADGEN_SUB_BUCKETS) % LOADGEN_SUB_BUCKETS) << exponent;
+}
+
+static void histogram_record(LatencyHistogram* histogram, UA_Int64 us){
+
+    if (us < 0) us = 0;
+
+    histogram->counts[histogram_bucket(us)]++;
+    histogram->total++;
+    histogram->sum += (UA_Double)us;
+    if (us > histogram->max) histogram->max = us;
+}
+
+static void histogram_merge(LatencyHistogram* into, const LatencyHistogram* from){
+
+    for (size_t b = 0; b < LOADGEN_BUCKETS; b++) into->counts[b] += from->counts[b];
+    into->total += from->total;
+    into->sum += from->sum;
+    if (from->max > into->max) into->max = from->max;
+}
+
+/// @brief Latency below which a fraction of the notifications arrived
+static UA_Int64 histogram_percentile(const LatencyHistogram* histogram, UA_Double fraction){
+
+    UA_UInt64 target = (UA_UInt64)ceil(fraction * (UA_Double)histogram->total);
+    UA_UInt64 seen = 0;
+
+    if (histogram->total == 0) return 0;
+    if (target == 0) target = 1;
+
+    for (size_t b = 0; b < LOADGEN_BUCKETS; b++) {
+        seen += histogram->counts[b];
+        if (seen >= target) return histogram_lower_bound(b);
+    }
+
+    return histogram->max;
+}
+
+/// @brief Read a whole file, for the client certificate and key
+static UA_ByteString load_file(const char* path){
+
+    UA_ByteString content = UA_BYTESTRING_NULL;
+    FILE* file = fopen(path, "rb");
+    long length;
+
+    if (!file) return content;
+
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (length > 0 && UA_ByteString_allocBuffer(&content, (size_t)length) == UA_STATUSCODE_GOOD) {
+        if (fread(content.data, 1, (size_t)length, file) != (size_t)length) UA_ByteString_clear(&content);
+    }
+
+    fclose(file);
+    return content;
+}
+
+/// @brief Sort the references of a browse result into variables and nodes still to browse
+static void collect_references(const UA_BrowseResult* result, UA_UInt16 skip_namespace, UA_NodeId** variables,
+                               size_t* count, UA_NodeId** queue, size_t* queue_count){
+
+    for (size_t r = 0; r < result->referencesSize; r++) {
+        const UA_ReferenceDescription* reference = &result->references[r];
+        const UA_NodeId* target = &reference->nodeId.nodeId;
+
+        // Namespace 0 and the gateway diagnostics are not item values
+        if (target->namespaceIndex == 0 || target->namespaceIndex == skip_namespace) continue;
+
+        if (reference->nodeClass == UA_NODECLASS_VARIABLE) {
+            UA_Array_appendCopy((void**)variables, count, target, &UA_TYPES[UA_TYPES_NODEID]);
+            continue;
+        }
+
+        // Objects may be reached through several hierarchical references
+        for (size_t q = 0; q < *queue_count && target; q++) {
+            if (UA_NodeId_equal(&(*queue)[q], target)) target = NULL;
+        }
+        if (target) UA_Array_appendCopy((void**)queue, queue_count, target, &UA_TYPES[UA_TYPES_NODEID]);
+    }
+}
+
+/// @brief Collect the variables below a node, breadth first
+/// @return Number of variables found, the caller frees the array with UA_Array_delete
+static size_t discover_variables(UA_Client* client, UA_NodeId root, UA_UInt16 skip_namespace, UA_NodeId** variables){
+
+    UA_NodeId* queue = NULL;
+    size_t queue_head = 0;
+    size_t queue_count = 0;
+    size_t count = 0;
+
+    *variables = NULL;
+    if (UA_Array_appendCopy((void**)&queue, &queue_count, &root, &UA_TYPES[UA_TYPES_NODEID]) != UA_STATUSCODE_GOOD) return 0;
+
+    while (queue_head < queue_count && running) {
+        UA_BrowseRequest request;
+        UA_BrowseResponse response;
+        UA_BrowseNextRequest next;
+        UA_BrowseNextResponse next_response;
+        UA_ByteString continuation = UA_BYTESTRING_NULL;
+
+        UA_BrowseRequest_init(&request);
+        request.nodesToBrowse = UA_BrowseDescription_new();
+        request.nodesToBrowseSize = 1;
+        UA_NodeId_copy(&queue[queue_head++], &request.nodesToBrowse[0].nodeId);
+        request.nodesToBrowse[0].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+        request.nodesToBrowse[0].includeSubtypes = true;
+        request.nodesToBrowse[0].browseDirection = UA_BROWSEDIRECTION_FORWARD;
+        request.nodesToBrowse[0].nodeClassMask = UA_NODECLASS_OBJECT | UA_NODECLASS_VARIABLE;
+        request.nodesToBrowse[0].resultMask = UA_BROWSERESULTMASK_NODECLASS;
+
+        response = UA_Client_Service_browse(client, request);
+        if (response.responseHeader.serviceResult == UA_STATUSCODE_GOOD && response.resultsSize == 1) {
+            collect_references(&response.results[0], skip_namespace, variables, &count, &queue, &queue_count);
+            UA_ByteString_copy(&response.results[0].continuationPoint, &continuation);
+        }
+        UA_BrowseResponse_clear(&response);
+        UA_BrowseRequest_clear(&request);
+
+        while (continuation.length > 0) {
+            UA_BrowseNextRequest_init(&next);
+            next.continuationPoints = &continuation;
+            next.continuationPointsSize = 1;
+
+            next_response = UA_Client_Service_browseNext(client, next);
+            UA_ByteString_clear(&continuation);
+
+            if (next_response.responseHeader.serviceResult == UA_STATUSCODE_GOOD && next_response.resultsSize == 1) {
+                collect_references(&next_response.results[0], skip_namespace, variables, &count, &queue, &queue_count);
+                UA_ByteString_copy(&next_response.results[0].continuationPoint, &continuation);
+            }
+            UA_BrowseNextResponse_clear(&next_response);
+        }
+    }
+
+    UA_Array_delete(queue, queue_count, &UA_TYPES[UA_TYPES_NODEID]);
+    return count;
+}
+
+/// @brief Create a client configured with the requested security policy
+static UA_Client* create_client(const LoadOptions* options){
+
+    UA_Client* client = UA_Client_new();
+    UA_ClientConfig* config;
+
+    if (!client) return NULL;
+
+    config = UA_Client_getConfig(client);
+    config->logging = UA_Log_Stdout_new(UA_LOGLEVEL_WARNING);
+    UA_ClientConfig_setDefault(config);
+
+    for (size_t p = 0; p < sizeof(POLICIES) / sizeof(POLICIES[0]); p++) {
+        if (strcmp(POLICIES[p].name, options->policy) != 0) continue;
+
+        if (p > 0) {
+#ifdef UA_ENABLE_ENCRYPTION
+            UA_ByteString certificate = load_file(options->certificate);
+            UA_ByteString key = load_file(options->key);
+
+            UA_ClientConfig_setDefaultEncryption(config, certificate, key, NULL, 0, NULL, 0);
+            // The server checks it against the URI of the client certificate
+            UA_String_clear(&config->clientDescription.applicationUri);
+            config->clientDescription.applicationUri = UA_STRING_ALLOC(options->application_uri);
+            UA_ByteString_clear(&certificate);
+            UA_ByteString_clear(&key);
+#endif
+        }
+
+        config->securityMode = p > 0 ? options->mode : UA_MESSAGESECURITYMODE_NONE;
+        config->securityPolicyUri = UA_STRING_ALLOC(POLICIES[p].uri);
+    }
+
+    return client;
+}
+
+/// @brief Monitored-item callback measuring the notification latency
+static void on_data_change(UA_Client* client, UA_UInt32 subscription_id, void* subscription_context,
+                           UA_UInt32 monitored_id, void* monitored_context, UA_DataValue* value){
+    (void)client; (void)subscription_id; (void)subscription_context; (void)monitored_id;
+
+    LoadSession* session = (LoadSession*)monitored_context;
+    UA_DateTime now = UA_DateTime_now();
+    UA_DateTime stamp;
+
+    // Initial values and values after the end of the run are not measured
+    if (now < measure_start || now > measure_end) return;
+
+    session->notifications++;
+    if (value->hasStatus && UA_StatusCode_isBad(value->status)) session->bad_values++;
+
+    stamp = (!session->server_timestamp && value->hasSourceTimestamp) ? value->sourceTimestamp : value->serverTimestamp;
+    if (stamp == 0) return;
+
+    histogram_record(&session->latency, (now - stamp) / UA_DATETIME_USEC);
+}
+
+/// @brief Disconnect and delete the client of a session that could not be opened
+static void close_session(LoadSession* session){
+
+    if (session->client) {
+        UA_Client_disconnect(session->client);
+        UA_Client_delete(session->client);
+    }
+    session->client = NULL;
+    session->connected = false;
+    session->item_count = 0;
+}
+
+/// @brief Open a session with its subscriptions and monitored items
+/// @note A session that fails to open is closed, its client is deleted and it is reported as not connected.
+static bool open_session(LoadWorker* worker, LoadSession* session, size_t first_node){
+
+    const LoadOptions* options = worker->options;
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    size_t created = 0;
+
+    session->client = create_client(options);
+    if (!session->client || UA_Client_connect(session->client, options->url) != UA_STATUSCODE_GOOD) {
+        close_session(session);
+        return false;
+    }
+
+    session->connect_ms = (UA_Double)(UA_DateTime_nowMonotonic() - start) / UA_DATETIME_MSEC;
+    session->connected = true;
+
+    for (size_t s = 0; s < options->subscriptions; s++) {
+        UA_CreateSubscriptionRequest request = UA_CreateSubscriptionRequest_default();
+        UA_CreateSubscriptionResponse response;
+        size_t items = options->items / options->subscriptions + (s < options->items % options->subscriptions ? 1 : 0);
+
+        request.requestedPublishingInterval = options->publishing;
+        request.maxNotificationsPerPublish = 0;
+
+        response = UA_Client_Subscriptions_create(session->client, request, NULL, NULL, NULL);
+        if (response.responseHeader.serviceResult != UA_STATUSCODE_GOOD) {
+            UA_CreateSubscriptionResponse_clear(&response);
+            close_session(session);
+            return false;
+        }
+
+        for (size_t done = 0; done < items; done += LOADGEN_ITEMS_PER_CALL) {
+            size_t batch = items - done < LOADGEN_ITEMS_PER_CALL ? items - done : LOADGEN_ITEMS_PER_CALL;
+            UA_MonitoredItemCreateRequest requests[LOADGEN_ITEMS_PER_CALL];
+            UA_Client_DataChangeNotificationCallback callbacks[LOADGEN_ITEMS_PER_CALL];
+            void* contexts[LOADGEN_ITEMS_PER_CALL];
+            UA_CreateMonitoredItemsRequest create;
+            UA_CreateMonitoredItemsResponse created_items;
+
+            for (size_t i = 0; i < batch; i++) {
+                requests[i] = UA_MonitoredItemCreateRequest_default(worker->nodes[(first_node + created + i) % worker->node_count]);
+                requests[i].requestedParameters.samplingInterval = options->sampling;
+                requests[i].requestedParameters.queueSize = options->queue_size;
+                callbacks[i] = on_data_change;
+                contexts[i] = session;
+            }
+
+            UA_CreateMonitoredItemsRequest_init(&create);
+            create.subscriptionId = response.subscriptionId;
+            create.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+            create.itemsToCreate = requests;
+            create.itemsToCreateSize = batch;
+
+            created_items = UA_Client_MonitoredItems_createDataChanges(session->client, create, contexts, callbacks, NULL);
+            for (size_t i = 0; i < created_items.resultsSize; i++) {
+                if (created_items.results[i].statusCode == UA_STATUSCODE_GOOD) session->item_count++;
+            }
+            created += batch;
+
+            // The requests only borrow the NodeIds of the worker
+            UA_CreateMonitoredItemsResponse_clear(&created_items);
+        }
+
+        UA_CreateSubscriptionResponse_clear(&response);
+    }
+
+    return true;
+}
+
+/// @brief Worker thread driving a slice of the sessions
+static void* run_worker(void* data){
+
+    LoadWorker* worker = (LoadWorker*)data;
+    struct timespec idle = {0, LOADGEN_IDLE_SLEEP * 1000};
+
+    for (size_t s = 0; s < worker->session_count && running; s++) {
+        LoadSession* session = &worker->sessions[s];
+
+        if (!open_session(worker, session, session->index * worker->options->items)) {
+            fprintf(stderr, "Session %zu failed to open\n", session->index);
+        }
+    }
+
+    pthread_mutex_lock(&gate_lock);
+    workers_ready++;
+    pthread_cond_broadcast(&gate_cond);
+    while (!gate_open) pthread_cond_wait(&gate_cond, &gate_lock);
+    pthread_mutex_unlock(&gate_lock);
+
+    while (running && UA_DateTime_now() < measure_end) {
+        for (size_t s = 0; s < worker->session_count; s++) {
+            if (worker->sessions[s].client) UA_Client_run_iterate(worker->sessions[s].client, 0);
+        }
+        nanosleep(&idle, NULL);
+    }
+
+    for (size_t s = 0; s < worker->session_count; s++) {
+        if (!worker->sessions[s].client) continue;
+        UA_Client_disconnect(worker->sessions[s].client);
+        UA_Client_delete(worker->sessions[s].client);
+        worker->sessions[s].client = NULL;
+    }
+
+    return NULL;
+}
+
+/// @brief Print the results and append them to the CSV file if requested
+static void report(const LoadOptions* options, LoadSession* sessions, UA_Double seconds, UA_Double cpu){
+
+    LatencyHistogram total;
+    UA_Double rate_sum = 0.0;
+    UA_Double rate_squares = 0.0;
+    UA_Double rate_min = INFINITY;
+    UA_Double rate_max = 0.0;
+    UA_Double connect_sum = 0.0;
+    UA_Double connect_max = 0.0;
+    UA_Int64 p99_min = INT64_MAX;
+    UA_Int64 p99_max = 0;
+    UA_UInt64 bad = 0;
+    size_t connected = 0;
+    size_t items = 0;
+    UA_Double fairness;
+
+    memset(&total, 0, sizeof(total));
+
+    for (size_t s = 0; s < options->sessions; s++) {
+        UA_Double rate = (UA_Double)sessions[s].notifications / seconds;
+        UA_Int64 p99 = histogram_percentile(&sessions[s].latency, 0.99);
+
+        if (!sessions[s].connected) continue;
+
+        connected++;
+        items += sessions[s].item_count;
+        bad += sessions[s].bad_values;
+        histogram_merge(&total, &sessions[s].latency);
+
+        rate_sum += rate;
+        rate_squares += rate * rate;
+        if (rate < rate_min) rate_min = rate;
+        if (rate > rate_max) rate_max = rate;
+        if (p99 < p99_min) p99_min = p99;
+        if (p99 > p99_max) p99_max = p99;
+        connect_sum += sessions[s].connect_ms;
+        if (sessions[s].connect_ms > connect_max) connect_max = sessions[s].connect_ms;
+    }
+
+    // Jain's index: 1 when every session receives the same rate, 1/n when one gets everything
+    fairness = rate_squares > 0.0 ? rate_sum * rate_sum / ((UA_Double)connected * rate_squares) : 0.0;
+    if (connected == 0) rate_min = p99_min = 0;
+
+    printf("loadgen: %zu sessions x %zu subscriptions, %zu items per session, sampling %g ms, publishing %g ms, "
+           "policy %s%s, %g s measured\n", options->sessions, options->subscriptions, options->items,
+           options->sampling, options->publishing, options->policy,
+           strcmp(options->policy, "None") == 0 ? "" :
+           options->mode == UA_MESSAGESECURITYMODE_SIGN ? " (Sign)" : " (SignAndEncrypt)", seconds);
+    printf("sessions:      %zu/%zu connected, %zu monitored items, connect mean %.1f ms max %.1f ms\n",
+           connected, options->sessions, items, connected ? connect_sum / (UA_Double)connected : 0.0, connect_max);
+    printf("notifications: %llu (%.0f/s), %llu bad\n", (unsigned long long)total.total,
+           (UA_Double)total.total / seconds, (unsigned long long)bad);
+    printf("latency (us):  p50 %lld  p90 %lld  p99 %lld  p99.9 %lld  max %lld  mean %.0f\n",
+           (long long)histogram_percentile(&total, 0.50), (long long)histogram_percentile(&total, 0.90),
+           (long long)histogram_percentile(&total, 0.99), (long long)histogram_percentile(&total, 0.999),
+           (long long)total.max, total.total ? total.sum / (UA_Double)total.total : 0.0);
+    printf("per session:   %.0f-%.0f notifications/s, p99 %lld-%lld us, Jain fairness %.4f\n",
+           rate_min, rate_max, (long long)p99_min, (long long)p99_max, fairness);
+    printf("client cpu:    %.2f s (%.0f%% of one core)\n", cpu, 100.0 * cpu / seconds);
+
+    if (options->csv) {
+        FILE* file = fopen(options->csv, "a+");
+
+        if (!file) {
+            fprintf(stderr, "Cannot open %s\n", options->csv);
+            return;
+        }
+
+        fseek(file, 0, SEEK_END);
+        if (ftell(file) == 0) {
+            fprintf(file, "policy,mode,sessions,subscriptions,items,sampling_ms,publishing_ms,seconds,connected,"
+                          "connect_mean_ms,notifications_per_s,p50_us,p90_us,p99_us,p999_us,max_us,fairness,client_cpu_s\n");
+        }
+        fprintf(file, "%s,%s,%zu,%zu,%zu,%g,%g,%g,%zu,%.2f,%.1f,%lld,%lld,%lld,%lld,%lld,%.4f,%.2f\n",
+                options->policy, strcmp(options->policy, "None") == 0 ? "None" :
+                options->mode == UA_MESSAGESECURITYMODE_SIGN ? "Sign" : "SignAndEncrypt",
+                options->sessions, options->subscriptions, options->items, options->sampling, options->publishing,
+                seconds, connected, connected ? connect_sum / (UA_Double)connected : 0.0, (UA_Double)total.total / seconds,
+                (long long)histogram_percentile(&total, 0.50), (long long)histogram_percentile(&total, 0.90),
+                (long long)histogram_percentile(&total, 0.99), (long long)histogram_percentile(&total, 0.999),
+                (long long)total.max, fairness, cpu);
+        fclose(file);
+    }
+}
+
+static void usage(const char* program){
+    fprintf(stderr,
+            "Usage: %s [options] [opc.tcp://localhost:62541]\n"
+            "  --sessions <n>        client sessions (default 10)\n"
+            "  --subscriptions <n>   subscriptions per session (default 1)\n"
+            "  --items <n>           monitored items per session (default 100)\n"
+            "  --sampling <ms>       sampling interval (default 100)\n"
+            "  --publishing <ms>     publishing interval (default: sampling interval)\n"
+            "  --queue-size <n>      monitored item queue size (default 1)\n"
+            "  --duration <s>        measured duration (default 30)\n"
+            "  --warmup <s>          time before measuring, after the sessions are open (default 2)\n"
+            "  --threads <n>         client threads sharing the sessions (default 1)\n"
+            "  --policy <name>       None, Basic128Rsa15, Basic256, Basic256Sha256,\n"
+            "                        Aes128_Sha256_RsaOaep or Aes256_Sha256_RsaPss (default None)\n"
+            "  --mode <mode>         Sign or SignAndEncrypt (default SignAndEncrypt)\n"
+            "  --certificate <file>  client certificate (DER) for the secure policies\n"
+            "  --key <file>          client private key (DER) for the secure policies\n"
+            "  --application-uri <u> URI of the client certificate (default urn:open62541.client.application)\n"
+            "  --server-timestamp    measure from the server timestamp instead of the source timestamp\n"
+            "  --csv <file>          append the results to a CSV file\n"
+            "  --help                show this help\n",
+            program);
+}
+
+int main(int argc, char *argv[]) {
+
+    LoadOptions options = {"opc.tcp://localhost:62541", 10, 1, 100, 100.0, 0.0, 1, 30.0, 2.0, 1, "None",
+                           UA_MESSAGESECURITYMODE_SIGNANDENCRYPT, NULL, NULL, "urn:open62541.client.application",
+                           false, NULL};
+    LoadSession* sessions;
+    LoadWorker* workers;
+    UA_Client* browser;
+    UA_NodeId* nodes = NULL;
+    size_t node_count;
+    size_t policy = 0;
+    UA_UInt16 gateway_namespace = 0;
+    UA_String gateway_uri = UA_STRING("urn:opcuaserver:gateway");
+    clock_t cpu_start;
+    UA_DateTime open_end;
+    UA_Double measured;
+    int option;
+
+    static struct option long_options[] = {
+        {"sessions", required_argument, NULL, 'n'},
+        {"subscriptions", required_argument, NULL, 'S'},
+        {"items", required_argument, NULL, 'i'},
+        {"sampling", required_argument, NULL, 's'},
+        {"publishing", required_argument, NULL, 'p'},
+        {"queue-size", required_argument, NULL, 'q'},
+        {"duration", required_argument, NULL, 'd'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"threads", required_argument, NULL, 't'},
+        {"policy", required_argument, NULL, 'P'},
+        {"mode", required_argument, NULL, 'm'},
+        {"certificate", required_argument, NULL, 'c'},
+        {"key", required_argument, NULL, 'k'},
+        {"application-uri", required_argument, NULL, 'u'},
+        {"server-timestamp", no_argument, NULL, 'T'},
+        {"csv", required_argument, NULL, 'o'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'n': options.sessions = strtoul(optarg, NULL, 10); break;
+            case 'S': options.subscriptions = strtoul(optarg, NULL, 10); break;
+            case 'i': options.items = strtoul(optarg, NULL, 10); break;
+            case 's': options.sampling = atof(optarg); break;
+            case 'p': options.publishing = atof(optarg); break;
+            case 'q': options.queue_size = (UA_UInt32)strtoul(optarg, NULL, 10); break;
+            case 'd': options.duration = atof(optarg); break;
+            case 'w': options.warmup = atof(optarg); break;
+            case 't': options.threads = strtoul(optarg, NULL, 10); break;
+            case 'P': options.policy = optarg; break;
+            case 'm':
+                options.mode = strcmp(optarg, "Sign") == 0 ? UA_MESSAGESECURITYMODE_SIGN : UA_MESSAGESECURITYMODE_SIGNANDENCRYPT;
+                break;
+            case 'c': options.certificate = optarg; break;
+            case 'k': options.key = optarg; break;
+            case 'u': options.application_uri = optarg; break;
+            case 'T': options.server_timestamp = true; break;
+            case 'o': options.csv = optarg; break;
+            case 'h':
+                usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind < argc) options.url = argv[optind];
+    if (options.publishing <= 0.0) options.publishing = options.sampling;
+    if (options.threads == 0) options.threads = 1;
+    if (options.threads > options.sessions) options.threads = options.sessions;
+
+    for (policy = 0; policy < sizeof(POLICIES) / sizeof(POLICIES[0]); policy++) {
+        if (strcmp(POLICIES[policy].name, options.policy) == 0) break;
+    }
+    if (options.sessions == 0 || options.subscriptions == 0 || options.items < options.subscriptions ||
+        options.duration <= 0.0 || policy == sizeof(POLICIES) / sizeof(POLICIES[0])) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (policy > 0 && (!options.certificate || !options.key)) {
+        fprintf(stderr, "Policy %s needs --certificate and --key\n", options.policy);
+        return EXIT_FAILURE;
+    }
+#ifndef UA_ENABLE_ENCRYPTION
+    if (policy > 0) {
+        fprintf(stderr, "open62541 was built without encryption\n");
+        return EXIT_FAILURE;
+    }
+#endif
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    // Discover the gateway variables once
+    browser = create_client(&options);
+    if (!browser || UA_Client_connect(browser, options.url) != UA_STATUSCODE_GOOD) {
+        fprintf(stderr, "Cannot connect to %s\n", options.url);
+        UA_Client_delete(browser);
+        return EXIT_FAILURE;
+    }
+    UA_Client_NamespaceGetIndex(browser, &gateway_uri, &gateway_namespace);
+    node_count = discover_variables(browser, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), gateway_namespace, &nodes);
+    UA_Client_disconnect(browser);
+    UA_Client_delete(browser);
+
+    if (node_count == 0) {
+        fprintf(stderr, "No variable to monitor on %s\n", options.url);
+        return EXIT_FAILURE;
+    }
+    printf("loadgen: %zu variables found on %s\n", node_count, options.url);
+
+    sessions = (LoadSession*)calloc(options.sessions, sizeof(LoadSession));
+    workers = (LoadWorker*)calloc(options.threads, sizeof(LoadWorker));
+    if (!sessions || !workers) {
+        fprintf(stderr, "Failed to allocate memory for the sessions\n");
+        exit(EXIT_FAILURE);
+    }
+
+    cpu_start = clock();
+
+    for (size_t s = 0; s < options.sessions; s++) {
+        sessions[s].index = s;
+        sessions[s].server_timestamp = options.server_timestamp;
+    }
+
+    for (size_t t = 0; t < options.threads; t++) {
+        size_t first = options.sessions * t / options.threads;
+        size_t last = options.sessions * (t + 1) / options.threads;
+
+        workers[t].options = &options;
+        workers[t].nodes = nodes;
+        workers[t].node_count = node_count;
+        workers[t].sessions = &sessions[first];
+        workers[t].session_count = last - first;
+        pthread_create(&workers[t].thread, NULL, run_worker, &workers[t]);
+    }
+
+    // Warm-up and measurement start once every session is open
+    pthread_mutex_lock(&gate_lock);
+    while (workers_ready < options.threads) pthread_cond_wait(&gate_cond, &gate_lock);
+    open_end = UA_DateTime_now();
+    measure_start = open_end + (UA_DateTime)(options.warmup * UA_DATETIME_SEC);
+    measure_end = measure_start + (UA_DateTime)(options.duration * UA_DATETIME_SEC);
+    gate_open = true;
+    pthread_cond_broadcast(&gate_cond);
+    pthread_mutex_unlock(&gate_lock);
+
+    for (size_t t = 0; t < options.threads; t++) pthread_join(workers[t].thread, NULL);
+
+    // An interrupted run reports the part measured so far
+    measured = (UA_Double)((UA_DateTime_now() < measure_end ? UA_DateTime_now() : measure_end) - measure_start) / UA_DATETIME_SEC;
+    if (measured > 0.0) {
+        report(&options, sessions, measured, (UA_Double)(clock() - cpu_start) / CLOCKS_PER_SEC);
+    } else {
+        fprintf(stderr, "Interrupted before the measurement started\n");
+    }
+
+    free(workers);
+    free(sessions);
+    UA_Array_delete(nodes, node_count, &UA_TYPES[UA_TYPES_NODEID]);
+
+    return EXIT_SUCCESS;
+}